@@ -0,0 +1,340 @@
+#include "bench.h"
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <initializer_list>
+#include <map>
+#include <sstream>
+
+using namespace Bench;
+
+namespace {
+    struct Case {
+        const char* name;
+        CaseFunc    func;
+    };
+
+    std::vector<Case>& cases() {
+        static std::vector<Case> registered;
+        return registered;
+    }
+
+    void writeString(std::ostream& out, const std::string& value) {
+        out << '"';
+        for (const char c : value) {
+            if (c == '"' || c == '\\') {
+                out << '\\' << c;
+            } else if (static_cast<unsigned char>(c) < 0x20) {
+                char escaped[8];
+                std::snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned>(c));
+                out << escaped;
+            } else {
+                out << c;
+            }
+        }
+        out << '"';
+    }
+
+    void writeNumber(std::ostream& out, double value) {
+        // JSON has no infinity or NaN.
+        out << (std::isfinite(value) ? value : 0.0);
+    }
+
+    // {"results": [{"name": ..., "unit": ..., "value": ..., "p99": ..., "allocsPerOp": ...}, ...]}
+    bool save(const std::string& path, const std::vector<Result>& results) {
+        std::ofstream out(path);
+        out.precision(10);
+        out << "{\n  \"results\": [";
+        for (std::size_t i = 0; i < results.size(); i++) {
+            const Result& result = results[i];
+            out << (i == 0 ? "\n    {" : ",\n    {") << "\"name\": ";
+            writeString(out, result.name);
+            out << ", \"unit\": ";
+            writeString(out, result.unit);
+            out << ", \"value\": ";
+            writeNumber(out, result.value);
+            out << ", \"p99\": ";
+            writeNumber(out, result.p99);
+            out << ", \"allocsPerOp\": ";
+            writeNumber(out, result.allocsPerOp);
+            out << '}';
+        }
+        out << "\n  ]\n}\n";
+        return bool(out);
+    }
+
+    // Reads what save writes. Other members are skipped, so baselines may carry more fields.
+    class JsonReader {
+    public:
+        explicit JsonReader(const std::string& text) : m_text(text) {}
+
+        bool results(std::map<std::string, Result>& results) {
+            if (!consume('{')) {
+                return false;
+            }
+            bool found = false;
+            return members([&](const std::string& key) {
+                if (key != "results") {
+                    return skipValue();
+                }
+                found = true;
+                return consume('[') && elements([&] { return result(results); });
+            }) && found && (space(), m_position == m_text.size());
+        }
+
+    private:
+        bool result(std::map<std::string, Result>& results) {
+            Result result{};
+            if (!consume('{') || !members([&](const std::string& key) {
+                    if (key == "name") {
+                        return string(result.name);
+                    } else if (key == "unit") {
+                        return string(result.unit);
+                    } else if (key == "value") {
+                        return number(result.value);
+                    } else if (key == "p99") {
+                        return number(result.p99);
+                    } else if (key == "allocsPerOp") {
+                        return number(result.allocsPerOp);
+                    }
+                    return skipValue();
+                })) {
+                return false;
+            }
+            if (!result.name.empty()) {
+                results[result.name] = result;
+            }
+            return true;
+        }
+
+        // The members of an object whose '{' was consumed, up to and including the '}'.
+        template <typename Member>
+        bool members(Member&& member) {
+            if (consume('}')) {
+                return true;
+            }
+            do {
+                std::string key;
+                if (!string(key) || !consume(':') || !member(key)) {
+                    return false;
+                }
+            } while (consume(','));
+            return consume('}');
+        }
+
+        // The elements of an array whose '[' was consumed, up to and including the ']'.
+        template <typename Element>
+        bool elements(Element&& element) {
+            if (consume(']')) {
+                return true;
+            }
+            do {
+                if (!element()) {
+                    return false;
+                }
+            } while (consume(','));
+            return consume(']');
+        }
+
+        bool skipValue() {
+            space();
+            if (consume('{')) {
+                return members([this](const std::string&) { return skipValue(); });
+            }
+            if (consume('[')) {
+                return elements([this] { return skipValue(); });
+            }
+            if (peek() == '"') {
+                std::string ignored;
+                return string(ignored);
+            }
+            for (const char* literal : {"true", "false", "null"}) {
+                const std::size_t length = std::strlen(literal);
+                if (m_text.compare(m_position, length, literal) == 0) {
+                    m_position += length;
+                    return true;
+                }
+            }
+            double ignored;
+            return number(ignored);
+        }
+
+        bool string(std::string& value) {
+            value.clear();
+            if (!consume('"')) {
+                return false;
+            }
+            while (m_position < m_text.size()) {
+                const char c = m_text[m_position++];
+                if (c == '"') {
+                    return true;
+                }
+                if (c != '\\') {
+                    value += c;
+                    continue;
+                }
+                if (m_position >= m_text.size()) {
+                    return false;
+                }
+                const char escaped = m_text[m_position++];
+                switch (escaped) {
+                case 'b': value += '\b'; break;
+                case 'f': value += '\f'; break;
+                case 'n': value += '\n'; break;
+                case 'r': value += '\r'; break;
+                case 't': value += '\t'; break;
+                case 'u': {
+                    // Names are ASCII, other code points are kept as '?'.
+                    if (m_position + 4 > m_text.size()) {
+                        return false;
+                    }
+                    const unsigned long code = std::strtoul(m_text.substr(m_position, 4).c_str(), nullptr, 16);
+                    m_position += 4;
+                    value += code < 0x80 ? static_cast<char>(code) : '?';
+                    break;
+                }
+                default: value += escaped; break;
+                }
+            }
+            return false;
+        }
+
+        bool number(double& value) {
+            space();
+            const char* begin = m_text.c_str() + m_position;
+            char* end = nullptr;
+            value = std::strtod(begin, &end);
+            if (end == begin) {
+                return false;
+            }
+            m_position += std::size_t(end - begin);
+            return true;
+        }
+
+        void space() {
+            while (m_position < m_text.size() && std::isspace(static_cast<unsigned char>(m_text[m_position]))) {
+                m_position++;
+            }
+        }
+
+        char peek() {
+            space();
+            return m_position < m_text.size() ? m_text[m_position] : '\0';
+        }
+
+        bool consume(char c) {
+            if (peek() != c) {
+                return false;
+            }
+            m_position++;
+            return true;
+        }
+
+        const std::string&  m_text;
+        std::size_t         m_position{0};
+    };
+
+    bool load(const std::string& path, std::map<std::string, Result>& results) {
+        std::ifstream in(path);
+        if (!in) {
+            return false;
+        }
+        std::ostringstream text;
+        text << in.rdbuf();
+        const std::string json = text.str();
+        return JsonReader(json).results(results);
+    }
+
+    // Prints the change of every timing against the baseline, returns false if one got slower than allowed.
+    bool compare(const std::map<std::string, Result>& baseline, const std::vector<Result>& results, double threshold) {
+        bool passed = true;
+        std::printf("\n%-44s %12s %12s %8s\n", "compared to baseline", "before", "after", "change");
+        for (const Result& result : results) {
+            const auto before = baseline.find(result.name);
+            if (result.unit != "ns" || before == baseline.end() || before->second.value <= 0) {
+                continue;
+            }
+            const double change = (result.value / before->second.value - 1) * 100;
+            const bool regressed = threshold > 0 && change > threshold;
+            std::printf("%-44s %12.1f %12.1f %+7.1f%%%s\n", result.name.c_str(), before->second.value, result.value, change,
+                        regressed ? "  REGRESSED" : "");
+            passed = passed && !regressed;
+        }
+        return passed;
+    }
+}
+
+Registrar::Registrar(const char* name, CaseFunc func) {
+    cases().push_back(Case{name, func});
+}
+
+bool Runner::selected(const std::string& name) const {
+    return m_filter.empty() || name.find(m_filter) != std::string::npos;
+}
+
+void Runner::report(const std::string& name, std::vector<double>& samples, double allocsPerOp) {
+    std::sort(samples.begin(), samples.end());
+    const std::size_t last = samples.size() - 1;
+    Result result{name, "ns", samples[last / 2], samples[std::size_t(std::ceil(0.99 * last))], allocsPerOp};
+    std::printf("%-44s %12.1f ns/op  p99 %12.1f  %8.2f allocs/op\n", name.c_str(), result.value, result.p99, allocsPerOp);
+    std::fflush(stdout);
+    m_results.push_back(result);
+}
+
+void Runner::note(const std::string& name, double value, const char* unit) {
+    if (!selected(name)) {
+        return;
+    }
+    std::printf("%-44s %12.1f %s\n", name.c_str(), value, unit);
+    std::fflush(stdout);
+    m_results.push_back(Result{name, unit, value, value, 0});
+}
+
+int main(int argc, char** argv) {
+    bool quick = false;
+    double threshold = 0;
+    std::string filter, savePath, comparePath;
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (arg == "--quick") {
+            quick = true;
+        } else if (arg == "--filter" && hasValue) {
+            filter = argv[++i];
+        } else if (arg == "--save" && hasValue) {
+            savePath = argv[++i];
+        } else if (arg == "--compare" && hasValue) {
+            comparePath = argv[++i];
+        } else if (arg == "--threshold" && hasValue) {
+            threshold = std::atof(argv[++i]);
+        } else {
+            std::fprintf(stderr, "usage: %s [--quick] [--filter <text>] [--save <file>] [--compare <file> [--threshold <percent>]]\n",
+                         argv[0]);
+            return 2;
+        }
+    }
+
+    std::map<std::string, Result> baseline;
+    if (!comparePath.empty() && !load(comparePath, baseline)) {
+        std::fprintf(stderr, "cannot read baseline %s, expected the JSON --save writes\n", comparePath.c_str());
+        return 2;
+    }
+
+    Runner runner(quick);
+    runner.setFilter(filter);
+    for (const Case& entry : cases()) {
+        entry.func(runner);
+    }
+
+    if (!savePath.empty() && !save(savePath, runner.results())) {
+        std::fprintf(stderr, "cannot write %s\n", savePath.c_str());
+        return 2;
+    }
+    if (!comparePath.empty() && !compare(baseline, runner.results(), threshold)) {
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,114 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Bench {
+
+    struct Result {
+        std::string     name;
+        std::string     unit;           // "ns" for timings, otherwise the unit of a noted value
+        double          value;          // the median for timings
+        double          p99;
+        double          allocsPerOp;
+    };
+
+    /**
+     * Runs the measurements of one benchmark case.
+     *
+     * Each measurement is calibrated so a sample takes a fixed time, then
+     * sampled repeatedly; the median and the 99th percentile of the
+     * per-operation time are reported together with the heap allocations
+     * per operation, counted by a global operator new.
+     */
+    class Runner {
+    public:
+        explicit Runner(bool quick) : m_quick(quick) {}
+
+        template <typename Body>
+        void measure(const std::string& name, Body&& body) {
+            measure(name, 1, body);
+        }
+
+        // For bodies that perform several operations per call, such as one pass over a batch.
+        template <typename Body>
+        void measure(const std::string& name, std::size_t opsPerCall, Body&& body) {
+            if (!selected(name)) {
+                return;
+            }
+            std::size_t calls = 1;
+            for (;;) {
+                const uint64_t ns = time(calls, body);
+                if (ns >= sampleNs() || calls >= (std::size_t(1) << 30)) {
+                    break;
+                }
+                calls = ns == 0 ? calls * 16 : std::max(calls * 2, std::size_t(double(calls) * sampleNs() / ns));
+            }
+
+            std::vector<double> samples(m_quick ? 3 : 31);
+            const uint64_t allocations = allocationCount();
+            for (double& sample : samples) {
+                sample = double(time(calls, body)) / double(calls * opsPerCall);
+            }
+            const double ops = double(samples.size() * calls * opsPerCall);
+            report(name, samples, double(allocationCount() - allocations) / ops);
+        }
+
+        // Reports a value that is not a time, such as a throughput or a memory size.
+        void note(const std::string& name, double value, const char* unit);
+
+        void setFilter(const std::string& filter) { m_filter = filter; }
+        // Whether a measurement runs, for cases with setup that is worth skipping.
+        bool selected(const std::string& name) const;
+        bool quick() const { return m_quick; }
+        const std::vector<Result>& results() const { return m_results; }
+
+        static uint64_t allocationCount();
+
+    private:
+        template <typename Body>
+        static uint64_t time(std::size_t calls, Body& body) {
+            const auto begin = std::chrono::steady_clock::now();
+            for (std::size_t i = 0; i < calls; i++) {
+                body();
+            }
+            return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count());
+        }
+
+        uint64_t sampleNs() const { return m_quick ? 200000 : 5000000; }
+        void report(const std::string& name, std::vector<double>& samples, double allocsPerOp);
+
+        bool                m_quick;
+        std::string         m_filter;
+        std::vector<Result> m_results;
+    };
+
+    typedef void (*CaseFunc)(Runner& runner);
+
+    struct Registrar {
+        Registrar(const char* name, CaseFunc func);
+    };
+
+    // Keeps the compiler from dropping a computation whose result is unused.
+    template <typename T>
+    inline void keep(const T& value) {
+#if defined(__GNUC__) || defined(__clang__)
+        asm volatile("" : : "r,m"(value) : "memory");
+#else
+        static volatile const void* sink;
+        sink = &value;
+#endif
+    }
+}
+
+#define BENCH_CASE(name) \
+    static void name(Bench::Runner& runner); \
+    static const Bench::Registrar name##Registrar(#name, name); \
+    static void name(Bench::Runner& runner)
+
+#endif // BENCH_H
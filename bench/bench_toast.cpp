@@ -0,0 +1,519 @@
+#include "bench.h"
+#include "sample_pe.h"
+#include "sample_show.h"
+#include "sample_toast.h"
+#include "mpsc_queue.h"
+#include "pe_icon.h"
+#include "toast_allocator.h"
+#include "toast_arguments.h"
+#include "toast_broker.h"
+#include "toast_budget.h"
+#include "toast_descriptor.h"
+#include "toast_end_guard.h"
+#include "toast_handler.h"
+#include "toast_pipe.h"
+#include "toast_registry.h"
+#include "toast_stats.h"
+#include "toast_strings.h"
+#include "toast_template.h"
+#include "toast_xml.h"
+#include <atomic>
+#include <chrono>
+#include <list>
+#include <memory>
+#include <thread>
+
+using namespace WinToastLib;
+using Sample::promptToast;
+
+namespace {
+    // Forwards like the WinToastHandler of notification_glue.cpp, to a counter instead of the Go callbacks.
+    class CountingHandler : public IWinToastHandler {
+    public:
+        void toastActivated() const override {
+            m_events++;
+        }
+        void toastActivated(int) const override {
+            m_events++;
+        }
+        void toastDismissed(WinToastDismissalReason state) const override {
+            if (m_end.dismissed(state == TimedOut)) {
+                m_events++;
+            }
+        }
+        void toastFailed() const override {
+            if (m_end.failed()) {
+                m_events++;
+            }
+        }
+
+    private:
+        mutable WinToastEndGuard    m_end;
+        mutable uint64_t            m_events{0};
+    };
+
+    std::vector<std::wstring> actionArguments(const WinToastTemplate& toast, int64_t id) {
+        std::vector<std::wstring> arguments;
+        for (std::size_t i = 0; i < toast.actionsCount(); i++) {
+            arguments.push_back(WinToastArguments::encode(id, static_cast<int>(i), toast.activationToken()));
+        }
+        return arguments;
+    }
+}
+
+BENCH_CASE(templates) {
+    runner.measure("template/build", [] {
+        WinToastTemplate toast = promptToast();
+        Bench::keep(toast);
+    });
+    runner.measure("template/setAudioPath system file", [] {
+        WinToastTemplate toast(WinToastTemplate::Text01);
+        toast.setAudioPath(WinToastTemplate::Alarm10);
+        Bench::keep(toast);
+    });
+
+    const WinToastTemplate toast = promptToast();
+    runner.measure("template/copy", [&toast] {
+        WinToastTemplate copy(toast);
+        Bench::keep(copy);
+    });
+    // Restores the moved-from template so every call moves a full one; the swap is part of the cost.
+    WinToastTemplate moving = promptToast();
+    runner.measure("template/move twice", [&moving] {
+        WinToastTemplate moved(std::move(moving));
+        moving = std::move(moved);
+        Bench::keep(moving);
+    });
+}
+
+BENCH_CASE(xml) {
+    const WinToastTemplate toast = promptToast();
+    const std::wstring launch = WinToastArguments::encode(42, WinToastArguments::BodyAction, toast.activationToken());
+    const std::vector<std::wstring> actions = actionArguments(toast, 42);
+
+    runner.measure("xml/compose+flatten heap", [&] {
+        const WinToastXml composer(toast, launch, actions, true);
+        std::wstring xml;
+        composer.flatten(xml);
+        Bench::keep(xml);
+    });
+    // As WinToast::prepare does it: spans and text from one arena per show.
+    runner.measure("xml/compose+write arena", [&] {
+        WinToastArena arena;
+        const WinToastXml composer(toast, launch, actions, true, &arena);
+        const std::size_t length = composer.length();
+        wchar_t* xml = static_cast<wchar_t*>(arena.allocate((length + 1) * sizeof(wchar_t), alignof(wchar_t)));
+        xml[composer.write(xml, length)] = L'\0';
+        Bench::keep(xml);
+    });
+    runner.measure("xml/escapedLength", [&toast] {
+        const std::wstring& line = toast.textField(WinToastTemplate::ThirdLine);
+        Bench::keep(WinToastXml::escapedLength(line.data(), line.size()));
+    });
+}
+
+BENCH_CASE(arguments) {
+    const std::wstring token = L"prompt:7f3a9c";
+    runner.measure("arguments/encode", [&token] {
+        Bench::keep(WinToastArguments::encode(0x1234567890ll, 2, token));
+    });
+    const std::wstring encoded = WinToastArguments::encode(0x1234567890ll, 2, token);
+    runner.measure("arguments/decode", [&encoded] {
+        WinToastArguments::Decoded decoded;
+        Bench::keep(WinToastArguments::decode(encoded.data(), encoded.size(), decoded));
+        Bench::keep(decoded);
+    });
+}
+
+BENCH_CASE(descriptor) {
+    const WinToastTemplate toast = promptToast();
+    std::vector<uint8_t> buffer;
+    WinToastDescriptor::write(toast, buffer);
+
+    runner.measure("descriptor/measure", [&toast] {
+        Bench::keep(WinToastDescriptor::measure(toast));
+    });
+    // Into a reused buffer, as the broker writes into its ring slots.
+    std::vector<uint64_t> slot(WinToastDescriptor::MaxSize / sizeof(uint64_t));
+    runner.measure("descriptor/write", [&toast, &slot] {
+        Bench::keep(WinToastDescriptor::write(toast, reinterpret_cast<uint8_t*>(slot.data()), slot.size() * sizeof(uint64_t)));
+    });
+    runner.measure("descriptor/open", [&buffer] {
+        WinToastDescriptor descriptor;
+        Bench::keep(descriptor.open(buffer.data(), buffer.size()));
+    });
+    WinToastDescriptor descriptor;
+    descriptor.open(buffer.data(), buffer.size());
+    runner.measure("descriptor/toTemplate", [&descriptor] {
+        WinToastTemplate copy;
+        descriptor.toTemplate(copy);
+        Bench::keep(copy);
+    });
+    runner.note("descriptor/size of prompt toast", double(buffer.size()), "bytes");
+}
+
+BENCH_CASE(budget) {
+    const std::wstring fits = L"Allow connection?";
+    const std::wstring plain(400, L'x');
+    const std::wstring path = L"C:\\Users\\someone\\AppData\\Local\\Programs\\Example Vendor\\Example Application\\"
+                              L"resources\\app\\node_modules\\helper\\bin\\example-helper.exe";
+    const std::wstring domain = L"a-very-long-subdomain.of-a-tracking-service.region-1.cdn.example.com";
+    std::wstring out;
+    runner.measure("budget/fits", [&] {
+        WinToastTextBudget::shorten(fits.data(), fits.size(), 64, WinToastTextBudget::Auto, out);
+        Bench::keep(out);
+    });
+    runner.measure("budget/plain 400 to 64", [&] {
+        WinToastTextBudget::shorten(plain.data(), plain.size(), 64, WinToastTextBudget::Plain, out);
+        Bench::keep(out);
+    });
+    runner.measure("budget/path auto", [&] {
+        WinToastTextBudget::shorten(path.data(), path.size(), 48, WinToastTextBudget::Auto, out);
+        Bench::keep(out);
+    });
+    runner.measure("budget/domain auto", [&] {
+        WinToastTextBudget::shorten(domain.data(), domain.size(), 32, WinToastTextBudget::Auto, out);
+        Bench::keep(out);
+    });
+}
+
+BENCH_CASE(stats) {
+    static WinToastStats stats;
+    runner.measure("stats/recordNs", [] {
+        stats.recordNs(WinToastStats::XmlBuild, 12345);
+    });
+    runner.measure("stats/lap", [] {
+        Bench::keep(stats.lap(WinToastStats::Show, WinToastStats::now()));
+    });
+    runner.measure("stats/snapshot", [] {
+        WinToastStats::Snapshot snapshot;
+        stats.snapshot(snapshot);
+        Bench::keep(snapshot);
+    });
+}
+
+BENCH_CASE(strings) {
+    const std::wstring label = L"Block all";
+    const WinToastString pooled(label);
+    runner.measure("strings/intern existing", [&label] {
+        WinToastString interned(label);
+        Bench::keep(interned);
+    });
+    runner.measure("strings/copy pooled", [&pooled] {
+        WinToastString copy(pooled);
+        Bench::keep(copy);
+    });
+    const std::wstring path = L"C:\\ProgramData\\Safing\\Portmaster\\exec\\icons\\example-updater.png";
+    runner.measure("strings/copy wstring", [&path] {
+        std::wstring copy(path);
+        Bench::keep(copy);
+    });
+
+    // Memory for the labels and image paths of 1000 live prompts sharing the same few values.
+    const std::size_t before = WinToastStringPool::memoryUsage();
+    std::vector<WinToastString> held;
+    std::size_t unpooled = 0;
+    for (int i = 0; i < 1000; i++) {
+        const std::wstring values[] = {L"Allow", L"Block", L"Block all", path};
+        for (const std::wstring& value : values) {
+            held.emplace_back(value);
+            unpooled += (value.size() + 1) * sizeof(wchar_t);
+        }
+    }
+    runner.note("strings/1000 prompts unpooled", double(unpooled), "bytes");
+    runner.note("strings/1000 prompts pooled", double(WinToastStringPool::memoryUsage() - before + held.size() * sizeof(WinToastString)),
+                "bytes");
+}
+
+BENCH_CASE(allocator) {
+    struct Node {
+        Node*   next;
+        int64_t id;
+        char    payload[48];
+    };
+    runner.measure("allocator/new+delete", [] {
+        std::unique_ptr<Node> node(new Node());
+        Bench::keep(node);
+    });
+    runner.measure("allocator/hooks", [] {
+        void* memory = WinToastAllocator::allocate(sizeof(Node), alignof(Node));
+        Bench::keep(memory);
+        WinToastAllocator::deallocate(memory, sizeof(Node), alignof(Node));
+    });
+    // One block stays held so the pool keeps its slab, as with a registry that is never empty.
+    WinToastPool pool(sizeof(Node), alignof(Node));
+    void* held = pool.allocate();
+    runner.measure("allocator/pool", [&pool] {
+        void* memory = pool.allocate();
+        Bench::keep(memory);
+        pool.deallocate(memory);
+    });
+    pool.deallocate(held);
+    runner.measure("allocator/arena 16 allocations", 16, [] {
+        WinToastArena arena;
+        for (int i = 0; i < 16; i++) {
+            Bench::keep(arena.allocate(sizeof(Node), alignof(Node)));
+        }
+    });
+    runner.measure("allocator/std::list heap", [] {
+        std::list<int64_t> list{1, 2, 3, 4};
+        Bench::keep(list);
+    });
+    runner.measure("allocator/std::list pooled", [] {
+        std::list<int64_t, WinToastPoolAllocator<int64_t>> list{1, 2, 3, 4};
+        Bench::keep(list);
+    });
+}
+
+BENCH_CASE(registry) {
+    // A registry at its capacity, so every insert also evicts, as with a host that caps live toasts.
+    WinToastRegistry registry;
+    std::vector<WinToastRegistry::Removed> evicted;
+    registry.setCapacity(256, 0, evicted);
+    int64_t id = 0;
+    const std::wstring groups[] = {L"prompts", L"updates", L"alerts", L"network"};
+    for (; id < 256; id++) {
+        registry.insert(id, WinToastRegistry::Entry{nullptr, nullptr, WinToastStats::now(), 0, int(id % 3), 512, groups[id % 4],
+                                                    L"key" + std::to_wstring(id)}, evicted);
+    }
+    runner.measure("registry/insert evicting at 256", [&] {
+        registry.insert(id, WinToastRegistry::Entry{nullptr, nullptr, WinToastStats::now(), 0, int(id % 3), 512, groups[id % 4],
+                                                    std::wstring()}, evicted);
+        id++;
+    });
+    runner.measure("registry/setState", [&registry, &id] {
+        registry.setState(id - 1, WinToastRegistry::Shown);
+    });
+    runner.measure("registry/state", [&registry, &id] {
+        Bench::keep(registry.state(id - 1));
+    });
+
+    // Hiding one of four groups of 64 live toasts, then showing them again.
+    runner.measure("registry/removeGroup 64 of 256", 64, [&] {
+        std::vector<WinToastRegistry::Removed> removed;
+        registry.removeGroup(L"prompts", removed);
+        for (const auto& entry : removed) {
+            registry.insert(entry.id, WinToastRegistry::Entry{nullptr, nullptr, WinToastStats::now(), 0, 0, 512, L"prompts", std::wstring()},
+                            evicted);
+        }
+    });
+}
+
+BENCH_CASE(peIcon) {
+    const std::vector<uint8_t> image = Sample::peImage({16, 24, 32, 48, 64, 256});
+    std::vector<uint8_t> ico;
+    runner.measure("peIcon/extract 48 of 6", [&] {
+        Bench::keep(PeIcon::extractIcon(image.data(), image.size(), 48, ico));
+    });
+    runner.measure("peIcon/extract 256 of 6", [&] {
+        Bench::keep(PeIcon::extractIcon(image.data(), image.size(), 256, ico));
+    });
+}
+
+BENCH_CASE(queue) {
+    MpscQueue<int64_t> queue;
+    runner.measure("queue/push+pop", [&queue] {
+        queue.push(1);
+        int64_t value;
+        queue.pop(value);
+        Bench::keep(value);
+    });
+}
+
+BENCH_CASE(ids) {
+    // WinToast::reserveId, one relaxed increment of a counter that every caller thread shares.
+    static std::atomic<int64_t> nextId{0};
+    runner.measure("ids/reserveId", [] {
+        Bench::keep(nextId.fetch_add(1, std::memory_order_relaxed));
+    });
+    if (!runner.selected("ids/reserveId 3 threads contending")) {
+        return;
+    }
+    std::atomic<bool> stop{false};
+    std::vector<std::thread> contending;
+    for (int i = 0; i < 3; i++) {
+        contending.emplace_back([&stop] {
+            while (!stop.load(std::memory_order_relaxed)) {
+                Bench::keep(nextId.fetch_add(1, std::memory_order_relaxed));
+            }
+        });
+    }
+    runner.measure("ids/reserveId 3 threads contending", [] {
+        Bench::keep(nextId.fetch_add(1, std::memory_order_relaxed));
+    });
+    stop.store(true);
+    for (auto& thread : contending) {
+        thread.join();
+    }
+}
+
+BENCH_CASE(dispatch) {
+    // The steps of WinToast::activated once the arguments are read: decode, look up, record, call the handler.
+    WinToastRegistry registry;
+    std::vector<WinToastRegistry::Removed> evicted;
+    const std::shared_ptr<IWinToastHandler> handler = std::make_shared<CountingHandler>();
+    const WinToastTemplate toast = promptToast();
+    for (int64_t id = 0; id < 256; id++) {
+        registry.insert(id, WinToastRegistry::Entry{nullptr, handler, WinToastStats::now(), 0, 1, 2048, toast.group(), toast.key()}, evicted);
+    }
+    static WinToastStats stats;
+    const std::wstring arguments = WinToastArguments::encode(200, 1, toast.activationToken());
+    runner.measure("dispatch/activated", [&] {
+        WinToastArguments::Decoded decoded;
+        WinToastRegistry::Entry entry;
+        if (WinToastArguments::decode(arguments.data(), arguments.size(), decoded) && registry.find(decoded.id, entry)) {
+            registry.setState(decoded.id, WinToastRegistry::Activated, decoded.action);
+            stats.increment(WinToastStats::Activated);
+            stats.record(WinToastStats::ShowToActivation, entry.shownAt, WinToastStats::now());
+            entry.handler->toastActivated(decoded.action);
+        }
+    });
+    // Dismissed as the handler registered per notification runs it; a time out leaves the toast registered.
+    runner.measure("dispatch/dismissed timed out", [&] {
+        const auto reason = registry.dismissed(100, WinToastRegistry::TimedOut, false);
+        handler->toastDismissed(static_cast<IWinToastHandler::WinToastDismissalReason>(reason));
+    });
+    int64_t id = 256;
+    runner.measure("dispatch/insert+dismissed", [&] {
+        const std::shared_ptr<IWinToastHandler> own = std::make_shared<CountingHandler>();
+        registry.insert(id, WinToastRegistry::Entry{nullptr, own, WinToastStats::now(), 0, 1, 2048, std::wstring(), std::wstring()}, evicted);
+        const auto reason = registry.dismissed(id++, WinToastRegistry::UserCanceled, false);
+        own->toastDismissed(static_cast<IWinToastHandler::WinToastDismissalReason>(reason));
+    });
+}
+
+BENCH_CASE(show) {
+    // showToast without WinRT: reserveId, the portable part of prepare, the registry and a stand-in Show.
+    // The XML parse, CreateToastNotification, the handler registration and IToastNotifier::Show are not included.
+    WinToastRegistry registry;
+    std::vector<WinToastRegistry::Removed> evicted;
+    registry.setCapacity(256, 0, evicted);
+    std::atomic<int64_t> nextId{0};
+    Sample::StandInNotifier notifier;
+    const std::shared_ptr<IWinToastHandler> handler = std::make_shared<CountingHandler>();
+    const WinToastTemplate toast = promptToast();
+    runner.measure("show/stand-in showToast", [&] {
+        const int64_t id = nextId.fetch_add(1, std::memory_order_relaxed);
+        registry.setState(id, WinToastRegistry::Queued);
+        WinToastArena arena;
+        std::size_t length = 0;
+        const wchar_t* xml = Sample::composeToast(id, toast, arena, length);
+        registry.insert(id, WinToastRegistry::Entry{nullptr, handler, WinToastStats::now(), 0, toast.priority(), 2048, toast.group(), toast.key()},
+                        evicted);
+        notifier.show(id, xml, length);
+        registry.setState(id, WinToastRegistry::Shown);
+    });
+}
+
+BENCH_CASE(broker) {
+    // A client and the owner in one process, through the shared section and its events as two processes use them.
+    // The owner answers every show with an event, as the glue does once the toast is activated.
+    if (!runner.selected("broker/show round trip") && !runner.selected("broker/shows per second")) {
+        return;
+    }
+    const std::wstring name = L"toast_bench_broker_" + std::to_wstring(std::chrono::steady_clock::now().time_since_epoch().count());
+    WinToastBroker owner, client;
+    std::atomic<uint64_t> served{0}, received{0};
+    const bool connected = owner.serve(name, [&owner, &served](WinToastBroker::Request& request) {
+        if (request.kind == WinToastBroker::Show) {
+            served.fetch_add(1);
+            owner.post(WinToastBroker::Activated, request.id, -1);
+        }
+    }) && client.connect(name, [&received](WinToastBroker::Kind, INT64, int32_t) {
+        received.fetch_add(1);
+    });
+    if (!connected) {
+        return;
+    }
+
+    const WinToastTemplate toast = promptToast();
+    uint64_t sent = 0;
+    runner.measure("broker/show round trip", [&] {
+        if (client.show(toast) != -1) {
+            sent++;
+        }
+        while (received.load() != sent) {
+            std::this_thread::yield();
+        }
+    });
+
+    if (runner.selected("broker/shows per second")) {
+        // Events the client is too slow for are dropped, so the owner's side is what is counted.
+        const uint64_t shows = runner.quick() ? 2000 : 100000;
+        const uint64_t before = served.load();
+        const auto begin = std::chrono::steady_clock::now();
+        for (uint64_t i = 0; i < shows; i++) {
+            while (client.show(toast) == -1) {
+                // The request ring is full until the owner catches up.
+                std::this_thread::yield();
+            }
+        }
+        while (served.load() - before < shows) {
+            std::this_thread::yield();
+        }
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+        runner.note("broker/shows per second", double(shows) / seconds, "shows/s");
+    }
+    client.stop();
+    owner.stop();
+}
+
+BENCH_CASE(pipe) {
+    // A client and the server in one process, over the stream the server uses on this host. The handler takes the
+    // show without a notifier behind it, so this is framing, dispatch and the transport.
+    if (!runner.selected("pipe/show round trip") && !runner.selected("pipe/pipelined show")) {
+        return;
+    }
+    std::atomic<INT64> nextId{0};
+    WinToastPipeServer server([&nextId] { return nextId.fetch_add(1); });
+    const std::wstring name = L"toast_bench_pipe_" + std::to_wstring(std::chrono::steady_clock::now().time_since_epoch().count());
+    WinToastPipeChannel client;
+    if (!server.start(name, [](WinToastPipeServer::Request& request) { request.hr = S_OK; }) || !client.connect(name)) {
+        return;
+    }
+
+    std::vector<uint8_t> descriptor;
+    WinToastDescriptor::write(promptToast(), descriptor);
+    const auto frames = [&descriptor](std::size_t count) {
+        std::vector<uint8_t> stream;
+        for (std::size_t i = 0; i < count; i++) {
+            WinToastPipeFramer::append(WinToastPipeServer::FrameHeader{uint32_t(descriptor.size()), WinToastPipeServer::Show, 0, i + 1},
+                                       descriptor.data(), stream);
+        }
+        return stream;
+    };
+    WinToastPipeFramer framer;
+    // Reads until count replies came back, false if the server went away.
+    const auto replies = [&client, &framer](std::size_t count) {
+        while (count > 0) {
+            std::size_t size = 0;
+            uint8_t* space = framer.space(size);
+            const std::size_t received = client.read(space, size);
+            if (received == 0) {
+                return false;
+            }
+            framer.commit(received);
+            WinToastPipeServer::FrameHeader header;
+            const uint8_t* payload = nullptr;
+            while (framer.next(header, payload) == WinToastPipeFramer::Frame) {
+                count -= header.type == WinToastPipeServer::Reply ? 1 : 0;
+            }
+        }
+        return true;
+    };
+
+    const std::vector<uint8_t> one = frames(1);
+    bool connected = true;
+    runner.measure("pipe/show round trip", [&] {
+        connected = connected && client.write(one.data(), one.size(), WinToastPipeServer::WriteTimeoutMs) && replies(1);
+    });
+
+    // Commands sent in one write without waiting, their replies come back written together.
+    const std::size_t Window = 64;
+    const std::vector<uint8_t> window = frames(Window);
+    runner.measure("pipe/pipelined show", Window, [&] {
+        connected = connected && client.write(window.data(), window.size(), WinToastPipeServer::WriteTimeoutMs) && replies(Window);
+    });
+    client.close();
+    server.stop();
+}
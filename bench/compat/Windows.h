@@ -0,0 +1,73 @@
+#ifndef BENCH_COMPAT_WINDOWS_H
+#define BENCH_COMPAT_WINDOWS_H
+
+// The few Windows SDK names the portable sources use, for the bench build only.
+#include <sal.h>
+#include <chrono>
+#include <cstdint>
+
+typedef int64_t INT64;
+typedef int32_t LONG;
+typedef int64_t LONG64;
+typedef uint64_t ULONGLONG;
+typedef uint16_t WORD;
+typedef uint32_t DWORD;
+typedef uint32_t ULONG;
+typedef uint16_t LANGID;
+typedef const wchar_t* PCWSTR;
+typedef int32_t HRESULT;
+
+#define LANG_NEUTRAL 0x00
+#define PRIMARYLANGID(language) ((WORD)(language) & 0x3ff)
+#define MAKELANGID(primary, sub) ((((WORD)(sub)) << 10) | (WORD)(primary))
+
+#define S_OK ((HRESULT)0L)
+#define S_FALSE ((HRESULT)1L)
+#define E_NOTIMPL ((HRESULT)0x80004001L)
+#define E_FAIL ((HRESULT)0x80004005L)
+#define E_INVALIDARG ((HRESULT)0x80070057L)
+#define SUCCEEDED(hr) (((HRESULT)(hr)) >= 0)
+#define FAILED(hr) (((HRESULT)(hr)) < 0)
+
+// Full barriers, like the Interlocked functions.
+inline LONG InterlockedExchange(_Inout_ volatile LONG* target, _In_ LONG value) {
+    return __atomic_exchange_n(target, value, __ATOMIC_SEQ_CST);
+}
+
+inline LONG InterlockedCompareExchange(_Inout_ volatile LONG* target, _In_ LONG exchange, _In_ LONG comparand) {
+    __atomic_compare_exchange_n(target, &comparand, exchange, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+    return comparand;
+}
+
+inline LONG64 InterlockedIncrement64(_Inout_ volatile LONG64* value) {
+    return __atomic_add_fetch(value, 1, __ATOMIC_SEQ_CST);
+}
+
+inline LONG64 InterlockedExchange64(_Inout_ volatile LONG64* target, _In_ LONG64 value) {
+    return __atomic_exchange_n(target, value, __ATOMIC_SEQ_CST);
+}
+
+inline LONG64 InterlockedCompareExchange64(_Inout_ volatile LONG64* target, _In_ LONG64 exchange, _In_ LONG64 comparand) {
+    __atomic_compare_exchange_n(target, &comparand, exchange, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+    return comparand;
+}
+
+inline void MemoryBarrier() {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+struct FILETIME {
+    DWORD dwLowDateTime;
+    DWORD dwHighDateTime;
+};
+
+inline void GetSystemTimeAsFileTime(_Out_ FILETIME* time) {
+    // 100 ns intervals since 1601, like the real one.
+    const uint64_t EpochDifference = 116444736000000000ull;
+    const uint64_t now = EpochDifference + static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                               std::chrono::system_clock::now().time_since_epoch()).count() / 100);
+    time->dwLowDateTime = static_cast<DWORD>(now);
+    time->dwHighDateTime = static_cast<DWORD>(now >> 32);
+}
+
+#endif // BENCH_COMPAT_WINDOWS_H
@@ -0,0 +1,18 @@
+#ifndef BENCH_COMPAT_SAL_H
+#define BENCH_COMPAT_SAL_H
+
+// Source annotations are only checked by MSVC, elsewhere they expand to nothing.
+#define _In_
+#define _In_opt_
+#define _In_z_
+#define _In_reads_(count)
+#define _In_reads_bytes_(size)
+#define _In_reads_bytes_opt_(size)
+#define _Out_
+#define _Out_opt_
+#define _Out_writes_(count)
+#define _Out_writes_bytes_(size)
+#define _Inout_
+#define _Inout_opt_
+
+#endif // BENCH_COMPAT_SAL_H
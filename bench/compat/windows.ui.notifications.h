@@ -0,0 +1,17 @@
+#ifndef BENCH_COMPAT_WINDOWS_UI_NOTIFICATIONS_H
+#define BENCH_COMPAT_WINDOWS_UI_NOTIFICATIONS_H
+
+#include <Windows.h>
+
+// The registry only holds notifications by reference; the bench tools implement this stand-in.
+namespace ABI { namespace Windows { namespace UI { namespace Notifications {
+    struct IToastNotification {
+        virtual ULONG AddRef() = 0;
+        virtual ULONG Release() = 0;
+
+    protected:
+        ~IToastNotification() = default;
+    };
+}}}}
+
+#endif // BENCH_COMPAT_WINDOWS_UI_NOTIFICATIONS_H
@@ -0,0 +1,52 @@
+#ifndef BENCH_COMPAT_WRL_CLIENT_H
+#define BENCH_COMPAT_WRL_CLIENT_H
+
+#include <utility>
+
+// Reference counting of Microsoft::WRL::ComPtr, without QueryInterface.
+namespace Microsoft { namespace WRL {
+    template <typename T>
+    class ComPtr {
+    public:
+        ComPtr() = default;
+        ComPtr(T* pointer) : m_pointer(pointer) { addRef(); }
+        ComPtr(const ComPtr& other) : m_pointer(other.m_pointer) { addRef(); }
+        ComPtr(ComPtr&& other) noexcept : m_pointer(other.m_pointer) { other.m_pointer = nullptr; }
+        ~ComPtr() { release(); }
+
+        ComPtr& operator=(ComPtr other) noexcept {
+            std::swap(m_pointer, other.m_pointer);
+            return *this;
+        }
+
+        T* Get() const { return m_pointer; }
+        T* operator->() const { return m_pointer; }
+        explicit operator bool() const { return m_pointer != nullptr; }
+
+        void Attach(T* pointer) {
+            release();
+            m_pointer = pointer;
+        }
+
+        unsigned long Reset() {
+            const unsigned long count = release();
+            m_pointer = nullptr;
+            return count;
+        }
+
+    private:
+        void addRef() {
+            if (m_pointer != nullptr) {
+                m_pointer->AddRef();
+            }
+        }
+
+        unsigned long release() {
+            return m_pointer != nullptr ? m_pointer->Release() : 0;
+        }
+
+        T* m_pointer{nullptr};
+    };
+}}
+
+#endif // BENCH_COMPAT_WRL_CLIENT_H
@@ -0,0 +1,201 @@
+// Fuzz target for WinToastDescriptor::open and everything that reads an opened descriptor.
+//
+// Built with -DTOAST_LIBFUZZER=ON (clang) this is a libFuzzer target. Otherwise
+// main() runs a deterministic mutation loop over valid descriptors, or replays
+// the files given on the command line:
+//
+//   descriptor_fuzz [--iterations <n>] [--seed <n>] [file...]
+#include "sample_toast.h"
+#include "toast_arguments.h"
+#include "toast_descriptor.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+using namespace WinToastLib;
+
+namespace {
+    void check(bool condition, const char* what) {
+        if (!condition) {
+            std::fprintf(stderr, "descriptor_fuzz: %s\n", what);
+            std::abort();
+        }
+    }
+
+    std::size_t touch(const WinToastDescriptor::Text& text) {
+        // Reads every character so the sanitizers see out of bounds accessors.
+        std::size_t sum = 0;
+        for (std::size_t i = 0; i <= text.length; i++) {
+            sum += static_cast<std::size_t>(text.data[i]);
+        }
+        check(text.data[text.length] == L'\0', "string is not terminated");
+        return sum;
+    }
+
+    // Returns whether open accepted the input.
+    bool fuzzOne(const uint8_t* data, std::size_t size) {
+        // open requires 8 byte alignment, as the broker slots and pipe frames provide.
+        std::vector<uint64_t> aligned((size + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+        if (size > 0) {
+            std::memcpy(aligned.data(), data, size);
+        }
+
+        WinToastDescriptor descriptor;
+        if (!descriptor.open(aligned.data(), size)) {
+            check(!descriptor.isOpen(), "failed open left the view open");
+            return false;
+        }
+        check(descriptor.size() <= size, "descriptor larger than its buffer");
+
+        std::size_t sum = 0;
+        for (int pos = WinToastTemplate::FirstLine; pos <= WinToastTemplate::ThirdLine; pos++) {
+            sum += touch(descriptor.textField(static_cast<WinToastTemplate::TextField>(pos)));
+        }
+        for (std::size_t pos = 0; pos <= WinToastDescriptor::MaxActions; pos++) {
+            sum += touch(descriptor.actionLabel(pos));
+        }
+        for (uint32_t field = 0; field <= WinToastDescriptor::FieldCount; field++) {
+            sum += touch(descriptor.field(static_cast<WinToastDescriptor::Field>(field)));
+        }
+        check(descriptor.field(WinToastDescriptor::ActivationToken).length <= WinToastArguments::MaxTokenLength, "token too long");
+
+        // Whatever open accepts must survive a round trip through a template.
+        WinToastTemplate toast;
+        descriptor.toTemplate(toast);
+        std::vector<uint8_t> written;
+        check(WinToastDescriptor::write(toast, written), "opened descriptor cannot be written back");
+        check(written.size() == WinToastDescriptor::measure(toast), "write and measure disagree");
+        WinToastDescriptor reopened;
+        check(reopened.open(written.data(), written.size()), "written descriptor does not open");
+        WinToastTemplate copy;
+        reopened.toTemplate(copy);
+        check(Sample::sameToast(toast, copy), "round trip changed the template");
+        static volatile std::size_t sink;
+        sink = sum;
+        return true;
+    }
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, std::size_t size) {
+    fuzzOne(data, size);
+    return 0;
+}
+
+#ifndef TOAST_LIBFUZZER
+namespace {
+    struct Random {
+        uint64_t state;
+
+        uint64_t next() {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            return state;
+        }
+
+        std::size_t below(std::size_t bound) {
+            return bound == 0 ? 0 : static_cast<std::size_t>(next() % bound);
+        }
+    };
+
+    std::vector<std::vector<uint8_t>> seeds() {
+        std::vector<WinToastTemplate> toasts;
+        toasts.push_back(Sample::promptToast());
+        toasts.emplace_back(WinToastTemplate::Text01);
+        WinToastTemplate full(WinToastTemplate::Text04);
+        full.setFirstLine(L"first");
+        full.setSecondLine(std::wstring(300, L'x'));
+        full.setActivationToken(std::wstring(WinToastArguments::MaxTokenLength, L't'));
+        full.setScenario(WinToastTemplate::Scenario::Reminder);
+        full.setPriority(WinToastTemplate::High);
+        full.setDuration(WinToastTemplate::Long);
+        full.setAudioOption(WinToastTemplate::Loop);
+        for (std::size_t i = 0; i < WinToastDescriptor::MaxActions; i++) {
+            full.addAction(L"action " + std::to_wstring(i));
+        }
+        toasts.push_back(full);
+
+        std::vector<std::vector<uint8_t>> buffers;
+        for (const WinToastTemplate& toast : toasts) {
+            std::vector<uint8_t> buffer;
+            check(WinToastDescriptor::write(toast, buffer), "seed cannot be written");
+            buffers.push_back(buffer);
+        }
+        return buffers;
+    }
+
+    // Mostly small edits, biased towards the header and string table where the checks are.
+    void mutate(Random& random, std::vector<uint8_t>& input) {
+        const std::size_t edits = 1 + random.below(4);
+        for (std::size_t i = 0; i < edits && !input.empty(); i++) {
+            const std::size_t hot = std::min<std::size_t>(input.size(), sizeof(WinToastDescriptor::Header) + 16 * 8);
+            const std::size_t at = random.below(2) == 0 ? random.below(hot) : random.below(input.size());
+            switch (random.below(6)) {
+            case 0:
+                input[at] ^= static_cast<uint8_t>(1u << random.below(8));
+                break;
+            case 1:
+                input[at] = static_cast<uint8_t>(random.next());
+                break;
+            case 2: {
+                static const uint32_t interesting[] = {0, 1, 0x7f, 0x80, 0xff, 0xffff, 0x7fffffff, 0x80000000u, 0xffffffffu};
+                const uint32_t value = interesting[random.below(sizeof(interesting) / sizeof(interesting[0]))];
+                std::memcpy(&input[at], &value, std::min<std::size_t>(sizeof(value), input.size() - at));
+                break;
+            }
+            case 3:
+                input.resize(random.below(input.size() + 1));
+                break;
+            case 4:
+                input.insert(input.begin() + static_cast<std::ptrdiff_t>(at), random.below(16) + 1, static_cast<uint8_t>(random.next()));
+                break;
+            default:
+                input.erase(input.begin() + static_cast<std::ptrdiff_t>(at),
+                            input.begin() + static_cast<std::ptrdiff_t>(std::min(input.size(), at + random.below(16) + 1)));
+                break;
+            }
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    unsigned long long iterations = 100000, seed = 0x5eed;
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        if (arg == "--iterations" && i + 1 < argc) {
+            iterations = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--seed" && i + 1 < argc) {
+            seed = std::strtoull(argv[++i], nullptr, 10);
+        } else {
+            files.push_back(arg);
+        }
+    }
+
+    if (!files.empty()) {
+        for (const std::string& file : files) {
+            std::ifstream in(file, std::ios::binary);
+            const std::vector<uint8_t> input((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+            fuzzOne(input.data(), input.size());
+        }
+        std::printf("replayed %zu inputs\n", files.size());
+        return 0;
+    }
+
+    const std::vector<std::vector<uint8_t>> corpus = seeds();
+    Random random{seed != 0 ? seed : 1};
+    unsigned long long opened = 0;
+    for (unsigned long long i = 0; i < iterations; i++) {
+        std::vector<uint8_t> input = corpus[random.below(corpus.size())];
+        mutate(random, input);
+        opened += fuzzOne(input.data(), input.size()) ? 1 : 0;
+    }
+    std::printf("%llu inputs, %llu opened\n", iterations, opened);
+    return 0;
+}
+#endif
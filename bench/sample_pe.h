@@ -0,0 +1,99 @@
+#ifndef SAMPLE_PE_H
+#define SAMPLE_PE_H
+
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+namespace Sample {
+
+    /**
+     * Builds a minimal PE32+ image whose only section holds the resources of
+     * one icon group, with a square icon of each extent (256 is stored as 0
+     * like in real group entries). The image data of an icon is its extent
+     * repeated, so tests can tell which one was extracted.
+     */
+    inline std::vector<uint8_t> peImage(const std::vector<unsigned>& extents) {
+        const uint32_t SectionOffset = 0x200, SectionRva = 0x1000;
+        const uint32_t OptionalOffset = 0x98, OptionalSize = 240;
+        const std::size_t count = extents.size();
+
+        std::vector<uint8_t> rsrc;
+        auto put16 = [&rsrc](std::size_t at, uint16_t value) { std::memcpy(&rsrc[at], &value, 2); };
+        auto put32 = [&rsrc](std::size_t at, uint32_t value) { std::memcpy(&rsrc[at], &value, 4); };
+        auto directory = [&](std::size_t at, const std::vector<std::pair<uint32_t, uint32_t>>& entries) {
+            put16(at + 14, static_cast<uint16_t>(entries.size()));
+            for (std::size_t i = 0; i < entries.size(); i++) {
+                put32(at + 16 + i * 8, entries[i].first);
+                put32(at + 20 + i * 8, entries[i].second);
+            }
+        };
+        const uint32_t Subdirectory = 0x80000000u;
+
+        // Directories, then data entries, then the data they point to.
+        const uint32_t root = 0, iconType = 32, groupType = iconType + 16 + uint32_t(count) * 8;
+        const uint32_t iconNames = groupType + 24, groupName = iconNames + uint32_t(count) * 24;
+        const uint32_t entries = groupName + 24, data = entries + uint32_t(count + 1) * 16;
+        const uint32_t groupSize = 6 + uint32_t(count) * 14;
+        uint32_t imagesSize = 0;
+        for (unsigned extent : extents) {
+            imagesSize += extent * extent;
+        }
+        rsrc.resize(data + groupSize + imagesSize);
+
+        directory(root, {{3, Subdirectory | iconType}, {14, Subdirectory | groupType}});
+        std::vector<std::pair<uint32_t, uint32_t>> icons;
+        for (std::size_t i = 0; i < count; i++) {
+            icons.emplace_back(uint32_t(i + 1), Subdirectory | (iconNames + uint32_t(i) * 24));
+            directory(iconNames + i * 24, {{0x409, entries + uint32_t(i) * 16}});
+        }
+        directory(iconType, icons);
+        directory(groupType, {{1, Subdirectory | groupName}});
+        directory(groupName, {{0x409, entries + uint32_t(count) * 16}});
+
+        put32(entries + count * 16, SectionRva + data);
+        put32(entries + count * 16 + 4, groupSize);
+        put16(data + 2, 1);
+        put16(data + 4, static_cast<uint16_t>(count));
+        uint32_t image = data + groupSize;
+        for (std::size_t i = 0; i < count; i++) {
+            const unsigned extent = extents[i];
+            const std::size_t entry = data + 6 + i * 14;
+            rsrc[entry] = rsrc[entry + 1] = static_cast<uint8_t>(extent >= 256 ? 0 : extent);
+            put16(entry + 4, 1);
+            put16(entry + 6, 32);
+            put32(entry + 8, extent * extent);
+            put16(entry + 12, static_cast<uint16_t>(i + 1));
+
+            put32(entries + i * 16, SectionRva + image);
+            put32(entries + i * 16 + 4, extent * extent);
+            std::memset(&rsrc[image], static_cast<uint8_t>(extent), extent * extent);
+            image += extent * extent;
+        }
+
+        std::vector<uint8_t> pe(SectionOffset + rsrc.size());
+        auto set16 = [&pe](std::size_t at, uint16_t value) { std::memcpy(&pe[at], &value, 2); };
+        auto set32 = [&pe](std::size_t at, uint32_t value) { std::memcpy(&pe[at], &value, 4); };
+        set16(0, 0x5a4d);
+        set32(0x3c, 0x80);
+        set32(0x80, 0x00004550);
+        set16(0x84, 0x8664);
+        set16(0x86, 1);
+        set16(0x94, static_cast<uint16_t>(OptionalSize));
+        set16(OptionalOffset, 0x20b);
+        set32(OptionalOffset + 108, 16);
+        set32(OptionalOffset + 112 + 2 * 8, SectionRva);
+        set32(OptionalOffset + 112 + 2 * 8 + 4, static_cast<uint32_t>(rsrc.size()));
+        const std::size_t section = OptionalOffset + OptionalSize;
+        std::memcpy(&pe[section], ".rsrc", 5);
+        set32(section + 8, static_cast<uint32_t>(rsrc.size()));
+        set32(section + 12, SectionRva);
+        set32(section + 16, static_cast<uint32_t>(rsrc.size()));
+        set32(section + 20, SectionOffset);
+        std::memcpy(&pe[SectionOffset], rsrc.data(), rsrc.size());
+        return pe;
+    }
+}
+
+#endif // SAMPLE_PE_H
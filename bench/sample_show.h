@@ -0,0 +1,89 @@
+#ifndef SAMPLE_SHOW_H
+#define SAMPLE_SHOW_H
+
+#include "toast_allocator.h"
+#include "toast_arguments.h"
+#include "toast_budget.h"
+#include "toast_schema.h"
+#include "toast_xml.h"
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Sample {
+
+    inline void spin(uint64_t ns) {
+        if (ns == 0) {
+            return;
+        }
+        const auto end = std::chrono::steady_clock::now() + std::chrono::nanoseconds(ns);
+        while (std::chrono::steady_clock::now() < end) {
+        }
+    }
+
+    // The portable part of WinToast::prepare: text budget, activation arguments and
+    // the XML composed into the arena. Returns the XML, which lives as long as the arena.
+    inline const wchar_t* composeToast(int64_t id, const WinToastLib::WinToastTemplate& toast, WinToastLib::WinToastArena& arena,
+                                       std::size_t& length) {
+        using namespace WinToastLib;
+        WinToastTemplate shortened;
+        bool copied = false;
+        std::wstring text;
+        for (std::size_t i = 0; i < toast.textFieldsCount(); i++) {
+            const auto field = static_cast<WinToastTemplate::TextField>(i);
+            const std::size_t budget = ToastSchema::textBudget(toast.type(), field);
+            const std::wstring& value = toast.textField(field);
+            if (budget == 0 || value.size() <= budget) {
+                continue;
+            }
+            if (!copied) {
+                shortened = toast;
+                copied = true;
+            }
+            WinToastTextBudget::shorten(value.data(), value.size(), budget, WinToastTextBudget::Auto, text);
+            shortened.setTextField(text, field);
+        }
+        const WinToastTemplate& composed = copied ? shortened : toast;
+
+        const std::wstring launchArguments = WinToastArguments::encode(id, WinToastArguments::BodyAction, toast.activationToken());
+        std::vector<std::wstring> actionArguments;
+        actionArguments.reserve(toast.actionsCount());
+        for (std::size_t i = 0; i < toast.actionsCount(); i++) {
+            actionArguments.push_back(WinToastArguments::encode(id, static_cast<int>(i), toast.activationToken()));
+        }
+
+        const WinToastXml composer(composed, launchArguments, actionArguments, true, &arena);
+        length = composer.length();
+        wchar_t* xml = static_cast<wchar_t*>(arena.allocate((length + 1) * sizeof(wchar_t), alignof(wchar_t)));
+        xml[composer.write(xml, length)] = L'\0';
+        return xml;
+    }
+
+    // Stands in for IToastNotifier::Show: checks the order, reads the whole XML and spins for submitNs.
+    class StandInNotifier {
+    public:
+        explicit StandInNotifier(uint64_t submitNs = 0) : m_submitNs(submitNs) {}
+
+        void show(int64_t id, const wchar_t* xml, std::size_t length) {
+            if (id != m_nextId++) {
+                m_outOfOrder++;
+            }
+            for (std::size_t i = 0; i < length; i++) {
+                m_checksum = (m_checksum ^ static_cast<uint64_t>(xml[i])) * 1099511628211ull;
+            }
+            spin(m_submitNs);
+        }
+
+        uint64_t outOfOrder() const { return m_outOfOrder; }
+        uint64_t checksum() const { return m_checksum; }
+
+    private:
+        uint64_t    m_submitNs;
+        int64_t     m_nextId{0};
+        uint64_t    m_outOfOrder{0};
+        uint64_t    m_checksum{14695981039346656037ull};
+    };
+}
+
+#endif // SAMPLE_SHOW_H
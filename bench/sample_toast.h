@@ -0,0 +1,45 @@
+#ifndef SAMPLE_TOAST_H
+#define SAMPLE_TOAST_H
+
+#include "toast_template.h"
+
+namespace Sample {
+
+    // A toast as Portmaster shows it for a connection prompt.
+    inline WinToastLib::WinToastTemplate promptToast() {
+        using WinToastLib::WinToastTemplate;
+        WinToastTemplate toast(WinToastTemplate::ImageAndText04);
+        toast.setFirstLine(L"Allow connection to telemetry.example.com?");
+        toast.setSecondLine(L"C:\\Program Files\\Example Vendor\\Example App\\bin\\example-updater.exe");
+        toast.setThirdLine(L"Outgoing TCP connection on port 443 & <reason>");
+        toast.setImagePath(L"C:\\ProgramData\\Safing\\Portmaster\\exec\\icons\\example-updater.png");
+        toast.setAudioPath(WinToastTemplate::Reminder);
+        toast.setAttributionText(L"Portmaster");
+        toast.setActivationToken(L"prompt:7f3a9c");
+        toast.setGroup(L"prompts");
+        toast.setKey(L"connection:12345");
+        toast.setExpiration(60000);
+        toast.addAction(L"Allow");
+        toast.addAction(L"Block");
+        toast.addAction(L"Block all");
+        return toast;
+    }
+
+    // WinToastTemplate has no operator==, the descriptor promises equality of everything it carries.
+    inline bool sameToast(const WinToastLib::WinToastTemplate& a, const WinToastLib::WinToastTemplate& b) {
+        if (a.type() != b.type() || a.textFields() != b.textFields() || a.actionsCount() != b.actionsCount()) {
+            return false;
+        }
+        for (std::size_t i = 0; i < a.actionsCount(); i++) {
+            if (a.actionLabel(i) != b.actionLabel(i)) {
+                return false;
+            }
+        }
+        return a.imagePath() == b.imagePath() && a.audioPath() == b.audioPath() && a.attributionText() == b.attributionText()
+            && a.activationToken() == b.activationToken() && a.group() == b.group() && a.key() == b.key()
+            && a.audioOption() == b.audioOption() && a.duration() == b.duration() && a.scenario() == b.scenario()
+            && a.priority() == b.priority() && a.expiration() == b.expiration();
+    }
+}
+
+#endif // SAMPLE_TOAST_H
@@ -0,0 +1,391 @@
+// Replays a recording of the C API (see WinToastRecorder) against a stand-in backend.
+//
+// Every recorded call is applied the way notification_glue.cpp applies it: notification
+// objects are WinToastTemplates, and a show reserves an Id, composes the toast like
+// WinToast::prepare (Sample::composeToast), tracks it in a WinToastRegistry and hands the
+// XML to the stand-in notifier, so hides by Id, group and key find what they found when
+// recorded. ShowTemplate renders from --catalog. There is no icon cache, images from
+// executables are left out, and the recorded events are counted but not replayed.
+//
+// The report holds the throughput, the latency distribution of the shows next to the one
+// recorded, and the heap allocations per call. Without a recording, a sample workload of
+// --sample toasts is recorded first, so the harness keeps building and running:
+//
+//   toast_replay [<recording>] [--real-time] [--catalog <file>] [--sample <n>] [--submit-ns <n>]
+#include "bench.h"
+#include "sample_show.h"
+#include "sample_toast.h"
+#include "toast_catalog.h"
+#include "toast_descriptor.h"
+#include "toast_recorder.h"
+#include "toast_registry.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+using namespace WinToastLib;
+
+namespace {
+    struct Options {
+        std::string recording;
+        std::string catalog;
+        bool        realTime{false};
+        std::size_t sample{2000};
+        uint64_t    submitNs{0};
+    };
+
+    struct Report {
+        uint64_t calls{0};
+        uint64_t events{0};
+        uint64_t failedShows{0};
+        uint64_t durationNs{0};
+        uint64_t allocations{0};
+        std::vector<uint64_t> shows;
+        std::vector<uint64_t> recordedShows;
+    };
+
+    std::wstring widen(const std::string& text) {
+        return std::wstring(text.begin(), text.end());
+    }
+
+    // Stands in for WinToast behind the glue, showing synchronously like the glue does without a worker.
+    class Backend {
+    public:
+        explicit Backend(uint64_t submitNs) : m_notifier(submitNs) {}
+
+        int64_t show(const WinToastTemplate& toast) {
+            const int64_t id = m_nextId++;
+            m_registry.setState(id, WinToastRegistry::Queued);
+            WinToastArena arena;
+            std::size_t length = 0;
+            const wchar_t* xml = Sample::composeToast(id, toast, arena, length);
+            m_registry.insert(id, WinToastRegistry::Entry{nullptr, nullptr, WinToastStats::now(), 0, toast.priority(),
+                                                          length * sizeof(wchar_t), toast.group(), toast.key()}, m_removed);
+            hidden();
+            m_notifier.show(id, xml, length);
+            m_registry.setState(id, WinToastRegistry::Shown);
+            return id;
+        }
+
+        bool hide(int64_t id) {
+            if (!m_registry.remove(id)) {
+                return false;
+            }
+            m_registry.setState(id, WinToastRegistry::Hidden);
+            return true;
+        }
+
+        void hideGroup(const std::wstring& group) {
+            m_registry.removeGroup(group, m_removed);
+            hidden();
+        }
+
+        void hideByKey(const std::wstring& key) {
+            m_registry.removeKey(key, m_removed);
+            hidden();
+        }
+
+        std::size_t shown() const { return m_registry.count(); }
+        uint64_t outOfOrder() const { return m_notifier.outOfOrder(); }
+
+    private:
+        void hidden() {
+            for (const auto& removed : m_removed) {
+                m_registry.setState(removed.id, WinToastRegistry::Hidden);
+            }
+            m_removed.clear();
+        }
+
+        WinToastRegistry                        m_registry;
+        std::vector<WinToastRegistry::Removed>  m_removed;
+        Sample::StandInNotifier                 m_notifier;
+        int64_t                                 m_nextId{0};
+    };
+
+    bool replay(const std::vector<WinToastRecorder::Entry>& entries, const Options& options, const WinToastCatalog& catalog,
+                Backend& backend, Report& report) {
+        std::unordered_map<uint32_t, std::unique_ptr<WinToastTemplate>> objects;
+        std::unordered_map<int64_t, int64_t> ids;
+        std::vector<WinToastCatalog::Argument> args;
+        report.shows.reserve(entries.size());
+        report.recordedShows.reserve(entries.size());
+
+        auto object = [&objects](uint32_t number) -> WinToastTemplate* {
+            auto it = objects.find(number);
+            return it != objects.end() ? it->second.get() : nullptr;
+        };
+        auto id = [&ids](int64_t recorded) -> int64_t {
+            auto it = ids.find(recorded);
+            return it != ids.end() ? it->second : -1;
+        };
+
+        const uint64_t allocations = Bench::Runner::allocationCount();
+        const uint64_t started = WinToastRecorder::now();
+        for (const WinToastRecorder::Entry& entry : entries) {
+            const WinToastRecorder::Record& record = entry.record;
+            if (record.call >= WinToastRecorder::Activated) {
+                report.events++;
+                continue;
+            }
+            if (options.realTime) {
+                const uint64_t elapsed = WinToastRecorder::now() - started;
+                if (record.timestamp > elapsed) {
+                    std::this_thread::sleep_for(std::chrono::nanoseconds(record.timestamp - elapsed));
+                }
+            }
+
+            WinToastTemplate* toast = object(record.object);
+            const uint64_t callStarted = WinToastRecorder::now();
+            int64_t shown = -1;
+            bool isShow = false;
+            switch (record.call) {
+            case WinToastRecorder::Create: {
+                std::unique_ptr<WinToastTemplate> created(new WinToastTemplate(WinToastTemplate::ImageAndText02));
+                created->setTextField(entry.strings[0], WinToastTemplate::FirstLine);
+                created->setTextField(entry.strings[1], WinToastTemplate::SecondLine);
+                created->setDuration(WinToastTemplate::Duration::Long);
+                objects[record.object] = std::move(created);
+                break;
+            }
+            case WinToastRecorder::Delete:
+                objects.erase(record.object);
+                break;
+            case WinToastRecorder::AddButton:
+                if (toast != nullptr) {
+                    toast->addAction(entry.strings[0]);
+                }
+                break;
+            case WinToastRecorder::SetImage:
+                if (toast != nullptr) {
+                    toast->setImagePath(entry.strings[0]);
+                }
+                break;
+            case WinToastRecorder::SetSound:
+                if (toast != nullptr) {
+                    toast->setAudioOption(static_cast<WinToastTemplate::AudioOption>(record.value));
+                    toast->setAudioPath(static_cast<WinToastTemplate::AudioSystemFile>(record.value2));
+                }
+                break;
+            case WinToastRecorder::SetPriority:
+                if (toast != nullptr) {
+                    toast->setPriority(static_cast<WinToastTemplate::Priority>(record.value));
+                }
+                break;
+            case WinToastRecorder::SetActivationToken:
+                if (toast != nullptr) {
+                    toast->setActivationToken(entry.strings[0]);
+                }
+                break;
+            case WinToastRecorder::SetGroup:
+                if (toast != nullptr) {
+                    toast->setGroup(entry.strings[0]);
+                }
+                break;
+            case WinToastRecorder::SetKey:
+                if (toast != nullptr) {
+                    toast->setKey(entry.strings[0]);
+                }
+                break;
+            case WinToastRecorder::Show:
+            case WinToastRecorder::ShowAsync:
+            case WinToastRecorder::ShowAndRelease:
+                if (toast != nullptr) {
+                    shown = backend.show(*toast);
+                }
+                if (record.call == WinToastRecorder::ShowAndRelease) {
+                    objects.erase(record.object);
+                }
+                isShow = true;
+                break;
+            case WinToastRecorder::ShowDescriptor: {
+                // Copied out of the entry, descriptors must be aligned for their header.
+                std::vector<uint64_t> aligned((entry.payload.size() + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+                if (!entry.payload.empty()) {
+                    std::memcpy(aligned.data(), entry.payload.data(), entry.payload.size());
+                }
+                WinToastDescriptor view;
+                if (view.open(aligned.data(), entry.payload.size())) {
+                    WinToastTemplate described;
+                    view.toTemplate(described);
+                    shown = backend.show(described);
+                }
+                isShow = true;
+                break;
+            }
+            case WinToastRecorder::TemplateArgument:
+                args.push_back(WinToastCatalog::Argument{entry.strings[0].c_str(), entry.strings[1].c_str()});
+                break;
+            case WinToastRecorder::ShowTemplate: {
+                WinToastTemplate rendered;
+                if (catalog.render(static_cast<uint32_t>(record.value2), args.data(), args.size(), rendered)) {
+                    shown = backend.show(rendered);
+                }
+                args.clear();
+                isShow = true;
+                break;
+            }
+            case WinToastRecorder::Hide:
+                backend.hide(id(record.value));
+                break;
+            case WinToastRecorder::HideGroup:
+                backend.hideGroup(entry.strings[0]);
+                break;
+            case WinToastRecorder::HideByKey:
+                backend.hideByKey(entry.strings[0]);
+                break;
+            case WinToastRecorder::SetImageFromExecutable:
+            case WinToastRecorder::Cancel:
+                // Need the icon cache and the worker queue, neither of which has a stand-in.
+                break;
+            default:
+                continue;
+            }
+            report.calls++;
+
+            if (isShow) {
+                report.shows.push_back(WinToastRecorder::now() - callStarted);
+                report.recordedShows.push_back(record.duration);
+                if (shown == -1) {
+                    report.failedShows++;
+                } else if (record.value != -1) {
+                    ids[record.value] = shown;
+                }
+            }
+        }
+        report.durationNs = WinToastRecorder::now() - started;
+        report.allocations = Bench::Runner::allocationCount() - allocations;
+        return backend.outOfOrder() == 0;
+    }
+
+    // Records what Portmaster does for a burst of connection prompts: most are answered and hidden by
+    // Id, some are replaced through their key, and every so often all prompts are hidden by group.
+    bool recordSample(const std::wstring& path, std::size_t toasts) {
+        WinToastRecorder recorder;
+        if (!recorder.start(path)) {
+            return false;
+        }
+        const WinToastTemplate prompt = Sample::promptToast();
+        std::vector<uint8_t> descriptor;
+        WinToastDescriptor::write(prompt, descriptor);
+
+        for (std::size_t i = 0; i < toasts; i++) {
+            const int64_t id = static_cast<int64_t>(i);
+            const std::wstring title = L"Allow connection to host" + std::to_wstring(i % 97) + L".example.com?";
+            const std::wstring key = L"connection:" + std::to_wstring(i % 13);
+            const uint64_t started = WinToastRecorder::now();
+            if (i % 5 == 4) {
+                recorder.recordShow(WinToastRecorder::ShowDescriptor, 0, id, 0, WinToastRecorder::now() - started,
+                                    descriptor.data(), descriptor.size());
+            } else {
+                std::unique_ptr<WinToastTemplate> toast(new WinToastTemplate(WinToastTemplate::ImageAndText02));
+                // The lock is outside the Basic Multilingual Plane, so its text crosses the recording as a pair.
+                recorder.record(WinToastRecorder::Create, toast.get(), 0, 0, title.c_str(), L"\U0001F512 example-updater.exe");
+                recorder.record(WinToastRecorder::AddButton, toast.get(), 0, 0, L"Allow");
+                recorder.record(WinToastRecorder::AddButton, toast.get(), 0, 0, L"Block");
+                recorder.record(WinToastRecorder::SetImage, toast.get(), 0, 0, prompt.imagePath().c_str());
+                recorder.record(WinToastRecorder::SetGroup, toast.get(), 0, 0, L"prompts");
+                recorder.record(WinToastRecorder::SetKey, toast.get(), 0, 0, key.c_str());
+                const uint32_t object = recorder.object(toast.get(), true);
+                recorder.recordShow(WinToastRecorder::ShowAndRelease, object, id, 0, WinToastRecorder::now() - started);
+            }
+            if (i % 3 == 0) {
+                recorder.record(WinToastRecorder::Activated, nullptr, id, 0);
+                recorder.record(WinToastRecorder::Hide, nullptr, id);
+            } else if (i % 7 == 1) {
+                recorder.record(WinToastRecorder::HideByKey, nullptr, 0, 0, key.c_str());
+            }
+            if (i % 64 == 63) {
+                recorder.record(WinToastRecorder::HideGroup, nullptr, 0, 0, L"prompts");
+            }
+        }
+        recorder.stop();
+        return true;
+    }
+
+    void printLatency(const char* name, std::vector<uint64_t>& values) {
+        if (values.empty()) {
+            std::printf("%-16s %10s\n", name, "-");
+            return;
+        }
+        std::sort(values.begin(), values.end());
+        const std::size_t last = values.size() - 1;
+        std::printf("%-16s %10.1f %10.1f %10.1f us\n", name, values[last / 2] / 1000.0, values[last * 99 / 100] / 1000.0,
+                    values[last] / 1000.0);
+    }
+
+    int usage(const char* program) {
+        std::fprintf(stderr, "usage: %s [<recording>] [--real-time] [--catalog <file>] [--sample <n>] [--submit-ns <n>]\n", program);
+        return 2;
+    }
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (arg == "--real-time") {
+            options.realTime = true;
+        } else if (arg == "--catalog" && hasValue) {
+            options.catalog = argv[++i];
+        } else if (arg == "--sample" && hasValue) {
+            options.sample = std::size_t(std::strtoull(argv[++i], nullptr, 10));
+        } else if (arg == "--submit-ns" && hasValue) {
+            options.submitNs = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg.compare(0, 2, "--") != 0 && options.recording.empty()) {
+            options.recording = arg;
+        } else {
+            return usage(argv[0]);
+        }
+    }
+
+    WinToastCatalog catalog;
+    if (!options.catalog.empty() && !catalog.open(widen(options.catalog), LANG_NEUTRAL)) {
+        std::fprintf(stderr, "cannot open catalog %s\n", options.catalog.c_str());
+        return 2;
+    }
+    const bool sample = options.recording.empty();
+    const std::string path = sample ? "toast_replay_sample.pmrc" : options.recording;
+    if (sample && !recordSample(widen(path), options.sample)) {
+        std::fprintf(stderr, "cannot record the sample to %s\n", path.c_str());
+        return 2;
+    }
+    std::vector<WinToastRecorder::Entry> entries;
+    if (!WinToastRecorder::load(widen(path), entries)) {
+        std::fprintf(stderr, "cannot read recording %s\n", path.c_str());
+        return 2;
+    }
+    if (sample) {
+        std::remove(path.c_str());
+    }
+
+    Backend backend(options.submitNs);
+    Report report;
+    if (!replay(entries, options, catalog, backend, report)) {
+        std::fprintf(stderr, "FAILED: shows reached the notifier out of order\n");
+        return 1;
+    }
+
+    const double seconds = report.durationNs / 1e9;
+    std::printf("%llu calls, %llu events counted, %llu failed shows, %zu toasts left shown\n",
+                static_cast<unsigned long long>(report.calls), static_cast<unsigned long long>(report.events),
+                static_cast<unsigned long long>(report.failedShows), backend.shown());
+    std::printf("%.1f ms, %.0f calls/s, %.2f allocs/call\n", report.durationNs / 1e6, seconds > 0 ? report.calls / seconds : 0.0,
+                report.calls != 0 ? double(report.allocations) / double(report.calls) : 0.0);
+    std::printf("%-16s %10s %10s %10s\n", "show latency", "p50", "p99", "max");
+    printLatency("replayed", report.shows);
+    printLatency("recorded", report.recordedShows);
+
+    if (sample && (report.failedShows != 0 || report.shows.size() != options.sample)) {
+        std::fprintf(stderr, "FAILED: the sample replayed %zu of %zu shows\n", report.shows.size() - report.failedShows, options.sample);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,207 @@
+// Throughput of the render pool against the number of render threads.
+//
+// Mirrors the pipeline of WinToastWorker with render threads: shows arrive on an
+// MpscQueue, the worker thread hands them to the render pool through one locked
+// deque, and submits the prepared toasts strictly in arrival order. A render does
+// the portable part of WinToast::prepareToast (text budget, activation arguments,
+// XML composed into a per-show arena); the WinRT parse can be modelled with
+// --parse-ns. The stand-in notifier checks the order, reads the whole XML and
+// spins for --submit-ns, the cost of IToastNotifier::Show.
+//
+//   toast_scaling [--toasts <n>] [--max-threads <n>] [--parse-ns <n>] [--submit-ns <n>]
+#include "mpsc_queue.h"
+#include "sample_show.h"
+#include "sample_toast.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace WinToastLib;
+
+namespace {
+    typedef std::chrono::steady_clock Clock;
+
+    struct Options {
+        std::size_t toasts{20000};
+        unsigned    maxThreads{0};      // 0 for the hardware concurrency
+        uint64_t    parseNs{0};
+        uint64_t    submitNs{2000};
+    };
+
+    struct Show {
+        int64_t                             id;
+        std::unique_ptr<WinToastTemplate>   toast;
+    };
+
+    // What prepareToast hands to submission; the arena holds the XML.
+    struct Render {
+        Show                    show;
+        WinToastArena           arena;
+        const wchar_t*          xml{nullptr};
+        std::size_t             length{0};
+        std::atomic<bool>       done{false};
+    };
+
+    void prepare(Render& job, uint64_t parseNs) {
+        job.xml = Sample::composeToast(job.show.id, *job.show.toast, job.arena, job.length);
+        Sample::spin(parseNs);
+    }
+
+    class Pipeline {
+    public:
+        Pipeline(unsigned renderThreads, const Options& options) : m_options(options), m_notifier(options.submitNs) {
+            for (unsigned i = 0; i < renderThreads; i++) {
+                m_renderers.emplace_back(&Pipeline::render, this);
+            }
+        }
+
+        ~Pipeline() {
+            {
+                std::lock_guard<std::mutex> lock(m_renderLock);
+                m_renderStop = true;
+            }
+            m_renderReady.notify_all();
+            for (auto& renderer : m_renderers) {
+                renderer.join();
+            }
+        }
+
+        void push(Show show) {
+            m_queue.push(std::move(show));
+        }
+
+        // The worker thread: submits finished renders in order and feeds the pool.
+        void run(std::size_t count) {
+            std::size_t submitted = 0;
+            while (submitted < count) {
+                while (!m_inFlight.empty() && m_inFlight.front()->done.load(std::memory_order_acquire)) {
+                    std::unique_ptr<Render> job = std::move(m_inFlight.front());
+                    m_inFlight.pop_front();
+                    m_notifier.show(job->show.id, job->xml, job->length);
+                    submitted++;
+                }
+
+                Show show;
+                if (!m_queue.pop(show)) {
+                    std::this_thread::yield();
+                    continue;
+                }
+                std::unique_ptr<Render> job(new Render());
+                job->show = std::move(show);
+                if (m_renderers.empty()) {
+                    prepare(*job, m_options.parseNs);
+                    m_notifier.show(job->show.id, job->xml, job->length);
+                    submitted++;
+                    continue;
+                }
+                {
+                    std::lock_guard<std::mutex> lock(m_renderLock);
+                    m_renderQueue.push_back(job.get());
+                }
+                m_renderReady.notify_one();
+                m_inFlight.push_back(std::move(job));
+            }
+        }
+
+        const Sample::StandInNotifier& notifier() const { return m_notifier; }
+
+    private:
+        void render() {
+            for (;;) {
+                Render* job = nullptr;
+                {
+                    std::unique_lock<std::mutex> lock(m_renderLock);
+                    m_renderReady.wait(lock, [this] { return m_renderStop || !m_renderQueue.empty(); });
+                    if (m_renderQueue.empty()) {
+                        return;
+                    }
+                    job = m_renderQueue.front();
+                    m_renderQueue.pop_front();
+                }
+                prepare(*job, m_options.parseNs);
+                job->done.store(true, std::memory_order_release);
+            }
+        }
+
+        Options                                 m_options;
+        Sample::StandInNotifier                 m_notifier;
+        MpscQueue<Show>                         m_queue;
+        std::vector<std::thread>                m_renderers;
+        std::mutex                              m_renderLock;
+        std::condition_variable                 m_renderReady;
+        std::deque<Render*>                     m_renderQueue;
+        bool                                    m_renderStop{false};
+        std::deque<std::unique_ptr<Render>>     m_inFlight;
+    };
+
+    // Toasts per second with the given number of render threads, 0 rendering on the worker thread.
+    double measure(unsigned renderThreads, const Options& options, uint64_t& checksum) {
+        Pipeline pipeline(renderThreads, options);
+        const WinToastTemplate prompt = Sample::promptToast();
+        for (std::size_t i = 0; i < options.toasts; i++) {
+            pipeline.push(Show{int64_t(i), std::unique_ptr<WinToastTemplate>(new WinToastTemplate(prompt))});
+        }
+
+        const auto begin = Clock::now();
+        pipeline.run(options.toasts);
+        const double seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+        if (pipeline.notifier().outOfOrder() != 0) {
+            std::fprintf(stderr, "FAILED: %llu toasts submitted out of order\n", static_cast<unsigned long long>(pipeline.notifier().outOfOrder()));
+            std::exit(1);
+        }
+        checksum = pipeline.notifier().checksum();
+        return double(options.toasts) / seconds;
+    }
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            std::fprintf(stderr, "usage: %s [--toasts <n>] [--max-threads <n>] [--parse-ns <n>] [--submit-ns <n>]\n", argv[0]);
+            return 2;
+        }
+        const unsigned long long value = std::strtoull(argv[++i], nullptr, 10);
+        if (arg == "--toasts") {
+            options.toasts = std::size_t(value);
+        } else if (arg == "--max-threads") {
+            options.maxThreads = unsigned(value);
+        } else if (arg == "--parse-ns") {
+            options.parseNs = value;
+        } else if (arg == "--submit-ns") {
+            options.submitNs = value;
+        } else {
+            std::fprintf(stderr, "usage: %s [--toasts <n>] [--max-threads <n>] [--parse-ns <n>] [--submit-ns <n>]\n", argv[0]);
+            return 2;
+        }
+    }
+    const unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    const unsigned maxThreads = options.maxThreads != 0 ? options.maxThreads : cores;
+
+    std::printf("%zu toasts, %u hardware threads, parse %llu ns, submit %llu ns\n", options.toasts, cores,
+                static_cast<unsigned long long>(options.parseNs), static_cast<unsigned long long>(options.submitNs));
+    std::printf("%10s %14s %9s %11s\n", "renderers", "toasts/s", "speedup", "efficiency");
+    uint64_t serialChecksum = 0;
+    const double serial = measure(0, options, serialChecksum);
+    std::printf("%10s %14.0f %8.2fx %10s\n", "inline", serial, 1.0, "-");
+    for (unsigned threads = 1; threads <= maxThreads; threads = threads < maxThreads && threads * 2 > maxThreads ? maxThreads : threads * 2) {
+        uint64_t checksum = 0;
+        const double rate = measure(threads, options, checksum);
+        if (checksum != serialChecksum) {
+            std::fprintf(stderr, "FAILED: %u render threads produced different XML\n", threads);
+            return 1;
+        }
+        std::printf("%10u %14.0f %8.2fx %9.0f%%\n", threads, rate, rate / serial, 100 * rate / serial / std::min(threads, cores));
+    }
+    return 0;
+}
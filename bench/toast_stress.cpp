@@ -0,0 +1,439 @@
+// Concurrent show/hide/event churn on the registry, the string pool and the allocator pools.
+//
+// Producer threads show toasts the way WinToast::showToast does: Queued, insert
+// with eviction, Shown. Hider threads hide random Ids, by Id or by group, the way
+// WinToast::hide does. One event thread plays the WinRT event pool: it raises
+// Activated, Dismissed and Failed on the toasts the producers handed it through
+// an MpscQueue, and Dismissed(ApplicationHidden) on every hidden or evicted one,
+// as IToastNotifier::Hide does. Dismissed runs WinToastRegistry::dismissed like
+// the handler in wintoastlib.cpp, and every event ends in a handler that reports
+// through a WinToastEndGuard like the one of notification_glue.cpp.
+//
+//   toast_stress [--seconds <n>] [--producers <n>] [--hiders <n>] [--capacity <n>]
+//
+// Exits non-zero if an invariant is broken:
+// - the handler of every shown Id reports exactly one final dismissal or failure
+// - the state table holds a terminal state for every recent Id
+// - the registry, its byte count and all notifications are released at the end
+#include "mpsc_queue.h"
+#include "sample_toast.h"
+#include "toast_descriptor.h"
+#include "toast_end_guard.h"
+#include "toast_registry.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace WinToastLib;
+using ABI::Windows::UI::Notifications::IToastNotification;
+
+namespace {
+    std::atomic<int64_t> liveNotifications{0};
+
+    const std::size_t MaxIds = 1 << 24;
+    const int GroupCount = 8;
+    const int32_t FailedResult = int32_t(0x80004005);    // E_FAIL
+
+    // Counts what reaches the caller, as the WinToastHandler of notification_glue.cpp forwards it.
+    class StandInHandler {
+    public:
+        StandInHandler(int64_t id, std::atomic<uint8_t>* ends) : m_id(id), m_ends(ends) {}
+
+        void toastActivated(int) const {}
+        void toastDismissed(WinToastRegistry::DismissalReason reason) const {
+            // TimedOut is reported too, but is not final.
+            if (m_end.dismissed(reason == WinToastRegistry::TimedOut) && reason != WinToastRegistry::TimedOut) {
+                ended();
+            }
+        }
+        void toastFailed() const {
+            if (m_end.failed()) {
+                ended();
+            }
+        }
+
+    private:
+        void ended() const {
+            m_ends[m_id].fetch_add(1, std::memory_order_relaxed);
+        }
+
+        int64_t                     m_id;
+        std::atomic<uint8_t>*       m_ends;
+        mutable WinToastEndGuard    m_end;
+    };
+
+    // Holds its handler the way a notification holds the event handlers registered on it.
+    class StandInNotification : public IToastNotification {
+    public:
+        StandInNotification(int64_t id, std::shared_ptr<StandInHandler> handler) : id(id), handler(std::move(handler)) {
+            liveNotifications.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        ULONG AddRef() override {
+            return m_references.fetch_add(1, std::memory_order_relaxed) + 1;
+        }
+
+        ULONG Release() override {
+            const ULONG count = m_references.fetch_sub(1, std::memory_order_acq_rel) - 1;
+            if (count == 0) {
+                liveNotifications.fetch_sub(1, std::memory_order_relaxed);
+                delete this;
+            }
+            return count;
+        }
+
+        const int64_t                           id;
+        const std::shared_ptr<StandInHandler>   handler;
+
+    private:
+        ~StandInNotification() = default;
+
+        std::atomic<ULONG> m_references{0};
+    };
+
+    struct Options {
+        double      seconds{2};
+        unsigned    producers{4};
+        unsigned    hiders{2};
+        std::size_t capacity{512};
+    };
+
+    // What reaches the event thread: a shown toast, including the toast as the broker would pass it, or a hidden one.
+    struct Event {
+        enum Kind {
+            Shown,
+            Hidden
+        };
+
+        Kind                                            kind;
+        Microsoft::WRL::ComPtr<IToastNotification>      notification;
+        std::vector<uint8_t>                            descriptor;
+    };
+
+    class Stress {
+    public:
+        explicit Stress(const Options& options) : m_options(options), m_ends(new std::atomic<uint8_t>[MaxIds]) {
+            for (std::size_t i = 0; i < MaxIds; i++) {
+                m_ends[i].store(0, std::memory_order_relaxed);
+            }
+            std::vector<WinToastRegistry::Removed> evicted;
+            m_registry.setCapacity(options.capacity, 0, evicted);
+        }
+
+        bool run();
+
+    private:
+        void produce(unsigned seed, std::vector<uint64_t>& latencies);
+        void hide(unsigned seed, std::vector<uint64_t>& latencies);
+        void events(std::vector<uint64_t>& latencies);
+        // What IToastNotifier::Hide leads to: the state is set right away, Dismissed follows on the event thread.
+        void hidden(const WinToastRegistry::Removed& removed);
+        // The Activated, Dismissed and Failed handlers of WinToast.
+        void activated(const StandInNotification& notification, int action);
+        void dismissed(const StandInNotification& notification, WinToastRegistry::DismissalReason reason);
+        void failed(const StandInNotification& notification);
+        bool check();
+
+        static uint64_t elapsedNs(std::chrono::steady_clock::time_point begin) {
+            return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count());
+        }
+
+        static std::wstring group(int64_t id) {
+            return L"group" + std::to_wstring(id % GroupCount);
+        }
+
+        static const StandInNotification& standIn(const Microsoft::WRL::ComPtr<IToastNotification>& notification) {
+            return *static_cast<const StandInNotification*>(notification.Get());
+        }
+
+        Options                                 m_options;
+        WinToastRegistry                        m_registry;
+        MpscQueue<Event>                        m_events;
+        std::atomic<int64_t>                    m_nextId{1};
+        std::atomic<bool>                       m_stopping{false};
+        std::atomic<bool>                       m_cleared{false};
+        std::unique_ptr<std::atomic<uint8_t>[]> m_ends;
+        std::atomic<uint64_t>                   m_hides{0};
+        std::atomic<uint64_t>                   m_eventCount{0};
+    };
+
+    void Stress::hidden(const WinToastRegistry::Removed& removed) {
+        m_registry.setState(removed.id, WinToastRegistry::Hidden);
+        m_events.push(Event{Event::Hidden, removed.notification, {}});
+    }
+
+    void Stress::activated(const StandInNotification& notification, int action) {
+        WinToastRegistry::Entry entry;
+        if (m_registry.find(notification.id, entry)) {
+            m_registry.setState(notification.id, WinToastRegistry::Activated, action);
+            notification.handler->toastActivated(action);
+        }
+    }
+
+    void Stress::dismissed(const StandInNotification& notification, WinToastRegistry::DismissalReason reason) {
+        reason = m_registry.dismissed(notification.id, reason, false);
+        notification.handler->toastDismissed(reason);
+    }
+
+    void Stress::failed(const StandInNotification& notification) {
+        m_registry.remove(notification.id);
+        m_registry.setState(notification.id, WinToastRegistry::Failed, FailedResult);
+        notification.handler->toastFailed();
+    }
+
+    void Stress::produce(unsigned seed, std::vector<uint64_t>& latencies) {
+        std::minstd_rand random(seed);
+        WinToastTemplate toast = Sample::promptToast();
+        std::vector<WinToastRegistry::Removed> evicted;
+        while (!m_stopping.load(std::memory_order_relaxed)) {
+            const int64_t id = m_nextId.fetch_add(1, std::memory_order_relaxed);
+            if (id >= int64_t(MaxIds)) {
+                break;
+            }
+            const auto begin = std::chrono::steady_clock::now();
+            // Interning and releasing pooled strings from every thread, as callers build their templates.
+            toast.setKey(L"key" + std::to_wstring(id));
+            toast.setImagePath(L"icon" + std::to_wstring(random() % 64) + L".png");
+            Event shown{Event::Shown, Microsoft::WRL::ComPtr<IToastNotification>(
+                                          new StandInNotification(id, std::make_shared<StandInHandler>(id, m_ends.get()))), {}};
+            WinToastDescriptor::write(toast, shown.descriptor);
+
+            m_registry.setState(id, WinToastRegistry::Queued);
+            m_registry.insert(id, WinToastRegistry::Entry{shown.notification, nullptr, WinToastStats::now(), 0,
+                                                          int(id % WinToastRegistry::PriorityCount), 256, group(id), toast.key()}, evicted);
+            m_registry.setState(id, WinToastRegistry::Shown);
+            m_events.push(std::move(shown));
+            for (const auto& entry : evicted) {
+                hidden(entry);
+            }
+            latencies.push_back(elapsedNs(begin));
+        }
+    }
+
+    void Stress::hide(unsigned seed, std::vector<uint64_t>& latencies) {
+        std::minstd_rand random(seed);
+        std::vector<WinToastRegistry::Removed> removed;
+        while (!m_stopping.load(std::memory_order_relaxed)) {
+            const int64_t last = m_nextId.load(std::memory_order_relaxed) - 1;
+            if (last < 1) {
+                std::this_thread::yield();
+                continue;
+            }
+            const auto begin = std::chrono::steady_clock::now();
+            if (random() % 64 == 0) {
+                m_registry.removeGroup(group(random()), removed);
+                for (const auto& entry : removed) {
+                    hidden(entry);
+                }
+            } else {
+                // Mostly recent Ids, which are the ones still live.
+                const int64_t id = std::max<int64_t>(1, last - int64_t(random() % (2 * std::max<std::size_t>(m_options.capacity, 1))));
+                WinToastRegistry::Entry entry;
+                if (m_registry.remove(id, &entry)) {
+                    hidden(WinToastRegistry::Removed{id, std::move(entry.notification)});
+                }
+            }
+            m_hides.fetch_add(1, std::memory_order_relaxed);
+            latencies.push_back(elapsedNs(begin));
+        }
+    }
+
+    void Stress::events(std::vector<uint64_t>& latencies) {
+        std::minstd_rand random(7);
+        std::vector<Microsoft::WRL::ComPtr<IToastNotification>> timedOut;
+        for (;;) {
+            Event event;
+            if (!m_events.pop(event)) {
+                // Once cleared nothing pushes any more, and what was pushed before is visible.
+                if (m_cleared.load(std::memory_order_acquire) && m_events.empty()) {
+                    break;
+                }
+                std::this_thread::yield();
+                continue;
+            }
+            const auto begin = std::chrono::steady_clock::now();
+            const StandInNotification& notification = standIn(event.notification);
+            if (event.kind == Event::Hidden) {
+                dismissed(notification, WinToastRegistry::ApplicationHidden);
+                m_eventCount.fetch_add(1, std::memory_order_relaxed);
+                latencies.push_back(elapsedNs(begin));
+                continue;
+            }
+
+            WinToastDescriptor descriptor;
+            WinToastTemplate toast;
+            if (descriptor.open(event.descriptor.data(), event.descriptor.size())) {
+                descriptor.toTemplate(toast);
+            }
+            switch (random() % 5) {
+            case 0:
+                // Activation does not end a toast, it stays registered until hidden.
+                activated(notification, int(random() % 3) - 1);
+                break;
+            case 1:
+                dismissed(notification, WinToastRegistry::UserCanceled);
+                break;
+            case 2:
+                // Timed out into the Action Center: stays registered and may be activated or dismissed from there later.
+                dismissed(notification, WinToastRegistry::TimedOut);
+                timedOut.push_back(std::move(event.notification));
+                break;
+            case 3:
+                // Both events may be raised for one notification, only the first may reach the caller.
+                failed(notification);
+                if (random() % 2 == 0) {
+                    dismissed(notification, WinToastRegistry::UserCanceled);
+                }
+                break;
+            default:
+                // Late event of a toast whose slot a newer toast may hold by now.
+                m_registry.setState(std::max<int64_t>(1, notification.id - int64_t(WinToastRegistry::StateSlots)), WinToastRegistry::Dismissed);
+                break;
+            }
+            if (timedOut.size() > 64) {
+                auto it = timedOut.begin() + std::ptrdiff_t(random() % timedOut.size());
+                if (random() % 2 == 0) {
+                    activated(standIn(*it), -1);
+                } else {
+                    dismissed(standIn(*it), WinToastRegistry::UserCanceled);
+                }
+                timedOut.erase(it);
+            }
+            m_eventCount.fetch_add(1, std::memory_order_relaxed);
+            latencies.push_back(elapsedNs(begin));
+        }
+    }
+
+    void printLatency(const char* name, std::vector<uint64_t>& latencies, double seconds) {
+        if (latencies.empty()) {
+            std::printf("%-8s no operations\n", name);
+            return;
+        }
+        std::sort(latencies.begin(), latencies.end());
+        const auto at = [&latencies](double quantile) { return latencies[std::size_t(quantile * double(latencies.size() - 1))]; };
+        std::printf("%-8s %10.0f ops/s  p50 %8llu ns  p99 %8llu ns  p99.9 %8llu ns  max %10llu ns\n", name,
+                    double(latencies.size()) / seconds, static_cast<unsigned long long>(at(0.5)), static_cast<unsigned long long>(at(0.99)),
+                    static_cast<unsigned long long>(at(0.999)), static_cast<unsigned long long>(latencies.back()));
+    }
+
+    bool Stress::run() {
+        std::vector<std::vector<uint64_t>> showLatencies(m_options.producers), hideLatencies(m_options.hiders);
+        std::vector<uint64_t> eventLatencies;
+        std::vector<std::thread> threads;
+        const auto begin = std::chrono::steady_clock::now();
+        for (unsigned i = 0; i < m_options.producers; i++) {
+            threads.emplace_back(&Stress::produce, this, 100 + i, std::ref(showLatencies[i]));
+        }
+        for (unsigned i = 0; i < m_options.hiders; i++) {
+            threads.emplace_back(&Stress::hide, this, 200 + i, std::ref(hideLatencies[i]));
+        }
+        std::thread eventThread(&Stress::events, this, std::ref(eventLatencies));
+
+        std::this_thread::sleep_for(std::chrono::duration<double>(m_options.seconds));
+        m_stopping.store(true, std::memory_order_relaxed);
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        const double seconds = double(elapsedNs(begin)) / 1e9;
+
+        // What is still live is hidden by WinToast::clear at shutdown, the event thread delivers the dismissals.
+        std::vector<WinToastRegistry::Removed> removed;
+        m_registry.removeAll(removed);
+        for (const auto& entry : removed) {
+            hidden(entry);
+        }
+        removed.clear();
+        m_cleared.store(true, std::memory_order_release);
+        eventThread.join();
+
+        std::vector<uint64_t> shows, hides;
+        for (auto& latencies : showLatencies) {
+            shows.insert(shows.end(), latencies.begin(), latencies.end());
+        }
+        for (auto& latencies : hideLatencies) {
+            hides.insert(hides.end(), latencies.begin(), latencies.end());
+        }
+        std::printf("%u producers, %u hiders, 1 event thread, capacity %zu, %.2f s\n", m_options.producers, m_options.hiders,
+                    m_options.capacity, seconds);
+        printLatency("show", shows, seconds);
+        printLatency("hide", hides, seconds);
+        printLatency("event", eventLatencies, seconds);
+        return check();
+    }
+
+    bool Stress::check() {
+        bool passed = true;
+        const auto fail = [&passed](const char* what, unsigned long long count) {
+            std::fprintf(stderr, "FAILED: %s (%llu)\n", what, count);
+            passed = false;
+        };
+
+        const int64_t shown = std::min<int64_t>(m_nextId.load(), int64_t(MaxIds));
+        unsigned long long lost = 0, repeated = 0, unended = 0;
+        for (int64_t id = 1; id < shown; id++) {
+            const uint8_t ends = m_ends[id].load(std::memory_order_relaxed);
+            if (ends == 0) {
+                lost++;
+            } else if (ends > 1) {
+                repeated++;
+            }
+        }
+        // The newest Ids still own their state slot, and every toast was either activated or ended.
+        for (int64_t id = std::max<int64_t>(1, shown - int64_t(WinToastRegistry::StateSlots)); id < shown; id++) {
+            if (m_registry.state(id) < WinToastRegistry::Activated) {
+                unended++;
+            }
+        }
+        if (lost != 0) {
+            fail("Ids without a final callback", lost);
+        }
+        if (repeated != 0) {
+            fail("Ids with more than one final callback", repeated);
+        }
+        if (unended != 0) {
+            fail("state slots without a terminal state", unended);
+        }
+        if (m_registry.count() != 0 || m_registry.bytes() != 0) {
+            fail("registry not empty", m_registry.count());
+        }
+        if (liveNotifications.load() != 0) {
+            fail("notifications not released", static_cast<unsigned long long>(liveNotifications.load()));
+        }
+        std::printf("%lld toasts, %llu hides, %llu events: %s\n", static_cast<long long>(shown - 1), static_cast<unsigned long long>(m_hides.load()),
+                    static_cast<unsigned long long>(m_eventCount.load()), passed ? "all invariants hold" : "FAILED");
+        return passed;
+    }
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        const std::string arg = argv[i];
+        if (arg == "--seconds") {
+            options.seconds = std::atof(argv[i + 1]);
+        } else if (arg == "--producers") {
+            options.producers = unsigned(std::atoi(argv[i + 1]));
+        } else if (arg == "--hiders") {
+            options.hiders = unsigned(std::atoi(argv[i + 1]));
+        } else if (arg == "--capacity") {
+            options.capacity = std::size_t(std::atoi(argv[i + 1]));
+        } else {
+            std::fprintf(stderr, "usage: %s [--seconds <n>] [--producers <n>] [--hiders <n>] [--capacity <n>]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (argc % 2 == 0) {
+        std::fprintf(stderr, "usage: %s [--seconds <n>] [--producers <n>] [--hiders <n>] [--capacity <n>]\n", argv[0]);
+        return 2;
+    }
+
+    Stress stress(options);
+    return stress.run() ? 0 : 1;
+}
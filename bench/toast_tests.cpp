@@ -0,0 +1,1059 @@
+// Checks of the sources the bench target builds, run by ctest.
+#include "sample_pe.h"
+#include "sample_toast.h"
+#include "icon_index.h"
+#include "mpsc_queue.h"
+#include "pe_icon.h"
+#include "toast_allocator.h"
+#include "toast_arguments.h"
+#include "toast_broker.h"
+#include "toast_budget.h"
+#include "toast_catalog.h"
+#include "toast_descriptor.h"
+#include "toast_end_guard.h"
+#include "toast_history.h"
+#include "toast_mapping.h"
+#include "toast_pipe.h"
+#include "toast_recorder.h"
+#include "toast_registry.h"
+#include "toast_stats.h"
+#include "toast_strings.h"
+#include "toast_xml.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace WinToastLib;
+
+namespace {
+    int failures = 0;
+
+    typedef void (*TestFunc)();
+
+    struct Test {
+        const char* name;
+        TestFunc    func;
+    };
+
+    std::vector<Test>& tests() {
+        static std::vector<Test> registered;
+        return registered;
+    }
+
+    struct Registrar {
+        Registrar(const char* name, TestFunc func) {
+            tests().push_back(Test{name, func});
+        }
+    };
+
+    struct CatalogEntry {
+        uint32_t                    id;
+        uint16_t                    language;
+        uint8_t                     type;
+        std::vector<std::wstring>   texts;
+        std::vector<std::wstring>   actions;
+        std::wstring                attribution;    // none if empty
+    };
+
+    template <typename T>
+    void append(std::vector<uint8_t>& bytes, T value) {
+        const std::size_t at = bytes.size();
+        bytes.resize(at + sizeof(T));
+        std::memcpy(bytes.data() + at, &value, sizeof(T));
+    }
+
+    // A catalog file in the layout toast_catalog.h documents: header, entries, string references, characters.
+    std::vector<uint8_t> catalogFile(const std::vector<CatalogEntry>& entries) {
+        std::vector<std::wstring> strings;
+        std::vector<uint8_t> bytes;
+        std::vector<uint8_t> entryBytes;
+        for (const CatalogEntry& entry : entries) {
+            append<uint32_t>(entryBytes, entry.id);
+            append<uint16_t>(entryBytes, entry.language);
+            append<uint8_t>(entryBytes, entry.type);
+            append<uint8_t>(entryBytes, 0);
+            append<uint8_t>(entryBytes, uint8_t(entry.texts.size()));
+            append<uint8_t>(entryBytes, uint8_t(entry.actions.size()));
+            append<uint8_t>(entryBytes, entry.attribution.empty() ? 0 : 1);
+            append<uint8_t>(entryBytes, 0);
+            append<uint32_t>(entryBytes, uint32_t(strings.size()));
+            strings.insert(strings.end(), entry.texts.begin(), entry.texts.end());
+            strings.insert(strings.end(), entry.actions.begin(), entry.actions.end());
+            if (!entry.attribution.empty()) {
+                strings.push_back(entry.attribution);
+            }
+        }
+        std::wstring chars;
+        std::vector<uint8_t> refBytes;
+        for (const std::wstring& string : strings) {
+            append<uint32_t>(refBytes, uint32_t(chars.size()));
+            append<uint32_t>(refBytes, uint32_t(string.size()));
+            chars += string;
+        }
+
+        append<uint32_t>(bytes, 0x43544d50);
+        append<uint16_t>(bytes, 1);
+        append<uint16_t>(bytes, uint16_t(entries.size()));
+        append<uint32_t>(bytes, uint32_t(strings.size()));
+        append<uint32_t>(bytes, uint32_t(chars.size()));
+        bytes.insert(bytes.end(), entryBytes.begin(), entryBytes.end());
+        bytes.insert(bytes.end(), refBytes.begin(), refBytes.end());
+        for (const wchar_t c : chars) {
+            append<wchar_t>(bytes, c);
+        }
+        return bytes;
+    }
+
+    void writeFile(const char* path, const std::vector<uint8_t>& bytes) {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(bytes.data()), std::streamsize(bytes.size()));
+    }
+}
+
+#define TEST(name) \
+    static void name(); \
+    static const Registrar name##Registrar(#name, name); \
+    static void name()
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+            failures++; \
+        } \
+    } while (false)
+
+TEST(argumentsRoundTrip) {
+    const std::wstring encoded = WinToastArguments::encode(0x1234567890abcdefll, 3, L"token:1");
+    CHECK(encoded == L"pm1:1234567890abcdef:3:token:1");
+    WinToastArguments::Decoded decoded;
+    CHECK(WinToastArguments::decode(encoded.data(), encoded.size(), decoded));
+    CHECK(decoded.id == 0x1234567890abcdefll);
+    CHECK(decoded.action == 3);
+    CHECK(std::wstring(decoded.token, decoded.tokenLength) == L"token:1");
+
+    const std::wstring body = WinToastArguments::encode(7, WinToastArguments::BodyAction);
+    CHECK(WinToastArguments::decode(body.data(), body.size(), decoded));
+    CHECK(decoded.id == 7 && decoded.action == WinToastArguments::BodyAction && decoded.tokenLength == 0);
+}
+
+TEST(argumentsRejectForeign) {
+    WinToastArguments::Decoded decoded;
+    const wchar_t* foreign[] = {L"", L"action=allow", L"pm1:", L"pm1:123:1", L"pm1:zz34567890abcdef:1", L"pm2:1234567890abcdef:1",
+                                L"pm1:1234567890abcdef:", L"pm1:1234567890abcdef:x"};
+    for (const wchar_t* arguments : foreign) {
+        CHECK(!WinToastArguments::decode(arguments, std::wcslen(arguments), decoded));
+    }
+}
+
+TEST(descriptorRoundTrip) {
+    const WinToastTemplate toast = Sample::promptToast();
+    std::vector<uint8_t> buffer;
+    CHECK(WinToastDescriptor::write(toast, buffer));
+    CHECK(buffer.size() == WinToastDescriptor::measure(toast));
+
+    WinToastDescriptor descriptor;
+    CHECK(descriptor.open(buffer.data(), buffer.size()));
+    const WinToastDescriptor::Text label = descriptor.actionLabel(2);
+    CHECK(std::wstring(label.data, label.length) == L"Block all");
+    CHECK(descriptor.expiration() == 60000);
+
+    WinToastTemplate copy;
+    descriptor.toTemplate(copy);
+    CHECK(Sample::sameToast(toast, copy));
+}
+
+TEST(descriptorRejectsDamage) {
+    std::vector<uint8_t> buffer;
+    WinToastDescriptor::write(Sample::promptToast(), buffer);
+    WinToastDescriptor descriptor;
+    CHECK(!descriptor.open(buffer.data(), buffer.size() - 1));
+    CHECK(!descriptor.open(buffer.data() + 8, buffer.size() - 8));
+
+    std::vector<uint8_t> damaged = buffer;
+    reinterpret_cast<WinToastDescriptor::Header*>(damaged.data())->reserved = 1;
+    CHECK(!descriptor.open(damaged.data(), damaged.size()));
+    damaged = buffer;
+    reinterpret_cast<WinToastDescriptor::Header*>(damaged.data())->type = 8;
+    CHECK(!descriptor.open(damaged.data(), damaged.size()));
+    // The terminator of the last string.
+    damaged = buffer;
+    damaged[damaged.size() - 1] = 0x41;
+    damaged[damaged.size() - sizeof(wchar_t)] = 0x41;
+    CHECK(!descriptor.open(damaged.data(), damaged.size()));
+
+    WinToastTemplate tooMany(WinToastTemplate::Text01);
+    for (std::size_t i = 0; i <= WinToastDescriptor::MaxActions; i++) {
+        tooMany.addAction(L"action");
+    }
+    CHECK(WinToastDescriptor::measure(tooMany) == 0);
+}
+
+TEST(budgetKeepsTails) {
+    std::wstring out;
+    WinToastTextBudget::shorten(L"short", 16, WinToastTextBudget::Auto, out);
+    CHECK(out == L"short");
+
+    const std::wstring path = L"C:\\Program Files\\Example Vendor\\Example App\\bin\\example-updater.exe";
+    WinToastTextBudget::shorten(path.c_str(), 40, WinToastTextBudget::Auto, out);
+    CHECK(out.size() <= 40);
+    CHECK(out.find(WinToastTextBudget::Ellipsis) != std::wstring::npos);
+    CHECK(out.size() >= 19 && out.compare(out.size() - 19, 19, L"example-updater.exe") == 0);
+
+    WinToastTextBudget::shorten(L"a-long-subdomain.of-a-tracking-service.example.co.uk", 24, WinToastTextBudget::Auto, out);
+    CHECK(out.size() <= 24);
+    CHECK(out.size() >= 13 && out.compare(out.size() - 13, 13, L"example.co.uk") == 0);
+}
+
+TEST(budgetKeepsTailsOfLongInput) {
+    // Past MaxScan the tail is taken from the end of the input, not from where the scan stops.
+    std::wstring out;
+    const std::wstring path = L"C:\\" + std::wstring(WinToastTextBudget::MaxScan + 1000, L'x') + L"\\example-updater.exe";
+    WinToastTextBudget::shorten(path.c_str(), 40, WinToastTextBudget::Auto, out);
+    CHECK(out.size() <= 40);
+    CHECK(out.size() >= 19 && out.compare(out.size() - 19, 19, L"example-updater.exe") == 0);
+
+    const std::wstring domain = std::wstring(3 * WinToastTextBudget::MaxScan, L'a') + L".example.co.uk";
+    WinToastTextBudget::shorten(domain.data(), domain.size(), 24, WinToastTextBudget::Auto, out);
+    CHECK(out.size() <= 24);
+    CHECK(out.size() >= 13 && out.compare(out.size() - 13, 13, L"example.co.uk") == 0);
+
+    const std::wstring plain = std::wstring(WinToastTextBudget::MaxScan, L'h') + std::wstring(WinToastTextBudget::MaxScan, L't');
+    WinToastTextBudget::shorten(plain.c_str(), 2 * WinToastTextBudget::MaxScan, WinToastTextBudget::Plain, out);
+    CHECK(out.size() < WinToastTextBudget::MaxScan && out.front() == L'h' && out.back() == L't');
+}
+
+TEST(budgetKeepsSurrogatePairs) {
+    // U+1F600 as a UTF-16 pair, the way the library sees text on Windows.
+    std::wstring text;
+    for (int i = 0; i < 40; i++) {
+        text += L'\xD83D';
+        text += L'\xDE00';
+    }
+    std::wstring out;
+    WinToastTextBudget::shorten(text.data(), text.size(), 21, WinToastTextBudget::Plain, out);
+    CHECK(out.size() <= 21);
+    for (std::size_t i = 0; i < out.size(); i++) {
+        if (out[i] == L'\xD83D') {
+            CHECK(i + 1 < out.size() && out[i + 1] == L'\xDE00');
+        }
+    }
+}
+
+TEST(xmlComposerEscapes) {
+    WinToastTemplate toast(WinToastTemplate::Text02);
+    toast.setFirstLine(L"a & b < \"c\" > 'd'");
+    toast.addAction(L"Allow");
+    const std::wstring launch = WinToastArguments::encode(1, WinToastArguments::BodyAction);
+    const std::vector<std::wstring> actions{WinToastArguments::encode(1, 0)};
+    const WinToastXml composer(toast, launch, actions, true);
+
+    std::wstring xml;
+    composer.flatten(xml);
+    CHECK(xml.size() == composer.length());
+    CHECK(xml.find(L"a &amp; b &lt; &quot;c&quot; &gt; &apos;d&apos;") != std::wstring::npos);
+    CHECK(xml.compare(0, 15, L"<toast launch=\"") == 0);
+    CHECK(xml.find(L"Allow") != std::wstring::npos);
+
+    std::vector<wchar_t> buffer(composer.length());
+    CHECK(composer.write(buffer.data(), buffer.size()) == composer.length());
+    CHECK(std::wstring(buffer.data(), buffer.size()) == xml);
+
+    // Without modern features the actions are left out.
+    const WinToastXml legacy(toast, launch, actions, false);
+    std::wstring legacyXml;
+    legacy.flatten(legacyXml);
+    CHECK(legacyXml.find(L"Allow") == std::wstring::npos);
+}
+
+TEST(peIconPicksPreferredSize) {
+    const std::vector<uint8_t> image = Sample::peImage({16, 32, 48, 256});
+    std::vector<uint8_t> ico;
+    const unsigned preferred[] = {1, 24, 32, 100, 512};
+    const unsigned expected[] = {16, 32, 32, 256, 256};
+    for (std::size_t i = 0; i < 5; i++) {
+        CHECK(PeIcon::extractIcon(image.data(), image.size(), preferred[i], ico));
+        CHECK(ico.size() == 22 + expected[i] * expected[i]);
+        CHECK(ico.size() > 22 && ico[22] == static_cast<uint8_t>(expected[i]) && ico.back() == static_cast<uint8_t>(expected[i]));
+    }
+
+    // Cut inside the resource directory, and one byte short of the last icon.
+    CHECK(!PeIcon::extractIcon(image.data(), 0x200 + 40, 32, ico));
+    CHECK(!PeIcon::extractIcon(image.data(), image.size() - 1, 256, ico));
+    CHECK(!PeIcon::extractIcon(nullptr, 0, 32, ico));
+    const std::vector<uint8_t> empty = Sample::peImage({});
+    CHECK(!PeIcon::extractIcon(empty.data(), empty.size(), 32, ico));
+}
+
+TEST(iconIndexInvalidatesChangedSources) {
+    WinToastIconIndex index;
+    index.reset(1000);
+    std::wstring name;
+    CHECK(!index.findSource(L"C:\\a.png", 10, 100, name));
+    index.insertFile(L"1.png", 100);
+    index.rememberSource(L"C:\\a.png", 10, 100, L"1.png");
+    CHECK(index.findSource(L"C:\\a.png", 10, 100, name) && name == L"1.png");
+
+    // A new write time or size means the source changed and is converted again.
+    CHECK(!index.findSource(L"C:\\a.png", 11, 100, name));
+    CHECK(!index.findSource(L"C:\\a.png", 10, 101, name));
+    index.insertFile(L"2.png", 100);
+    index.rememberSource(L"C:\\a.png", 11, 100, L"2.png");
+    CHECK(index.findSource(L"C:\\a.png", 11, 100, name) && name == L"2.png");
+    CHECK(!index.findSource(L"C:\\a.png", 10, 100, name));
+
+    // The icon of an executable is another source than the executable read as an image.
+    CHECK(!index.findSource(L"C:\\a.png|icon", 11, 100, name));
+    CHECK(index.usedBytes() == 200 && index.fileCount() == 2);
+}
+
+TEST(iconIndexEvictsLeastRecentlyUsed) {
+    WinToastIconIndex index;
+    index.reset(300);
+    index.insertFile(L"1.png", 100);
+    index.insertFile(L"2.png", 100);
+    index.insertFile(L"3.png", 100);
+    index.rememberSource(L"a", 1, 1, L"1.png");
+    index.rememberSource(L"b", 1, 1, L"2.png");
+    CHECK(index.evict().empty());
+
+    // A hit makes the file the most recently used one, so 2.png goes first.
+    std::wstring name;
+    CHECK(index.findSource(L"a", 1, 1, name));
+    index.insertFile(L"4.png", 100);
+    const std::vector<std::wstring> evicted = index.evict();
+    CHECK(evicted.size() == 1 && evicted[0] == L"2.png");
+    CHECK(index.usedBytes() == 300 && index.fileCount() == 3);
+
+    // A source whose file was evicted misses even though it did not change.
+    CHECK(!index.findSource(L"b", 1, 1, name));
+    CHECK(index.findFile(L"3.png") && index.findFile(L"1.png"));
+
+    // Updating a file's size re-accounts it; the newest file stays even if it alone is over budget.
+    index.insertFile(L"5.png", 1000);
+    CHECK(index.evict().size() == 3);
+    CHECK(index.fileCount() == 1 && index.usedBytes() == 1000 && index.findFile(L"5.png"));
+    index.insertFile(L"5.png", 50);
+    CHECK(index.evict().empty() && index.usedBytes() == 50);
+
+    index.reset(300);
+    CHECK(index.fileCount() == 0 && index.usedBytes() == 0 && !index.findSource(L"a", 1, 1, name));
+}
+
+TEST(statsQuantiles) {
+    WinToastStats stats;
+    for (uint64_t i = 1; i <= 1000; i++) {
+        stats.recordNs(WinToastStats::XmlBuild, i * 1000);
+    }
+    stats.increment(WinToastStats::Shown);
+    stats.recordFailure(-2147467259);
+    stats.recordFailure(-2147467259);
+
+    WinToastStats::Snapshot snapshot;
+    stats.snapshot(snapshot);
+    const WinToastStats::Latency& latency = snapshot.stages[WinToastStats::XmlBuild];
+    CHECK(latency.count == 1000);
+    CHECK(latency.sumNs == 500500000);
+    CHECK(latency.maxNs == 1000000);
+    // Log-linear buckets bound the error to 25%.
+    CHECK(latency.p50Ns >= 500000 && latency.p50Ns <= 625000);
+    CHECK(latency.p99Ns >= 990000 && latency.p99Ns <= 1250000);
+    CHECK(snapshot.counters[WinToastStats::Shown] == 1);
+    CHECK(snapshot.failureCount == 1 && snapshot.failures[0].count == 2);
+}
+
+TEST(stringPoolSharesValues) {
+    const std::size_t before = WinToastStringPool::count();
+    {
+        WinToastString a(std::wstring(L"pooled value")), b(std::wstring(L"pooled value")), c(std::wstring(L"other value"));
+        CHECK(a == b && a != c);
+        CHECK(a.str() == L"pooled value");
+        CHECK(WinToastStringPool::count() == before + 2);
+        WinToastString copy = a;
+        CHECK(copy.handle() == a.handle());
+        CHECK(WinToastString(std::wstring()).empty());
+    }
+    CHECK(WinToastStringPool::count() == before);
+}
+
+TEST(allocatorHooksAccount) {
+    struct Counting {
+        std::size_t allocations;
+        std::size_t resets;
+    } counting{0, 0};
+    WinToastAllocator::Hooks hooks{
+        [](void* context, std::size_t size, std::size_t) -> void* {
+            static_cast<Counting*>(context)->allocations++;
+            return new (std::nothrow) char[size];
+        },
+        [](void*, void* memory, std::size_t, std::size_t) { delete[] static_cast<char*>(memory); },
+        [](void* context) { static_cast<Counting*>(context)->resets++; },
+        &counting};
+    CHECK(!WinToastAllocator::setHooks(WinToastAllocator::Hooks{hooks.allocate, nullptr, nullptr, nullptr}));
+    CHECK(WinToastAllocator::setHooks(hooks));
+
+    void* memory = WinToastAllocator::allocate(100, 16);
+    CHECK(reinterpret_cast<uintptr_t>(memory) % 16 == 0);
+    CHECK(WinToastAllocator::allocatedBytes() >= 100);
+    {
+        WinToastArena arena;
+        for (int i = 0; i < 100; i++) {
+            CHECK(reinterpret_cast<uintptr_t>(arena.allocate(24, 8)) % 8 == 0);
+        }
+        CHECK(arena.allocate(WinToastArena::ChunkSize * 2, 64) != nullptr);
+    }
+    WinToastAllocator::deallocate(memory, 100, 16);
+    CHECK(WinToastAllocator::allocatedBytes() == 0);
+    CHECK(counting.allocations > 2 && counting.resets >= 1);
+
+    CHECK(WinToastAllocator::setHooks(WinToastAllocator::Hooks{nullptr, nullptr, nullptr, nullptr}));
+}
+
+TEST(poolReusesBlocks) {
+    WinToastPool pool(40, 8);
+    void* first = pool.allocate();
+    void* second = pool.allocate();
+    CHECK(first != second);
+    pool.deallocate(second);
+    CHECK(pool.allocate() == second);
+    pool.deallocate(second);
+    pool.deallocate(first);
+}
+
+TEST(registryEvictsLowestPriorityFirst) {
+    WinToastRegistry registry;
+    std::vector<WinToastRegistry::Removed> evicted;
+    registry.setCapacity(2, 0, evicted);
+    const int priorities[] = {WinToastTemplate::High, WinToastTemplate::Low, WinToastTemplate::Normal};
+    for (int64_t id = 1; id <= 3; id++) {
+        registry.insert(id, WinToastRegistry::Entry{nullptr, nullptr, WinToastStats::now(), 0, priorities[id - 1], 0, L"group",
+                                                    L"key" + std::to_wstring(id)}, evicted);
+    }
+    CHECK(evicted.size() == 1 && evicted[0].id == 2);
+    CHECK(registry.count() == 2);
+
+    std::vector<WinToastRegistry::Removed> removed;
+    registry.removeKey(L"key3", removed);
+    CHECK(removed.size() == 1 && removed[0].id == 3);
+    registry.removeGroup(L"group", removed);
+    CHECK(removed.size() == 1 && removed[0].id == 1);
+    CHECK(registry.count() == 0 && registry.bytes() == 0);
+}
+
+TEST(registryRemovesBySource) {
+    // The toasts of this process and those a broker client showed through it share the group and key.
+    WinToastRegistry registry;
+    std::vector<WinToastRegistry::Removed> evicted, removed;
+    const int64_t client = int64_t(2) << WinToastRegistry::SequenceBits;
+    for (const int64_t id : {int64_t(1), client + 1, client + 2, (int64_t(3) << WinToastRegistry::SequenceBits) + 1}) {
+        registry.insert(id, WinToastRegistry::Entry{nullptr, nullptr, WinToastStats::now(), 0, 0, 0, L"prompts", L"key"}, evicted);
+    }
+    registry.removeGroup(L"prompts", removed, 2);
+    CHECK(removed.size() == 2 && registry.count() == 2);
+    registry.removeKey(L"key", removed, 2);
+    CHECK(removed.empty());
+    registry.removeKey(L"key", removed, 0);
+    CHECK(removed.size() == 1 && removed[0].id == 1);
+    registry.removeGroup(L"prompts", removed);
+    CHECK(removed.size() == 1 && registry.count() == 0);
+}
+
+TEST(registryRemoveHandsOutEntry) {
+    WinToastRegistry registry;
+    std::vector<WinToastRegistry::Removed> evicted;
+    registry.insert(7, WinToastRegistry::Entry{nullptr, nullptr, WinToastStats::now(), 0, 0, 64, L"prompts", L"prompt:7"}, evicted);
+    WinToastRegistry::Entry entry;
+    CHECK(registry.remove(7, &entry));
+    CHECK(entry.group == L"prompts" && entry.key == L"prompt:7" && entry.bytes == 64);
+    CHECK(registry.count() == 0 && registry.bytes() == 0);
+
+    // The indexes must not keep the id of the removed entry.
+    std::vector<WinToastRegistry::Removed> removed;
+    registry.removeGroup(L"prompts", removed);
+    CHECK(removed.empty());
+    registry.removeKey(L"prompt:7", removed);
+    CHECK(removed.empty());
+}
+
+TEST(registryChurnReturnsToEmpty) {
+    // Every way out of the registry, many times over, must give back exactly the bytes it took.
+    WinToastRegistry registry;
+    std::vector<WinToastRegistry::Removed> evicted, removed;
+    registry.setCapacity(512, 0, evicted);
+    const std::wstring groups[] = {L"prompts", L"updates", L"alerts", L"network", std::wstring()};
+    uint64_t seed = 0x9e3779b97f4a7c15ull;
+    std::vector<int64_t> live;
+    for (int64_t id = 0; id < 100000; id++) {
+        seed ^= seed << 13;
+        seed ^= seed >> 7;
+        seed ^= seed << 17;
+        std::wstring key = seed % 3 == 0 ? std::wstring() : L"key" + std::to_wstring(seed % 1024);
+        registry.insert(id, WinToastRegistry::Entry{nullptr, nullptr, WinToastStats::now(), 0, int(seed % 3), std::size_t(seed % 4096),
+                                                    groups[seed % 5], std::move(key)}, evicted);
+        live.push_back(id);
+        CHECK(registry.bytes() < uint64_t(1) << 32);
+
+        switch ((seed >> 8) % 8) {
+        case 0: {
+            WinToastRegistry::Entry entry;
+            registry.remove(live[std::size_t(seed >> 16) % live.size()], &entry);
+            break;
+        }
+        case 1:
+            registry.remove(live[std::size_t(seed >> 16) % live.size()]);
+            break;
+        case 2:
+            if ((seed >> 16) % 32 == 0) {
+                registry.removeGroup(groups[(seed >> 24) % 4], removed);
+            }
+            break;
+        case 3:
+            registry.removeKey(L"key" + std::to_wstring((seed >> 16) % 1024), removed);
+            break;
+        default:
+            break;
+        }
+        if (live.size() > 4096) {
+            live.erase(live.begin(), live.begin() + 2048);
+        }
+    }
+    CHECK(registry.count() <= 512);
+
+    for (int64_t id = 0; id < 100000; id++) {
+        registry.remove(id);
+    }
+    CHECK(registry.count() == 0 && registry.bytes() == 0);
+    registry.removeGroup(L"prompts", removed);
+    CHECK(removed.empty());
+}
+
+TEST(registryDismissedKeepsTimedOut) {
+    WinToastRegistry registry;
+    std::vector<WinToastRegistry::Removed> evicted;
+    registry.insert(1, WinToastRegistry::Entry{nullptr, nullptr, WinToastStats::now(), 0, 0, 0, std::wstring(), std::wstring()}, evicted);
+    registry.setState(1, WinToastRegistry::Shown);
+    // A time out moves the toast to the Action Center, it stays live.
+    CHECK(registry.dismissed(1, WinToastRegistry::TimedOut, false) == WinToastRegistry::TimedOut);
+    CHECK(registry.count() == 1 && registry.state(1) == WinToastRegistry::Shown);
+    CHECK(registry.dismissed(1, WinToastRegistry::UserCanceled, true) == WinToastRegistry::TimedOut);
+    CHECK(registry.count() == 0 && registry.state(1) == WinToastRegistry::Expired);
+
+    WinToastEndGuard guard;
+    CHECK(guard.dismissed(true) && guard.dismissed(true));
+    CHECK(guard.dismissed(false));
+    CHECK(!guard.dismissed(false) && !guard.failed() && !guard.dismissed(true));
+}
+
+TEST(registryStateSlotsKeepNewestId) {
+    WinToastRegistry registry;
+    const int64_t older = 5, newer = older + WinToastRegistry::StateSlots;
+    registry.setState(older, WinToastRegistry::Shown);
+    registry.setState(newer, WinToastRegistry::Shown);
+    // A late dismissal of the older toast must not take the slot back.
+    registry.setState(older, WinToastRegistry::Dismissed);
+    CHECK(registry.state(newer) == WinToastRegistry::Shown);
+    CHECK(registry.state(older) == WinToastRegistry::Unknown);
+
+    // States only move forward, terminal ones are final.
+    registry.setState(newer, WinToastRegistry::Activated, 1);
+    registry.setState(newer, WinToastRegistry::Hidden);
+    registry.setState(newer, WinToastRegistry::Queued);
+    CHECK(registry.state(newer) == WinToastRegistry::Activated);
+
+    WinToastRegistry::Status statuses[4];
+    CHECK(registry.snapshot(statuses, 4) == 1);
+    CHECK(statuses[0].id == newer && statuses[0].value == 1 && statuses[0].shownAt != 0 && statuses[0].endedAt >= statuses[0].shownAt);
+}
+
+TEST(catalogExpandsPlaceholders) {
+    writeFile("toast_tests_catalog.bin", catalogFile({
+        {7, LANG_NEUTRAL, WinToastTemplate::Text02, {L"{app} connects to {domain}", L"{{app}} {missing} {unclosed"},
+         {L"Allow {app}", L"Block"}, L"via {app}"}}));
+    WinToastCatalog catalog;
+    CHECK(catalog.open(L"toast_tests_catalog.bin", MAKELANGID(0x09, 0x01)));
+    CHECK(catalog.isOpen());
+
+    const WinToastCatalog::Argument arguments[] = {{L"app", L"Example"}, {L"domain", L"example.com"}, {L"ap", L"prefix only"}};
+    WinToastTemplate toast;
+    CHECK(catalog.render(7, arguments, 3, toast));
+    CHECK(toast.type() == WinToastTemplate::Text02);
+    CHECK(toast.textField(WinToastTemplate::FirstLine) == L"Example connects to example.com");
+    // "{{" is a literal brace, unknown and unclosed placeholders are kept as they are.
+    CHECK(toast.textField(WinToastTemplate::SecondLine) == L"{app}} {missing} {unclosed");
+    CHECK(toast.actionsCount() == 2 && toast.actionLabel(0) == L"Allow Example" && toast.actionLabel(1) == L"Block");
+    CHECK(toast.attributionText() == L"via Example");
+
+    CHECK(catalog.render(7, nullptr, 0, toast));
+    CHECK(toast.textField(WinToastTemplate::FirstLine) == L"{app} connects to {domain}");
+    CHECK(!catalog.render(8, arguments, 3, toast));
+    CHECK(!catalog.render(7, arguments, WinToastCatalog::MaxArguments + 1, toast));
+    catalog.close();
+    CHECK(!catalog.isOpen() && !catalog.render(7, arguments, 3, toast));
+    std::remove("toast_tests_catalog.bin");
+}
+
+TEST(catalogPrefersLanguage) {
+    const LANGID german = MAKELANGID(0x07, 0x01), british = MAKELANGID(0x09, 0x02);
+    writeFile("toast_tests_languages.bin", catalogFile({
+        {1, LANG_NEUTRAL, WinToastTemplate::Text01, {L"neutral"}, {}, L""},
+        {1, german, WinToastTemplate::Text01, {L"de-DE"}, {}, L""},
+        {1, british, WinToastTemplate::Text01, {L"en-GB"}, {}, L""}}));
+    const std::pair<LANGID, const wchar_t*> cases[] = {
+        {german, L"de-DE"}, {MAKELANGID(0x09, 0x01), L"en-GB"}, {MAKELANGID(0x0c, 0x01), L"neutral"}};
+    for (const auto& language : cases) {
+        WinToastCatalog catalog;
+        WinToastTemplate toast;
+        CHECK(catalog.open(L"toast_tests_languages.bin", language.first) && catalog.render(1, nullptr, 0, toast));
+        CHECK(toast.textField(WinToastTemplate::FirstLine) == language.second);
+    }
+    std::remove("toast_tests_languages.bin");
+}
+
+TEST(catalogRejectsDamage) {
+    const std::vector<uint8_t> valid = catalogFile({
+        {1, LANG_NEUTRAL, WinToastTemplate::Text01, {L"one"}, {}, L""},
+        {2, LANG_NEUTRAL, WinToastTemplate::Text02, {L"two", L"lines"}, {L"ok"}, L""}});
+    const std::size_t entries = 16, strings = entries + 2 * 16;
+    writeFile("toast_tests_valid.bin", valid);
+    WinToastCatalog catalog;
+    CHECK(catalog.open(L"toast_tests_valid.bin", LANG_NEUTRAL));
+
+    std::vector<std::vector<uint8_t>> damaged;
+    damaged.push_back(valid);
+    damaged.back()[0] ^= 1;                                 // magic
+    damaged.push_back(valid);
+    damaged.back().resize(valid.size() - 1);                // truncated characters
+    damaged.push_back(valid);
+    damaged.back()[strings + 8 * 3] = 200;                  // string past the characters
+    damaged.push_back(valid);
+    damaged.back()[entries] = 3;                            // entries out of order
+    damaged.push_back(valid);
+    damaged.back()[entries + 6] = 200;                      // unknown template type
+    damaged.push_back(valid);
+    damaged.back()[entries + 16 + 6] = WinToastTemplate::Text01;   // two texts for a one line template
+    damaged.push_back(valid);
+    damaged.back()[entries + 16 + 12] = 3;                  // strings past the string table
+    damaged.push_back(std::vector<uint8_t>(valid.begin(), valid.begin() + 8));
+    damaged.push_back(std::vector<uint8_t>());
+    for (const auto& bytes : damaged) {
+        writeFile("toast_tests_damaged.bin", bytes);
+        CHECK(!catalog.open(L"toast_tests_damaged.bin", LANG_NEUTRAL));
+    }
+    CHECK(!catalog.open(L"toast_tests_missing.bin", LANG_NEUTRAL));
+
+    // A failed open keeps the catalog that was open.
+    WinToastTemplate toast;
+    CHECK(catalog.isOpen() && catalog.render(2, nullptr, 0, toast) && toast.actionLabel(0) == L"ok");
+    catalog.close();
+    std::remove("toast_tests_valid.bin");
+    std::remove("toast_tests_damaged.bin");
+}
+
+TEST(historyWrapsOldestFirst) {
+    const std::wstring path = L"toast_tests_history.bin";
+    std::remove("toast_tests_history.bin");
+    WinToastHistory::Record records[32];
+    {
+        WinToastHistory history;
+        CHECK(history.open(path, 8));
+        CHECK(history.read(records, 32) == 0);
+        for (int64_t id = 0; id < 20; id++) {
+            history.write(WinToastHistory::Shown, id, 0x1234, int32_t(id));
+        }
+        // The newest capacity records, oldest first.
+        CHECK(history.read(records, 32) == 8);
+        for (int i = 0; i < 8; i++) {
+            CHECK(records[i].toastId == 12 + i && records[i].sequence == uint64_t(13 + i) && records[i].value == 12 + i);
+        }
+        // Fewer than the ring holds: the newest ones.
+        CHECK(history.read(records, 3) == 3 && records[0].toastId == 17 && records[2].toastId == 19);
+    }
+    {
+        // Survives a restart with the same capacity.
+        WinToastHistory history;
+        CHECK(history.open(path, 8));
+        CHECK(history.read(records, 32) == 8 && records[7].toastId == 19 && records[7].contentHash == 0x1234);
+        history.write(WinToastHistory::Activated, 20, 0, 1);
+        CHECK(history.read(records, 32) == 8 && records[0].toastId == 13 && records[7].outcome == WinToastHistory::Activated);
+    }
+    {
+        // A different capacity resets the file.
+        WinToastHistory history;
+        CHECK(history.open(path, 16));
+        CHECK(history.read(records, 32) == 0);
+    }
+    std::remove("toast_tests_history.bin");
+}
+
+TEST(historySkipsTornRecords) {
+    const std::wstring path = L"toast_tests_torn.bin";
+    std::remove("toast_tests_torn.bin");
+    WinToastHistory history;
+    CHECK(history.open(path, 8));
+    const int64_t marker = 0x5eed000000000000ll;
+    for (int64_t i = 0; i < 6; i++) {
+        history.write(WinToastHistory::Dismissed, marker + i);
+    }
+
+    // Another mapping of the file, as a second process or what a crash leaves behind: a record whose
+    // sequence was cleared for rewriting, and one whose sequence belongs to another position.
+    WinToastMapping mapping;
+    CHECK(mapping.open(path, WinToastMapping::ReadWrite));
+    const auto words = static_cast<uint64_t*>(mapping.data());
+    const std::size_t count = std::size_t(mapping.size() / sizeof(uint64_t));
+    for (std::size_t i = 1; i < count; i++) {
+        // Records start with their sequence followed by the toast Id.
+        if (words[i] == uint64_t(marker + 2)) {
+            words[i - 1] = 0;
+        } else if (words[i] == uint64_t(marker + 4)) {
+            words[i - 1] += 8;
+        }
+    }
+
+    WinToastHistory::Record records[8];
+    CHECK(history.read(records, 8) == 4);
+    CHECK(records[0].toastId == marker && records[1].toastId == marker + 1 && records[2].toastId == marker + 3
+          && records[3].toastId == marker + 5);
+    mapping.close();
+    std::remove("toast_tests_torn.bin");
+}
+
+TEST(recorderRoundTrip) {
+    const std::wstring path = L"toast_tests_recording.pmrc";
+    const WinToastTemplate toast = Sample::promptToast();
+    std::vector<uint8_t> descriptor;
+    CHECK(WinToastDescriptor::write(toast, descriptor));
+    {
+        WinToastRecorder recorder;
+        CHECK(recorder.start(path));
+        // Text outside the Basic Multilingual Plane is stored as a surrogate pair on every host.
+        recorder.record(WinToastRecorder::Create, &toast, 0, 0, L"Allow \U0001F512?", L"");
+        recorder.recordShow(WinToastRecorder::ShowAndRelease, recorder.object(&toast, true), 7, 0, 1234);
+        recorder.recordShow(WinToastRecorder::ShowDescriptor, 0, 8, 0, 99, descriptor.data(), descriptor.size());
+        recorder.record(WinToastRecorder::HideGroup, nullptr, 0, 0, L"prompts");
+        recorder.stop();
+    }
+
+    std::vector<WinToastRecorder::Entry> entries;
+    CHECK(WinToastRecorder::load(path, entries));
+    CHECK(entries.size() == 4);
+    if (entries.size() == 4) {
+        CHECK(entries[0].record.call == WinToastRecorder::Create && entries[0].record.object == 1);
+        CHECK(entries[0].record.lengths[0] == 9 && entries[0].strings[0] == L"Allow \U0001F512?" && entries[0].strings[1].empty());
+        CHECK(entries[1].record.object == 1 && entries[1].record.value == 7 && entries[1].record.duration == 1234);
+        CHECK(entries[2].payload == descriptor && entries[2].strings[0].empty());
+        WinToastDescriptor view;
+        WinToastTemplate described;
+        CHECK(view.open(entries[2].payload.data(), entries[2].payload.size()));
+        view.toTemplate(described);
+        CHECK(Sample::sameToast(described, toast));
+        CHECK(entries[3].strings[0] == L"prompts" && entries[3].payload.empty());
+    }
+
+    // A record cut off by a crash ends the recording.
+    std::vector<uint8_t> bytes;
+    {
+        std::ifstream in("toast_tests_recording.pmrc", std::ios::binary);
+        bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    bytes.resize(bytes.size() - 4);
+    writeFile("toast_tests_recording.pmrc", bytes);
+    CHECK(WinToastRecorder::load(path, entries) && entries.size() == 3);
+    std::remove("toast_tests_recording.pmrc");
+}
+
+TEST(brokerRoundTrip) {
+    // The owner and a client in one process, each with its own mapping of the section.
+    struct Received {
+        WinToastBroker::Kind    kind;
+        int64_t                 id;
+        int                     source;
+        std::wstring            text;
+    };
+    std::mutex lock;
+    std::condition_variable changed;
+    std::vector<Received> requests;
+    std::vector<std::pair<int64_t, int32_t>> events;
+    const std::wstring name = L"toast_tests_broker_" + std::to_wstring(std::chrono::steady_clock::now().time_since_epoch().count());
+
+    WinToastBroker owner;
+    CHECK(owner.serve(name, [&](WinToastBroker::Request& request) {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            requests.push_back(Received{request.kind, request.id, request.source(),
+                                        request.toast ? request.toast->textField(WinToastTemplate::FirstLine) : request.match});
+        }
+        changed.notify_all();
+        if (request.kind == WinToastBroker::Show) {
+            owner.post(WinToastBroker::Activated, request.id, 1);
+        }
+    }));
+    WinToastBroker client;
+    CHECK(client.connect(name, [&](WinToastBroker::Kind kind, INT64 id, int32_t value) {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            events.push_back(std::make_pair(int64_t(id), kind == WinToastBroker::Activated ? value : -100));
+        }
+        changed.notify_all();
+    }));
+    CHECK(owner.isOwner() && client.isClient());
+
+    const WinToastTemplate toast = Sample::promptToast();
+    const int64_t id = client.show(toast);
+    CHECK(WinToastBroker::isClientId(id));
+    CHECK(client.hide(id));
+    // Accepted into the ring but dropped by the owner, the Id is not of the client's slot.
+    CHECK(client.hide(5));
+    CHECK(client.hideGroup(L"prompts"));
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        changed.wait_for(guard, std::chrono::seconds(5), [&] {
+            return requests.size() >= 3 && !events.empty();
+        });
+        CHECK(requests.size() == 3 && events.size() == 1);
+        if (requests.size() == 3 && events.size() == 1) {
+            CHECK(requests[0].kind == WinToastBroker::Show && requests[0].id == id && requests[0].text == toast.textField(WinToastTemplate::FirstLine));
+            CHECK(requests[1].kind == WinToastBroker::Hide && requests[1].id == id);
+            CHECK(requests[2].kind == WinToastBroker::HideGroup && requests[2].text == L"prompts");
+            CHECK(requests[0].source == requests[2].source && requests[0].source == int(id >> WinToastRegistry::SequenceBits));
+            CHECK(events[0].first == id && events[0].second == 1);
+        }
+    }
+    client.stop();
+    owner.stop();
+    CHECK(!client.isClient() && !owner.isOwner());
+}
+
+TEST(pipeFramesSplitReads) {
+    typedef WinToastPipeServer::FrameHeader FrameHeader;
+    // Payload lengths that leave the following frames unaligned, an empty one and the largest allowed.
+    const uint32_t lengths[] = {10, 8, 0, 4, WinToastPipeServer::MaxPayload, 3};
+    std::vector<uint8_t> stream;
+    for (uint32_t i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++) {
+        std::vector<uint8_t> payload(lengths[i]);
+        for (uint32_t j = 0; j < lengths[i]; j++) {
+            payload[j] = static_cast<uint8_t>(i * 31 + j);
+        }
+        WinToastPipeFramer::append(FrameHeader{lengths[i], WinToastPipeServer::Show, 0, 1000 + i}, payload.data(), stream);
+    }
+
+    for (const std::size_t chunk : {std::size_t(1), std::size_t(7), std::size_t(4096), stream.size()}) {
+        WinToastPipeFramer framer;
+        std::size_t offset = 0, frames = 0;
+        bool valid = true;
+        while (offset < stream.size() && valid) {
+            std::size_t size = 0;
+            uint8_t* space = framer.space(size);
+            CHECK(size > 0);
+            const std::size_t read = std::min(std::min(size, chunk), stream.size() - offset);
+            memcpy(space, stream.data() + offset, read);
+            offset += read;
+            framer.commit(read);
+
+            FrameHeader header;
+            const uint8_t* payload = nullptr;
+            WinToastPipeFramer::Result result;
+            while ((result = framer.next(header, payload)) == WinToastPipeFramer::Frame) {
+                valid = valid && header.tag == 1000 + frames && header.length == lengths[frames]
+                        && reinterpret_cast<uintptr_t>(payload) % alignof(uint64_t) == 0;
+                for (uint32_t j = 0; valid && j < header.length; j++) {
+                    valid = payload[j] == static_cast<uint8_t>(frames * 31 + j);
+                }
+                frames++;
+            }
+            valid = valid && result == WinToastPipeFramer::Incomplete;
+        }
+        CHECK(valid && frames == sizeof(lengths) / sizeof(lengths[0]) && framer.pending() == 0);
+    }
+
+    // A header announcing more than MaxPayload cannot be followed.
+    WinToastPipeFramer framer;
+    std::size_t size = 0;
+    uint8_t* space = framer.space(size);
+    const FrameHeader oversized{WinToastPipeServer::MaxPayload + 1, WinToastPipeServer::Show, 0, 1};
+    memcpy(space, &oversized, sizeof(oversized));
+    framer.commit(sizeof(oversized));
+    FrameHeader header;
+    const uint8_t* payload = nullptr;
+    CHECK(framer.next(header, payload) == WinToastPipeFramer::Invalid);
+}
+
+TEST(pipeRoundTrip) {
+    typedef WinToastPipeServer::FrameHeader FrameHeader;
+    std::mutex lock;
+    std::vector<std::pair<WinToastPipeServer::Type, int64_t>> requests;
+    INT64 nextId = 100;
+    WinToastPipeServer server([&nextId] { return nextId++; });
+    const std::wstring name = L"toast_tests_pipe_" + std::to_wstring(std::chrono::steady_clock::now().time_since_epoch().count());
+    CHECK(server.start(name, [&](WinToastPipeServer::Request& request) {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            requests.push_back(std::make_pair(request.kind, int64_t(request.id)));
+        }
+        if (request.kind == WinToastPipeServer::Show && request.toast->textField(WinToastTemplate::FirstLine) == L"queued") {
+            request.hr = S_FALSE;
+        } else if (request.kind == WinToastPipeServer::Show) {
+            request.handler->toastActivated(2);
+        }
+    }));
+    CHECK(!WinToastPipeServer([] { return INT64(0); }).start(name, [](WinToastPipeServer::Request&) {}));
+
+    WinToastPipeChannel client;
+    CHECK(client.connect(name));
+    // Ends the reads below if the server stops answering.
+    std::mutex watchdogLock;
+    std::condition_variable finished;
+    bool done = false;
+    std::thread watchdog([&] {
+        std::unique_lock<std::mutex> guard(watchdogLock);
+        if (!finished.wait_for(guard, std::chrono::seconds(10), [&] { return done; })) {
+            client.shutdown();
+        }
+    });
+
+    WinToastTemplate toast = Sample::promptToast();
+    std::vector<uint8_t> descriptor, queued, stream;
+    CHECK(WinToastDescriptor::write(toast, descriptor));
+    toast.setTextField(L"queued", WinToastTemplate::FirstLine);
+    CHECK(WinToastDescriptor::write(toast, queued));
+    const uint32_t subscribe = 1;
+    const INT64 hidden = 100;
+    const uint8_t garbage[12] = {};
+    // Pipelined in one write, answered in order.
+    WinToastPipeFramer::append(FrameHeader{sizeof(subscribe), WinToastPipeServer::Subscribe, 0, 1}, &subscribe, stream);
+    WinToastPipeFramer::append(FrameHeader{uint32_t(descriptor.size()), WinToastPipeServer::Show, 0, 2}, descriptor.data(), stream);
+    WinToastPipeFramer::append(FrameHeader{sizeof(hidden), WinToastPipeServer::Hide, 0, 3}, &hidden, stream);
+    WinToastPipeFramer::append(FrameHeader{0, 9, 0, 4}, nullptr, stream);
+    WinToastPipeFramer::append(FrameHeader{sizeof(garbage), WinToastPipeServer::Show, 0, 5}, garbage, stream);
+    WinToastPipeFramer::append(FrameHeader{uint32_t(queued.size()), WinToastPipeServer::Show, 0, 6}, queued.data(), stream);
+    CHECK(client.write(stream.data(), stream.size(), 1000));
+
+    struct Reply {
+        INT64    id;
+        int32_t  hr;
+        uint32_t reserved;
+    };
+    struct Event {
+        uint32_t kind;
+        int32_t  value;
+        INT64    id;
+    };
+    std::vector<std::pair<uint64_t, Reply>> replies;
+    std::vector<Event> events;
+    WinToastPipeFramer framer;
+    const auto receive = [&](std::size_t replyCount, std::size_t eventCount) {
+        while (replies.size() < replyCount || events.size() < eventCount) {
+            std::size_t size = 0;
+            uint8_t* space = framer.space(size);
+            const std::size_t received = client.read(space, size);
+            if (received == 0) {
+                return false;
+            }
+            framer.commit(received);
+            FrameHeader header;
+            const uint8_t* payload = nullptr;
+            while (framer.next(header, payload) == WinToastPipeFramer::Frame) {
+                if (header.type == WinToastPipeServer::Reply && header.length == sizeof(Reply)) {
+                    Reply reply;
+                    memcpy(&reply, payload, sizeof(reply));
+                    replies.push_back(std::make_pair(header.tag, reply));
+                } else if (header.type == WinToastPipeServer::Event && header.length == sizeof(Event)) {
+                    Event event;
+                    memcpy(&event, payload, sizeof(event));
+                    events.push_back(event);
+                }
+            }
+        }
+        return true;
+    };
+
+    CHECK(receive(6, 1));
+    if (replies.size() == 6 && events.size() == 1) {
+        for (std::size_t i = 0; i < replies.size(); i++) {
+            CHECK(replies[i].first == i + 1);
+        }
+        CHECK(replies[0].second.hr == S_OK);
+        CHECK(replies[1].second.id == 100 && replies[1].second.hr == S_OK);
+        CHECK(replies[2].second.id == 100 && replies[2].second.hr == S_OK);
+        CHECK(replies[3].second.hr == E_NOTIMPL);
+        CHECK(replies[4].second.id == -1 && replies[4].second.hr == E_INVALIDARG);
+        CHECK(replies[5].second.id == 101 && replies[5].second.hr == S_FALSE);
+        CHECK(events[0].kind == WinToastPipeServer::Activated && events[0].value == 2 && events[0].id == 100);
+    }
+
+    // The queued show fails later and is reported as an event.
+    CHECK(server.completed(101, E_FAIL));
+    CHECK(!server.completed(101, E_FAIL));
+    CHECK(receive(6, 2));
+    if (events.size() == 2) {
+        CHECK(events[1].kind == WinToastPipeServer::Failed && events[1].value == E_FAIL && events[1].id == 101);
+    }
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        CHECK(requests.size() == 3);
+        if (requests.size() == 3) {
+            CHECK(requests[0] == std::make_pair(WinToastPipeServer::Show, int64_t(100)));
+            CHECK(requests[1] == std::make_pair(WinToastPipeServer::Hide, int64_t(100)));
+            CHECK(requests[2] == std::make_pair(WinToastPipeServer::Show, int64_t(101)));
+        }
+    }
+
+    // Stopping closes the connection.
+    server.stop();
+    uint8_t byte;
+    CHECK(client.read(&byte, 1) == 0);
+    {
+        std::lock_guard<std::mutex> guard(watchdogLock);
+        done = true;
+    }
+    finished.notify_all();
+    watchdog.join();
+    CHECK(!server.isRunning());
+}
+
+TEST(queueKeepsProducerOrder) {
+    MpscQueue<int64_t> queue;
+    const int Producers = 4, PerProducer = 20000;
+    std::vector<std::thread> producers;
+    for (int p = 0; p < Producers; p++) {
+        producers.emplace_back([&queue, p] {
+            for (int i = 0; i < PerProducer; i++) {
+                queue.push(int64_t(p) * PerProducer + i);
+            }
+        });
+    }
+    std::vector<int64_t> last(Producers, -1);
+    int received = 0;
+    while (received < Producers * PerProducer) {
+        int64_t value;
+        if (!queue.pop(value)) {
+            std::this_thread::yield();
+            continue;
+        }
+        const int producer = int(value / PerProducer);
+        CHECK(value > last[producer]);
+        last[producer] = value;
+        received++;
+    }
+    for (auto& producer : producers) {
+        producer.join();
+    }
+    CHECK(queue.empty());
+}
+
+int main() {
+    for (const Test& test : tests()) {
+        const int before = failures;
+        test.func();
+        std::printf("%-40s %s\n", test.name, failures == before ? "ok" : "FAILED");
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,378 @@
+#include "icon_cache.h"
+#include "pe_icon.h"
+#include <wincodec.h>
+#include <wrl/client.h>
+#include <algorithm>
+#include <vector>
+
+#pragma comment(lib,"windowscodecs")
+
+using namespace WinToastLib;
+using Microsoft::WRL::ComPtr;
+
+namespace {
+    const std::size_t MaxSourceBytes = 32 * 1024 * 1024;
+
+    uint64_t contentHash(const BYTE* data, std::size_t length, UINT size) {
+        // FNV-1a, salted with the target size so different sizes get different files.
+        uint64_t hash = 14695981039346656037ull ^ size;
+        for (std::size_t i = 0; i < length; i++) {
+            hash ^= data[i];
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    std::wstring fileName(uint64_t hash) {
+        wchar_t name[32];
+        swprintf_s(name, L"%016llx.png", static_cast<unsigned long long>(hash));
+        return name;
+    }
+
+    ULONGLONG combine(DWORD high, DWORD low) {
+        return (static_cast<ULONGLONG>(high) << 32) | low;
+    }
+
+    // Prefixes paths that don't fit into MAX_PATH so the file APIs accept them.
+    std::wstring extendedPath(const std::wstring& path) {
+        if (path.size() < MAX_PATH || path.compare(0, 4, L"\\\\?\\") == 0) {
+            return path;
+        }
+        if (path.compare(0, 2, L"\\\\") == 0) {
+            return L"\\\\?\\UNC\\" + path.substr(2);
+        }
+        return L"\\\\?\\" + path;
+    }
+
+    bool readFile(const std::wstring& path, std::vector<BYTE>& content) {
+        HANDLE file = CreateFileW(extendedPath(path).c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr,
+                                  OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            return false;
+        }
+
+        LARGE_INTEGER size;
+        bool ok = GetFileSizeEx(file, &size) && size.QuadPart > 0 && static_cast<ULONGLONG>(size.QuadPart) <= MaxSourceBytes;
+        if (ok) {
+            content.resize(static_cast<std::size_t>(size.QuadPart));
+            DWORD read = 0;
+            ok = ReadFile(file, content.data(), static_cast<DWORD>(content.size()), &read, nullptr) && read == content.size();
+        }
+        CloseHandle(file);
+        return ok;
+    }
+
+    // Maps the executable read-only and extracts its icon closest to size as an .ico file.
+    bool readIcon(const std::wstring& path, UINT size, std::vector<BYTE>& icon) {
+        HANDLE file = CreateFileW(extendedPath(path).c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr,
+                                  OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            return false;
+        }
+
+        bool ok = false;
+        LARGE_INTEGER length;
+        if (GetFileSizeEx(file, &length) && length.QuadPart > 0 && static_cast<ULONGLONG>(length.QuadPart) <= SIZE_MAX) {
+            HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (mapping != nullptr) {
+                const BYTE* view = static_cast<const BYTE*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+                if (view != nullptr) {
+                    ok = PeIcon::extractIcon(view, static_cast<std::size_t>(length.QuadPart), size, icon);
+                    UnmapViewOfFile(view);
+                }
+                CloseHandle(mapping);
+            }
+        }
+        CloseHandle(file);
+        return ok;
+    }
+}
+
+bool WinToastIconCache::configure(_In_ const std::wstring& directory, _In_ uint64_t maxBytes, _In_ UINT size) {
+    if (directory.empty() || maxBytes == 0 || size == 0) {
+        return false;
+    }
+
+    std::wstring dir = directory;
+    if (dir.back() != L'\\' && dir.back() != L'/') {
+        dir += L'\\';
+    }
+    if (!CreateDirectoryW(extendedPath(dir).c_str(), nullptr) && GetLastError() != ERROR_ALREADY_EXISTS) {
+        return false;
+    }
+
+    struct Existing {
+        std::wstring name;
+        uint64_t bytes;
+        ULONGLONG lastWrite;
+    };
+    std::vector<Existing> existing;
+    WIN32_FIND_DATAW data;
+    HANDLE find = FindFirstFileExW(extendedPath(dir + L"*.png").c_str(), FindExInfoBasic, &data, FindExSearchNameMatch, nullptr, 0);
+    if (find != INVALID_HANDLE_VALUE) {
+        do {
+            if (!(data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
+                existing.push_back({data.cFileName, combine(data.nFileSizeHigh, data.nFileSizeLow),
+                                    combine(data.ftLastWriteTime.dwHighDateTime, data.ftLastWriteTime.dwLowDateTime)});
+            }
+        } while (FindNextFileW(find, &data));
+        FindClose(find);
+    }
+    std::sort(existing.begin(), existing.end(), [](const Existing& a, const Existing& b) {
+        return a.lastWrite < b.lastWrite;
+    });
+
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_directory = dir;
+    m_size = size;
+    m_index.reset(maxBytes);
+    for (const auto& file : existing) {
+        m_index.insertFile(file.name, file.bytes);
+    }
+    evict();
+    return true;
+}
+
+bool WinToastIconCache::isEnabled() const {
+    std::lock_guard<std::mutex> lock(m_lock);
+    return !m_directory.empty();
+}
+
+uint64_t WinToastIconCache::usedBytes() const {
+    std::lock_guard<std::mutex> lock(m_lock);
+    return m_index.usedBytes();
+}
+
+bool WinToastIconCache::cachedPath(_In_ const std::wstring& source, _Out_ std::wstring& cached) {
+    return cachedSource(source, false, cached);
+}
+
+bool WinToastIconCache::cachedPathForExecutable(_In_ const std::wstring& executable, _Out_ std::wstring& cached) {
+    return cachedSource(executable, true, cached);
+}
+
+bool WinToastIconCache::cachedPathForData(_In_ const BYTE* data, _In_ std::size_t length, _Out_ std::wstring& cached) {
+    if (data == nullptr || length == 0) {
+        return false;
+    }
+    return lookupData(data, length, cached);
+}
+
+bool WinToastIconCache::cachedSource(_In_ const std::wstring& source, _In_ bool executable, _Out_ std::wstring& cached) {
+    WIN32_FILE_ATTRIBUTE_DATA attributes;
+    if (!GetFileAttributesExW(extendedPath(source).c_str(), GetFileExInfoStandard, &attributes)) {
+        return false;
+    }
+    const ULONGLONG lastWrite = combine(attributes.ftLastWriteTime.dwHighDateTime, attributes.ftLastWriteTime.dwLowDateTime);
+    const ULONGLONG size = combine(attributes.nFileSizeHigh, attributes.nFileSizeLow);
+
+    // '|' can't appear in a path, so icons of executables never collide with plain images.
+    const std::wstring key = executable ? source + L"|icon" : source;
+    UINT iconSize;
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        if (m_directory.empty()) {
+            return false;
+        }
+        iconSize = m_size;
+        std::wstring name;
+        if (m_index.findSource(key, lastWrite, size, name)) {
+            cached = m_directory + name;
+            return true;
+        }
+    }
+
+    std::vector<BYTE> content;
+    const bool loaded = executable ? readIcon(source, iconSize, content) : readFile(source, content);
+    if (!loaded || !lookupData(content.data(), content.size(), cached)) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_index.rememberSource(key, lastWrite, size, cached.substr(m_directory.size()));
+    return true;
+}
+
+bool WinToastIconCache::lookupData(_In_ const BYTE* data, _In_ std::size_t length, _Out_ std::wstring& cached) {
+    std::wstring directory;
+    UINT size;
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        if (m_directory.empty()) {
+            return false;
+        }
+        directory = m_directory;
+        size = m_size;
+    }
+
+    const std::wstring name = fileName(contentHash(data, length, size));
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        if (m_index.findFile(name)) {
+            cached = directory + name;
+            return true;
+        }
+    }
+
+    // Encode into a temporary file first, so no reader ever sees a partial image.
+    wchar_t suffix[24];
+    swprintf_s(suffix, L".%lu.tmp", GetCurrentThreadId());
+    const std::wstring target = directory + name;
+    const std::wstring temporary = target + suffix;
+    if (!convert(data, length, temporary)) {
+        DeleteFileW(extendedPath(temporary).c_str());
+        return false;
+    }
+    if (!MoveFileExW(extendedPath(temporary).c_str(), extendedPath(target).c_str(), MOVEFILE_REPLACE_EXISTING)) {
+        DeleteFileW(extendedPath(temporary).c_str());
+        return false;
+    }
+
+    WIN32_FILE_ATTRIBUTE_DATA attributes;
+    uint64_t bytes = 0;
+    if (GetFileAttributesExW(extendedPath(target).c_str(), GetFileExInfoStandard, &attributes)) {
+        bytes = combine(attributes.nFileSizeHigh, attributes.nFileSizeLow);
+    }
+
+    std::lock_guard<std::mutex> lock(m_lock);
+    if (m_directory != directory) {
+        return false;
+    }
+    m_index.insertFile(name, bytes);
+    evict();
+    cached = target;
+    return true;
+}
+
+bool WinToastIconCache::convert(_In_ const BYTE* data, _In_ std::size_t length, _In_ const std::wstring& target) const {
+    // The caller may be any thread, make sure it can use WIC.
+    const HRESULT initHr = CoInitializeEx(nullptr, COINIT::COINIT_MULTITHREADED);
+
+    ComPtr<IWICImagingFactory> factory;
+    HRESULT hr = CoCreateInstance(CLSID_WICImagingFactory, nullptr, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&factory));
+    ComPtr<IWICStream> input;
+    if (SUCCEEDED(hr)) {
+        hr = factory->CreateStream(&input);
+    }
+    if (SUCCEEDED(hr)) {
+        hr = input->InitializeFromMemory(const_cast<BYTE*>(data), static_cast<DWORD>(length));
+    }
+    ComPtr<IWICBitmapDecoder> decoder;
+    if (SUCCEEDED(hr)) {
+        hr = factory->CreateDecoderFromStream(input.Get(), nullptr, WICDecodeMetadataCacheOnDemand, &decoder);
+    }
+
+    // Icons carry several frames, use the smallest one that is not smaller than the
+    // target size, or the largest one if all of them are smaller.
+    UINT frameCount = 0;
+    if (SUCCEEDED(hr)) {
+        hr = decoder->GetFrameCount(&frameCount);
+    }
+    ComPtr<IWICBitmapFrameDecode> best;
+    UINT width = 0, height = 0;
+    for (UINT i = 0; SUCCEEDED(hr) && i < frameCount; i++) {
+        ComPtr<IWICBitmapFrameDecode> frame;
+        UINT w = 0, h = 0;
+        if (FAILED(decoder->GetFrame(i, &frame)) || FAILED(frame->GetSize(&w, &h))) {
+            continue;
+        }
+        const UINT extent = (std::max)(w, h), bestExtent = (std::max)(width, height);
+        const bool better = !best
+            || (bestExtent < m_size && extent > bestExtent)
+            || (extent >= m_size && extent < bestExtent);
+        if (better) {
+            best = frame;
+            width = w;
+            height = h;
+        }
+    }
+    if (SUCCEEDED(hr) && !best) {
+        hr = WINCODEC_ERR_FRAMEMISSING;
+    }
+
+    ComPtr<IWICBitmapSource> source;
+    UINT targetWidth = width, targetHeight = height;
+    if (SUCCEEDED(hr)) {
+        source = best;
+        const UINT extent = (std::max)(width, height);
+        if (extent > m_size) {
+            targetWidth = (std::max)(1u, static_cast<UINT>(static_cast<ULONGLONG>(width) * m_size / extent));
+            targetHeight = (std::max)(1u, static_cast<UINT>(static_cast<ULONGLONG>(height) * m_size / extent));
+            ComPtr<IWICBitmapScaler> scaler;
+            hr = factory->CreateBitmapScaler(&scaler);
+            if (SUCCEEDED(hr)) {
+                hr = scaler->Initialize(best.Get(), targetWidth, targetHeight, WICBitmapInterpolationModeFant);
+            }
+            if (SUCCEEDED(hr)) {
+                source = scaler;
+            }
+        }
+    }
+
+    ComPtr<IWICFormatConverter> converter;
+    if (SUCCEEDED(hr)) {
+        hr = factory->CreateFormatConverter(&converter);
+    }
+    if (SUCCEEDED(hr)) {
+        hr = converter->Initialize(source.Get(), GUID_WICPixelFormat32bppBGRA, WICBitmapDitherTypeNone, nullptr, 0.0, WICBitmapPaletteTypeCustom);
+    }
+
+    ComPtr<IWICStream> output;
+    if (SUCCEEDED(hr)) {
+        hr = factory->CreateStream(&output);
+    }
+    if (SUCCEEDED(hr)) {
+        hr = output->InitializeFromFilename(extendedPath(target).c_str(), GENERIC_WRITE);
+    }
+    ComPtr<IWICBitmapEncoder> encoder;
+    if (SUCCEEDED(hr)) {
+        hr = factory->CreateEncoder(GUID_ContainerFormatPng, nullptr, &encoder);
+    }
+    if (SUCCEEDED(hr)) {
+        hr = encoder->Initialize(output.Get(), WICBitmapEncoderNoCache);
+    }
+    ComPtr<IWICBitmapFrameEncode> frame;
+    if (SUCCEEDED(hr)) {
+        hr = encoder->CreateNewFrame(&frame, nullptr);
+    }
+    if (SUCCEEDED(hr)) {
+        hr = frame->Initialize(nullptr);
+    }
+    if (SUCCEEDED(hr)) {
+        hr = frame->SetSize(targetWidth, targetHeight);
+    }
+    if (SUCCEEDED(hr)) {
+        WICPixelFormatGUID format = GUID_WICPixelFormat32bppBGRA;
+        hr = frame->SetPixelFormat(&format);
+    }
+    if (SUCCEEDED(hr)) {
+        hr = frame->WriteSource(converter.Get(), nullptr);
+    }
+    if (SUCCEEDED(hr)) {
+        hr = frame->Commit();
+    }
+    if (SUCCEEDED(hr)) {
+        hr = encoder->Commit();
+    }
+
+    // Release everything before leaving the apartment.
+    frame.Reset();
+    encoder.Reset();
+    output.Reset();
+    converter.Reset();
+    source.Reset();
+    best.Reset();
+    decoder.Reset();
+    input.Reset();
+    factory.Reset();
+    if (SUCCEEDED(initHr)) {
+        CoUninitialize();
+    }
+    return SUCCEEDED(hr);
+}
+
+void WinToastIconCache::evict() {
+    for (const auto& name : m_index.evict()) {
+        DeleteFileW(extendedPath(m_directory + name).c_str());
+    }
+}
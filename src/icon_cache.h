@@ -0,0 +1,52 @@
+#ifndef ICON_CACHE_H
+#define ICON_CACHE_H
+
+#include "icon_index.h"
+#include <Windows.h>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+namespace WinToastLib {
+
+    /**
+     * Disk cache of notification images scaled down to the toast logo size.
+     *
+     * Source images are decoded once, scaled with WIC and stored as small PNG
+     * files named after a hash of the source content, so the notification
+     * platform never has to decode the original file again. Lookups of an
+     * unchanged source file are answered from memory. The cache directory is
+     * kept below a byte budget by evicting the least recently used files.
+     */
+    class WinToastIconCache {
+    public:
+        static constexpr UINT DefaultSize = 96;
+
+        bool configure(_In_ const std::wstring& directory, _In_ uint64_t maxBytes, _In_ UINT size = DefaultSize);
+        bool isEnabled() const;
+
+        // Returns the path of the cached image for source, creating it if needed.
+        bool cachedPath(_In_ const std::wstring& source, _Out_ std::wstring& cached);
+
+        // Returns the path of the cached image for the icon embedded in an executable.
+        bool cachedPathForExecutable(_In_ const std::wstring& executable, _Out_ std::wstring& cached);
+
+        // Stores an already encoded image (for example an extracted icon) under its content hash.
+        bool cachedPathForData(_In_ const BYTE* data, _In_ std::size_t length, _Out_ std::wstring& cached);
+
+        uint64_t usedBytes() const;
+
+    private:
+        bool convert(_In_ const BYTE* data, _In_ std::size_t length, _In_ const std::wstring& target) const;
+        void evict();
+        bool cachedSource(_In_ const std::wstring& source, _In_ bool executable, _Out_ std::wstring& cached);
+        bool lookupData(_In_ const BYTE* data, _In_ std::size_t length, _Out_ std::wstring& cached);
+
+        mutable std::mutex                              m_lock;
+        std::wstring                                    m_directory;
+        UINT                                            m_size{DefaultSize};
+        WinToastIconIndex                               m_index;
+    };
+}
+
+#endif // ICON_CACHE_H
@@ -0,0 +1,61 @@
+#include "icon_index.h"
+#include <utility>
+
+using namespace WinToastLib;
+
+void WinToastIconIndex::reset(_In_ uint64_t maxBytes) {
+    m_maxBytes = maxBytes;
+    m_usedBytes = 0;
+    m_sources.clear();
+    m_files.clear();
+    m_lru.clear();
+}
+
+bool WinToastIconIndex::findSource(_In_ const std::wstring& source, _In_ uint64_t lastWrite, _In_ uint64_t size, _Out_ std::wstring& name) {
+    auto it = m_sources.find(source);
+    if (it == m_sources.end() || it->second.lastWrite != lastWrite || it->second.size != size
+        || !findFile(it->second.cached)) {
+        return false;
+    }
+    name = it->second.cached;
+    return true;
+}
+
+void WinToastIconIndex::rememberSource(_In_ const std::wstring& source, _In_ uint64_t lastWrite, _In_ uint64_t size, _In_ const std::wstring& name) {
+    m_sources[source] = SourceInfo{lastWrite, size, name};
+}
+
+bool WinToastIconIndex::findFile(_In_ const std::wstring& name) {
+    auto it = m_files.find(name);
+    if (it == m_files.end()) {
+        return false;
+    }
+    m_lru.splice(m_lru.begin(), m_lru, it->second.lru);
+    return true;
+}
+
+void WinToastIconIndex::insertFile(_In_ const std::wstring& name, _In_ uint64_t bytes) {
+    auto it = m_files.find(name);
+    if (it != m_files.end()) {
+        m_usedBytes -= it->second.bytes;
+        it->second.bytes = bytes;
+        m_usedBytes += bytes;
+        m_lru.splice(m_lru.begin(), m_lru, it->second.lru);
+        return;
+    }
+    m_lru.push_front(name);
+    m_files[name] = CacheFile{bytes, m_lru.begin()};
+    m_usedBytes += bytes;
+}
+
+std::vector<std::wstring> WinToastIconIndex::evict() {
+    std::vector<std::wstring> evicted;
+    while (m_usedBytes > m_maxBytes && m_lru.size() > 1) {
+        auto it = m_files.find(m_lru.back());
+        m_usedBytes -= it->second.bytes;
+        m_files.erase(it);
+        evicted.push_back(std::move(m_lru.back()));
+        m_lru.pop_back();
+    }
+    return evicted;
+}
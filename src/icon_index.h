@@ -0,0 +1,62 @@
+#ifndef ICON_INDEX_H
+#define ICON_INDEX_H
+
+#include <sal.h>
+#include <cstdint>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace WinToastLib {
+
+    /**
+     * The bookkeeping of the icon cache, without the file system.
+     *
+     * Remembers which cached file each source was converted to, along with
+     * the source's last write time and size when it was read: a source that
+     * changed since then is converted again. Cached files are tracked in
+     * least recently used order and evicted to stay below the byte budget.
+     * Not synchronized, the icon cache calls it under its lock.
+     */
+    class WinToastIconIndex {
+    public:
+        // Forgets every source and file.
+        void reset(_In_ uint64_t maxBytes);
+
+        // The cached file of source, if it was converted with this identity and the file is still cached.
+        bool findSource(_In_ const std::wstring& source, _In_ uint64_t lastWrite, _In_ uint64_t size, _Out_ std::wstring& name);
+        void rememberSource(_In_ const std::wstring& source, _In_ uint64_t lastWrite, _In_ uint64_t size, _In_ const std::wstring& name);
+
+        // Whether the file is cached, marking it as the most recently used one.
+        bool findFile(_In_ const std::wstring& name);
+        void insertFile(_In_ const std::wstring& name, _In_ uint64_t bytes);
+
+        // Drops the least recently used files until the budget holds and returns their names.
+        // The most recently used file is always kept, even if it alone exceeds the budget.
+        std::vector<std::wstring> evict();
+
+        uint64_t usedBytes() const { return m_usedBytes; }
+        std::size_t fileCount() const { return m_files.size(); }
+
+    private:
+        struct SourceInfo {
+            uint64_t lastWrite;
+            uint64_t size;
+            std::wstring cached;
+        };
+
+        struct CacheFile {
+            uint64_t bytes;
+            std::list<std::wstring>::iterator lru;
+        };
+
+        uint64_t                                        m_maxBytes{0};
+        uint64_t                                        m_usedBytes{0};
+        std::unordered_map<std::wstring, SourceInfo>    m_sources;
+        std::unordered_map<std::wstring, CacheFile>     m_files;
+        std::list<std::wstring>                         m_lru;
+    };
+}
+
+#endif // ICON_INDEX_H
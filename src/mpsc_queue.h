@@ -0,0 +1,68 @@
+#ifndef MPSC_QUEUE_H
+#define MPSC_QUEUE_H
+
+#include <atomic>
+#include <utility>
+
+namespace WinToastLib {
+
+    /**
+     * Unbounded lock-free multi-producer single-consumer queue.
+     *
+     * Producers link a new node with a single atomic exchange, so push never
+     * blocks and preserves the order of pushes from the same thread. Only one
+     * thread may call pop() and empty().
+     */
+    template <typename T>
+    class MpscQueue {
+    public:
+        MpscQueue() : m_head(new Node()), m_tail(m_head.load(std::memory_order_relaxed)) {}
+
+        ~MpscQueue() {
+            T value;
+            while (pop(value)) {
+            }
+            delete m_tail;
+        }
+
+        MpscQueue(const MpscQueue&) = delete;
+        MpscQueue& operator=(const MpscQueue&) = delete;
+
+        void push(T value) {
+            Node* node = new Node(std::move(value));
+            Node* previous = m_head.exchange(node, std::memory_order_acq_rel);
+            previous->next.store(node, std::memory_order_seq_cst);
+        }
+
+        bool pop(T& value) {
+            Node* next = m_tail->next.load(std::memory_order_acquire);
+            if (next == nullptr) {
+                return false;
+            }
+            value = std::move(next->value);
+            delete m_tail;
+            m_tail = next;
+            return true;
+        }
+
+        // A push that is still in progress may not be visible yet; its producer
+        // observes the consumer state only after the node has been linked.
+        bool empty() const {
+            return m_tail->next.load(std::memory_order_seq_cst) == nullptr;
+        }
+
+    private:
+        struct Node {
+            Node() : next(nullptr), value() {}
+            explicit Node(T&& v) : next(nullptr), value(std::move(v)) {}
+
+            std::atomic<Node*> next;
+            T value;
+        };
+
+        std::atomic<Node*> m_head;
+        Node* m_tail;
+    };
+}
+
+#endif // MPSC_QUEUE_H
@@ -1,11 +1,36 @@
 #include "notification_glue.h"
 #include "wintoastlib.h"
+#include "toast_trace.h"
+#include "toast_worker.h"
+#include "icon_cache.h"
+#include "toast_arguments.h"
+#include "toast_catalog.h"
+#include "toast_recorder.h"
+#include "toast_broker.h"
+#include "toast_pipe.h"
+#include "toast_descriptor.h"
+#include "toast_allocator.h"
+#include "toast_end_guard.h"
+#include <atomic>
+#include <cstring>
+#include <type_traits>
 
 using namespace WinToastLib;
 
-static callback_func activatedCallback = nullptr;
-static callback_func dissmisedCallback = nullptr;
-static callback_func failedCallback = nullptr;
+// Set from the caller's threads and read on the threads WinRT raises events on.
+static std::atomic<callback_func> activatedCallback{nullptr};
+static std::atomic<callback_func> dissmisedCallback{nullptr};
+static std::atomic<callback_func> failedCallback{nullptr};
+static std::atomic<callback_func> completedCallback{nullptr};
+
+static const uint32_t defaultWatchdogTimeoutMs = 10000;
+
+static WinToastWorker worker(WinToast::instance());
+static WinToastIconCache iconCache;
+static WinToastCatalog catalog;
+static WinToastRecorder recorder;
+static WinToastBroker broker;
+static WinToastPipeServer pipeServer([] { return WinToast::instance()->reserveId(); });
 
 class WinToastHandler : public IWinToastHandler
 {
@@ -13,27 +38,57 @@ public:
     WinToastHandler() {}
 
     void toastActivated() const override {
-        if (activatedCallback != nullptr) {
+        recorder.record(WinToastRecorder::Activated, nullptr, m_id, -1);
+        if (WinToastBroker::isClientId(m_id)) {
+            broker.post(WinToastBroker::Activated, m_id, -1);
+            return;
+        }
+        callback_func callback = activatedCallback.load();
+        if (callback != nullptr) {
             // Calling go function
-            activatedCallback(m_id, -1);
+            callback(m_id, -1);
         }
     }
     void toastActivated(int actionIndex) const override {
-        if(activatedCallback != nullptr) {
+        recorder.record(WinToastRecorder::Activated, nullptr, m_id, actionIndex);
+        if (WinToastBroker::isClientId(m_id)) {
+            broker.post(WinToastBroker::Activated, m_id, actionIndex);
+            return;
+        }
+        callback_func callback = activatedCallback.load();
+        if(callback != nullptr) {
             // Calling go function
-            activatedCallback(m_id, actionIndex);
+            callback(m_id, actionIndex);
         }
     }
     void toastDismissed(WinToastDismissalReason state) const override {
-        if (dissmisedCallback != nullptr) {
+        if (!m_end.dismissed(state == TimedOut)) {
+            return;
+        }
+        recorder.record(WinToastRecorder::Dismissed, nullptr, m_id, state);
+        if (WinToastBroker::isClientId(m_id)) {
+            broker.post(WinToastBroker::Dismissed, m_id, state);
+            return;
+        }
+        callback_func callback = dissmisedCallback.load();
+        if (callback != nullptr) {
             // Calling go function
-            dissmisedCallback(m_id, state);
+            callback(m_id, state);
         }
     }
     void toastFailed() const override {
-        if (failedCallback != nullptr) {
+        if (!m_end.failed()) {
+            return;
+        }
+        recorder.record(WinToastRecorder::Failed, nullptr, m_id);
+        if (WinToastBroker::isClientId(m_id)) {
+            broker.post(WinToastBroker::Failed, m_id, E_FAIL);
+            return;
+        }
+        callback_func callback = failedCallback.load();
+        if (callback != nullptr) {
             // Calling go function
-            failedCallback(m_id, 0);
+            callback(m_id, 0);
         }
     }
 
@@ -42,6 +97,8 @@ public:
     }
 private:
     uint64_t m_id;
+    // The caller gets at most one final dismissal or failure per notification.
+    mutable WinToastEndGuard m_end;
 };
 
 uint64_t PortmasterToastInitialize(const wchar_t *appName, const wchar_t *aumi, const wchar_t* originalShortcutPath) {
@@ -67,10 +124,12 @@ void* PortmasterToastCreateNotification(const wchar_t *title, const wchar_t *con
 
     templ->setDuration(WinToastTemplate::Duration::Long);
 
+    recorder.record(WinToastRecorder::Create, templ, 0, 0, title, content);
     return templ;
 }
 
 void PortmasterToastDeleteNotification(void* notification) {
+    recorder.record(WinToastRecorder::Delete, notification);
     WinToastTemplate *winToastPtr = (WinToastTemplate*)notification;
     delete winToastPtr;
 }
@@ -80,6 +139,7 @@ uint64_t PortmasterToastAddButton(void *notification, wchar_t *buttonText) {
         return 0;
     }
 
+    recorder.record(WinToastRecorder::AddButton, notification, 0, 0, buttonText);
     WinToastTemplate *winToastPtr = (WinToastTemplate*) notification;
     winToastPtr->addAction(buttonText);
     return 1;
@@ -90,8 +150,73 @@ uint64_t PortmasterToastSetImage(void *notification, wchar_t *imagePath) {
         return 0;
     }
 
+    recorder.record(WinToastRecorder::SetImage, notification, 0, 0, imagePath);
+    WinToastTemplate *winToastPtr = (WinToastTemplate*) notification;
+    std::wstring cached;
+    if (iconCache.isEnabled() && iconCache.cachedPath(imagePath, cached)) {
+        winToastPtr->setImagePath(cached);
+    } else {
+        winToastPtr->setImagePath(imagePath);
+    }
+    return 1;
+}
+
+uint64_t PortmasterToastSetImageFromExecutable(void *notification, wchar_t *exePath) {
+    if(notification == nullptr || exePath == nullptr) {
+        return 0;
+    }
+
+    recorder.record(WinToastRecorder::SetImageFromExecutable, notification, 0, 0, exePath);
+    std::wstring cached;
+    if (!iconCache.isEnabled() || !iconCache.cachedPathForExecutable(exePath, cached)) {
+        return 0;
+    }
+    WinToastTemplate *winToastPtr = (WinToastTemplate*) notification;
+    winToastPtr->setImagePath(cached);
+    return 1;
+}
+
+uint64_t PortmasterToastSetPriority(void *notification, int priority) {
+    if(notification == nullptr || priority < WinToastTemplate::Low || priority > WinToastTemplate::High) {
+        return 0;
+    }
+
+    recorder.record(WinToastRecorder::SetPriority, notification, priority);
+    WinToastTemplate *winToastPtr = (WinToastTemplate*) notification;
+    winToastPtr->setPriority((WinToastTemplate::Priority) priority);
+    return 1;
+}
+
+uint64_t PortmasterToastSetActivationToken(void *notification, wchar_t *token) {
+    if(notification == nullptr || token == nullptr || wcslen(token) > WinToastArguments::MaxTokenLength) {
+        return 0;
+    }
+
+    recorder.record(WinToastRecorder::SetActivationToken, notification, 0, 0, token);
+    WinToastTemplate *winToastPtr = (WinToastTemplate*) notification;
+    winToastPtr->setActivationToken(token);
+    return 1;
+}
+
+uint64_t PortmasterToastSetGroup(void *notification, wchar_t *group) {
+    if(notification == nullptr || group == nullptr) {
+        return 0;
+    }
+
+    recorder.record(WinToastRecorder::SetGroup, notification, 0, 0, group);
+    WinToastTemplate *winToastPtr = (WinToastTemplate*) notification;
+    winToastPtr->setGroup(group);
+    return 1;
+}
+
+uint64_t PortmasterToastSetKey(void *notification, wchar_t *key) {
+    if(notification == nullptr || key == nullptr) {
+        return 0;
+    }
+
+    recorder.record(WinToastRecorder::SetKey, notification, 0, 0, key);
     WinToastTemplate *winToastPtr = (WinToastTemplate*) notification;
-    winToastPtr->setImagePath(imagePath);
+    winToastPtr->setKey(key);
     return 1;
 }
 
@@ -99,6 +224,7 @@ uint64_t PortmasterToastSetSound(void *notification, int option, int file) {
     if(notification == nullptr) {
         return 0;
     }
+    recorder.record(WinToastRecorder::SetSound, notification, option, file);
     WinToastTemplate *winToastPtr = (WinToastTemplate*) notification;
     winToastPtr->setAudioOption((WinToastTemplate::AudioOption) option);
     winToastPtr->setAudioPath((WinToastTemplate::AudioSystemFile) file);
@@ -110,15 +236,125 @@ uint64_t PortmasterToastShow(void *notification) {
         return -1;
     }
 
+    const uint64_t started = recorder.isRecording() ? WinToastRecorder::now() : 0;
     WinToastTemplate *winToastPtr = (WinToastTemplate*) notification;
-    auto handler = std::make_shared<WinToastHandler>();
-    int64_t toastID = WinToast::instance()->showToast(*winToastPtr, handler);
+    if (broker.isClient()) {
+        int64_t toastID = broker.show(*winToastPtr);
+        if (started != 0) {
+            recorder.recordShow(WinToastRecorder::Show, recorder.object(notification), toastID, 0, WinToastRecorder::now() - started);
+        }
+        return toastID;
+    }
+
+    auto handler = std::allocate_shared<WinToastHandler>(WinToastStlAllocator<WinToastHandler>());
+    int64_t toastID = WinToast::instance()->reserveId();
+    handler->setID(toastID);
+
+    if (!worker.show(toastID, *winToastPtr, handler)) {
+        toastID = WinToast::instance()->showToastWithId(toastID, *winToastPtr, handler); // -1 for error
+    }
+    if (started != 0) {
+        recorder.recordShow(WinToastRecorder::Show, recorder.object(notification), toastID, 0, WinToastRecorder::now() - started);
+    }
+    return toastID;
+}
 
+static int64_t showAndRelease(int64_t toastID, std::unique_ptr<WinToastTemplate> toast) {
+    auto handler = std::allocate_shared<WinToastHandler>(WinToastStlAllocator<WinToastHandler>());
     handler->setID(toastID);
-    return toastID; // -1 for error
+
+    if (worker.show(toastID, std::move(toast), handler)) {
+        return toastID;
+    }
+
+    return WinToast::instance()->showToastWithId(toastID, std::move(*toast), handler); // -1 for error
+}
+
+uint64_t PortmasterToastShowAndRelease(void *notification) {
+    if(notification == nullptr) {
+        return -1;
+    }
+
+    // The number is taken before the object is handed over, its address may be reused once it is freed.
+    const uint64_t started = recorder.isRecording() ? WinToastRecorder::now() : 0;
+    const uint32_t object = recorder.object(notification, true);
+    int64_t toastID = -1;
+    if (broker.isClient()) {
+        std::unique_ptr<WinToastTemplate> toast((WinToastTemplate*) notification);
+        toastID = broker.show(*toast);
+    } else {
+        toastID = showAndRelease(WinToast::instance()->reserveId(), std::unique_ptr<WinToastTemplate>((WinToastTemplate*) notification));
+    }
+    if (started != 0) {
+        recorder.recordShow(WinToastRecorder::ShowAndRelease, object, toastID, 0, WinToastRecorder::now() - started);
+    }
+    return toastID;
+}
+
+static_assert(PORTMASTER_TOAST_MAX_TEMPLATE_ARGS == WinToastCatalog::MaxArguments, "template argument limit mismatch");
+static_assert(sizeof(PortmasterToastTemplateArg) == sizeof(WinToastCatalog::Argument), "template argument layout mismatch");
+
+uint64_t PortmasterToastLoadCatalog(const wchar_t *path) {
+    if (path == nullptr) {
+        return 0;
+    }
+
+    return catalog.open(path, GetUserDefaultUILanguage()) ? 1 : 0;
+}
+
+uint64_t PortmasterToastShowTemplate(uint32_t templateId, const PortmasterToastTemplateArg *args, uint32_t count) {
+    const uint64_t started = recorder.isRecording() ? WinToastRecorder::now() : 0;
+    if (started != 0) {
+        for (uint32_t i = 0; args != nullptr && i < count; i++) {
+            recorder.record(WinToastRecorder::TemplateArgument, nullptr, 0, 0, args[i].name, args[i].value);
+        }
+    }
+
+    int64_t toastID = -1;
+    std::unique_ptr<WinToastTemplate> toast(new WinToastTemplate());
+    if (catalog.render(templateId, (const WinToastCatalog::Argument*) args, count, *toast)) {
+        if (broker.isClient()) {
+            toastID = broker.show(*toast);
+        } else {
+            toastID = showAndRelease(WinToast::instance()->reserveId(), std::move(toast));
+        }
+    }
+    if (started != 0) {
+        recorder.recordShow(WinToastRecorder::ShowTemplate, 0, toastID, templateId, WinToastRecorder::now() - started);
+    }
+    return toastID;
+}
+
+uint64_t PortmasterToastShowDescriptor(const void *descriptor, uint64_t size) {
+    const uint64_t started = recorder.isRecording() ? WinToastRecorder::now() : 0;
+    int64_t toastID = -1;
+    WinToastDescriptor view;
+    if (view.open(descriptor, (std::size_t) size)) {
+        std::unique_ptr<WinToastTemplate> toast(new WinToastTemplate());
+        view.toTemplate(*toast);
+        if (broker.isClient()) {
+            toastID = broker.show(*toast);
+        } else {
+            toastID = showAndRelease(WinToast::instance()->reserveId(), std::move(toast));
+        }
+    }
+    if (started != 0) {
+        // Descriptors that do not open are recorded without their bytes and fail again when replayed.
+        recorder.recordShow(WinToastRecorder::ShowDescriptor, 0, toastID, 0, WinToastRecorder::now() - started,
+                            descriptor, view.isOpen() ? view.size() : 0);
+    }
+    return toastID;
 }
 
 uint64_t PortmasterToastHide(uint64_t notificationID) {
+    recorder.record(WinToastRecorder::Hide, nullptr, notificationID);
+    if (broker.isClient()) {
+        return broker.hide(notificationID) ? 1 : 0;
+    }
+    if (worker.hide(notificationID)) {
+        return 1;
+    }
+
     bool success = WinToast::instance()->hideToast(notificationID);
     if(!success) {
         return 0;
@@ -127,12 +363,44 @@ uint64_t PortmasterToastHide(uint64_t notificationID) {
     return 1;
 }
 
+uint64_t PortmasterToastHideGroup(wchar_t *group) {
+    if (group == nullptr || *group == L'\0') {
+        return 0;
+    }
+
+    recorder.record(WinToastRecorder::HideGroup, nullptr, 0, 0, group);
+    if (broker.isClient()) {
+        return broker.hideGroup(group) ? 1 : 0;
+    }
+    if (worker.hideGroup(group)) {
+        return 1;
+    }
+
+    return WinToast::instance()->hideGroup(group);
+}
+
+uint64_t PortmasterToastHideByKey(wchar_t *key) {
+    if (key == nullptr || *key == L'\0') {
+        return 0;
+    }
+
+    recorder.record(WinToastRecorder::HideByKey, nullptr, 0, 0, key);
+    if (broker.isClient()) {
+        return broker.hideByKey(key) ? 1 : 0;
+    }
+    if (worker.hideByKey(key)) {
+        return 1;
+    }
+
+    return WinToast::instance()->hideByKey(key);
+}
+
 uint64_t PortmasterToastActivatedCallback(callback_func func) {
     if(func == nullptr) {
         return 0;
     }
     
-    activatedCallback = func;
+    activatedCallback.store(func);
     return 1;
 }
 
@@ -141,7 +409,7 @@ uint64_t PortmasterToastDismissedCallback(callback_func func) {
         return 0;
     }
 
-    dissmisedCallback = func;
+    dissmisedCallback.store(func);
     return 1;
 }
 
@@ -150,6 +418,422 @@ uint64_t PortmasterToastFailedCallback(callback_func func) {
         return 0;
     }
 
-    failedCallback = func;
+    failedCallback.store(func);
+    return 1;
+}
+
+
+static_assert(PORTMASTER_TOAST_MAX_FAILURE_CODES == WinToastStats::MaxFailureCodes, "failure table size mismatch");
+
+static void copyLatency(PortmasterToastLatency *dst, const WinToastStats::Latency &src) {
+    dst->count = src.count;
+    dst->sum = src.sumNs;
+    dst->p50 = src.p50Ns;
+    dst->p99 = src.p99Ns;
+    dst->max = src.maxNs;
+}
+
+uint64_t PortmasterToastGetStats(PortmasterToastStats *stats) {
+    if (stats == nullptr) {
+        return 0;
+    }
+
+    WinToastStats::Snapshot snapshot;
+    WinToast::instance()->stats().snapshot(snapshot);
+
+    stats->shown = snapshot.counters[WinToastStats::Shown];
+    stats->failed = snapshot.counters[WinToastStats::Failed];
+    stats->activated = snapshot.counters[WinToastStats::Activated];
+    stats->dismissed = snapshot.counters[WinToastStats::Dismissed];
+
+    copyLatency(&stats->factoryLookup, snapshot.stages[WinToastStats::FactoryLookup]);
+    copyLatency(&stats->xmlBuild, snapshot.stages[WinToastStats::XmlBuild]);
+    copyLatency(&stats->createNotification, snapshot.stages[WinToastStats::CreateNotification]);
+    copyLatency(&stats->registerHandlers, snapshot.stages[WinToastStats::RegisterHandlers]);
+    copyLatency(&stats->show, snapshot.stages[WinToastStats::Show]);
+    copyLatency(&stats->showTotal, snapshot.stages[WinToastStats::ShowTotal]);
+    copyLatency(&stats->showToActivation, snapshot.stages[WinToastStats::ShowToActivation]);
+    copyLatency(&stats->showToDismissal, snapshot.stages[WinToastStats::ShowToDismissal]);
+
+    stats->failureCount = snapshot.failureCount;
+    for (std::size_t i = 0; i < snapshot.failureCount; i++) {
+        stats->failures[i].hr = snapshot.failures[i].hr;
+        stats->failures[i].count = snapshot.failures[i].count;
+    }
+    return 1;
+}
+
+static_assert(sizeof(PortmasterToastTraceRecord) == sizeof(WinToastTrace::Record), "trace record layout mismatch");
+
+uint64_t PortmasterToastSetTraceLevel(int level) {
+    if (level < WinToastTrace::Error || level > WinToastTrace::Debug) {
+        return 0;
+    }
+
+    WinToastTrace::setLevel((WinToastTrace::Level) level);
+    return 1;
+}
+
+uint64_t PortmasterToastTraceDump(PortmasterToastTraceRecord *records, uint64_t capacity) {
+    if (records == nullptr) {
+        return 0;
+    }
+
+    return WinToastTrace::dump((WinToastTrace::Record*) records, (std::size_t) capacity);
+}
+
+uint64_t PortmasterToastSetFlightRecorder(const wchar_t *path) {
+    WinToastTrace::setFlightRecorderPath(path != nullptr ? path : L"");
+    return 1;
+}
+
+static void workerCompleted(INT64 id, WinToast::WinToastError error, HRESULT hr) {
+    recorder.record(WinToastRecorder::Completed, nullptr, id, hr);
+    if (pipeServer.completed(id, error == WinToast::NoError ? S_OK : FAILED(hr) ? hr : E_FAIL)) {
+        return;
+    }
+    if (WinToastBroker::isClientId(id)) {
+        if (error != WinToast::NoError) {
+            broker.post(WinToastBroker::Failed, id, FAILED(hr) ? hr : E_FAIL);
+        }
+        return;
+    }
+    callback_func completed = completedCallback.load();
+    callback_func failed = failedCallback.load();
+    if (completed != nullptr) {
+        // Calling go function
+        completed(id, hr);
+    } else if (error != WinToast::NoError && failed != nullptr) {
+        // Calling go function
+        failed(id, 0);
+    }
+}
+
+uint64_t PortmasterToastStartWorker(uint32_t watchdogTimeoutMs) {
+    bool started = worker.start(watchdogTimeoutMs, workerCompleted);
+    return started ? 1 : 0;
+}
+
+uint64_t PortmasterToastStartWorkerWithRenderers(uint32_t watchdogTimeoutMs, uint32_t renderThreads) {
+    bool started = worker.start(watchdogTimeoutMs, workerCompleted, renderThreads);
+    return started ? 1 : 0;
+}
+
+uint64_t PortmasterToastStopWorker() {
+    if (!worker.isRunning()) {
+        return 0;
+    }
+
+    worker.stop();
+    return 1;
+}
+
+uint64_t PortmasterToastShowAsync(void *notification) {
+    if(notification == nullptr) {
+        return -1;
+    }
+
+    if (broker.isClient()) {
+        // Queued in the ring of the broker, the owner shows it on its own thread.
+        const uint64_t started = recorder.isRecording() ? WinToastRecorder::now() : 0;
+        int64_t toastID = broker.show(*(WinToastTemplate*) notification);
+        if (started != 0) {
+            recorder.recordShow(WinToastRecorder::ShowAsync, recorder.object(notification), toastID, 0, WinToastRecorder::now() - started);
+        }
+        return toastID;
+    }
+
+    if (!worker.isRunning() && !worker.start(defaultWatchdogTimeoutMs, workerCompleted) && !worker.isRunning()) {
+        return -1;
+    }
+
+    const uint64_t started = recorder.isRecording() ? WinToastRecorder::now() : 0;
+    WinToastTemplate *winToastPtr = (WinToastTemplate*) notification;
+    auto handler = std::allocate_shared<WinToastHandler>(WinToastStlAllocator<WinToastHandler>());
+    int64_t toastID = WinToast::instance()->reserveId();
+    handler->setID(toastID);
+
+    if (!worker.show(toastID, *winToastPtr, handler)) {
+        // The worker was stopped in the meantime, show directly and still report the completion.
+        WinToast::WinToastError error = WinToast::NoError;
+        HRESULT hr = S_OK;
+        WinToast::instance()->showToastWithId(toastID, *winToastPtr, handler, &error, &hr);
+        workerCompleted(toastID, error, hr);
+    }
+    if (started != 0) {
+        recorder.recordShow(WinToastRecorder::ShowAsync, recorder.object(notification), toastID, 0, WinToastRecorder::now() - started);
+    }
+    return toastID;
+}
+
+uint64_t PortmasterToastCancel(uint64_t notificationID) {
+    recorder.record(WinToastRecorder::Cancel, nullptr, notificationID);
+    if (!worker.isRunning()) {
+        return 0;
+    }
+
+    return worker.cancel(notificationID) ? 1 : 0;
+}
+
+uint64_t PortmasterToastCompletedCallback(callback_func func) {
+    if (func == nullptr) {
+        return 0;
+    }
+
+    completedCallback.store(func);
+    return 1;
+}
+
+uint64_t PortmasterToastSetIconCache(const wchar_t *directory, uint64_t maxBytes, uint32_t size) {
+    if (directory == nullptr) {
+        return 0;
+    }
+
+    return iconCache.configure(directory, maxBytes, size != 0 ? size : WinToastIconCache::DefaultSize) ? 1 : 0;
+}
+
+static_assert(sizeof(PortmasterToastHistoryRecord) == sizeof(WinToastHistory::Record), "history record layout mismatch");
+
+uint64_t PortmasterToastHistoryOpen(const wchar_t *path, uint32_t capacity) {
+    if (path == nullptr) {
+        return 0;
+    }
+
+    return WinToast::instance()->history().open(path, capacity) ? 1 : 0;
+}
+
+uint64_t PortmasterToastHistoryRead(PortmasterToastHistoryRecord *records, uint64_t capacity) {
+    if (records == nullptr) {
+        return 0;
+    }
+
+    return WinToast::instance()->history().read((WinToastHistory::Record*) records, (std::size_t) capacity);
+}
+
+uint64_t PortmasterToastDecodeArguments(const wchar_t *arguments, int64_t *id, int32_t *action, wchar_t *token, uint32_t tokenCapacity) {
+    if (arguments == nullptr || id == nullptr || action == nullptr) {
+        return 0;
+    }
+
+    WinToastArguments::Decoded decoded;
+    if (!WinToastArguments::decode(arguments, wcslen(arguments), decoded)) {
+        return 0;
+    }
+    *id = decoded.id;
+    *action = decoded.action;
+    if (token != nullptr && tokenCapacity > 0) {
+        const std::size_t length = decoded.tokenLength < tokenCapacity ? decoded.tokenLength : tokenCapacity - 1;
+        wmemcpy(token, decoded.token != nullptr ? decoded.token : L"", length);
+        token[length] = L'\0';
+    }
+    return 1;
+}
+
+uint64_t PortmasterToastSetCapacity(uint64_t maxCount, uint64_t maxBytes) {
+    WinToast::instance()->setCapacity((std::size_t) maxCount, maxBytes);
+    return 1;
+}
+
+uint64_t PortmasterToastGetMemoryUsage(PortmasterToastMemoryUsage *usage) {
+    if (usage == nullptr) {
+        return 0;
+    }
+
+    WinToast* toast = WinToast::instance();
+    usage->liveToasts = toast->registry().count();
+    usage->registry = toast->registry().bytes();
+    usage->stats = sizeof(WinToastStats);
+    usage->trace = WinToastTrace::memoryUsage();
+    usage->history = toast->history().mappedBytes();
+    usage->iconCacheDisk = iconCache.usedBytes();
+    usage->strings = WinToastStringPool::memoryUsage();
+    usage->pooledStrings = WinToastStringPool::count();
+    return 1;
+}
+
+static_assert(PORTMASTER_TOAST_STATE_SLOTS == WinToastRegistry::StateSlots, "state table size mismatch");
+static_assert(sizeof(PortmasterToastStatus) == sizeof(WinToastRegistry::Status), "status layout mismatch");
+static_assert(WinToastRegistry::SequenceBits == WinToastBroker::ClientIdShift, "broker client Ids must order like local Ids");
+
+uint64_t PortmasterToastSnapshot(PortmasterToastStatus *statuses, uint64_t capacity) {
+    if (statuses == nullptr) {
+        return 0;
+    }
+
+    return WinToast::instance()->registry().snapshot((WinToastRegistry::Status*) statuses, (std::size_t) capacity);
+}
+
+uint64_t PortmasterToastGetState(uint64_t notificationID) {
+    return WinToast::instance()->registry().state((INT64) notificationID);
+}
+
+uint64_t PortmasterToastStartRecording(const wchar_t *path) {
+    if (path == nullptr) {
+        return 0;
+    }
+
+    return recorder.start(path) ? 1 : 0;
+}
+
+uint64_t PortmasterToastStopRecording() {
+    recorder.stop();
+    return 1;
+}
+
+// Runs on the broker thread of the owner.
+static void brokerRequest(WinToastBroker::Request &request) {
+    switch (request.kind) {
+    case WinToastBroker::Show:
+        if (showAndRelease(request.id, std::move(request.toast)) == -1) {
+            broker.post(WinToastBroker::Failed, request.id, E_FAIL);
+        }
+        break;
+    case WinToastBroker::Hide:
+        if (!worker.hide(request.id)) {
+            WinToast::instance()->hideToast(request.id);
+        }
+        break;
+    case WinToastBroker::HideGroup:
+        // Only the client's own toasts, not those of the owner or of other clients.
+        if (!worker.hideGroup(request.match, request.source())) {
+            WinToast::instance()->hideGroup(request.match, request.source());
+        }
+        break;
+    case WinToastBroker::HideKey:
+        if (!worker.hideByKey(request.match, request.source())) {
+            WinToast::instance()->hideByKey(request.match, request.source());
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+// Runs on the connection threads of the pipe server. Takes the path of PortmasterToastShowDescriptor and PortmasterToastHide.
+static void pipeRequest(WinToastPipeServer::Request &request) {
+    switch (request.kind) {
+    case WinToastPipeServer::Show: {
+        const uint64_t started = recorder.isRecording() ? WinToastRecorder::now() : 0;
+        if (worker.show(request.id, std::move(request.toast), request.handler)) {
+            request.hr = S_FALSE;
+        } else {
+            WinToast::WinToastError error = WinToast::NoError;
+            request.id = WinToast::instance()->showToastWithId(request.id, std::move(*request.toast), request.handler, &error, &request.hr);
+            if (request.id == -1 && SUCCEEDED(request.hr)) {
+                request.hr = E_FAIL;
+            }
+        }
+        if (started != 0) {
+            recorder.recordShow(WinToastRecorder::ShowDescriptor, 0, request.id, 0, WinToastRecorder::now() - started,
+                                request.descriptor, request.size);
+        }
+        break;
+    }
+    case WinToastPipeServer::Hide:
+        recorder.record(WinToastRecorder::Hide, nullptr, request.id);
+        if (worker.hide(request.id)) {
+            request.hr = S_FALSE;
+        } else {
+            request.hr = WinToast::instance()->hideToast(request.id) ? S_OK : HRESULT_FROM_WIN32(ERROR_NOT_FOUND);
+        }
+        break;
+    default:
+        request.hr = E_NOTIMPL;
+        break;
+    }
+}
+
+// Runs on the broker thread of a client.
+static void brokerEvent(WinToastBroker::Kind kind, INT64 id, int32_t value) {
+    switch (kind) {
+    case WinToastBroker::Activated: {
+        recorder.record(WinToastRecorder::Activated, nullptr, id, value);
+        callback_func callback = activatedCallback.load();
+        if (callback != nullptr) {
+            // Calling go function
+            callback(id, value);
+        }
+        break;
+    }
+    case WinToastBroker::Dismissed: {
+        recorder.record(WinToastRecorder::Dismissed, nullptr, id, value);
+        callback_func callback = dissmisedCallback.load();
+        if (callback != nullptr) {
+            // Calling go function
+            callback(id, value);
+        }
+        break;
+    }
+    case WinToastBroker::Failed: {
+        recorder.record(WinToastRecorder::Failed, nullptr, id);
+        callback_func callback = failedCallback.load();
+        if (callback != nullptr) {
+            // Calling go function
+            callback(id, 0);
+        }
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+uint64_t PortmasterToastStartBroker(const wchar_t *name) {
+    if (name == nullptr || !WinToast::instance()->isInitialized()) {
+        return 0;
+    }
+
+    return broker.serve(name, brokerRequest) ? 1 : 0;
+}
+
+uint64_t PortmasterToastConnectBroker(const wchar_t *name) {
+    if (name == nullptr) {
+        return 0;
+    }
+
+    return broker.connect(name, brokerEvent) ? 1 : 0;
+}
+
+uint64_t PortmasterToastStopBroker() {
+    if (!broker.isOwner() && !broker.isClient()) {
+        return 0;
+    }
+
+    broker.stop();
+    return 1;
+}
+
+uint64_t PortmasterToastStartPipeServer(const wchar_t *name) {
+    if (name == nullptr || !WinToast::instance()->isInitialized()) {
+        return 0;
+    }
+
+    return pipeServer.start(name, pipeRequest) ? 1 : 0;
+}
+
+uint64_t PortmasterToastStopPipeServer() {
+    if (!pipeServer.isRunning()) {
+        return 0;
+    }
+
+    pipeServer.stop();
     return 1;
 }
+
+uint64_t PortmasterToastSetTextBudget(uint32_t enabled) {
+    WinToast::instance()->setTextBudget(enabled != 0);
+    return 1;
+}
+
+static_assert(std::is_same<PortmasterToastAllocateFunc, WinToastAllocator::AllocateFunc>::value, "allocate hook mismatch");
+static_assert(std::is_same<PortmasterToastFreeFunc, WinToastAllocator::FreeFunc>::value, "free hook mismatch");
+static_assert(std::is_same<PortmasterToastResetFunc, WinToastAllocator::ResetFunc>::value, "reset hook mismatch");
+
+uint64_t PortmasterToastSetAllocator(PortmasterToastAllocateFunc allocate, PortmasterToastFreeFunc deallocate,
+                                     PortmasterToastResetFunc reset, void *context) {
+    return WinToastAllocator::setHooks(WinToastAllocator::Hooks{allocate, deallocate, reset, context}) ? 1 : 0;
+}
+
+uint64_t PortmasterToastAllocatedBytes() {
+    return WinToastAllocator::allocatedBytes();
+}
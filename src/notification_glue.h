@@ -1,6 +1,7 @@
 #ifndef NOTIFICATION_GLUE_H
 #define NOTIFICATION_GLUE_H
 
+#include <stddef.h>
 #include <stdint.h>
 
 #ifdef __cplusplus
@@ -15,9 +16,143 @@
  * @par    id      = id of the notification
  * @par    action  = index of the clicked button or reason for dismissal or 0 for failed callback
  * @return return value is ignored it is used only for compatability
+ * @note   called on threads of the notification platform, concurrently for different notifications.
+ *         Callbacks can be replaced at any time.
 **/
 typedef uint64_t(*callback_func)(uint64_t id, int action);
 
+/**
+ * @brief latency summary of one stage of the show path, all values in nanoseconds
+ */
+typedef struct {
+    uint64_t count;
+    uint64_t sum;
+    uint64_t p50;
+    uint64_t p99;
+    uint64_t max;
+} PortmasterToastLatency;
+
+#define PORTMASTER_TOAST_MAX_FAILURE_CODES 16
+
+/**
+ * @brief snapshot of the notification statistics
+ *
+ * @note   failures holds the number of failures per HRESULT, only the first failureCount entries are valid
+ */
+typedef struct {
+    uint64_t shown;
+    uint64_t failed;
+    uint64_t activated;
+    uint64_t dismissed;
+
+    PortmasterToastLatency factoryLookup;
+    PortmasterToastLatency xmlBuild;
+    PortmasterToastLatency createNotification;
+    PortmasterToastLatency registerHandlers;
+    PortmasterToastLatency show;
+    PortmasterToastLatency showTotal;
+    PortmasterToastLatency showToActivation;
+    PortmasterToastLatency showToDismissal;
+
+    uint64_t failureCount;
+    struct {
+        int32_t hr;
+        uint64_t count;
+    } failures[PORTMASTER_TOAST_MAX_FAILURE_CODES];
+} PortmasterToastStats;
+
+/**
+ * @brief binary trace record
+ *
+ * @par    timestamp = monotonic time in nanoseconds
+ * @par    event     = 1 Initialize, 2 ShowBegin, 3 ShowEnd, 4 ShowFailed, 5 Hide, 6 Clear, 7 Activated, 8 Dismissed, 9 Failed, 10 WorkerStalled, 11 Evicted
+ * @par    level     = 0 Error, 1 Warning, 2 Info, 3 Debug
+ * @par    payload   = event specific value (action index, dismissal reason, WinToastError, ...)
+ */
+typedef struct {
+    uint64_t timestamp;
+    int64_t toastId;
+    int32_t hr;
+    uint16_t event;
+    uint8_t level;
+    uint8_t thread;
+    uint64_t payload;
+} PortmasterToastTraceRecord;
+
+/**
+ * @brief notification history record
+ *
+ * @par    sequence    = position of the record in the history, increases with every record
+ * @par    contentHash = hash of the texts, image and buttons of the notification
+ * @par    timestamp   = FILETIME (100ns intervals since 1601-01-01 UTC) the record was written
+ * @par    outcome     = 1 Shown, 2 Activated, 3 Dismissed, 4 Failed
+ * @par    value       = action index (-1 for the body) for Activated, dismissal reason for Dismissed, HRESULT for Failed
+ */
+typedef struct {
+    uint64_t sequence;
+    int64_t toastId;
+    uint64_t contentHash;
+    uint64_t timestamp;
+    int32_t outcome;
+    int32_t value;
+} PortmasterToastHistoryRecord;
+
+/**
+ * @brief memory used by the library, in bytes unless noted otherwise
+ *
+ * @par    liveToasts     = number of toasts in the registry
+ * @par    registry       = registry nodes plus the estimated XML, COM object and handler memory of the live toasts
+ * @par    stats          = latency histograms and counters
+ * @par    trace          = per-thread trace rings
+ * @par    history        = mapped history file
+ * @par    iconCacheDisk  = disk space used by the icon cache
+ * @par    strings        = pooled button labels, image paths and audio URIs
+ * @par    pooledStrings  = number of distinct pooled strings
+ */
+typedef struct {
+    uint64_t liveToasts;
+    uint64_t registry;
+    uint64_t stats;
+    uint64_t trace;
+    uint64_t history;
+    uint64_t iconCacheDisk;
+    uint64_t strings;
+    uint64_t pooledStrings;
+} PortmasterToastMemoryUsage;
+
+/**
+ * @brief value of a placeholder of a catalog template
+ *
+ * @par    name  = placeholder name without braces, e.g. L"app" for {app}
+ * @par    value = text the placeholder is replaced with
+ */
+typedef struct {
+    const wchar_t *name;
+    const wchar_t *value;
+} PortmasterToastTemplateArg;
+
+#define PORTMASTER_TOAST_MAX_TEMPLATE_ARGS 16
+
+#define PORTMASTER_TOAST_STATE_SLOTS 1024
+
+/**
+ * @brief lifecycle state of a notification
+ *
+ * @par    queuedAt    = FILETIME (100ns intervals since 1601-01-01 UTC) the show was requested, 0 if unknown
+ * @par    shownAt     = FILETIME the notification was handed to the OS, 0 if it never was
+ * @par    endedAt     = FILETIME the final state was reached, 0 while the notification is queued or shown
+ * @par    state       = 1 Queued, 2 Shown, 3 Activated, 4 Dismissed, 5 Expired, 6 Failed, 7 Hidden
+ * @par    value       = action index (-1 for the body) for Activated, dismissal reason for Dismissed, HRESULT for Failed
+ */
+typedef struct {
+    int64_t toastId;
+    uint64_t queuedAt;
+    uint64_t shownAt;
+    uint64_t endedAt;
+    int32_t state;
+    int32_t value;
+} PortmasterToastStatus;
+
 /**
  * @brief Initialize notifications
  *
@@ -66,9 +201,54 @@ EXPORT uint64_t PortmasterToastAddButton(void *notification, wchar_t *buttonText
  * @par    notification = pointer to a notification object
  * @par    imagePath    = path to the image file
  * @return 1 for success 0 for failure
+ * @note   if the icon cache is configured the image is replaced by its cached, scaled down copy
  */
 EXPORT uint64_t PortmasterToastSetImage(void *notification, wchar_t *imagePath);
 
+/**
+ * @brief sets the notification icon to the icon embedded in an executable
+ * @par    notification = pointer to a notification object
+ * @par    exePath      = path to the executable (or dll) whose icon resource is used
+ * @return 1 for success 0 for failure
+ * @note   requires the icon cache, the extracted icon is converted and stored there
+ */
+EXPORT uint64_t PortmasterToastSetImageFromExecutable(void *notification, wchar_t *exePath);
+
+/**
+ * @brief sets the priority that decides which notifications are evicted first when the capacity is exceeded
+ * @par    notification = pointer to a notification object
+ * @par    priority     = 0 Low, 1 Normal (default), 2 High
+ * @return 1 for success 0 for failure
+ */
+EXPORT uint64_t PortmasterToastSetPriority(void *notification, int priority);
+
+/**
+ * @brief sets an opaque token that is included in the activation arguments of the notification
+ * @par    notification = pointer to a notification object
+ * @par    token        = caller defined token, at most 128 characters
+ * @return 1 for success 0 for failure
+ * @note   see PortmasterToastDecodeArguments
+ */
+EXPORT uint64_t PortmasterToastSetActivationToken(void *notification, wchar_t *token);
+
+/**
+ * @brief sets the group of the notification
+ * @par    notification = pointer to a notification object
+ * @par    group        = caller defined group name
+ * @return 1 for success 0 for failure
+ * @note   see PortmasterToastHideGroup
+ */
+EXPORT uint64_t PortmasterToastSetGroup(void *notification, wchar_t *group);
+
+/**
+ * @brief sets a caller defined key the notification can be hidden by, e.g. the id of the connection it is about
+ * @par    notification = pointer to a notification object
+ * @par    key          = caller defined key
+ * @return 1 for success 0 for failure
+ * @note   see PortmasterToastHideByKey
+ */
+EXPORT uint64_t PortmasterToastSetKey(void *notification, wchar_t *key);
+
 /**
  * @brief sets the sound of the notification
  * @par    notification = pointer to a notification object
@@ -82,16 +262,72 @@ EXPORT uint64_t PortmasterToastSetSound(void *notification, int option, int file
  * @brief make a request to the OS to show the notification
  * @par    notification = pointer to a notification object
  * @return Id of the notification or -1 for failure
+ * @note   while the worker is running the notification is copied and shown from the worker thread,
+ *         the Id is returned immediately and failures are reported through the failed callback
  */
 EXPORT uint64_t PortmasterToastShow(void *notification);
 
+/**
+ * @brief shows the notification and releases the notification object
+ * @par    notification = pointer to a notification object, must not be used after the call
+ * @return Id of the notification or -1 for failure
+ * @note   replaces PortmasterToastShow followed by PortmasterToastDeleteNotification. The object is
+ *         handed to the library instead of copied, it is released also if the show fails
+ */
+EXPORT uint64_t PortmasterToastShowAndRelease(void *notification);
+
+/**
+ * @brief loads the template catalog, replacing a previously loaded one
+ * @par    path = path to the catalog file, see toast_catalog.h for the format
+ * @return 1 for success 0 for failure
+ * @note   entries in the user's UI language are preferred over neutral ones
+ */
+EXPORT uint64_t PortmasterToastLoadCatalog(const wchar_t *path);
+
+/**
+ * @brief shows a notification from the template catalog
+ * @par    templateId = Id of the catalog entry
+ * @par    args       = values of the placeholders of the entry, may be nullptr if count is 0
+ * @par    count      = number of args, at most PORTMASTER_TOAST_MAX_TEMPLATE_ARGS
+ * @return Id of the notification or -1 for failure
+ * @note   shown the same way as with PortmasterToastShow, including the worker
+ */
+EXPORT uint64_t PortmasterToastShowTemplate(uint32_t templateId, const PortmasterToastTemplateArg *args, uint32_t count);
+
+/**
+ * @brief shows a notification described by one buffer instead of a notification object
+ *
+ * @par    descriptor = WinToastDescriptor as described in toast_descriptor.h, aligned to 8 bytes
+ * @par    size       = bytes of the buffer, at least the size recorded in the descriptor
+ * @return id of the notification, -1 for failure or if the descriptor is invalid
+ * @note   the buffer is only read during the call
+ */
+EXPORT uint64_t PortmasterToastShowDescriptor(const void *descriptor, uint64_t size);
+
 /**
  * @brief hides previously shown notification
  * @par    notification = pointer to a notification object
  * @return 1 for success 0 for failure
+ * @note   while the worker is running the request is queued and 1 is returned
  */
 EXPORT uint64_t PortmasterToastHide(uint64_t notificationID);
 
+/**
+ * @brief hides all shown notifications of a group
+ * @par    group = group set with PortmasterToastSetGroup
+ * @return number of notifications hidden
+ * @note   while the worker is running the request is queued and 1 is returned
+ */
+EXPORT uint64_t PortmasterToastHideGroup(wchar_t *group);
+
+/**
+ * @brief hides all shown notifications with a key
+ * @par    key = key set with PortmasterToastSetKey
+ * @return number of notifications hidden
+ * @note   while the worker is running the request is queued and 1 is returned
+ */
+EXPORT uint64_t PortmasterToastHideByKey(wchar_t *key);
+
 /**
  * @brief set callback function that well be called when notification button is clicked
  *		  Or if the notification is clicked. In that case the action id will be -1 
@@ -107,6 +343,7 @@ EXPORT uint64_t PortmasterToastActivatedCallback(callback_func func);
  *			2 -> TimedOut
  * @par    func = pointer to a valid function see callback_func type
  * @return 1 for success 0 for failure
+ * @note   a notification is dismissed or failed at most once, a dismissed notification does not fail afterwards
  */
 EXPORT uint64_t PortmasterToastDismissedCallback(callback_func func);
 
@@ -118,5 +355,268 @@ EXPORT uint64_t PortmasterToastDismissedCallback(callback_func func);
  */
 EXPORT uint64_t PortmasterToastFailedCallback(callback_func func);
 
+/**
+ * @brief copies the current notification statistics
+ *
+ * @par    stats = pointer to the structure that will be filled
+ * @return 1 for success 0 for failure
+ */
+EXPORT uint64_t PortmasterToastGetStats(PortmasterToastStats *stats);
+
+/**
+ * @brief sets the most verbose level that is traced
+ *
+ * @par    level = 0, 1, 2, 3 (Error, Warning, Info, Debug)
+ * @return 1 for success 0 for failure
+ */
+EXPORT uint64_t PortmasterToastSetTraceLevel(int level);
+
+/**
+ * @brief copies the most recent trace records, oldest first
+ *
+ * @par    records  = buffer for the records
+ * @par    capacity = number of records that fit into the buffer
+ * @return number of records copied
+ */
+EXPORT uint64_t PortmasterToastTraceDump(PortmasterToastTraceRecord *records, uint64_t capacity);
+
+/**
+ * @brief sets the file that the trace is written to whenever an error is traced
+ *
+ * @par    path = path of the flight recorder file, nullptr or empty string disables it
+ * @return 1 for success 0 for failure
+ */
+EXPORT uint64_t PortmasterToastSetFlightRecorder(const wchar_t *path);
+
+/**
+ * @brief starts the worker thread that owns the COM apartment and performs all show and hide calls
+ *
+ * @par    watchdogTimeoutMs = time after which a hanging COM call is reported as failed, 0 disables the watchdog
+ * @return 1 for success 0 for failure
+ */
+EXPORT uint64_t PortmasterToastStartWorker(uint32_t watchdogTimeoutMs);
+
+/**
+ * @brief starts the worker thread together with threads that build the notifications of shows in parallel
+ *
+ * @par    watchdogTimeoutMs = time after which a hanging COM call is reported as failed, 0 disables the watchdog
+ * @par    renderThreads     = number of threads building notifications, at most 16, 0 builds them on the worker thread
+ * @return 1 for success 0 for failure
+ * @note   notifications are still shown one at a time in the order they were requested
+ */
+EXPORT uint64_t PortmasterToastStartWorkerWithRenderers(uint32_t watchdogTimeoutMs, uint32_t renderThreads);
+
+/**
+ * @brief stops the worker thread after all queued requests were executed
+ * @return 1 for success 0 if the worker was not running
+ * @note   must be called before the library is unloaded if the worker was started
+ */
+EXPORT uint64_t PortmasterToastStopWorker();
+
+/**
+ * @brief queues the notification to be shown from the worker thread and returns without waiting for the OS
+ *
+ * @par    notification = pointer to a notification object, it is copied and can be deleted right away
+ * @return Id of the notification or -1 for failure
+ * @note   starts the worker if it is not running. The result is reported through the completed callback,
+ *         or through the failed callback if no completed callback is set. Notifications queued from the
+ *         same thread are shown in order.
+ */
+EXPORT uint64_t PortmasterToastShowAsync(void *notification);
+
+/**
+ * @brief cancels a notification queued with PortmasterToastShowAsync that was not shown yet
+ *
+ * @par    notificationID = Id returned by PortmasterToastShowAsync
+ * @return 1 if the notification will not be shown 0 if it was already shown or is unknown
+ * @note   the cancelled notification is completed with E_ABORT
+ */
+EXPORT uint64_t PortmasterToastCancel(uint64_t notificationID);
+
+/**
+ * @brief set callback function that will be called when a queued notification was shown or failed to show
+ *
+ * @par    func = pointer to a valid function see callback_func type, action is the HRESULT of the show (0 on success)
+ * @return 1 for success 0 for failure
+ */
+EXPORT uint64_t PortmasterToastCompletedCallback(callback_func func);
+
+/**
+ * @brief enables the icon cache used by PortmasterToastSetImage
+ *
+ * @par    directory = directory the scaled images are stored in, created if missing
+ * @par    maxBytes  = size budget of the directory, least recently used images are deleted above it
+ * @par    size      = edge length in pixels the images are scaled down to, 0 for the default of 96
+ * @return 1 for success 0 for failure
+ */
+EXPORT uint64_t PortmasterToastSetIconCache(const wchar_t *directory, uint64_t maxBytes, uint32_t size);
+
+/**
+ * @brief opens the history file that shown notifications and their outcomes are recorded in
+ *
+ * @par    path     = path of the history file, created if missing
+ * @par    capacity = number of records kept, older records are overwritten
+ * @return 1 for success 0 for failure
+ * @note   the file is kept across restarts. A file written with a different capacity is reset.
+ */
+EXPORT uint64_t PortmasterToastHistoryOpen(const wchar_t *path, uint32_t capacity);
+
+/**
+ * @brief copies the recorded history, oldest first
+ *
+ * @par    records  = buffer that the records are copied to
+ * @par    capacity = number of records that fit into the buffer
+ * @return number of records copied
+ * @note   notifications with a Shown record but no outcome may still be in the Action Center
+ */
+EXPORT uint64_t PortmasterToastHistoryRead(PortmasterToastHistoryRecord *records, uint64_t capacity);
+
+/**
+ * @brief decodes the activation arguments of a notification, for example the ones the app was launched with
+ *
+ * @par    arguments     = activation arguments
+ * @par    id            = receives the Id of the notification
+ * @par    action        = receives the index of the activated button, -1 for the notification body
+ * @par    token         = buffer that receives the activation token, may be nullptr
+ * @par    tokenCapacity = size of the token buffer in characters, including the terminating zero
+ * @return 1 for success 0 if the arguments were not created by this library
+ */
+EXPORT uint64_t PortmasterToastDecodeArguments(const wchar_t *arguments, int64_t *id, int32_t *action, wchar_t *token, uint32_t tokenCapacity);
+
+
+/**
+ * @brief limits the number of live notifications and their estimated memory
+ *
+ * @par    maxCount = maximum number of live notifications, 0 for no limit
+ * @par    maxBytes = maximum estimated memory of live notifications, 0 for no limit
+ * @return 1 for success 0 for failure
+ * @note   above the limits the least recently shown notifications of the lowest priority are hidden,
+ *         their handlers receive a dismissed callback with ApplicationHidden
+ */
+EXPORT uint64_t PortmasterToastSetCapacity(uint64_t maxCount, uint64_t maxBytes);
+
+/**
+ * @brief reports the memory used by the library
+ *
+ * @par    usage = pointer to the struct that receives the values
+ * @return 1 for success 0 for failure
+ */
+EXPORT uint64_t PortmasterToastGetMemoryUsage(PortmasterToastMemoryUsage *usage);
+
+/**
+ * @brief copies the state of the tracked notifications, queued and shown ones as well as recently finished ones
+ *
+ * @par    statuses = buffer of at least capacity records
+ * @par    capacity = number of records the buffer can hold, PORTMASTER_TOAST_STATE_SLOTS for all of them
+ * @return number of records copied
+ * @note   all records are taken at the same point in time, they are not ordered
+ */
+EXPORT uint64_t PortmasterToastSnapshot(PortmasterToastStatus *statuses, uint64_t capacity);
+
+/**
+ * @brief returns the lifecycle state of a notification without calling into the OS
+ * @par    notificationID = Id of the notification
+ * @return state as in PortmasterToastStatus, 0 if the notification is unknown
+ * @note   the state of the last PORTMASTER_TOAST_STATE_SLOTS Ids is kept
+ */
+EXPORT uint64_t PortmasterToastGetState(uint64_t notificationID);
+
+/**
+ * @brief starts recording all API calls and callbacks to a file
+ *
+ * @par    path = path of the recording, overwritten if it exists
+ * @return 1 for success 0 for failure or if a recording is already running
+ * @note   notifications created before the recording was started are not recorded. Recordings are replayed
+ *         outside of the library, by toast_replay of the bench build
+ */
+EXPORT uint64_t PortmasterToastStartRecording(const wchar_t *path);
+
+/**
+ * @brief stops the running recording
+ * @return 1 for success 0 for failure
+ */
+EXPORT uint64_t PortmasterToastStopRecording();
+
+/**
+ * @brief lets other processes show notifications through this one
+ *
+ * @par    name = name of the broker, shared by the owner and its clients within the session
+ * @return 1 for success 0 for failure or if a broker of that name is already running
+ * @note   the library must be initialized. Events of brokered notifications are delivered to the process
+ *         that showed them, not to the callbacks of this process.
+ */
+EXPORT uint64_t PortmasterToastStartBroker(const wchar_t *name);
+
+/**
+ * @brief shows the notifications of this process through the process that started the broker
+ *
+ * @par    name = name of the broker
+ * @return 1 for success 0 for failure or if all client slots are taken
+ * @note   initializing the library is not needed. Show, hide and their variants are forwarded to the owner and
+ *         return without waiting for it. Callbacks are called on the broker thread of this process.
+ */
+EXPORT uint64_t PortmasterToastConnectBroker(const wchar_t *name);
+
+/**
+ * @brief stops serving as broker owner or disconnects from the broker
+ * @return 1 for success 0 if neither was running
+ */
+EXPORT uint64_t PortmasterToastStopBroker();
+
+/**
+ * @brief accepts show, hide, update and event subscription commands from other local processes over a named pipe
+ *
+ * @par    name = name of the pipe, the server listens on \\.\pipe\name
+ * @return 1 for success 0 for failure or if the name is taken
+ * @note   the library must be initialized. The protocol is described in toast_pipe.h. Events of notifications
+ *         shown through the pipe are sent to the connection that showed them, not to the callbacks of this process.
+ *         Shows and hides take the same path as the host's own: they are recorded, and queued on the worker while it runs.
+ */
+EXPORT uint64_t PortmasterToastStartPipeServer(const wchar_t *name);
+
+/**
+ * @brief stops the pipe server and closes all of its connections
+ * @return 1 for success 0 if it was not running
+ */
+EXPORT uint64_t PortmasterToastStopPipeServer();
+
+/**
+ * @brief shortens the text fields of notifications shown afterwards to what Windows can show
+ *
+ * @par    enabled = 1 to shorten, 0 to pass the text on unchanged
+ * @return 1 for success
+ * @note   applies to every way of showing, including templates, descriptors, the pipe and broker clients,
+ *         whose notifications are shown under the setting of the owner. Text over budget is cut in the middle.
+ *         The file name of a path and the registrable domain of a domain name are kept.
+ */
+EXPORT uint64_t PortmasterToastSetTextBudget(uint32_t enabled);
+
+/**
+ * @brief allocator hooks, alignment is a power of two and at least 16
+ * @note   allocate returns NULL on failure. deallocate receives the size and alignment passed to allocate.
+ *         reset is called when the last block taken from the hooks has been freed.
+ */
+typedef void *(*PortmasterToastAllocateFunc)(void *context, size_t size, size_t alignment);
+typedef void (*PortmasterToastFreeFunc)(void *context, void *memory, size_t size, size_t alignment);
+typedef void (*PortmasterToastResetFunc)(void *context);
+
+/**
+ * @brief routes the library's internal memory (registry, handlers, per notification scratch memory) through the host
+ *
+ * @par    allocate   = allocation function, NULL together with deallocate restores the process heap
+ * @par    deallocate = function releasing memory returned by allocate
+ * @par    reset      = optional, called whenever all memory taken through these hooks has been given back
+ * @par    context    = passed to the hooks unchanged
+ * @return 1 for success 0 if only one of allocate and deallocate is set
+ * @note   can be called at any time. Memory taken through earlier hooks is still given back to them, so they
+ *         must stay callable until their reset hook ran or the library is unloaded.
+ */
+EXPORT uint64_t PortmasterToastSetAllocator(PortmasterToastAllocateFunc allocate, PortmasterToastFreeFunc deallocate,
+                                            PortmasterToastResetFunc reset, void *context);
+
+/**
+ * @brief bytes currently held through the hooks set last, including a small header per allocation
+ */
+EXPORT uint64_t PortmasterToastAllocatedBytes();
 
 #endif // NOTIFICATION_GLUE_H
\ No newline at end of file
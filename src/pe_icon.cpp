@@ -0,0 +1,248 @@
+#include "pe_icon.h"
+#include <cstring>
+
+using namespace WinToastLib;
+
+namespace {
+    const uint32_t ResourceDirectoryIndex = 2;
+    const uint32_t RtIcon = 3;
+    const uint32_t RtGroupIcon = 14;
+    const uint32_t SubdirectoryFlag = 0x80000000u;
+    const std::size_t GroupHeaderSize = 6;
+    const std::size_t GroupEntrySize = 14;
+    const std::size_t IcoHeaderSize = 6;
+    const std::size_t IcoEntrySize = 16;
+
+    class Reader {
+    public:
+        Reader(const uint8_t* data, std::size_t size) : m_data(data), m_size(size) {}
+
+        bool has(std::size_t offset, std::size_t length) const {
+            return offset <= m_size && length <= m_size - offset;
+        }
+
+        template <typename T>
+        bool read(std::size_t offset, T& value) const {
+            if (!has(offset, sizeof(T))) {
+                return false;
+            }
+            // PE files are little endian, as are all platforms this library runs on.
+            std::memcpy(&value, m_data + offset, sizeof(T));
+            return true;
+        }
+
+        const uint8_t* at(std::size_t offset) const {
+            return m_data + offset;
+        }
+
+    private:
+        const uint8_t* m_data;
+        std::size_t m_size;
+    };
+
+    class PeImage {
+    public:
+        PeImage(const uint8_t* data, std::size_t size) : m_reader(data, size) {}
+
+        bool parse() {
+            uint16_t magic = 0;
+            uint32_t peOffset = 0;
+            if (!m_reader.read(0, magic) || magic != 0x5a4d || !m_reader.read(0x3c, peOffset)) {
+                return false;
+            }
+
+            uint32_t signature = 0;
+            if (!m_reader.read(peOffset, signature) || signature != 0x00004550) {
+                return false;
+            }
+
+            const std::size_t coff = std::size_t(peOffset) + 4;
+            uint16_t sectionCount = 0, optionalSize = 0;
+            if (!m_reader.read(coff + 2, sectionCount) || !m_reader.read(coff + 16, optionalSize)) {
+                return false;
+            }
+
+            const std::size_t optional = coff + 20;
+            uint16_t optionalMagic = 0;
+            if (!m_reader.read(optional, optionalMagic)) {
+                return false;
+            }
+            std::size_t directoryCountOffset, directoriesOffset;
+            if (optionalMagic == 0x10b) {
+                directoryCountOffset = 92;
+                directoriesOffset = 96;
+            } else if (optionalMagic == 0x20b) {
+                directoryCountOffset = 108;
+                directoriesOffset = 112;
+            } else {
+                return false;
+            }
+
+            uint32_t directoryCount = 0;
+            if (!m_reader.read(optional + directoryCountOffset, directoryCount) || directoryCount <= ResourceDirectoryIndex) {
+                return false;
+            }
+            const std::size_t resourceEntry = optional + directoriesOffset + ResourceDirectoryIndex * 8;
+            uint32_t resourceRva = 0;
+            if (directoriesOffset + (ResourceDirectoryIndex + 1) * 8 > optionalSize
+                || !m_reader.read(resourceEntry, resourceRva) || resourceRva == 0) {
+                return false;
+            }
+
+            m_sectionTable = optional + optionalSize;
+            m_sectionCount = sectionCount;
+            return toOffset(resourceRva, 16, m_resourceRoot);
+        }
+
+        bool toOffset(uint32_t rva, std::size_t length, std::size_t& offset) const {
+            for (uint16_t i = 0; i < m_sectionCount; i++) {
+                const std::size_t entry = m_sectionTable + std::size_t(i) * 40;
+                uint32_t virtualAddress = 0, rawSize = 0, rawOffset = 0;
+                if (!m_reader.read(entry + 12, virtualAddress) || !m_reader.read(entry + 16, rawSize)
+                    || !m_reader.read(entry + 20, rawOffset)) {
+                    return false;
+                }
+                if (rva >= virtualAddress && rva - virtualAddress < rawSize) {
+                    const uint32_t delta = rva - virtualAddress;
+                    if (length > rawSize - delta) {
+                        return false;
+                    }
+                    offset = std::size_t(rawOffset) + delta;
+                    return m_reader.has(offset, length);
+                }
+            }
+            return false;
+        }
+
+        // Looks up id in the resource directory at directory, or the first entry if id is zero.
+        bool findEntry(std::size_t directory, uint32_t id, uint32_t& target) const {
+            uint16_t named = 0, ids = 0;
+            if (!m_reader.read(directory + 12, named) || !m_reader.read(directory + 14, ids)) {
+                return false;
+            }
+            const std::size_t count = std::size_t(named) + ids;
+            for (std::size_t i = 0; i < count; i++) {
+                const std::size_t entry = directory + 16 + i * 8;
+                uint32_t name = 0, offset = 0;
+                if (!m_reader.read(entry, name) || !m_reader.read(entry + 4, offset)) {
+                    return false;
+                }
+                if (id == 0 || (!(name & SubdirectoryFlag) && name == id)) {
+                    target = offset;
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        // Resolves type/name to the data of its first language.
+        bool findData(uint32_t type, uint32_t name, const uint8_t*& data, uint32_t& length) const {
+            std::size_t directory = m_resourceRoot;
+            const uint32_t path[3] = {type, name, 0};
+            uint32_t entry = 0;
+            for (int level = 0; level < 3; level++) {
+                if (!findEntry(directory, path[level], entry)) {
+                    return false;
+                }
+                // Type and name levels point to subdirectories, the language level to data.
+                const bool isDirectory = (entry & SubdirectoryFlag) != 0;
+                if (isDirectory != (level < 2)) {
+                    return false;
+                }
+                if (level < 2) {
+                    directory = m_resourceRoot + (entry & ~SubdirectoryFlag);
+                }
+            }
+
+            uint32_t dataRva = 0;
+            std::size_t dataEntry = m_resourceRoot + entry, offset = 0;
+            if (!m_reader.read(dataEntry, dataRva) || !m_reader.read(dataEntry + 4, length)
+                || !toOffset(dataRva, length, offset)) {
+                return false;
+            }
+            data = m_reader.at(offset);
+            return true;
+        }
+
+    private:
+        Reader m_reader;
+        std::size_t m_sectionTable{0};
+        uint16_t m_sectionCount{0};
+        std::size_t m_resourceRoot{0};
+    };
+
+    struct GroupEntry {
+        unsigned extent;
+        uint16_t bitCount;
+        uint16_t id;
+        std::size_t offset;
+    };
+
+    bool better(const GroupEntry& candidate, const GroupEntry& best, unsigned preferred) {
+        const bool candidateFits = candidate.extent >= preferred, bestFits = best.extent >= preferred;
+        if (candidate.extent != best.extent) {
+            if (candidateFits != bestFits) {
+                return candidateFits;
+            }
+            return candidateFits ? candidate.extent < best.extent : candidate.extent > best.extent;
+        }
+        return candidate.bitCount > best.bitCount;
+    }
+}
+
+bool PeIcon::extractIcon(const uint8_t* image, std::size_t size, unsigned preferredSize, std::vector<uint8_t>& ico) {
+    if (image == nullptr) {
+        return false;
+    }
+
+    PeImage pe(image, size);
+    const uint8_t* group = nullptr;
+    uint32_t groupLength = 0;
+    if (!pe.parse() || !pe.findData(RtGroupIcon, 0, group, groupLength)) {
+        return false;
+    }
+
+    Reader reader(group, groupLength);
+    uint16_t type = 0, count = 0;
+    if (!reader.read(2, type) || !reader.read(4, count) || type != 1 || count == 0) {
+        return false;
+    }
+
+    GroupEntry best{};
+    bool found = false;
+    for (uint16_t i = 0; i < count; i++) {
+        const std::size_t offset = GroupHeaderSize + std::size_t(i) * GroupEntrySize;
+        uint8_t width = 0;
+        GroupEntry entry;
+        if (!reader.read(offset, width) || !reader.read(offset + 6, entry.bitCount) || !reader.read(offset + 12, entry.id)) {
+            break;
+        }
+        entry.extent = width == 0 ? 256 : width;
+        entry.offset = offset;
+        if (!found || better(entry, best, preferredSize)) {
+            best = entry;
+            found = true;
+        }
+    }
+    if (!found) {
+        return false;
+    }
+
+    const uint8_t* data = nullptr;
+    uint32_t length = 0;
+    if (!pe.findData(RtIcon, best.id, data, length) || length == 0) {
+        return false;
+    }
+
+    // The group entry matches the .ico directory entry except for its last field,
+    // which is the resource ID there and the image offset here.
+    ico.resize(IcoHeaderSize + IcoEntrySize + length);
+    const uint8_t header[IcoHeaderSize] = {0, 0, 1, 0, 1, 0};
+    std::memcpy(ico.data(), header, IcoHeaderSize);
+    std::memcpy(ico.data() + IcoHeaderSize, group + best.offset, 8);
+    std::memcpy(ico.data() + IcoHeaderSize + 8, &length, 4);
+    const uint32_t imageOffset = static_cast<uint32_t>(IcoHeaderSize + IcoEntrySize);
+    std::memcpy(ico.data() + IcoHeaderSize + 12, &imageOffset, 4);
+    std::memcpy(ico.data() + imageOffset, data, length);
+    return true;
+}
@@ -0,0 +1,26 @@
+#ifndef PE_ICON_H
+#define PE_ICON_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace WinToastLib {
+
+    /**
+     * Icon extraction from the resource section of PE images.
+     *
+     * The parser works on an image that is already in memory (usually a
+     * read-only file mapping) and only reads from it, every offset is bounds
+     * checked against the image size. It does not depend on any Windows API.
+     */
+    namespace PeIcon {
+
+        // Picks the icon of the first RT_GROUP_ICON resource whose size is closest to
+        // preferredSize (preferring larger ones and more colors) and writes it as a
+        // single-image .ico file to ico. Returns false if the image has no usable icon.
+        bool extractIcon(const uint8_t* image, std::size_t size, unsigned preferredSize, std::vector<uint8_t>& ico);
+    }
+}
+
+#endif // PE_ICON_H
@@ -0,0 +1,197 @@
+#include "toast_allocator.h"
+#include <atomic>
+#include <cstdlib>
+#include <malloc.h>
+#include <thread>
+
+using namespace WinToastLib;
+
+namespace {
+    // Hooks as installed, never freed since memory allocated through them may outlive the next setHooks.
+    struct Installed {
+        WinToastAllocator::Hooks    hooks;
+        std::atomic<std::size_t>    bytes;
+    };
+
+    // Set in the byte count while the reset hook runs, allocations through the same hooks wait for it.
+    const std::size_t Resetting = static_cast<std::size_t>(1) << (sizeof(std::size_t) * 8 - 1);
+    // Room in front of every allocation for the hooks it came from, keeps 16-byte alignment.
+    const std::size_t HeaderSize = 16;
+
+    // The portable branch is only built by the benchmarks in bench/.
+    void* heapAllocate(void*, std::size_t size, std::size_t alignment) {
+#ifdef _WIN32
+        return _aligned_malloc(size, alignment);
+#else
+        void* memory = nullptr;
+        return posix_memalign(&memory, alignment, size) == 0 ? memory : nullptr;
+#endif
+    }
+
+    void heapFree(void*, void* memory, std::size_t, std::size_t) {
+#ifdef _WIN32
+        _aligned_free(memory);
+#else
+        free(memory);
+#endif
+    }
+
+    Installed heap{{heapAllocate, heapFree, nullptr, nullptr}, {0}};
+    std::atomic<Installed*> current{&heap};
+
+    std::size_t headerSize(std::size_t alignment) {
+        return alignment > HeaderSize ? alignment : HeaderSize;
+    }
+
+    void hold(Installed& installed, std::size_t bytes) {
+        while (installed.bytes.fetch_add(bytes, std::memory_order_acquire) & Resetting) {
+            installed.bytes.fetch_sub(bytes, std::memory_order_relaxed);
+            std::this_thread::yield();
+        }
+    }
+
+    void drop(Installed& installed, std::size_t bytes) {
+        if (installed.bytes.fetch_sub(bytes, std::memory_order_release) != bytes || installed.hooks.reset == nullptr) {
+            return;
+        }
+        // Only reset if nothing was allocated since the count reached zero.
+        std::size_t idle = 0;
+        if (installed.bytes.compare_exchange_strong(idle, Resetting, std::memory_order_acquire, std::memory_order_relaxed)) {
+            installed.hooks.reset(installed.hooks.context);
+            installed.bytes.fetch_sub(Resetting, std::memory_order_release);
+        }
+    }
+
+    char* alignUp(char* pointer, std::size_t alignment) {
+        const std::uintptr_t mask = static_cast<std::uintptr_t>(alignment) - 1;
+        return reinterpret_cast<char*>((reinterpret_cast<std::uintptr_t>(pointer) + mask) & ~mask);
+    }
+}
+
+bool WinToastAllocator::setHooks(_In_ const Hooks& hooks) {
+    if ((hooks.allocate == nullptr) != (hooks.free == nullptr)) {
+        return false;
+    }
+    if (hooks.allocate == nullptr) {
+        current.store(&heap, std::memory_order_release);
+        return true;
+    }
+
+    Installed* installed = new (std::nothrow) Installed{hooks, {0}};
+    if (installed == nullptr) {
+        return false;
+    }
+    current.store(installed, std::memory_order_release);
+    return true;
+}
+
+void* WinToastAllocator::allocate(_In_ std::size_t size, _In_ std::size_t alignment) {
+    const std::size_t header = headerSize(alignment);
+    if (size > (std::numeric_limits<std::size_t>::max() >> 2) - header) {
+        throw std::bad_alloc();
+    }
+
+    Installed* installed = current.load(std::memory_order_acquire);
+    const std::size_t total = header + size;
+    hold(*installed, total);
+    char* memory = static_cast<char*>(installed->hooks.allocate(installed->hooks.context, total, header));
+    if (memory == nullptr) {
+        drop(*installed, total);
+        throw std::bad_alloc();
+    }
+    reinterpret_cast<Installed**>(memory + header)[-1] = installed;
+    return memory + header;
+}
+
+void WinToastAllocator::deallocate(_In_opt_ void* memory, _In_ std::size_t size, _In_ std::size_t alignment) noexcept {
+    if (memory == nullptr) {
+        return;
+    }
+    const std::size_t header = headerSize(alignment);
+    Installed* installed = static_cast<Installed**>(memory)[-1];
+    installed->hooks.free(installed->hooks.context, static_cast<char*>(memory) - header, header + size, header);
+    drop(*installed, header + size);
+}
+
+std::size_t WinToastAllocator::allocatedBytes() {
+    return current.load(std::memory_order_acquire)->bytes.load(std::memory_order_relaxed) & ~Resetting;
+}
+
+WinToastArena::~WinToastArena() {
+    reset();
+}
+
+void* WinToastArena::allocate(_In_ std::size_t size, _In_ std::size_t alignment) {
+    char* memory = m_cursor != nullptr ? alignUp(m_cursor, alignment) : nullptr;
+    if (memory == nullptr || memory > m_end || static_cast<std::size_t>(m_end - memory) < size) {
+        // Room to align the first allocation of the chunk; larger requests get a chunk of their own.
+        const std::size_t header = sizeof(Chunk) + alignment;
+        if (size > std::numeric_limits<std::size_t>::max() - header) {
+            throw std::bad_alloc();
+        }
+        const std::size_t chunkSize = size + header > ChunkSize ? size + header : ChunkSize;
+        Chunk* chunk = static_cast<Chunk*>(WinToastAllocator::allocate(chunkSize, alignof(Chunk)));
+        chunk->next = m_chunks;
+        chunk->size = chunkSize;
+        m_chunks = chunk;
+        m_end = reinterpret_cast<char*>(chunk) + chunkSize;
+        memory = alignUp(reinterpret_cast<char*>(chunk + 1), alignment);
+    }
+    m_cursor = memory + size;
+    return memory;
+}
+
+void WinToastArena::reset() {
+    while (m_chunks != nullptr) {
+        Chunk* next = m_chunks->next;
+        WinToastAllocator::deallocate(m_chunks, m_chunks->size, alignof(Chunk));
+        m_chunks = next;
+    }
+    m_cursor = nullptr;
+    m_end = nullptr;
+}
+
+WinToastPool::WinToastPool(_In_ std::size_t size, _In_ std::size_t alignment)
+    : m_alignment(alignment > alignof(Block) ? alignment : alignof(Block)) {
+    const std::size_t blockSize = size > sizeof(Block) ? size : sizeof(Block);
+    m_blockSize = (blockSize + m_alignment - 1) & ~(m_alignment - 1);
+}
+
+void* WinToastPool::allocate() {
+    std::lock_guard<std::mutex> lock(m_lock);
+    if (m_free == nullptr) {
+        char* slab = static_cast<char*>(WinToastAllocator::allocate(m_blockSize * (SlabBlocks + 1), m_alignment));
+        Block* head = reinterpret_cast<Block*>(slab);
+        head->next = m_slabs;
+        m_slabs = head;
+        for (std::size_t i = SlabBlocks; i > 0; i--) {
+            Block* block = reinterpret_cast<Block*>(slab + i * m_blockSize);
+            block->next = m_free;
+            m_free = block;
+        }
+    }
+
+    Block* block = m_free;
+    m_free = block->next;
+    m_used++;
+    return block;
+}
+
+void WinToastPool::deallocate(_In_ void* block) noexcept {
+    std::lock_guard<std::mutex> lock(m_lock);
+    Block* freed = static_cast<Block*>(block);
+    freed->next = m_free;
+    m_free = freed;
+    if (--m_used == 0) {
+        release();
+    }
+}
+
+void WinToastPool::release() {
+    while (m_slabs != nullptr) {
+        Block* next = m_slabs->next;
+        WinToastAllocator::deallocate(m_slabs, m_blockSize * (SlabBlocks + 1), m_alignment);
+        m_slabs = next;
+    }
+    m_free = nullptr;
+}
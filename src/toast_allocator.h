@@ -0,0 +1,190 @@
+#ifndef TOAST_ALLOCATOR_H
+#define TOAST_ALLOCATOR_H
+
+#include <sal.h>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <new>
+
+namespace WinToastLib {
+
+    /**
+     * Process-wide memory hooks for the library's internal containers.
+     *
+     * The registry, the handlers of shown toasts and the per-show scratch
+     * memory are allocated through these hooks, so a host can route them
+     * into its own heap and account for them. Without hooks the process
+     * heap is used. Every allocation remembers the hooks it came from and
+     * is given back to them, so hooks can be replaced at any time while
+     * older memory is still held. The optional reset hook is called each
+     * time the last byte held through a set of hooks is given back, so a
+     * host arena can be rewound in one step.
+     */
+    class WinToastAllocator {
+    public:
+        typedef void* (*AllocateFunc)(void* context, std::size_t size, std::size_t alignment);
+        typedef void (*FreeFunc)(void* context, void* memory, std::size_t size, std::size_t alignment);
+        typedef void (*ResetFunc)(void* context);
+
+        struct Hooks {
+            AllocateFunc    allocate;   // returns nullptr on failure
+            FreeFunc        free;
+            ResetFunc       reset;      // optional
+            void*           context;
+        };
+
+        // Null allocate and free restore the process heap. Fails if only one of them is set.
+        static bool setHooks(_In_ const Hooks& hooks);
+
+        // Throws std::bad_alloc on failure, like the containers built on it expect.
+        static void* allocate(_In_ std::size_t size, _In_ std::size_t alignment);
+        static void deallocate(_In_opt_ void* memory, _In_ std::size_t size, _In_ std::size_t alignment) noexcept;
+
+        // Bytes held through the current hooks, including the per allocation header.
+        static std::size_t allocatedBytes();
+    };
+
+    /**
+     * Bump allocator over chunks taken from WinToastAllocator.
+     *
+     * Allocations are never freed one by one; everything is given back when
+     * the arena is reset or destroyed. Meant for memory that lives exactly
+     * as long as one unit of work, such as composing the XML of one toast.
+     */
+    class WinToastArena {
+    public:
+        static constexpr std::size_t ChunkSize = 4096;
+
+        WinToastArena() = default;
+        ~WinToastArena();
+        WinToastArena(const WinToastArena&) = delete;
+        WinToastArena& operator=(const WinToastArena&) = delete;
+
+        void* allocate(_In_ std::size_t size, _In_ std::size_t alignment);
+        void reset();
+
+    private:
+        struct Chunk {
+            Chunk*          next;
+            std::size_t     size;
+        };
+
+        Chunk*  m_chunks{nullptr};
+        char*   m_cursor{nullptr};
+        char*   m_end{nullptr};
+    };
+
+    /**
+     * Free list of equally sized blocks, carved from slabs of SlabBlocks.
+     *
+     * All slabs are given back once the last block is freed, so an idle
+     * pool returns its memory to the hooks it was taken from.
+     */
+    class WinToastPool {
+    public:
+        static constexpr std::size_t SlabBlocks = 64;
+
+        WinToastPool(_In_ std::size_t size, _In_ std::size_t alignment);
+        WinToastPool(const WinToastPool&) = delete;
+        WinToastPool& operator=(const WinToastPool&) = delete;
+
+        void* allocate();
+        void deallocate(_In_ void* block) noexcept;
+
+    private:
+        struct Block {
+            Block*  next;
+        };
+
+        void release();
+
+        std::mutex      m_lock;
+        Block*          m_free{nullptr};
+        Block*          m_slabs{nullptr};   // the first block of each slab links the slabs
+        std::size_t     m_used{0};
+        std::size_t     m_blockSize;
+        std::size_t     m_alignment;
+    };
+
+    // Standard allocator on WinToastAllocator, or on an arena when one is given.
+    template <typename T>
+    class WinToastStlAllocator {
+    public:
+        typedef T value_type;
+
+        WinToastStlAllocator() noexcept = default;
+        explicit WinToastStlAllocator(_In_opt_ WinToastArena* arena) noexcept : m_arena(arena) {}
+        template <typename U>
+        WinToastStlAllocator(_In_ const WinToastStlAllocator<U>& other) noexcept : m_arena(other.arena()) {}
+
+        T* allocate(_In_ std::size_t count) {
+            if (count > std::numeric_limits<std::size_t>::max() / sizeof(T)) {
+                throw std::bad_alloc();
+            }
+            void* memory = m_arena != nullptr ? m_arena->allocate(count * sizeof(T), alignof(T))
+                                              : WinToastAllocator::allocate(count * sizeof(T), alignof(T));
+            return static_cast<T*>(memory);
+        }
+
+        void deallocate(_In_ T* memory, _In_ std::size_t count) noexcept {
+            if (m_arena == nullptr) {
+                WinToastAllocator::deallocate(memory, count * sizeof(T), alignof(T));
+            }
+        }
+
+        WinToastArena* arena() const noexcept { return m_arena; }
+
+        template <typename U>
+        bool operator==(_In_ const WinToastStlAllocator<U>& other) const noexcept { return m_arena == other.arena(); }
+        template <typename U>
+        bool operator!=(_In_ const WinToastStlAllocator<U>& other) const noexcept { return m_arena != other.arena(); }
+
+    private:
+        WinToastArena* m_arena{nullptr};
+    };
+
+    // Standard allocator for node based containers: single nodes come from a pool per type, arrays from WinToastAllocator.
+    template <typename T>
+    class WinToastPoolAllocator {
+    public:
+        typedef T value_type;
+
+        WinToastPoolAllocator() noexcept = default;
+        template <typename U>
+        WinToastPoolAllocator(_In_ const WinToastPoolAllocator<U>&) noexcept {}
+
+        T* allocate(_In_ std::size_t count) {
+            if (count == 1) {
+                return static_cast<T*>(pool().allocate());
+            }
+            if (count > std::numeric_limits<std::size_t>::max() / sizeof(T)) {
+                throw std::bad_alloc();
+            }
+            return static_cast<T*>(WinToastAllocator::allocate(count * sizeof(T), alignof(T)));
+        }
+
+        void deallocate(_In_ T* memory, _In_ std::size_t count) noexcept {
+            if (count == 1) {
+                pool().deallocate(memory);
+            } else {
+                WinToastAllocator::deallocate(memory, count * sizeof(T), alignof(T));
+            }
+        }
+
+        template <typename U>
+        bool operator==(_In_ const WinToastPoolAllocator<U>&) const noexcept { return true; }
+        template <typename U>
+        bool operator!=(_In_ const WinToastPoolAllocator<U>&) const noexcept { return false; }
+
+    private:
+        // Never destroyed, containers held by other statics may still free their nodes at exit.
+        static WinToastPool& pool() {
+            static WinToastPool* instance = new WinToastPool(sizeof(T), alignof(T));
+            return *instance;
+        }
+    };
+}
+
+#endif // TOAST_ALLOCATOR_H
@@ -0,0 +1,76 @@
+#include "toast_arguments.h"
+#include <climits>
+#include <cwchar>
+
+using namespace WinToastLib;
+
+namespace {
+    const wchar_t Prefix[] = L"pm1:";
+    const std::size_t PrefixLength = sizeof(Prefix) / sizeof(Prefix[0]) - 1;
+    const std::size_t IdLength = 16;
+    const std::size_t MaxActionDigits = 10;
+
+    int hexValue(wchar_t c) {
+        if (c >= L'0' && c <= L'9') return c - L'0';
+        if (c >= L'a' && c <= L'f') return c - L'a' + 10;
+        if (c >= L'A' && c <= L'F') return c - L'A' + 10;
+        return -1;
+    }
+}
+
+std::wstring WinToastArguments::encode(_In_ int64_t id, _In_ int action, _In_ const std::wstring& token) {
+    wchar_t buffer[PrefixLength + IdLength + MaxActionDigits + 4];
+    swprintf(buffer, sizeof(buffer) / sizeof(buffer[0]), L"%ls%016llx:%d", Prefix, static_cast<unsigned long long>(id), action);
+
+    std::wstring arguments(buffer);
+    if (!token.empty()) {
+        arguments += L':';
+        arguments.append(token, 0, MaxTokenLength);
+    }
+    return arguments;
+}
+
+bool WinToastArguments::decode(_In_reads_(length) const wchar_t* arguments, _In_ std::size_t length, _Out_ Decoded& decoded) {
+    decoded = Decoded{0, BodyAction, nullptr, 0};
+    if (arguments == nullptr || length < PrefixLength + IdLength + 2 || wcsncmp(arguments, Prefix, PrefixLength) != 0) {
+        return false;
+    }
+
+    std::size_t pos = PrefixLength;
+    unsigned long long id = 0;
+    for (const std::size_t end = pos + IdLength; pos < end; pos++) {
+        const int digit = hexValue(arguments[pos]);
+        if (digit < 0) {
+            return false;
+        }
+        id = (id << 4) | static_cast<unsigned>(digit);
+    }
+    if (arguments[pos++] != L':') {
+        return false;
+    }
+
+    const bool negative = pos < length && arguments[pos] == L'-';
+    if (negative) {
+        pos++;
+    }
+    const std::size_t digitsBegin = pos;
+    long long action = 0;
+    while (pos < length && arguments[pos] >= L'0' && arguments[pos] <= L'9' && pos - digitsBegin < MaxActionDigits) {
+        action = action * 10 + (arguments[pos] - L'0');
+        pos++;
+    }
+    if (pos == digitsBegin || action > INT_MAX) {
+        return false;
+    }
+
+    if (pos < length) {
+        if (arguments[pos] != L':' || length - pos - 1 > MaxTokenLength) {
+            return false;
+        }
+        decoded.token = arguments + pos + 1;
+        decoded.tokenLength = length - pos - 1;
+    }
+    decoded.id = static_cast<int64_t>(id);
+    decoded.action = static_cast<int>(negative ? -action : action);
+    return true;
+}
@@ -0,0 +1,39 @@
+#ifndef TOAST_ARGUMENTS_H
+#define TOAST_ARGUMENTS_H
+
+#include <sal.h>
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+namespace WinToastLib {
+
+    /**
+     * Activation arguments that identify the toast and action they belong to.
+     *
+     * Every action and the toast body carry "pm1:<id>:<action>[:<token>]",
+     * with the id as 16 hex digits, the action index in decimal (-1 for the
+     * body) and an optional opaque caller token. Because the arguments route
+     * themselves, an activation can be attributed without any per-toast state,
+     * also by a process that did not show the toast.
+     */
+    class WinToastArguments {
+    public:
+        static constexpr int BodyAction = -1;
+        static constexpr std::size_t MaxTokenLength = 128;
+
+        struct Decoded {
+            int64_t id;
+            int action;
+            const wchar_t* token;           // points into the decoded string, not terminated
+            std::size_t tokenLength;
+        };
+
+        static std::wstring encode(_In_ int64_t id, _In_ int action, _In_ const std::wstring& token = std::wstring());
+
+        // Parses arguments without allocating. Returns false for anything that wasn't created by encode.
+        static bool decode(_In_reads_(length) const wchar_t* arguments, _In_ std::size_t length, _Out_ Decoded& decoded);
+    };
+}
+
+#endif // TOAST_ARGUMENTS_H
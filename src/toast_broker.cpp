@@ -0,0 +1,463 @@
+#include "toast_broker.h"
+#include "toast_descriptor.h"
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <cwchar>
+#include <vector>
+#ifndef _WIN32
+#include <cerrno>
+#include <signal.h>
+#include <unistd.h>
+#endif
+
+using namespace WinToastLib;
+
+namespace {
+    const uint32_t Magic = 0x4b424d50; // "PMBK"
+    const uint32_t Version = 3;
+    const std::size_t RequestSlots = 32;
+    const std::size_t EventSlots = 256;
+    const std::size_t DataCapacity = 4096;
+
+    struct RequestSlot {
+        volatile LONG64 sequence;
+        uint32_t        kind;
+        uint32_t        length;     // bytes of data
+        INT64           id;
+        // Show: a WinToastDescriptor. HideGroup and HideKey: the group or key, zero terminated.
+        uint8_t         data[DataCapacity];
+    };
+
+    static_assert(offsetof(RequestSlot, data) % alignof(WinToastDescriptor::Header) == 0, "descriptors are written in place");
+
+    struct EventSlot {
+        volatile LONG64 sequence;
+        uint32_t        kind;
+        int32_t         value;
+        INT64           id;
+    };
+
+    // Slot i starts with sequence i. A producer may fill it when the sequence equals its position
+    // and publishes it as position + 1; the consumer frees it for the next lap as position + Size.
+    template <typename Slot, std::size_t Size>
+    struct Ring {
+        volatile LONG64 head;
+        volatile LONG64 tail;
+        volatile LONG   sleeping;
+        Slot            slots[Size];
+    };
+
+    inline LONG64 load(_In_ volatile LONG64* value) {
+        return InterlockedCompareExchange64(value, 0, 0);
+    }
+
+    template <typename Slot, std::size_t Size>
+    void initialize(_Out_ Ring<Slot, Size>& ring) {
+        for (std::size_t i = 0; i < Size; i++) {
+            ring.slots[i].sequence = static_cast<LONG64>(i);
+        }
+    }
+
+    template <typename Slot, std::size_t Size>
+    bool isEmpty(_In_ Ring<Slot, Size>& ring) {
+        const LONG64 position = load(&ring.tail);
+        return load(&ring.slots[position % Size].sequence) != position + 1;
+    }
+
+    // The slot is filled in place, the payload is never staged in a separate buffer.
+    template <typename Slot, std::size_t Size, typename Fill>
+    bool push(_Inout_ Ring<Slot, Size>& ring, _Inout_ WinToastEvent& wake, _In_ Fill fill) {
+        LONG64 position = load(&ring.head);
+        for (;;) {
+            Slot& slot = ring.slots[position % Size];
+            const LONG64 difference = load(&slot.sequence) - position;
+            if (difference < 0) {
+                return false;
+            }
+            if (difference == 0 && InterlockedCompareExchange64(&ring.head, position + 1, position) == position) {
+                fill(slot);
+                InterlockedExchange64(&slot.sequence, position + 1);
+                if (InterlockedExchange(&ring.sleeping, 0) != 0) {
+                    wake.set();
+                }
+                return true;
+            }
+            position = load(&ring.head);
+        }
+    }
+
+    template <typename Slot, std::size_t Size, typename Consume>
+    bool pop(_Inout_ Ring<Slot, Size>& ring, _In_ Consume consume) {
+        const LONG64 position = ring.tail;
+        Slot& slot = ring.slots[position % Size];
+        if (load(&slot.sequence) != position + 1) {
+            return false;
+        }
+        consume(slot);
+        InterlockedExchange64(&slot.sequence, position + static_cast<LONG64>(Size));
+        InterlockedExchange64(&ring.tail, position + 1);
+        return true;
+    }
+
+    // Returns false once stopping is set. stop sets the event after it, so a wait never misses it.
+    template <typename Slot, std::size_t Size>
+    bool wait(_Inout_ Ring<Slot, Size>& ring, _Inout_ WinToastEvent& wake, _In_ const std::atomic<bool>& stopping) {
+        InterlockedExchange(&ring.sleeping, 1);
+        if (isEmpty(ring) && !stopping.load()) {
+            wake.wait();
+        }
+        InterlockedExchange(&ring.sleeping, 0);
+        return !stopping.load();
+    }
+
+    LONG currentProcess() {
+#ifdef _WIN32
+        return static_cast<LONG>(GetCurrentProcessId());
+#else
+        return static_cast<LONG>(getpid());
+#endif
+    }
+
+    bool isProcessAlive(_In_ LONG processId) {
+#ifdef _WIN32
+        HANDLE process = OpenProcess(SYNCHRONIZE, FALSE, static_cast<DWORD>(processId));
+        if (process == nullptr) {
+            return GetLastError() == ERROR_ACCESS_DENIED;
+        }
+        const bool alive = WaitForSingleObject(process, 0) == WAIT_TIMEOUT;
+        CloseHandle(process);
+        return alive;
+#else
+        return kill(static_cast<pid_t>(processId), 0) == 0 || errno == EPERM;
+#endif
+    }
+}
+
+struct WinToastBroker::Shared {
+    uint32_t                                magic;          // written last by the owner
+    uint32_t                                version;
+    uint32_t                                size;
+    volatile LONG                           ownerProcess;   // 0 once the owner stopped
+    volatile LONG                           clients[MaxClients];    // process Id of the client in the slot, 0 if free
+    volatile LONG                           ready[MaxClients];      // client the owner last reset the request ring for
+    Ring<RequestSlot, RequestSlots>         requests[MaxClients];
+    Ring<EventSlot, EventSlots>             events[MaxClients];
+};
+
+WinToastBroker::~WinToastBroker() {
+    stop();
+}
+
+bool WinToastBroker::serve(_In_ const std::wstring& name, _In_ RequestHandler handler) {
+    std::lock_guard<std::mutex> lock(m_lock);
+    if (m_role.load() != None || !handler || !map(name, true)) {
+        return false;
+    }
+
+    m_requestHandler = std::move(handler);
+    m_stopping.store(false);
+    m_role.store(Owner);
+    m_thread = std::thread(&WinToastBroker::run, this);
+    return true;
+}
+
+bool WinToastBroker::connect(_In_ const std::wstring& name, _In_ EventHandler handler) {
+    std::lock_guard<std::mutex> lock(m_lock);
+    if (m_role.load() != None || !handler || !map(name, false)) {
+        return false;
+    }
+
+    // Slots of clients that exited without disconnecting are taken over.
+    const LONG self = currentProcess();
+    bool claimed = false;
+    for (uint32_t i = 0; i < MaxClients && !claimed; i++) {
+        const LONG current = m_shared->clients[i];
+        if (current == 0 || !isProcessAlive(current)) {
+            claimed = InterlockedCompareExchange(&m_shared->clients[i], self, current) == current;
+            m_slot = i;
+        }
+    }
+    if (!claimed) {
+        unmap();
+        return false;
+    }
+
+    // Events left over for the previous client of the slot.
+    while (pop(m_shared->events[m_slot], [](EventSlot&) {})) {
+    }
+
+    // The owner resets the request ring of a slot that changed hands before the client may use it.
+    m_requestEvent.set();
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(DWORD{ConnectTimeoutMs});
+    while (InterlockedCompareExchange(&m_shared->ready[m_slot], 0, 0) != self) {
+        if (std::chrono::steady_clock::now() > deadline || InterlockedCompareExchange(&m_shared->ownerProcess, 0, 0) == 0) {
+            InterlockedCompareExchange(&m_shared->clients[m_slot], 0, self);
+            unmap();
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    FILETIME now;
+    GetSystemTimeAsFileTime(&now);
+    const INT64 counter = static_cast<INT64>((static_cast<uint64_t>(now.dwHighDateTime) << 32) | now.dwLowDateTime);
+    m_nextId.store((static_cast<INT64>(m_slot) + 1) << ClientIdShift | (counter & ((INT64(1) << ClientIdShift) - 1)));
+    m_eventHandler = std::move(handler);
+    m_stopping.store(false);
+    m_role.store(Client);
+    m_thread = std::thread(&WinToastBroker::run, this);
+    return true;
+}
+
+void WinToastBroker::stop() {
+    std::lock_guard<std::mutex> lock(m_lock);
+    const Role role = m_role.exchange(None);
+    if (role == None) {
+        return;
+    }
+
+    if (role == Owner) {
+        InterlockedExchange(&m_shared->ownerProcess, 0);
+    }
+    m_stopping.store(true);
+    (role == Owner ? m_requestEvent : m_clientEvents[m_slot]).set();
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+    while (m_users.load() != 0) {
+        std::this_thread::yield();
+    }
+    if (role == Client) {
+        // Released only after the last push, the owner resets the ring once the slot is free.
+        InterlockedExchange(&m_shared->clients[m_slot], 0);
+    }
+    unmap();
+    m_requestHandler = nullptr;
+    m_eventHandler = nullptr;
+}
+
+bool WinToastBroker::isOwner() const {
+    return m_role.load() == Owner;
+}
+
+bool WinToastBroker::isClient() const {
+    return m_role.load() == Client;
+}
+
+INT64 WinToastBroker::show(_In_ const WinToastTemplate& toast) {
+    const std::size_t size = WinToastDescriptor::measure(toast);
+    if (size == 0 || size > DataCapacity) {
+        return -1;
+    }
+
+    const INT64 id = m_nextId.fetch_add(1);
+    return request(Show, id, &toast, nullptr) ? id : -1;
+}
+
+bool WinToastBroker::hide(_In_ INT64 id) {
+    return request(Hide, id, nullptr, nullptr);
+}
+
+bool WinToastBroker::hideGroup(_In_ const std::wstring& group) {
+    return group.size() < DataCapacity / sizeof(wchar_t) && request(HideGroup, -1, nullptr, &group);
+}
+
+bool WinToastBroker::hideByKey(_In_ const std::wstring& key) {
+    return key.size() < DataCapacity / sizeof(wchar_t) && request(HideKey, -1, nullptr, &key);
+}
+
+bool WinToastBroker::post(_In_ Kind kind, _In_ INT64 id, _In_ int32_t value) {
+    if (!isClientId(id) || !enter(Owner)) {
+        return false;
+    }
+
+    const std::size_t client = static_cast<std::size_t>(id >> ClientIdShift) - 1;
+    const bool posted = InterlockedCompareExchange(&m_shared->clients[client], 0, 0) != 0
+        && push(m_shared->events[client], m_clientEvents[client], [kind, id, value](EventSlot& slot) {
+            slot.kind = kind;
+            slot.value = value;
+            slot.id = id;
+        });
+    leave();
+    return posted;
+}
+
+bool WinToastBroker::isClientId(_In_ INT64 id) {
+    return id > 0 && (id >> ClientIdShift) >= 1 && (id >> ClientIdShift) <= static_cast<INT64>(MaxClients);
+}
+
+bool WinToastBroker::map(_In_ const std::wstring& name, _In_ bool create) {
+    if (name.empty()) {
+        return false;
+    }
+
+    const uint32_t size = static_cast<uint32_t>(sizeof(Shared));
+    // A name in use means another owner is running, or was running and left its clients behind.
+    if (create ? !m_section.createShared(name, size) : !m_section.openShared(name, size)) {
+        return false;
+    }
+
+    Shared* shared = static_cast<Shared*>(m_section.data());
+    if (create) {
+        // A new section is zero filled.
+        shared->version = Version;
+        shared->size = size;
+        shared->ownerProcess = currentProcess();
+        for (auto& ring : shared->requests) {
+            initialize(ring);
+        }
+        for (auto& ring : shared->events) {
+            initialize(ring);
+        }
+        MemoryBarrier();
+        shared->magic = Magic;
+    } else if (shared->magic != Magic || shared->version != Version || shared->size != size || shared->ownerProcess == 0) {
+        m_section.close();
+        return false;
+    }
+
+    m_shared = shared;
+    bool succeeded = m_requestEvent.open(name + L".requests", create);
+    for (std::size_t i = 0; i < MaxClients && succeeded; i++) {
+        succeeded = m_clientEvents[i].open(name + L".events." + std::to_wstring(i), create);
+    }
+    if (!succeeded) {
+        unmap();
+    }
+    return succeeded;
+}
+
+void WinToastBroker::unmap() {
+    for (auto& event : m_clientEvents) {
+        event.close();
+    }
+    m_requestEvent.close();
+    m_section.close();
+    m_shared = nullptr;
+}
+
+bool WinToastBroker::request(_In_ Kind kind, _In_ INT64 id, _In_opt_ const WinToastTemplate* toast, _In_opt_ const std::wstring* match) {
+    if (!enter(Client)) {
+        return false;
+    }
+
+    const bool sent = InterlockedCompareExchange(&m_shared->ownerProcess, 0, 0) != 0
+        && push(m_shared->requests[m_slot], m_requestEvent, [kind, id, toast, match](RequestSlot& slot) {
+            slot.kind = kind;
+            slot.id = id;
+            slot.length = 0;
+            if (toast != nullptr) {
+                slot.length = static_cast<uint32_t>(WinToastDescriptor::write(*toast, slot.data, DataCapacity));
+            } else if (match != nullptr) {
+                slot.length = static_cast<uint32_t>((match->size() + 1) * sizeof(wchar_t));
+                memcpy(slot.data, match->c_str(), slot.length);
+            }
+        });
+    leave();
+    return sent;
+}
+
+bool WinToastBroker::enter(_In_ Role role) {
+    m_users.fetch_add(1);
+    if (m_role.load() == role) {
+        return true;
+    }
+    m_users.fetch_sub(1);
+    return false;
+}
+
+void WinToastBroker::leave() {
+    m_users.fetch_sub(1);
+}
+
+void WinToastBroker::run() {
+    if (m_role.load() == Owner) {
+        std::vector<uint8_t> data;
+        data.reserve(DataCapacity);
+        do {
+            for (uint32_t i = 0; i < MaxClients; i++) {
+                serveClient(i, data);
+            }
+        } while (waitForRequests());
+    } else {
+        auto& ring = m_shared->events[m_slot];
+        do {
+            EventSlot event{};
+            while (pop(ring, [&event](EventSlot& slot) {
+                event.kind = slot.kind;
+                event.value = slot.value;
+                event.id = slot.id;
+            })) {
+                m_eventHandler(static_cast<Kind>(event.kind), event.id, event.value);
+            }
+        } while (wait(ring, m_clientEvents[m_slot], m_stopping));
+    }
+}
+
+void WinToastBroker::serveClient(_In_ uint32_t client, _Inout_ std::vector<uint8_t>& data) {
+    auto& ring = m_shared->requests[client];
+    // Read before draining: a client releases its slot only after its last push.
+    const LONG current = InterlockedCompareExchange(&m_shared->clients[client], 0, 0);
+
+    // Requests are copied out of the section before they are checked, so a client cannot change them afterwards.
+    Request received{};
+    while (pop(ring, [&received, &data](RequestSlot& slot) {
+        received.kind = static_cast<Kind>(slot.kind);
+        received.id = slot.id;
+        data.assign(slot.data, slot.data + (slot.length < DataCapacity ? slot.length : DataCapacity));
+    })) {
+        received.client = client;
+        bool valid = true;
+        if (received.kind == Show) {
+            WinToastDescriptor descriptor;
+            valid = descriptor.open(data.data(), data.size());
+            if (valid) {
+                received.toast.reset(new WinToastTemplate());
+                descriptor.toTemplate(*received.toast);
+            }
+        } else if ((received.kind == HideGroup || received.kind == HideKey) && !data.empty()) {
+            const wchar_t* text = reinterpret_cast<const wchar_t*>(data.data());
+            received.match.assign(text, wcsnlen(text, data.size() / sizeof(wchar_t)));
+        }
+
+        // Clients only show and hide toasts with Ids of their own slot. The handler limits their
+        // HideGroup and HideKey to the toasts of the slot, see Request::source.
+        const bool ownId = isClientId(received.id) && (received.id >> ClientIdShift) - 1 == static_cast<INT64>(client);
+        if (!valid) {
+            post(Failed, received.id, E_INVALIDARG);
+        } else if (received.kind == Show || received.kind == Hide ? ownId : received.kind <= HideKey) {
+            m_requestHandler(received);
+        }
+        received = Request{};
+    }
+
+    // The slot changed hands. A slot the last client claimed but never published, because it died
+    // in between, would block the ring for good, so it is started over for the next client.
+    if (current != m_shared->ready[client]) {
+        ring.head = 0;
+        ring.tail = 0;
+        ring.sleeping = 0;
+        initialize(ring);
+        MemoryBarrier();
+        InterlockedExchange(&m_shared->ready[client], current);
+    }
+}
+
+// Returns false once the broker is stopping.
+bool WinToastBroker::waitForRequests() {
+    for (auto& ring : m_shared->requests) {
+        InterlockedExchange(&ring.sleeping, 1);
+    }
+    bool idle = !m_stopping.load();
+    for (uint32_t i = 0; i < MaxClients && idle; i++) {
+        idle = isEmpty(m_shared->requests[i]) && InterlockedCompareExchange(&m_shared->clients[i], 0, 0) == m_shared->ready[i];
+    }
+    if (idle) {
+        m_requestEvent.wait();
+    }
+    for (auto& ring : m_shared->requests) {
+        InterlockedExchange(&ring.sleeping, 0);
+    }
+    return !m_stopping.load();
+}
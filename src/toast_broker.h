@@ -0,0 +1,131 @@
+#ifndef TOAST_BROKER_H
+#define TOAST_BROKER_H
+
+#include "toast_mapping.h"
+#include "toast_template.h"
+#include <Windows.h>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace WinToastLib {
+
+    /**
+     * Lets several processes show notifications through the WinToast
+     * instance of one owner process.
+     *
+     * The owner creates a named shared memory section holding one request
+     * ring and one event ring per client. A client writes a show request as
+     * a WinToastDescriptor directly into a slot of its request ring and
+     * returns without waiting for the owner. The owner copies the slot out,
+     * checks it and shows the toast on its broker thread. Activated,
+     * dismissed and failed events are posted back to the ring of the client
+     * that showed the toast. Rings are bounded and lock-free. Each slot is
+     * published by storing its sequence number last. A consumer that finds
+     * its rings empty sleeps on a named event, and producers signal that
+     * event only when the consumer is asleep.
+     *
+     * A client that dies between claiming a ring slot and publishing it only
+     * stalls its own request ring. The owner drains and resets the ring of a
+     * client slot whenever the slot changes hands, and a connecting client
+     * waits for that before it sends anything.
+     *
+     * Clients choose their toast Ids themselves, (slot + 1) << ClientIdShift
+     * plus a counter, so they never collide with the Ids of the owner. A
+     * client only shows and hides toasts with Ids of its slot, and hides by
+     * group or key are limited to them as well.
+     *
+     * The section and the events are a WinToastMapping and WinToastEvents,
+     * so the broker builds on POSIX hosts too, where it is benchmarked.
+     */
+    class WinToastBroker {
+    public:
+        enum Kind : uint32_t {
+            Show = 1,
+            Hide,
+            HideGroup,
+            HideKey,
+            Activated = 100,    // value: action index, -1 for the body
+            Dismissed,          // value: reason
+            Failed              // value: HRESULT
+        };
+
+        static constexpr std::size_t MaxClients = 8;
+        static constexpr unsigned ClientIdShift = 58;
+        static constexpr DWORD ConnectTimeoutMs = 2000;
+
+        // A request taken from the ring, toast is set for Show and match for HideGroup and HideKey.
+        struct Request {
+            Kind                                kind;
+            uint32_t                            client;
+            INT64                               id;
+            std::unique_ptr<WinToastTemplate>   toast;
+            std::wstring                        match;
+
+            // The WinToastRegistry source of the client's Ids, to limit HideGroup and HideKey to its toasts.
+            int source() const { return static_cast<int>(client) + 1; }
+        };
+
+        typedef std::function<void(Request& request)> RequestHandler;
+        typedef std::function<void(Kind kind, INT64 id, int32_t value)> EventHandler;
+
+        WinToastBroker() = default;
+        ~WinToastBroker();
+        WinToastBroker(const WinToastBroker&) = delete;
+        WinToastBroker& operator=(const WinToastBroker&) = delete;
+
+        // Creates the section and handles requests on a broker thread.
+        bool serve(_In_ const std::wstring& name, _In_ RequestHandler handler);
+        // Opens the section of a running owner and takes a free client slot.
+        bool connect(_In_ const std::wstring& name, _In_ EventHandler handler);
+        void stop();
+
+        bool isOwner() const;
+        bool isClient() const;
+
+        // Client side. Returns the Id of the toast, -1 if the request does not fit a slot or the ring is full.
+        INT64 show(_In_ const WinToastTemplate& toast);
+        bool hide(_In_ INT64 id);
+        bool hideGroup(_In_ const std::wstring& group);
+        bool hideByKey(_In_ const std::wstring& key);
+
+        // Owner side. Events of toasts that do not belong to a client, or to a client that is gone, are dropped.
+        bool post(_In_ Kind kind, _In_ INT64 id, _In_ int32_t value = 0);
+        static bool isClientId(_In_ INT64 id);
+
+    private:
+        struct Shared;
+        enum Role { None, Owner, Client };
+
+        bool map(_In_ const std::wstring& name, _In_ bool create);
+        void unmap();
+        bool request(_In_ Kind kind, _In_ INT64 id, _In_opt_ const WinToastTemplate* toast, _In_opt_ const std::wstring* match);
+        void run();
+        void serveClient(_In_ uint32_t client, _Inout_ std::vector<uint8_t>& data);
+        bool waitForRequests();
+        // Keeps the section mapped while a request or event is pushed from outside the broker thread.
+        bool enter(_In_ Role role);
+        void leave();
+
+        std::mutex                  m_lock;
+        std::atomic<Role>           m_role{None};
+        std::atomic<bool>           m_stopping{false};
+        WinToastMapping             m_section;
+        Shared*                     m_shared{nullptr};
+        WinToastEvent               m_requestEvent;
+        WinToastEvent               m_clientEvents[MaxClients];
+        uint32_t                    m_slot{0};
+        std::atomic<INT64>          m_nextId{0};
+        std::atomic<int>            m_users{0};
+        std::thread                 m_thread;
+        RequestHandler              m_requestHandler;
+        EventHandler                m_eventHandler;
+    };
+}
+
+#endif // TOAST_BROKER_H
@@ -0,0 +1,175 @@
+#include "toast_budget.h"
+#include <cwchar>
+
+using namespace WinToastLib;
+
+namespace {
+    const wchar_t ZeroWidthJoiner = 0x200D;
+    const std::size_t MinHead = 4;
+
+    bool isHighSurrogate(_In_ wchar_t c) { return c >= 0xD800 && c <= 0xDBFF; }
+    bool isLowSurrogate(_In_ wchar_t c) { return c >= 0xDC00 && c <= 0xDFFF; }
+
+    // Characters that extend the preceding one.
+    bool isExtend(_In_ wchar_t c) {
+        return (c >= 0x0300 && c <= 0x036F) || (c >= 0x1AB0 && c <= 0x1AFF) || (c >= 0x1DC0 && c <= 0x1DFF)
+            || (c >= 0x20D0 && c <= 0x20FF) || (c >= 0xFE00 && c <= 0xFE0F) || (c >= 0xFE20 && c <= 0xFE2F);
+    }
+
+    // U+1F3FB..U+1F3FF
+    bool isEmojiModifier(_In_reads_(length) const wchar_t* text, _In_ std::size_t length, _In_ std::size_t position) {
+        return position + 1 < length && text[position] == 0xD83C && text[position + 1] >= 0xDFFB && text[position + 1] <= 0xDFFF;
+    }
+
+    // U+1F1E6..U+1F1FF
+    bool isRegionalIndicator(_In_reads_(length) const wchar_t* text, _In_ std::size_t length, _In_ std::size_t position) {
+        return position + 1 < length && text[position] == 0xD83C && text[position + 1] >= 0xDDE6 && text[position + 1] <= 0xDDFF;
+    }
+
+    bool isSeparator(_In_ wchar_t c) {
+        return c == L'\\' || c == L'/';
+    }
+
+    bool isDomainCharacter(_In_ wchar_t c) {
+        return (c >= L'a' && c <= L'z') || (c >= L'A' && c <= L'Z') || (c >= L'0' && c <= L'9') || c == L'-' || c == L'.';
+    }
+
+    // Reads the first and the last window characters only.
+    WinToastTextBudget::Kind detect(_In_reads_(length) const wchar_t* text, _In_ std::size_t length, _In_ std::size_t window) {
+        if ((length >= 3 && text[1] == L':' && isSeparator(text[2])) || (length >= 2 && isSeparator(text[0]) && isSeparator(text[1]))
+            || (length >= 1 && text[0] == L'/')) {
+            return WinToastTextBudget::Path;
+        }
+
+        const std::size_t headEnd = length > window ? window : length;
+        const std::size_t tailStart = length > 2 * window ? length - window : headEnd;
+        bool dot = false;
+        for (std::size_t i = 0; i < length; i = i + 1 == headEnd ? tailStart : i + 1) {
+            if (!isDomainCharacter(text[i])) {
+                return WinToastTextBudget::Plain;
+            }
+            dot = dot || text[i] == L'.';
+        }
+        return dot ? WinToastTextBudget::Domain : WinToastTextBudget::Plain;
+    }
+
+    // Length of the part that is kept at the end, 0 if there is none within limit characters.
+    std::size_t tailLength(_In_reads_(length) const wchar_t* text, _In_ std::size_t length, _In_ WinToastTextBudget::Kind kind,
+                           _In_ std::size_t limit) {
+        const std::size_t stop = length > limit ? length - limit : 0;
+        if (kind == WinToastTextBudget::Path) {
+            for (std::size_t i = length; i-- > stop;) {
+                if (isSeparator(text[i])) {
+                    return length - i;
+                }
+            }
+            return 0;
+        }
+
+        // Positions of the last three dots.
+        std::size_t dots[3] = {};
+        std::size_t found = 0;
+        for (std::size_t i = length; i-- > stop && found < 3;) {
+            if (text[i] == L'.') {
+                dots[found++] = i;
+            }
+        }
+        if (found < 2) {
+            return 0;
+        }
+        // example.co.uk: a two letter top level domain after a short second level label.
+        const bool secondLevel = length - dots[0] - 1 == 2 && dots[0] - dots[1] - 1 <= 3;
+        if (!secondLevel) {
+            return length - dots[1];
+        }
+        return found == 3 ? length - dots[2] : 0;
+    }
+}
+
+bool WinToastTextBudget::isAscii(_In_reads_(length) const wchar_t* text, _In_ std::size_t length) {
+    // A branch free reduction the compiler vectorizes.
+    wchar_t bits = 0;
+    for (std::size_t i = 0; i < length; i++) {
+        bits |= text[i];
+    }
+    return bits < 0x80;
+}
+
+bool WinToastTextBudget::isBoundary(_In_reads_(length) const wchar_t* text, _In_ std::size_t length, _In_ std::size_t position) {
+    if (position == 0 || position >= length) {
+        return true;
+    }
+
+    const wchar_t previous = text[position - 1];
+    const wchar_t current = text[position];
+    if ((previous == L'\r' && current == L'\n') || (isHighSurrogate(previous) && isLowSurrogate(current))
+        || previous == ZeroWidthJoiner || current == ZeroWidthJoiner || isExtend(current) || isEmojiModifier(text, length, position)) {
+        return false;
+    }
+    if (isRegionalIndicator(text, length, position)) {
+        // Indicators pair up from the start of their run, a cut after an odd count splits a flag.
+        std::size_t count = 0;
+        for (std::size_t i = position; i >= 2 && isRegionalIndicator(text, length, i - 2); i -= 2) {
+            count++;
+        }
+        return count % 2 == 0;
+    }
+    return true;
+}
+
+void WinToastTextBudget::shorten(_In_reads_(length) const wchar_t* text, _In_ std::size_t length, _In_ std::size_t budget,
+                                 _In_ Kind kind, _Out_ std::wstring& out) {
+    if (length <= budget && length <= MaxScan) {
+        out.assign(text, length);
+        return;
+    }
+    if (budget < MinHead + 1) {
+        out.assign(budget > 0 ? 1 : 0, Ellipsis);
+        return;
+    }
+
+    // Longer input is only read in a head and a tail window of MaxScan characters each.
+    budget = budget < MaxScan ? budget : MaxScan - 1;
+    const std::size_t tailWindow = length > MaxScan ? length - MaxScan : 0;
+    if (kind == Auto) {
+        kind = detect(text, length, MaxScan);
+    }
+    const std::size_t room = budget - 1;
+    std::size_t tail = kind != Plain ? tailLength(text, length, kind, room - MinHead) : 0;
+    if (tail == 0) {
+        tail = room / 2;
+    }
+    std::size_t head = room - tail;
+    std::size_t tailStart = length - tail;
+
+    if (!isAscii(text, head + 1) || !isAscii(text + tailStart - 1, tail + 1)) {
+        while (head > 0 && !isBoundary(text, length, head)) {
+            head--;
+        }
+        while (tailStart < length && !isBoundary(text + tailWindow, length - tailWindow, tailStart - tailWindow)) {
+            tailStart++;
+        }
+    } else {
+        // CR LF is the only ASCII sequence that must not be split.
+        if (text[head - 1] == L'\r' && text[head] == L'\n') {
+            head--;
+        }
+        if (text[tailStart - 1] == L'\r' && text[tailStart] == L'\n') {
+            tailStart++;
+        }
+    }
+
+    out.clear();
+    out.reserve(head + 1 + (length - tailStart));
+    out.append(text, head);
+    out += Ellipsis;
+    out.append(text + tailStart, length - tailStart);
+}
+
+void WinToastTextBudget::shorten(_In_z_ const wchar_t* text, _In_ std::size_t budget, _In_ Kind kind, _Out_ std::wstring& out) {
+    if (text == nullptr) {
+        out.clear();
+        return;
+    }
+    shorten(text, wcslen(text), budget, kind, out);
+}
@@ -0,0 +1,54 @@
+#ifndef TOAST_BUDGET_H
+#define TOAST_BUDGET_H
+
+#include <sal.h>
+#include <cstddef>
+#include <string>
+
+namespace WinToastLib {
+
+    /**
+     * Shortens text to what a toast can show before it is copied into a
+     * template.
+     *
+     * Windows clips long text at the end, which drops the executable name of
+     * a path and the registrable part of a domain. Text over budget is cut
+     * in the middle instead, keeping the head and a tail joined by an
+     * ellipsis. For paths the tail is the file name, for domains the last
+     * two labels, or three when the second to last one looks like a second
+     * level suffix such as co.uk. Cuts never split a surrogate pair,
+     * combining marks or variation selectors from their base, a ZWJ
+     * sequence, an emoji modifier or a regional indicator pair. Pure ASCII
+     * input skips those checks.
+     *
+     * Of longer input only the first and the last MaxScan characters are
+     * read, so the tail is still found and work and output are bounded by
+     * MaxScan and the budget whatever the input length. The overload for
+     * terminated strings has to find the length first.
+     * WinToast applies it to the text fields of every toast it prepares
+     * when enabled with setTextBudget.
+     */
+    class WinToastTextBudget {
+    public:
+        enum Kind {
+            Auto,       // Path or Domain if the text looks like one, otherwise Plain
+            Plain,
+            Path,
+            Domain
+        };
+
+        static constexpr std::size_t MaxScan = 32 * 1024;
+        static constexpr wchar_t Ellipsis = L'\x2026';
+
+        // budget is in UTF-16 code units. The output is never longer.
+        static void shorten(_In_reads_(length) const wchar_t* text, _In_ std::size_t length, _In_ std::size_t budget,
+                            _In_ Kind kind, _Out_ std::wstring& out);
+        static void shorten(_In_z_ const wchar_t* text, _In_ std::size_t budget, _In_ Kind kind, _Out_ std::wstring& out);
+
+        static bool isAscii(_In_reads_(length) const wchar_t* text, _In_ std::size_t length);
+        // Whether a cut at position may be made without splitting a character.
+        static bool isBoundary(_In_reads_(length) const wchar_t* text, _In_ std::size_t length, _In_ std::size_t position);
+    };
+}
+
+#endif // TOAST_BUDGET_H
@@ -0,0 +1,207 @@
+#include "toast_catalog.h"
+#include "toast_schema.h"
+#include <algorithm>
+#include <cwchar>
+#include <utility>
+
+using namespace WinToastLib;
+
+namespace {
+    const uint32_t Magic = 0x43544d50; // "PMTC"
+    const uint16_t Version = 1;
+    const std::size_t MaxActions = 5;
+    const std::size_t ScenarioCount = static_cast<std::size_t>(WinToastTemplate::Scenario::Reminder) + 1;
+
+    // Preference of an entry's language, higher is better.
+    int languageRank(_In_ LANGID entry, _In_ LANGID wanted) {
+        if (entry == wanted) return 3;
+        if (PRIMARYLANGID(entry) == PRIMARYLANGID(wanted)) return 2;
+        if (entry == LANG_NEUTRAL) return 1;
+        return 0;
+    }
+}
+
+WinToastCatalog::~WinToastCatalog() {
+    close();
+}
+
+bool WinToastCatalog::open(_In_ const std::wstring& path, _In_ LANGID language) {
+    WinToastMapping mapping;
+    if (!mapping.open(path, WinToastMapping::ReadOnly) || mapping.size() < sizeof(Header)
+        || !validate(static_cast<const uint8_t*>(mapping.data()), mapping.size())) {
+        return false;
+    }
+
+    const Header* header = static_cast<const Header*>(mapping.data());
+    std::lock_guard<std::mutex> lock(m_lock);
+    unmap();
+    m_mapping = std::move(mapping);
+    m_entries = reinterpret_cast<const Entry*>(header + 1);
+    m_strings = reinterpret_cast<const StringRef*>(m_entries + header->entryCount);
+    m_chars = reinterpret_cast<const wchar_t*>(m_strings + header->stringCount);
+    m_entryCount = header->entryCount;
+    m_language = language;
+    return true;
+}
+
+void WinToastCatalog::close() {
+    std::lock_guard<std::mutex> lock(m_lock);
+    unmap();
+}
+
+bool WinToastCatalog::isOpen() const {
+    std::lock_guard<std::mutex> lock(m_lock);
+    return m_mapping.isOpen();
+}
+
+bool WinToastCatalog::render(_In_ uint32_t templateId, _In_reads_(count) const Argument* arguments, _In_ std::size_t count,
+                             _Out_ WinToastTemplate& toast) const {
+    if (count > MaxArguments || (count > 0 && arguments == nullptr)) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(m_lock);
+    const Entry* entry = find(templateId);
+    if (entry == nullptr) {
+        return false;
+    }
+
+    toast = WinToastTemplate(static_cast<WinToastTemplate::WinToastTemplateType>(entry->type));
+    toast.setScenario(static_cast<WinToastTemplate::Scenario>(entry->scenario));
+
+    const StringRef* strings = m_strings + entry->firstString;
+    std::wstring text;
+    for (std::size_t i = 0; i < entry->textCount; i++) {
+        expand(*strings++, arguments, count, text);
+        toast.setTextField(text, static_cast<WinToastTemplate::TextField>(i));
+    }
+    for (std::size_t i = 0; i < entry->actionCount; i++) {
+        expand(*strings++, arguments, count, text);
+        toast.addAction(text);
+    }
+    if (entry->flags & HasAttribution) {
+        expand(*strings++, arguments, count, text);
+        toast.setAttributionText(text);
+    }
+    if (entry->flags & HasImage) {
+        expand(*strings++, arguments, count, text);
+        toast.setImagePath(text);
+    }
+    return true;
+}
+
+std::size_t WinToastCatalog::stringCount(_In_ const Entry& entry) {
+    return static_cast<std::size_t>(entry.textCount) + entry.actionCount
+         + ((entry.flags & HasAttribution) ? 1 : 0) + ((entry.flags & HasImage) ? 1 : 0);
+}
+
+void WinToastCatalog::unmap() {
+    m_mapping.close();
+    m_entries = nullptr;
+    m_strings = nullptr;
+    m_chars = nullptr;
+    m_entryCount = 0;
+}
+
+// Checks everything render relies on once, so rendering needs no bounds checks.
+bool WinToastCatalog::validate(_In_reads_bytes_(size) const uint8_t* view, _In_ ULONGLONG size) {
+    const Header* header = reinterpret_cast<const Header*>(view);
+    if (header->magic != Magic || header->version != Version) {
+        return false;
+    }
+
+    const ULONGLONG required = sizeof(Header) + static_cast<ULONGLONG>(header->entryCount) * sizeof(Entry)
+                             + static_cast<ULONGLONG>(header->stringCount) * sizeof(StringRef)
+                             + static_cast<ULONGLONG>(header->charCount) * sizeof(wchar_t);
+    if (required > size) {
+        return false;
+    }
+
+    const Entry* entries = reinterpret_cast<const Entry*>(header + 1);
+    const StringRef* strings = reinterpret_cast<const StringRef*>(entries + header->entryCount);
+    for (uint32_t i = 0; i < header->stringCount; i++) {
+        if (static_cast<ULONGLONG>(strings[i].offset) + strings[i].length > header->charCount) {
+            return false;
+        }
+    }
+
+    for (uint32_t i = 0; i < header->entryCount; i++) {
+        const Entry& entry = entries[i];
+        const auto type = static_cast<WinToastTemplate::WinToastTemplateType>(entry.type);
+        if (!ToastSchema::isValid(type) || entry.textCount > ToastSchema::textFieldsCount(type) || entry.actionCount > MaxActions
+            || entry.scenario >= ScenarioCount
+            || static_cast<ULONGLONG>(entry.firstString) + stringCount(entry) > header->stringCount) {
+            return false;
+        }
+        if (i > 0 && (entries[i - 1].id > entry.id || (entries[i - 1].id == entry.id && entries[i - 1].language >= entry.language))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+const WinToastCatalog::Entry* WinToastCatalog::find(_In_ uint32_t templateId) const {
+    std::size_t low = 0;
+    std::size_t high = m_entryCount;
+    while (low < high) {
+        const std::size_t middle = low + (high - low) / 2;
+        if (m_entries[middle].id < templateId) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    const Entry* best = nullptr;
+    int bestRank = -1;
+    for (std::size_t i = low; i < m_entryCount && m_entries[i].id == templateId; i++) {
+        const int rank = languageRank(m_entries[i].language, m_language);
+        if (rank > bestRank) {
+            best = m_entries + i;
+            bestRank = rank;
+        }
+    }
+    return best;
+}
+
+void WinToastCatalog::expand(_In_ const StringRef& pattern, _In_reads_(count) const Argument* arguments, _In_ std::size_t count,
+                             _Out_ std::wstring& text) const {
+    const wchar_t* it = m_chars + pattern.offset;
+    const wchar_t* const end = it + pattern.length;
+    text.clear();
+    text.reserve(pattern.length);
+
+    while (it < end) {
+        const wchar_t* open = std::find(it, end, L'{');
+        text.append(it, open);
+        if (open == end) {
+            break;
+        }
+        if (open + 1 < end && open[1] == L'{') {
+            text += L'{';
+            it = open + 2;
+            continue;
+        }
+
+        const wchar_t* close = std::find(open + 1, end, L'}');
+        if (close == end) {
+            text.append(open, end);
+            break;
+        }
+
+        const std::size_t nameLength = static_cast<std::size_t>(close - open - 1);
+        const Argument* argument = nullptr;
+        for (std::size_t i = 0; i < count && argument == nullptr; i++) {
+            if (arguments[i].name != nullptr && wcsncmp(arguments[i].name, open + 1, nameLength) == 0
+                && arguments[i].name[nameLength] == L'\0') {
+                argument = arguments + i;
+            }
+        }
+        if (argument != nullptr && argument->value != nullptr) {
+            text += argument->value;
+        } else {
+            text.append(open, close + 1);
+        }
+        it = close + 1;
+    }
+}
@@ -0,0 +1,105 @@
+#ifndef TOAST_CATALOG_H
+#define TOAST_CATALOG_H
+
+#include <Windows.h>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include "toast_mapping.h"
+#include "toast_template.h"
+
+namespace WinToastLib {
+
+    /**
+     * Read-only catalog of parameterized, localized toast templates.
+     *
+     * The catalog file is mapped once and never copied. Each entry describes
+     * a toast (template type, scenario, texts, buttons and optional
+     * attribution and image) whose strings may contain placeholders such as
+     * {app} or {domain}. Rendering an entry only fills those slots with the
+     * caller's arguments, so a toast is requested by template Id and a few
+     * short values instead of all of its strings. "{{" renders as "{",
+     * placeholders without an argument are kept as they are.
+     *
+     * File layout, little endian:
+     *   Header
+     *   Entry[entryCount]       sorted by id, then language
+     *   StringRef[stringCount]
+     *   wchar_t[charCount]      UTF-16 strings on Windows, not terminated
+     * The strings of an entry are consecutive StringRefs starting at
+     * firstString: the texts, the button labels, then the attribution and
+     * the image path if the respective flag is set.
+     */
+    class WinToastCatalog {
+    public:
+        static constexpr std::size_t MaxArguments = 16;
+
+        struct Argument {
+            PCWSTR name;
+            PCWSTR value;
+        };
+
+        WinToastCatalog() = default;
+        ~WinToastCatalog();
+        WinToastCatalog(const WinToastCatalog&) = delete;
+        WinToastCatalog& operator=(const WinToastCatalog&) = delete;
+
+        // Maps the catalog file, replacing a previously opened one only if the file is valid.
+        // Entries of language are preferred, then those of its primary language, then neutral ones.
+        bool open(_In_ const std::wstring& path, _In_ LANGID language);
+        void close();
+        bool isOpen() const;
+
+        bool render(_In_ uint32_t templateId, _In_reads_(count) const Argument* arguments, _In_ std::size_t count,
+                    _Out_ WinToastTemplate& toast) const;
+
+    private:
+        enum Flags : uint8_t {
+            HasAttribution = 1,
+            HasImage = 2
+        };
+
+        struct Header {
+            uint32_t magic;
+            uint16_t version;
+            uint16_t entryCount;
+            uint32_t stringCount;
+            uint32_t charCount;
+        };
+
+        struct Entry {
+            uint32_t id;
+            uint16_t language;
+            uint8_t type;
+            uint8_t scenario;
+            uint8_t textCount;
+            uint8_t actionCount;
+            uint8_t flags;
+            uint8_t reserved;
+            uint32_t firstString;
+        };
+
+        struct StringRef {
+            uint32_t offset;        // in characters
+            uint32_t length;
+        };
+
+        static std::size_t stringCount(_In_ const Entry& entry);
+        void unmap();
+        static bool validate(_In_reads_bytes_(size) const uint8_t* view, _In_ ULONGLONG size);
+        const Entry* find(_In_ uint32_t templateId) const;
+        void expand(_In_ const StringRef& pattern, _In_reads_(count) const Argument* arguments, _In_ std::size_t count,
+                    _Out_ std::wstring& text) const;
+
+        mutable std::mutex      m_lock;
+        WinToastMapping         m_mapping;
+        const Entry*            m_entries{nullptr};
+        const StringRef*        m_strings{nullptr};
+        const wchar_t*          m_chars{nullptr};
+        uint32_t                m_entryCount{0};
+        LANGID                  m_language{0};
+    };
+}
+
+#endif // TOAST_CATALOG_H
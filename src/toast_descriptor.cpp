@@ -0,0 +1,224 @@
+#include "toast_descriptor.h"
+#include "toast_arguments.h"
+#include "toast_schema.h"
+#include <cwchar>
+
+using namespace WinToastLib;
+
+namespace {
+    const wchar_t EmptyText[] = L"";
+
+    bool isAligned(_In_ const void* data) {
+        return reinterpret_cast<uintptr_t>(data) % alignof(WinToastDescriptor::Header) == 0;
+    }
+
+    const std::wstring& fieldValue(_In_ const WinToastTemplate& toast, _In_ std::size_t field) {
+        switch (field) {
+        case WinToastDescriptor::Image:           return toast.imagePath();
+        case WinToastDescriptor::Audio:           return toast.audioPath();
+        case WinToastDescriptor::Attribution:     return toast.attributionText();
+        case WinToastDescriptor::ActivationToken: return toast.activationToken();
+        case WinToastDescriptor::Group:           return toast.group();
+        default:                                  return toast.key();
+        }
+    }
+}
+
+std::size_t WinToastDescriptor::measure(_In_ const WinToastTemplate& toast) {
+    if (toast.actionsCount() > MaxActions) {
+        return 0;
+    }
+
+    std::size_t chars = 0;
+    for (const auto& text : toast.textFields()) {
+        chars += text.size() + 1;
+    }
+    for (std::size_t i = 0; i < toast.actionsCount(); i++) {
+        chars += toast.actionLabel(i).size() + 1;
+    }
+    for (std::size_t i = 0; i < FieldCount; i++) {
+        chars += fieldValue(toast, i).size() + 1;
+    }
+
+    const std::size_t strings = toast.textFieldsCount() + toast.actionsCount() + FieldCount;
+    const std::size_t size = sizeof(Header) + strings * sizeof(StringRef) + chars * sizeof(wchar_t);
+    return size <= MaxSize ? size : 0;
+}
+
+std::size_t WinToastDescriptor::write(_In_ const WinToastTemplate& toast, _Out_writes_bytes_(capacity) uint8_t* buffer, _In_ std::size_t capacity) {
+    const std::size_t size = measure(toast);
+    if (size == 0 || size > capacity || buffer == nullptr || !isAligned(buffer)) {
+        return 0;
+    }
+
+    Header* header = reinterpret_cast<Header*>(buffer);
+    header->magic = Magic;
+    header->version = Version;
+    header->headerSize = sizeof(Header);
+    header->size = static_cast<uint32_t>(size);
+    header->type = static_cast<uint8_t>(toast.type());
+    header->audioOption = static_cast<uint8_t>(toast.audioOption());
+    header->duration = static_cast<uint8_t>(toast.duration());
+    header->scenario = static_cast<uint8_t>(toast.scenario());
+    header->priority = static_cast<uint8_t>(toast.priority());
+    header->textCount = static_cast<uint8_t>(toast.textFieldsCount());
+    header->actionCount = static_cast<uint8_t>(toast.actionsCount());
+    header->flags = 0;
+    header->reserved = 0;
+    header->expiration = toast.expiration();
+    header->stringCount = static_cast<uint32_t>(toast.textFieldsCount() + toast.actionsCount() + FieldCount);
+
+    StringRef* strings = reinterpret_cast<StringRef*>(header + 1);
+    wchar_t* const chars = reinterpret_cast<wchar_t*>(strings + header->stringCount);
+    uint32_t offset = 0;
+    auto append = [&strings, chars, &offset](const std::wstring& value) {
+        strings->offset = offset;
+        strings->length = static_cast<uint32_t>(value.size());
+        strings++;
+        wmemcpy(chars + offset, value.c_str(), value.size() + 1);
+        offset += static_cast<uint32_t>(value.size() + 1);
+    };
+    for (const auto& text : toast.textFields()) {
+        append(text);
+    }
+    for (std::size_t i = 0; i < toast.actionsCount(); i++) {
+        append(toast.actionLabel(i));
+    }
+    for (std::size_t i = 0; i < FieldCount; i++) {
+        append(fieldValue(toast, i));
+    }
+    header->charCount = offset;
+    return size;
+}
+
+bool WinToastDescriptor::write(_In_ const WinToastTemplate& toast, _Out_ std::vector<uint8_t>& buffer) {
+    // operator new aligns the storage for the header.
+    const std::size_t size = measure(toast);
+    buffer.clear();
+    if (size == 0) {
+        return false;
+    }
+    buffer.resize(size);
+    return write(toast, buffer.data(), buffer.size()) == size;
+}
+
+// Checks everything the accessors rely on once, so reading needs no bounds checks.
+bool WinToastDescriptor::open(_In_reads_bytes_(size) const void* data, _In_ std::size_t size) {
+    m_header = nullptr;
+    if (data == nullptr || size < sizeof(Header) || !isAligned(data)) {
+        return false;
+    }
+
+    const Header* header = static_cast<const Header*>(data);
+    const auto type = static_cast<WinToastTemplate::WinToastTemplateType>(header->type);
+    if (header->magic != Magic || header->version != Version || header->headerSize != sizeof(Header)
+        || header->flags != 0 || header->reserved != 0
+        || !ToastSchema::isValid(type) || header->textCount > ToastSchema::textFieldsCount(type) || header->actionCount > MaxActions
+        || header->audioOption > WinToastTemplate::AudioOption::Loop || header->duration > WinToastTemplate::Duration::Long
+        || header->scenario > static_cast<uint8_t>(WinToastTemplate::Scenario::Reminder) || header->priority > WinToastTemplate::High
+        || header->stringCount != static_cast<uint32_t>(header->textCount) + header->actionCount + FieldCount) {
+        return false;
+    }
+
+    const uint64_t required = sizeof(Header) + static_cast<uint64_t>(header->stringCount) * sizeof(StringRef)
+                             + static_cast<uint64_t>(header->charCount) * sizeof(wchar_t);
+    if (required != header->size || required > size || required > MaxSize) {
+        return false;
+    }
+
+    const StringRef* strings = reinterpret_cast<const StringRef*>(header + 1);
+    const wchar_t* chars = reinterpret_cast<const wchar_t*>(strings + header->stringCount);
+    for (uint32_t i = 0; i < header->stringCount; i++) {
+        const uint64_t end = static_cast<uint64_t>(strings[i].offset) + strings[i].length;
+        if (end >= header->charCount || chars[end] != L'\0') {
+            return false;
+        }
+    }
+    // A template cannot hold a longer token, toTemplate would have to cut it.
+    if (strings[static_cast<std::size_t>(header->textCount) + header->actionCount + ActivationToken].length > WinToastArguments::MaxTokenLength) {
+        return false;
+    }
+
+    m_header = header;
+    m_strings = strings;
+    m_chars = chars;
+    return true;
+}
+
+WinToastTemplate::WinToastTemplateType WinToastDescriptor::type() const {
+    return static_cast<WinToastTemplate::WinToastTemplateType>(m_header->type);
+}
+
+WinToastTemplate::AudioOption WinToastDescriptor::audioOption() const {
+    return static_cast<WinToastTemplate::AudioOption>(m_header->audioOption);
+}
+
+WinToastTemplate::Duration WinToastDescriptor::duration() const {
+    return static_cast<WinToastTemplate::Duration>(m_header->duration);
+}
+
+WinToastTemplate::Scenario WinToastDescriptor::scenario() const {
+    return static_cast<WinToastTemplate::Scenario>(m_header->scenario);
+}
+
+WinToastTemplate::Priority WinToastDescriptor::priority() const {
+    return static_cast<WinToastTemplate::Priority>(m_header->priority);
+}
+
+int64_t WinToastDescriptor::expiration() const {
+    return m_header->expiration;
+}
+
+WinToastDescriptor::Text WinToastDescriptor::textField(_In_ WinToastTemplate::TextField pos) const {
+    const auto index = static_cast<std::size_t>(pos);
+    return index < m_header->textCount ? string(index) : Text{EmptyText, 0};
+}
+
+WinToastDescriptor::Text WinToastDescriptor::actionLabel(_In_ std::size_t pos) const {
+    return pos < m_header->actionCount ? string(m_header->textCount + pos) : Text{EmptyText, 0};
+}
+
+WinToastDescriptor::Text WinToastDescriptor::field(_In_ Field field) const {
+    return field < FieldCount ? string(static_cast<std::size_t>(m_header->textCount) + m_header->actionCount + field) : Text{EmptyText, 0};
+}
+
+void WinToastDescriptor::toTemplate(_Out_ WinToastTemplate& toast) const {
+    toast = WinToastTemplate(type());
+    for (std::size_t i = 0; i < m_header->textCount; i++) {
+        const Text text = string(i);
+        toast.setTextField(std::wstring(text.data, text.length), static_cast<WinToastTemplate::TextField>(i));
+    }
+    for (std::size_t i = 0; i < m_header->actionCount; i++) {
+        const Text label = actionLabel(i);
+        toast.addAction(std::wstring(label.data, label.length));
+    }
+
+    Text text = field(Image);
+    if (text.length > 0) {
+        toast.setImagePath(std::wstring(text.data, text.length));
+    }
+    text = field(Audio);
+    if (text.length > 0) {
+        toast.setAudioPath(std::wstring(text.data, text.length));
+    }
+    text = field(Attribution);
+    toast.setAttributionText(std::wstring(text.data, text.length));
+    text = field(ActivationToken);
+    toast.setActivationToken(std::wstring(text.data, text.length));
+    text = field(Group);
+    toast.setGroup(std::wstring(text.data, text.length));
+    text = field(Key);
+    toast.setKey(std::wstring(text.data, text.length));
+
+    toast.setAudioOption(audioOption());
+    toast.setDuration(duration());
+    toast.setScenario(scenario());
+    toast.setPriority(priority());
+    if (expiration() > 0) {
+        toast.setExpiration(expiration());
+    }
+}
+
+WinToastDescriptor::Text WinToastDescriptor::string(_In_ std::size_t index) const {
+    return Text{m_chars + m_strings[index].offset, m_strings[index].length};
+}
@@ -0,0 +1,116 @@
+#ifndef TOAST_DESCRIPTOR_H
+#define TOAST_DESCRIPTOR_H
+
+#include <sal.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "toast_template.h"
+
+namespace WinToastLib {
+
+    /**
+     * Flat binary description of a complete toast.
+     *
+     * A descriptor carries a toast as one buffer across the C API or to
+     * another process, instead of one call per string. It is checked once
+     * by open, after which all fields are read in place without allocating.
+     * Only copying it into a WinToastTemplate allocates. write produces
+     * exactly the bytes that open accepts, and a template written and
+     * copied back is equal to the original.
+     *
+     * Layout, little endian, the buffer aligned to 8 bytes:
+     *   Header
+     *   StringRef[stringCount]  texts, button labels, then one per Field
+     *   wchar_t[charCount]      UTF-16 strings, each zero terminated
+     */
+    class WinToastDescriptor {
+    public:
+        enum Field : uint32_t {
+            Image,
+            Audio,
+            Attribution,
+            ActivationToken,
+            Group,
+            Key,
+            FieldCount
+        };
+
+        struct Header {
+            uint32_t magic;
+            uint16_t version;
+            uint16_t headerSize;
+            uint32_t size;          // bytes of the whole descriptor
+            uint8_t  type;
+            uint8_t  audioOption;
+            uint8_t  duration;
+            uint8_t  scenario;
+            uint8_t  priority;
+            uint8_t  textCount;
+            uint8_t  actionCount;
+            uint8_t  flags;         // none defined, must be 0
+            uint32_t reserved;      // must be 0, keeps expiration aligned without implicit padding
+            int64_t  expiration;    // ms from showing, 0 for none
+            uint32_t stringCount;   // textCount + actionCount + FieldCount
+            uint32_t charCount;
+        };
+
+        struct StringRef {
+            uint32_t offset;        // in characters from the start of the strings
+            uint32_t length;        // in characters, without the terminator
+        };
+
+        // A string inside the descriptor buffer, valid as long as the buffer.
+        struct Text {
+            const wchar_t*  data;
+            std::size_t     length;
+        };
+
+        static constexpr uint32_t Magic = 0x44544d50; // "PMTD"
+        static constexpr uint16_t Version = 1;
+        static constexpr std::size_t MaxSize = 1 << 20;
+        static constexpr std::size_t MaxActions = 5;
+
+        // Bytes write needs for the template, 0 if it cannot be described.
+        static std::size_t measure(_In_ const WinToastTemplate& toast);
+        // Returns the bytes written, 0 if the buffer is too small or not aligned.
+        static std::size_t write(_In_ const WinToastTemplate& toast, _Out_writes_bytes_(capacity) uint8_t* buffer, _In_ std::size_t capacity);
+        static bool write(_In_ const WinToastTemplate& toast, _Out_ std::vector<uint8_t>& buffer);
+
+        WinToastDescriptor() = default;
+
+        // Checks the whole descriptor. The buffer is not copied and must outlive the view.
+        bool open(_In_reads_bytes_(size) const void* data, _In_ std::size_t size);
+        bool isOpen() const { return m_header != nullptr; }
+        std::size_t size() const { return m_header->size; }
+
+        WinToastTemplate::WinToastTemplateType type() const;
+        WinToastTemplate::AudioOption audioOption() const;
+        WinToastTemplate::Duration duration() const;
+        WinToastTemplate::Scenario scenario() const;
+        WinToastTemplate::Priority priority() const;
+        int64_t expiration() const;
+
+        std::size_t textFieldsCount() const { return m_header->textCount; }
+        std::size_t actionsCount() const { return m_header->actionCount; }
+        // Empty for positions beyond the count.
+        Text textField(_In_ WinToastTemplate::TextField pos) const;
+        Text actionLabel(_In_ std::size_t pos) const;
+        Text field(_In_ Field field) const;
+
+        void toTemplate(_Out_ WinToastTemplate& toast) const;
+
+    private:
+        Text string(_In_ std::size_t index) const;
+
+        const Header*       m_header{nullptr};
+        const StringRef*    m_strings{nullptr};
+        const wchar_t*      m_chars{nullptr};
+    };
+
+    static_assert(sizeof(WinToastDescriptor::Header) == 40, "descriptor header is part of the format");
+    static_assert(offsetof(WinToastDescriptor::Header, expiration) == 24, "descriptor header has no implicit padding");
+    static_assert(sizeof(WinToastDescriptor::StringRef) == 8, "descriptor strings are part of the format");
+}
+
+#endif // TOAST_DESCRIPTOR_H
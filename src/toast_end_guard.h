@@ -0,0 +1,36 @@
+#ifndef TOAST_END_GUARD_H
+#define TOAST_END_GUARD_H
+
+#include <sal.h>
+#include <atomic>
+
+namespace WinToastLib {
+
+    /**
+     * Lets the handler of a toast report its end once.
+     *
+     * WinRT may raise Dismissed and Failed for the same notification, and a
+     * hide races the user's own dismissal of it. A dismissal for another
+     * reason than TimedOut and a failure end the toast: the first one is
+     * reported, later ones are dropped. A timed out toast moves to the
+     * Action Center and may still be activated or dismissed there, so
+     * TimedOut is reported while the toast has not ended and does not end it.
+     * Safe to call from any thread.
+     */
+    class WinToastEndGuard {
+    public:
+        // Whether a dismissal is to be reported.
+        bool dismissed(_In_ bool timedOut) {
+            return timedOut ? !m_ended.load() : !m_ended.exchange(true);
+        }
+        // Whether a failure is to be reported.
+        bool failed() {
+            return !m_ended.exchange(true);
+        }
+
+    private:
+        std::atomic<bool> m_ended{false};
+    };
+}
+
+#endif // TOAST_END_GUARD_H
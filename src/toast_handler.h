@@ -0,0 +1,24 @@
+#ifndef TOAST_HANDLER_H
+#define TOAST_HANDLER_H
+
+#include "toast_registry.h"
+
+namespace WinToastLib {
+
+    // Receives the events of one toast, on the threads WinRT raises them on.
+    class IWinToastHandler {
+    public:
+        enum WinToastDismissalReason {
+            UserCanceled = WinToastRegistry::UserCanceled,
+            ApplicationHidden = WinToastRegistry::ApplicationHidden,
+            TimedOut = WinToastRegistry::TimedOut
+        };
+        virtual ~IWinToastHandler() = default;
+        virtual void toastActivated() const = 0;
+        virtual void toastActivated(int actionIndex) const = 0;
+        virtual void toastDismissed(WinToastDismissalReason state) const = 0;
+        virtual void toastFailed() const = 0;
+    };
+}
+
+#endif // TOAST_HANDLER_H
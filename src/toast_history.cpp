@@ -0,0 +1,128 @@
+#include "toast_history.h"
+#include <cstring>
+#include <utility>
+
+using namespace WinToastLib;
+
+namespace {
+    const uint32_t Magic = 0x48544d50; // "PMTH"
+    const uint16_t Version = 1;
+
+    volatile LONG64* sequenceOf(WinToastHistory::Record& record) {
+        return reinterpret_cast<volatile LONG64*>(&record.sequence);
+    }
+
+    uint64_t loadSequence(WinToastHistory::Record& record) {
+        // Interlocked compare with equal values is a plain load with full barrier semantics.
+        return static_cast<uint64_t>(InterlockedCompareExchange64(sequenceOf(record), 0, 0));
+    }
+}
+
+WinToastHistory::~WinToastHistory() {
+    close();
+}
+
+bool WinToastHistory::open(_In_ const std::wstring& path, _In_ uint32_t capacity) {
+    std::lock_guard<std::mutex> lock(m_openLock);
+    if (m_header.load() != nullptr || path.empty() || capacity == 0 || capacity > MaxCapacity) {
+        return false;
+    }
+
+    const uint64_t bytes = sizeof(Header) + static_cast<uint64_t>(capacity) * sizeof(Record);
+    WinToastMapping mapping;
+    bool resized = false;
+    if (!mapping.open(path, WinToastMapping::ReadWrite, bytes, &resized)) {
+        return false;
+    }
+
+    void* view = mapping.data();
+    Header* header = static_cast<Header*>(view);
+    if (resized || header->magic != Magic || header->version != Version || header->recordSize != sizeof(Record)
+        || header->capacity != capacity) {
+        // The magic is written last so a crash during the reset leaves a file that is reset again.
+        header->magic = 0;
+        std::memset(view, 0, static_cast<std::size_t>(bytes));
+        header->version = Version;
+        header->recordSize = sizeof(Record);
+        header->capacity = capacity;
+        header->next = 0;
+        MemoryBarrier();
+        header->magic = Magic;
+    }
+
+    m_mapping = std::move(mapping);
+    m_records = reinterpret_cast<Record*>(header + 1);
+    m_header.store(header, std::memory_order_release);
+    return true;
+}
+
+bool WinToastHistory::isOpen() const {
+    return m_header.load(std::memory_order_acquire) != nullptr;
+}
+
+uint64_t WinToastHistory::mappedBytes() const {
+    const Header* header = m_header.load(std::memory_order_acquire);
+    return header != nullptr ? sizeof(Header) + static_cast<uint64_t>(header->capacity) * sizeof(Record) : 0;
+}
+
+void WinToastHistory::write(_In_ Outcome outcome, _In_ int64_t toastId, _In_ uint64_t contentHash, _In_ int32_t value) {
+    Header* header = m_header.load(std::memory_order_acquire);
+    if (header == nullptr) {
+        return;
+    }
+
+    const uint64_t position = static_cast<uint64_t>(InterlockedIncrement64(&header->next)) - 1;
+    Record& slot = m_records[position % header->capacity];
+    InterlockedExchange64(sequenceOf(slot), 0);
+
+    FILETIME now;
+    GetSystemTimeAsFileTime(&now);
+    slot.toastId = toastId;
+    slot.contentHash = contentHash;
+    slot.timestamp = (static_cast<uint64_t>(now.dwHighDateTime) << 32) | now.dwLowDateTime;
+    slot.outcome = outcome;
+    slot.value = value;
+
+    InterlockedExchange64(sequenceOf(slot), static_cast<LONG64>(position + 1));
+}
+
+std::size_t WinToastHistory::read(_Out_writes_(capacity) Record* records, _In_ std::size_t capacity) const {
+    Header* header = m_header.load(std::memory_order_acquire);
+    if (header == nullptr || records == nullptr || capacity == 0) {
+        return 0;
+    }
+
+    const uint64_t next = static_cast<uint64_t>(InterlockedCompareExchange64(&header->next, 0, 0));
+    const uint64_t ring = header->capacity;
+    uint64_t first = next > ring ? next - ring : 0;
+    if (next - first > capacity) {
+        first = next - capacity;
+    }
+
+    std::size_t count = 0;
+    for (uint64_t position = first; position < next; position++) {
+        Record& slot = m_records[position % ring];
+        if (loadSequence(slot) != position + 1) {
+            continue;
+        }
+        records[count] = slot;
+        if (loadSequence(slot) != position + 1) {
+            // Overwritten while copying.
+            continue;
+        }
+        records[count].sequence = position + 1;
+        count++;
+    }
+    return count;
+}
+
+void WinToastHistory::close() {
+    std::lock_guard<std::mutex> lock(m_openLock);
+    Header* header = m_header.exchange(nullptr);
+    if (header == nullptr) {
+        return;
+    }
+
+    m_mapping.close();
+    m_records = nullptr;
+}
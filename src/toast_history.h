@@ -0,0 +1,79 @@
+#ifndef TOAST_HISTORY_H
+#define TOAST_HISTORY_H
+
+#include <Windows.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include "toast_mapping.h"
+
+namespace WinToastLib {
+
+    /**
+     * Persistent history of shown notifications and their outcomes.
+     *
+     * Records are appended to a fixed-size ring inside a memory-mapped file,
+     * so the history survives a restart of the process and the newest
+     * records overwrite the oldest ones. Writers claim a slot with an
+     * interlocked increment and publish it by storing its sequence number
+     * last; a slot whose sequence does not match its position was torn by a
+     * crash or is being rewritten and is skipped when reading.
+     */
+    class WinToastHistory {
+    public:
+        enum Outcome {
+            Shown = 1,
+            Activated,
+            Dismissed,
+            Failed
+        };
+
+        struct Record {
+            uint64_t sequence;      // position in the ring + 1, 0 while being written
+            int64_t toastId;
+            uint64_t contentHash;
+            uint64_t timestamp;     // FILETIME, UTC
+            int32_t outcome;
+            int32_t value;          // action index, dismissal reason or HRESULT depending on outcome
+        };
+
+        static constexpr uint32_t MaxCapacity = 1 << 20;
+
+        WinToastHistory() = default;
+        ~WinToastHistory();
+        WinToastHistory(const WinToastHistory&) = delete;
+        WinToastHistory& operator=(const WinToastHistory&) = delete;
+
+        // Opens or creates the ring file. An existing file with a different layout or capacity is reset.
+        bool open(_In_ const std::wstring& path, _In_ uint32_t capacity);
+        bool isOpen() const;
+        // Size of the mapped ring file, zero if the history is not open.
+        uint64_t mappedBytes() const;
+
+        void write(_In_ Outcome outcome, _In_ int64_t toastId, _In_ uint64_t contentHash = 0, _In_ int32_t value = 0);
+
+        // Copies up to capacity committed records, oldest first. Returns the number of records copied.
+        std::size_t read(_Out_writes_(capacity) Record* records, _In_ std::size_t capacity) const;
+
+    private:
+        struct Header {
+            uint32_t magic;
+            uint16_t version;
+            uint16_t recordSize;
+            uint32_t capacity;
+            uint32_t reserved;
+            volatile LONG64 next;
+        };
+
+        void close();
+
+        std::mutex              m_openLock;
+        WinToastMapping         m_mapping;
+        std::atomic<Header*>    m_header{nullptr};
+        Record*                 m_records{nullptr};
+    };
+}
+
+#endif // TOAST_HISTORY_H
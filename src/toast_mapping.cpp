@@ -0,0 +1,366 @@
+#include "toast_mapping.h"
+#include "toast_path.h"
+#include <utility>
+#ifndef _WIN32
+#include <cerrno>
+#include <ctime>
+#include <fcntl.h>
+#include <semaphore.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace WinToastLib;
+
+#ifndef _WIN32
+namespace {
+    // Names of shared memory and semaphores are a single path component after the slash.
+    std::string sharedName(_In_ const std::wstring& name) {
+        std::string native = nativePath(name);
+        for (char& c : native) {
+            if (c == '/') {
+                c = '_';
+            }
+        }
+        return "/" + native;
+    }
+}
+#endif
+
+WinToastMapping::~WinToastMapping() {
+    close();
+}
+
+WinToastMapping::WinToastMapping(WinToastMapping&& other) noexcept {
+    *this = std::move(other);
+}
+
+WinToastMapping& WinToastMapping::operator=(WinToastMapping&& other) noexcept {
+    if (this != &other) {
+        close();
+        std::swap(m_view, other.m_view);
+        std::swap(m_size, other.m_size);
+#ifdef _WIN32
+        std::swap(m_file, other.m_file);
+        std::swap(m_mapping, other.m_mapping);
+#else
+        std::swap(m_sharedName, other.m_sharedName);
+#endif
+    }
+    return *this;
+}
+
+#ifdef _WIN32
+
+bool WinToastMapping::open(_In_ const std::wstring& path, _In_ Access access, _In_ uint64_t size, _Out_opt_ bool* resized) {
+    close();
+    if (resized != nullptr) {
+        *resized = false;
+    }
+    const bool write = access == ReadWrite;
+    HANDLE file = CreateFileW(path.c_str(), write ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ, FILE_SHARE_READ, nullptr,
+                              write ? OPEN_ALWAYS : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    LARGE_INTEGER length;
+    if (!GetFileSizeEx(file, &length)) {
+        CloseHandle(file);
+        return false;
+    }
+    if (size != 0 && static_cast<uint64_t>(length.QuadPart) != size) {
+        length.QuadPart = static_cast<LONGLONG>(size);
+        if (!write || !SetFilePointerEx(file, length, nullptr, FILE_BEGIN) || !SetEndOfFile(file)) {
+            CloseHandle(file);
+            return false;
+        }
+        if (resized != nullptr) {
+            *resized = true;
+        }
+    }
+    if (length.QuadPart == 0 || static_cast<ULONGLONG>(length.QuadPart) > SIZE_MAX) {
+        CloseHandle(file);
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingW(file, nullptr, write ? PAGE_READWRITE : PAGE_READONLY, 0, 0, nullptr);
+    void* view = mapping != nullptr ? MapViewOfFile(mapping, write ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (view == nullptr) {
+        if (mapping != nullptr) {
+            CloseHandle(mapping);
+        }
+        CloseHandle(file);
+        return false;
+    }
+
+    m_file = file;
+    m_mapping = mapping;
+    m_view = view;
+    m_size = static_cast<uint64_t>(length.QuadPart);
+    return true;
+}
+
+bool WinToastMapping::createShared(_In_ const std::wstring& name, _In_ uint64_t size) {
+    close();
+    if (name.empty() || size == 0 || size > SIZE_MAX) {
+        return false;
+    }
+    HANDLE mapping = CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, static_cast<DWORD>(size >> 32),
+                                        static_cast<DWORD>(size), name.c_str());
+    if (mapping == nullptr) {
+        return false;
+    }
+    if (GetLastError() == ERROR_ALREADY_EXISTS) {
+        CloseHandle(mapping);
+        return false;
+    }
+
+    void* view = MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, static_cast<SIZE_T>(size));
+    if (view == nullptr) {
+        CloseHandle(mapping);
+        return false;
+    }
+    m_mapping = mapping;
+    m_view = view;
+    m_size = size;
+    return true;
+}
+
+bool WinToastMapping::openShared(_In_ const std::wstring& name, _In_ uint64_t size) {
+    close();
+    if (name.empty() || size == 0 || size > SIZE_MAX) {
+        return false;
+    }
+    HANDLE mapping = OpenFileMappingW(FILE_MAP_WRITE, FALSE, name.c_str());
+    if (mapping == nullptr) {
+        return false;
+    }
+
+    void* view = MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, static_cast<SIZE_T>(size));
+    if (view == nullptr) {
+        CloseHandle(mapping);
+        return false;
+    }
+    m_mapping = mapping;
+    m_view = view;
+    m_size = size;
+    return true;
+}
+
+void WinToastMapping::close() {
+    if (m_view != nullptr) {
+        UnmapViewOfFile(m_view);
+    }
+    if (m_mapping != nullptr) {
+        CloseHandle(m_mapping);
+    }
+    if (m_file != INVALID_HANDLE_VALUE) {
+        CloseHandle(m_file);
+    }
+    m_view = nullptr;
+    m_size = 0;
+    m_mapping = nullptr;
+    m_file = INVALID_HANDLE_VALUE;
+}
+
+WinToastEvent::~WinToastEvent() {
+    close();
+}
+
+bool WinToastEvent::open(_In_ const std::wstring& name, _In_ bool) {
+    close();
+    m_event = CreateEventW(nullptr, FALSE, FALSE, name.c_str());
+    return m_event != nullptr;
+}
+
+void WinToastEvent::close() {
+    if (m_event != nullptr) {
+        CloseHandle(m_event);
+        m_event = nullptr;
+    }
+}
+
+bool WinToastEvent::isOpen() const {
+    return m_event != nullptr;
+}
+
+void WinToastEvent::set() {
+    SetEvent(m_event);
+}
+
+bool WinToastEvent::wait(_In_ uint32_t timeoutMs) {
+    return WaitForSingleObject(m_event, timeoutMs == Infinite ? INFINITE : timeoutMs) == WAIT_OBJECT_0;
+}
+
+#else
+
+bool WinToastMapping::open(_In_ const std::wstring& path, _In_ Access access, _In_ uint64_t size, _Out_opt_ bool* resized) {
+    close();
+    if (resized != nullptr) {
+        *resized = false;
+    }
+    const bool write = access == ReadWrite;
+    const int file = ::open(nativePath(path).c_str(), write ? O_RDWR | O_CREAT | O_CLOEXEC : O_RDONLY | O_CLOEXEC, 0644);
+    if (file < 0) {
+        return false;
+    }
+
+    struct stat status;
+    if (fstat(file, &status) != 0) {
+        ::close(file);
+        return false;
+    }
+    uint64_t length = static_cast<uint64_t>(status.st_size);
+    if (size != 0 && length != size) {
+        if (!write || ftruncate(file, static_cast<off_t>(size)) != 0) {
+            ::close(file);
+            return false;
+        }
+        length = size;
+        if (resized != nullptr) {
+            *resized = true;
+        }
+    }
+    if (length == 0 || length > SIZE_MAX) {
+        ::close(file);
+        return false;
+    }
+
+    // The mapping keeps its own reference to the file.
+    void* view = mmap(nullptr, static_cast<std::size_t>(length), write ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, file, 0);
+    ::close(file);
+    if (view == MAP_FAILED) {
+        return false;
+    }
+    m_view = view;
+    m_size = length;
+    return true;
+}
+
+bool WinToastMapping::createShared(_In_ const std::wstring& name, _In_ uint64_t size) {
+    close();
+    if (name.empty() || size == 0 || size > SIZE_MAX) {
+        return false;
+    }
+    const std::string shared = sharedName(name);
+    const int file = shm_open(shared.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (file < 0) {
+        return false;
+    }
+
+    void* view = ftruncate(file, static_cast<off_t>(size)) == 0
+        ? mmap(nullptr, static_cast<std::size_t>(size), PROT_READ | PROT_WRITE, MAP_SHARED, file, 0)
+        : MAP_FAILED;
+    ::close(file);
+    if (view == MAP_FAILED) {
+        shm_unlink(shared.c_str());
+        return false;
+    }
+    m_view = view;
+    m_size = size;
+    m_sharedName = shared;
+    return true;
+}
+
+bool WinToastMapping::openShared(_In_ const std::wstring& name, _In_ uint64_t size) {
+    close();
+    if (name.empty() || size == 0 || size > SIZE_MAX) {
+        return false;
+    }
+    const int file = shm_open(sharedName(name).c_str(), O_RDWR, 0);
+    if (file < 0) {
+        return false;
+    }
+
+    struct stat status;
+    void* view = fstat(file, &status) == 0 && static_cast<uint64_t>(status.st_size) >= size
+        ? mmap(nullptr, static_cast<std::size_t>(size), PROT_READ | PROT_WRITE, MAP_SHARED, file, 0)
+        : MAP_FAILED;
+    ::close(file);
+    if (view == MAP_FAILED) {
+        return false;
+    }
+    m_view = view;
+    m_size = size;
+    return true;
+}
+
+void WinToastMapping::close() {
+    if (m_view != nullptr) {
+        munmap(m_view, static_cast<std::size_t>(m_size));
+    }
+    if (!m_sharedName.empty()) {
+        shm_unlink(m_sharedName.c_str());
+        m_sharedName.clear();
+    }
+    m_view = nullptr;
+    m_size = 0;
+}
+
+WinToastEvent::~WinToastEvent() {
+    close();
+}
+
+bool WinToastEvent::open(_In_ const std::wstring& name, _In_ bool owner) {
+    close();
+    const std::string native = sharedName(name);
+    sem_t* semaphore = sem_open(native.c_str(), O_CREAT, 0600, 0);
+    if (semaphore == SEM_FAILED) {
+        return false;
+    }
+    m_semaphore = semaphore;
+    if (owner) {
+        m_name = native;
+    }
+    return true;
+}
+
+void WinToastEvent::close() {
+    if (m_semaphore != nullptr) {
+        sem_close(static_cast<sem_t*>(m_semaphore));
+        m_semaphore = nullptr;
+    }
+    if (!m_name.empty()) {
+        sem_unlink(m_name.c_str());
+        m_name.clear();
+    }
+}
+
+bool WinToastEvent::isOpen() const {
+    return m_semaphore != nullptr;
+}
+
+void WinToastEvent::set() {
+    sem_post(static_cast<sem_t*>(m_semaphore));
+}
+
+bool WinToastEvent::wait(_In_ uint32_t timeoutMs) {
+    sem_t* semaphore = static_cast<sem_t*>(m_semaphore);
+    if (timeoutMs == Infinite) {
+        while (sem_wait(semaphore) != 0) {
+            if (errno != EINTR) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += timeoutMs / 1000;
+    deadline.tv_nsec += static_cast<long>(timeoutMs % 1000) * 1000000;
+    if (deadline.tv_nsec >= 1000000000) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+    }
+    while (sem_timedwait(semaphore, &deadline) != 0) {
+        if (errno != EINTR) {
+            return false;
+        }
+    }
+    return true;
+}
+
+#endif
@@ -0,0 +1,97 @@
+#ifndef TOAST_MAPPING_H
+#define TOAST_MAPPING_H
+
+#include <sal.h>
+#include <cstdint>
+#include <string>
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+
+namespace WinToastLib {
+
+    /**
+     * A file or named shared memory mapped into memory, shared with every
+     * other process mapping it.
+     *
+     * The history and the catalog keep their data in mapped files, the
+     * broker keeps its rings in named shared memory; this is the only part
+     * of them that differs between Windows (CreateFileMapping) and POSIX
+     * (mmap, shm_open), so the rest builds and is tested on any host.
+     */
+    class WinToastMapping {
+    public:
+        enum Access {
+            ReadOnly,
+            ReadWrite       // creates the file if it does not exist
+        };
+
+        WinToastMapping() = default;
+        ~WinToastMapping();
+        WinToastMapping(WinToastMapping&& other) noexcept;
+        WinToastMapping& operator=(WinToastMapping&& other) noexcept;
+        WinToastMapping(const WinToastMapping&) = delete;
+        WinToastMapping& operator=(const WinToastMapping&) = delete;
+
+        // Maps the whole file. With a size, a ReadWrite file of another size is resized first, which
+        // zero-fills it and is reported through resized. Empty files cannot be mapped.
+        bool open(_In_ const std::wstring& path, _In_ Access access, _In_ uint64_t size = 0, _Out_opt_ bool* resized = nullptr);
+        // Named shared memory, zero filled when created. create fails if the name is in use. On POSIX the
+        // creator removes the name when it closes the mapping; a creator that crashed leaves it behind.
+        bool createShared(_In_ const std::wstring& name, _In_ uint64_t size);
+        bool openShared(_In_ const std::wstring& name, _In_ uint64_t size);
+        void close();
+
+        bool isOpen() const { return m_view != nullptr; }
+        void* data() const { return m_view; }
+        uint64_t size() const { return m_size; }
+
+    private:
+        void*       m_view{nullptr};
+        uint64_t    m_size{0};
+#ifdef _WIN32
+        // The file stays open for the sharing mode to hold.
+        HANDLE      m_file{INVALID_HANDLE_VALUE};
+        HANDLE      m_mapping{nullptr};
+#else
+        std::string m_sharedName;   // removed on close, set for the creator of shared memory
+#endif
+    };
+
+    /**
+     * A named auto-reset event shared between processes.
+     *
+     * set wakes one waiting thread, or the next one to wait if none is
+     * waiting. A Windows event, a named semaphore on POSIX, where sets that
+     * meet no waiter add up and may wake later waits spuriously; waiters
+     * recheck their condition anyway.
+     */
+    class WinToastEvent {
+    public:
+        static constexpr uint32_t Infinite = 0xFFFFFFFF;
+
+        WinToastEvent() = default;
+        ~WinToastEvent();
+        WinToastEvent(const WinToastEvent&) = delete;
+        WinToastEvent& operator=(const WinToastEvent&) = delete;
+
+        // Opens the event, creating it if needed. On POSIX the owner removes the name when it closes the event.
+        bool open(_In_ const std::wstring& name, _In_ bool owner = false);
+        void close();
+        bool isOpen() const;
+
+        void set();
+        // Whether the event was set before timeoutMs passed.
+        bool wait(_In_ uint32_t timeoutMs = Infinite);
+
+    private:
+#ifdef _WIN32
+        HANDLE      m_event{nullptr};
+#else
+        void*       m_semaphore{nullptr};
+        std::string m_name;         // removed on close, set for the owner
+#endif
+    };
+}
+
+#endif // TOAST_MAPPING_H
@@ -0,0 +1,43 @@
+#ifndef TOAST_PATH_H
+#define TOAST_PATH_H
+
+#include <sal.h>
+#include <cstdint>
+#include <string>
+
+namespace WinToastLib {
+
+#ifdef _WIN32
+    // A path as the file APIs of the host take it.
+    inline const std::wstring& nativePath(_In_ const std::wstring& path) {
+        return path;
+    }
+#else
+    // Outside of Windows paths are UTF-8 and wchar_t holds code points.
+    inline std::string nativePath(_In_ const std::wstring& path) {
+        std::string bytes;
+        bytes.reserve(path.size());
+        for (const wchar_t c : path) {
+            const uint32_t code = static_cast<uint32_t>(c);
+            if (code < 0x80) {
+                bytes += static_cast<char>(code);
+            } else if (code < 0x800) {
+                bytes += static_cast<char>(0xC0 | (code >> 6));
+                bytes += static_cast<char>(0x80 | (code & 0x3F));
+            } else if (code < 0x10000) {
+                bytes += static_cast<char>(0xE0 | (code >> 12));
+                bytes += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+                bytes += static_cast<char>(0x80 | (code & 0x3F));
+            } else {
+                bytes += static_cast<char>(0xF0 | (code >> 18));
+                bytes += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+                bytes += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+                bytes += static_cast<char>(0x80 | (code & 0x3F));
+            }
+        }
+        return bytes;
+    }
+#endif
+}
+
+#endif // TOAST_PATH_H
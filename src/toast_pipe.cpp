@@ -0,0 +1,368 @@
+#include "toast_pipe.h"
+#include "toast_descriptor.h"
+#include "toast_allocator.h"
+#include "toast_end_guard.h"
+#include <cstring>
+#include <deque>
+
+using namespace WinToastLib;
+
+namespace {
+    // Reads smaller than this move a partial frame to the front of the buffer first.
+    const std::size_t MinRead = 4096;
+
+    struct ReplyPayload {
+        INT64    id;
+        int32_t  hr;
+        uint32_t reserved;
+    };
+
+    struct EventPayload {
+        uint32_t kind;
+        int32_t  value;
+        INT64    id;
+    };
+
+    static_assert(sizeof(ReplyPayload) == 16 && sizeof(EventPayload) == 16, "payloads are part of the protocol");
+}
+
+struct WinToastPipeServer::Connection {
+    // Handlers of toasts still on screen may wake the channel until they let go of the connection.
+    WinToastPipeChannel channel;
+    std::mutex          writeLock;
+    bool                open{true};     // guarded by writeLock, nothing is written once it is false
+    std::vector<uint8_t> output;        // frames queued on the connection thread
+    std::mutex          eventsLock;
+    std::deque<EventPayload> events;    // guarded by eventsLock, sent by the connection thread
+    std::atomic<bool>   subscribed{false};
+    std::atomic<bool>   finished{false};
+    std::thread         thread;
+};
+
+// Sends the events of a toast shown through a connection back over it.
+class WinToastPipeServer::Handler : public IWinToastHandler {
+public:
+    Handler(_In_ std::weak_ptr<Connection> connection, _In_ INT64 id) : m_connection(std::move(connection)), m_id(id) {}
+
+    void toastActivated() const override {
+        post(Activated, -1);
+    }
+    void toastActivated(_In_ int actionIndex) const override {
+        post(Activated, actionIndex);
+    }
+    void toastDismissed(_In_ WinToastDismissalReason state) const override {
+        if (m_end.dismissed(state == TimedOut)) {
+            post(Dismissed, state);
+        }
+    }
+    void toastFailed() const override {
+        failed(E_FAIL);
+    }
+    void failed(_In_ HRESULT hr) const {
+        if (m_end.failed()) {
+            post(Failed, hr);
+        }
+    }
+
+private:
+    // Called on WinRT threads, the connection thread does the writing.
+    void post(_In_ EventKind kind, _In_ int32_t value) const {
+        std::shared_ptr<Connection> connection = m_connection.lock();
+        if (connection == nullptr || !connection->subscribed.load()) {
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(connection->eventsLock);
+            if (connection->events.size() >= MaxPendingEvents) {
+                return;
+            }
+            connection->events.push_back(EventPayload{kind, value, m_id});
+        }
+        connection->channel.wake();
+    }
+
+    std::weak_ptr<Connection>   m_connection;
+    INT64                       m_id;
+    mutable WinToastEndGuard    m_end;
+};
+
+WinToastPipeServer::~WinToastPipeServer() {
+    stop();
+}
+
+bool WinToastPipeServer::start(_In_ const std::wstring& name, _In_ RequestHandler handler) {
+    std::lock_guard<std::mutex> lock(m_lock);
+    if (m_running.load() || name.empty() || !m_reserveId || !handler || !m_listener.open(name)) {
+        return false;
+    }
+
+    m_handler = std::move(handler);
+    m_running.store(true);
+    m_listenThread = std::thread(&WinToastPipeServer::listen, this);
+    return true;
+}
+
+void WinToastPipeServer::stop() {
+    std::lock_guard<std::mutex> lock(m_lock);
+    if (!m_running.exchange(false)) {
+        return;
+    }
+
+    m_listener.shutdown();
+    m_listenThread.join();
+    m_listener.close();
+    for (auto& connection : m_connections) {
+        connection->channel.shutdown();
+    }
+    for (auto& connection : m_connections) {
+        connection->thread.join();
+    }
+    m_connections.clear();
+
+    std::lock_guard<std::mutex> queuedLock(m_queuedLock);
+    m_queued.clear();
+}
+
+bool WinToastPipeServer::isRunning() const {
+    return m_running.load();
+}
+
+bool WinToastPipeServer::completed(_In_ INT64 id, _In_ HRESULT hr) {
+    std::shared_ptr<Handler> handler;
+    {
+        std::lock_guard<std::mutex> lock(m_queuedLock);
+        auto it = m_queued.find(id);
+        if (it == m_queued.end()) {
+            return false;
+        }
+        handler = std::move(it->second);
+        m_queued.erase(it);
+    }
+    if (FAILED(hr)) {
+        handler->failed(hr);
+    }
+    return true;
+}
+
+void WinToastPipeServer::listen() {
+    for (;;) {
+        auto connection = std::make_shared<Connection>();
+        if (!m_listener.accept(connection->channel)) {
+            break;
+        }
+
+        for (auto it = m_connections.begin(); it != m_connections.end();) {
+            if ((*it)->finished.load()) {
+                (*it)->thread.join();
+                it = m_connections.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        if (m_connections.size() >= MaxConnections) {
+            connection->channel.close();
+            continue;
+        }
+        connection->thread = std::thread(&WinToastPipeServer::serve, this, connection);
+        m_connections.push_back(std::move(connection));
+    }
+}
+
+void WinToastPipeServer::serve(_In_ std::shared_ptr<Connection> connection) {
+#ifdef _WIN32
+    const HRESULT initHr = CoInitializeEx(nullptr, COINIT::COINIT_MULTITHREADED);
+#endif
+
+    // Events queued by the callbacks are sent while waiting for the client.
+    const std::function<void()> woken = [&connection] { sendEvents(*connection); };
+    WinToastPipeFramer framer;
+    WinToastPipeFramer::Result result = WinToastPipeFramer::Incomplete;
+    while (result == WinToastPipeFramer::Incomplete) {
+        std::size_t size = 0;
+        uint8_t* space = framer.space(size);
+        const std::size_t received = connection->channel.read(space, size, woken);
+        if (received == 0) {
+            break;
+        }
+        framer.commit(received);
+
+        FrameHeader header;
+        const uint8_t* payload = nullptr;
+        while ((result = framer.next(header, payload)) == WinToastPipeFramer::Frame) {
+            execute(connection, header, payload);
+        }
+        flush(*connection);
+    }
+
+    {
+        // Handlers of toasts still on screen keep the connection, but no longer write to it.
+        std::lock_guard<std::mutex> lock(connection->writeLock);
+        connection->open = false;
+        connection->channel.close();
+    }
+    connection->finished.store(true);
+
+#ifdef _WIN32
+    if (SUCCEEDED(initHr)) {
+        CoUninitialize();
+    }
+#endif
+}
+
+void WinToastPipeServer::sendEvents(_In_ Connection& connection) {
+    std::deque<EventPayload> events;
+    {
+        std::lock_guard<std::mutex> lock(connection.eventsLock);
+        events.swap(connection.events);
+    }
+    for (const EventPayload& event : events) {
+        const FrameHeader header{sizeof(event), Event, 0, 0};
+        queue(connection, header, &event);
+    }
+    flush(connection);
+}
+
+void WinToastPipeServer::execute(_In_ const std::shared_ptr<Connection>& connection, _In_ const FrameHeader& header,
+                                 _In_reads_bytes_(header.length) const uint8_t* payload) {
+    INT64 id = -1;
+    HRESULT hr = E_INVALIDARG;
+    switch (header.type) {
+    case Show:
+        id = show(connection, payload, header.length, hr);
+        break;
+    case Hide:
+        if (header.length == sizeof(id)) {
+            memcpy(&id, payload, sizeof(id));
+            hr = hide(id);
+        }
+        break;
+    case Update:
+        if (header.length > sizeof(id)) {
+            memcpy(&id, payload, sizeof(id));
+            hide(id);
+            id = show(connection, payload + sizeof(id), header.length - sizeof(id), hr);
+        }
+        break;
+    case Subscribe:
+        if (header.length == sizeof(uint32_t)) {
+            uint32_t enable = 0;
+            memcpy(&enable, payload, sizeof(enable));
+            connection->subscribed.store(enable != 0);
+            hr = S_OK;
+        }
+        break;
+    default:
+        hr = E_NOTIMPL;
+        break;
+    }
+
+    const ReplyPayload reply{id, static_cast<int32_t>(hr), 0};
+    const FrameHeader out{sizeof(reply), Reply, 0, header.tag};
+    queue(*connection, out, &reply);
+}
+
+INT64 WinToastPipeServer::show(_In_ const std::shared_ptr<Connection>& connection, _In_ const uint8_t* payload, _In_ std::size_t size,
+                               _Out_ HRESULT& hr) {
+    WinToastDescriptor descriptor;
+    if (!descriptor.open(payload, size)) {
+        hr = E_INVALIDARG;
+        return -1;
+    }
+
+    Request request{Show, m_reserveId(), std::unique_ptr<WinToastTemplate>(new WinToastTemplate()), nullptr, payload, size, S_OK};
+    descriptor.toTemplate(*request.toast);
+    auto handler = std::allocate_shared<Handler>(WinToastStlAllocator<Handler>(), connection, request.id);
+    request.handler = handler;
+    const INT64 id = request.id;
+    {
+        // Registered first, a queued show may complete before the handler returns.
+        std::lock_guard<std::mutex> lock(m_queuedLock);
+        m_queued[id] = std::move(handler);
+    }
+    m_handler(request);
+    if (request.hr != S_FALSE) {
+        std::lock_guard<std::mutex> lock(m_queuedLock);
+        m_queued.erase(id);
+    }
+    hr = request.hr;
+    return request.id;
+}
+
+HRESULT WinToastPipeServer::hide(_In_ INT64 id) {
+    Request request{Hide, id, nullptr, nullptr, nullptr, 0, S_OK};
+    m_handler(request);
+    return request.hr;
+}
+
+void WinToastPipeServer::queue(_In_ Connection& connection, _In_ const FrameHeader& header,
+                               _In_reads_bytes_(header.length) const void* payload) {
+    WinToastPipeFramer::append(header, payload, connection.output);
+}
+
+bool WinToastPipeServer::flush(_In_ Connection& connection) {
+    if (connection.output.empty()) {
+        return true;
+    }
+
+    std::lock_guard<std::mutex> lock(connection.writeLock);
+    const bool written = connection.open && connection.channel.write(connection.output.data(), connection.output.size(), WriteTimeoutMs);
+    connection.output.clear();
+    if (!written && connection.open) {
+        // A client that stops reading is dropped. Shutting the channel down ends the connection thread.
+        connection.open = false;
+        connection.channel.shutdown();
+    }
+    return written;
+}
+
+uint8_t* WinToastPipeFramer::space(_Out_ std::size_t& size) {
+    if (m_begin == m_end) {
+        m_begin = m_end = 0;
+    } else if (m_begin > 0 && m_buffer.size() - m_end < MinRead) {
+        // Only the start of a frame is left, it fits in front of the room it still needs.
+        memmove(m_buffer.data(), m_buffer.data() + m_begin, m_end - m_begin);
+        m_end -= m_begin;
+        m_begin = 0;
+    }
+    size = m_buffer.size() - m_end;
+    return m_buffer.data() + m_end;
+}
+
+void WinToastPipeFramer::commit(_In_ std::size_t size) {
+    m_end += size;
+}
+
+WinToastPipeFramer::Result WinToastPipeFramer::next(_Out_ FrameHeader& header, _Out_ const uint8_t*& payload) {
+    payload = nullptr;
+    if (pending() < sizeof(header)) {
+        return Incomplete;
+    }
+    memcpy(&header, m_buffer.data() + m_begin, sizeof(header));
+    if (header.length > WinToastPipeServer::MaxPayload) {
+        return Invalid;
+    }
+    if (pending() - sizeof(header) < header.length) {
+        return Incomplete;
+    }
+
+    const uint8_t* data = m_buffer.data() + m_begin + sizeof(header);
+    m_begin += sizeof(header) + header.length;
+    if (reinterpret_cast<uintptr_t>(data) % alignof(uint64_t) != 0) {
+        m_aligned.resize((header.length + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+        memcpy(m_aligned.data(), data, header.length);
+        data = reinterpret_cast<const uint8_t*>(m_aligned.data());
+    }
+    payload = data;
+    return Frame;
+}
+
+void WinToastPipeFramer::append(_In_ const FrameHeader& header, _In_reads_bytes_(header.length) const void* payload,
+                                _Inout_ std::vector<uint8_t>& out) {
+    const std::size_t offset = out.size();
+    out.resize(offset + sizeof(header) + header.length);
+    memcpy(out.data() + offset, &header, sizeof(header));
+    if (header.length > 0) {
+        memcpy(out.data() + offset + sizeof(header), payload, header.length);
+    }
+}
@@ -0,0 +1,178 @@
+#ifndef TOAST_PIPE_H
+#define TOAST_PIPE_H
+
+#include "toast_handler.h"
+#include "toast_pipe_transport.h"
+#include "toast_template.h"
+#include <Windows.h>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace WinToastLib {
+
+    /**
+     * Accepts notification commands from other processes over a local named
+     * pipe, so a service outside the interactive session can show toasts
+     * through a process inside it.
+     *
+     * Every message is a FrameHeader followed by length bytes of payload, all
+     * integers little endian. A client may send any number of commands
+     * without waiting for their replies. The commands of a connection are
+     * executed in order on a thread of that connection, and each one is
+     * answered with a Reply carrying the tag of the command; the replies to
+     * the commands that arrived in one read are written together. After
+     * Subscribe, the events of the toasts shown through the connection are
+     * sent as Event frames in between the replies.
+     *
+     * Shows and hides are handed to the request handler of the host, so they
+     * take the same path as its own. A reply with S_FALSE means the command
+     * was queued; a queued show that fails later is reported as a Failed
+     * event once the host passes its completion to completed(). Events are
+     * queued by the notification callbacks and written by the connection
+     * thread, a client that stops reading never blocks a callback.
+     *
+     * Framing and dispatch are the same on every host, the stream is a
+     * WinToastPipeChannel: a named pipe on Windows, which only accepts local
+     * clients and whose default security lets LocalSystem, administrators
+     * and the creating user write to it, and a Unix domain socket on POSIX,
+     * where the server is tested and benchmarked.
+     */
+    class WinToastPipeServer {
+    public:
+        enum Type : uint16_t {
+            Show = 1,       // payload: WinToastDescriptor
+            Hide,           // payload: INT64 toast Id
+            Update,         // payload: INT64 toast Id, WinToastDescriptor. Hides the toast and shows the new one with a new Id.
+            Subscribe,      // payload: uint32_t 1 to receive events, 0 to stop
+
+            Reply = 0x80,   // payload: INT64 toast Id or -1, HRESULT, 4 reserved bytes
+            Event           // payload: uint32_t EventKind, int32_t value, INT64 toast Id
+        };
+
+        enum EventKind : uint32_t {
+            Activated = 1,  // value: action index, -1 for the body
+            Dismissed,      // value: reason
+            Failed          // value: HRESULT
+        };
+
+        // A command of a connection. The handler sets hr, and id to -1 if a show failed.
+        struct Request {
+            Type                                kind;       // Show or Hide
+            INT64                               id;
+            std::unique_ptr<WinToastTemplate>   toast;      // Show
+            std::shared_ptr<IWinToastHandler>   handler;    // Show, sends the events back over the connection
+            const void*                         descriptor; // Show, the descriptor the toast was made from
+            std::size_t                         size;
+            HRESULT                             hr;
+        };
+
+        typedef std::function<void(Request& request)> RequestHandler;
+
+        struct FrameHeader {
+            uint32_t length;    // bytes of payload following the header
+            uint16_t type;
+            uint16_t reserved;
+            uint64_t tag;       // chosen by the client and echoed in the reply, 0 for events
+        };
+
+        static constexpr uint32_t MaxPayload = 64 * 1024;
+        static constexpr std::size_t MaxConnections = 16;
+        static constexpr DWORD WriteTimeoutMs = 5000;
+        static constexpr std::size_t MaxPendingEvents = 256;   // per connection, later events are dropped
+
+        // Reserves the Id of a toast shown through the pipe, WinToast::reserveId in the library.
+        typedef std::function<INT64()> IdSource;
+
+        explicit WinToastPipeServer(_In_ IdSource reserveId) : m_reserveId(std::move(reserveId)) {}
+        ~WinToastPipeServer();
+        WinToastPipeServer(const WinToastPipeServer&) = delete;
+        WinToastPipeServer& operator=(const WinToastPipeServer&) = delete;
+
+        // Listens on the pipe of that name, see WinToastPipeListener. The handler runs on the connection threads.
+        bool start(_In_ const std::wstring& name, _In_ RequestHandler handler);
+        void stop();
+        bool isRunning() const;
+
+        // Result of a show that was queued. Returns false if the toast was not shown through the pipe.
+        bool completed(_In_ INT64 id, _In_ HRESULT hr);
+
+    private:
+        struct Connection;
+        class Handler;
+
+        void listen();
+        void serve(_In_ std::shared_ptr<Connection> connection);
+        static void sendEvents(_In_ Connection& connection);
+        void execute(_In_ const std::shared_ptr<Connection>& connection, _In_ const FrameHeader& header,
+                     _In_reads_bytes_(header.length) const uint8_t* payload);
+        INT64 show(_In_ const std::shared_ptr<Connection>& connection, _In_ const uint8_t* payload, _In_ std::size_t size,
+                   _Out_ HRESULT& hr);
+        HRESULT hide(_In_ INT64 id);
+        // Frames are queued on the connection thread and written by flush.
+        static void queue(_In_ Connection& connection, _In_ const FrameHeader& header, _In_reads_bytes_(header.length) const void* payload);
+        static bool flush(_In_ Connection& connection);
+
+        IdSource                                    m_reserveId;
+        RequestHandler                              m_handler;
+        std::mutex                                  m_lock;
+        std::atomic<bool>                           m_running{false};
+        WinToastPipeListener                        m_listener;
+        std::thread                                 m_listenThread;
+        std::vector<std::shared_ptr<Connection>>    m_connections;  // owned by the listener thread
+        std::mutex                                  m_queuedLock;
+        std::unordered_map<INT64, std::shared_ptr<Handler>> m_queued;   // shows waiting for completed()
+    };
+
+    /**
+     * Cuts the byte stream of a connection into frames.
+     *
+     * The stream is read into space() and what was read is committed, then
+     * every whole frame is taken out with next() until it returns
+     * Incomplete. Payloads are handed out in place unless they are not
+     * aligned for a WinToastDescriptor. The buffer holds a frame of
+     * MaxPayload, so a stream that follows the protocol always has room for
+     * its next read.
+     */
+    class WinToastPipeFramer {
+    public:
+        typedef WinToastPipeServer::FrameHeader FrameHeader;
+
+        enum Result {
+            Incomplete,
+            Frame,
+            Invalid         // a header announced more than MaxPayload, the stream cannot be followed past it
+        };
+
+        static constexpr std::size_t Capacity = sizeof(FrameHeader) + WinToastPipeServer::MaxPayload;
+
+        WinToastPipeFramer() : m_buffer(Capacity) {}
+
+        // Room for the next read, size bytes at least 1 once every frame was taken out.
+        uint8_t* space(_Out_ std::size_t& size);
+        void commit(_In_ std::size_t size);
+        // The payload stays valid until the next call to space or next.
+        Result next(_Out_ FrameHeader& header, _Out_ const uint8_t*& payload);
+        // Bytes committed and not taken out yet.
+        std::size_t pending() const { return m_end - m_begin; }
+
+        // Appends a whole frame, for the writing side.
+        static void append(_In_ const FrameHeader& header, _In_reads_bytes_(header.length) const void* payload, _Inout_ std::vector<uint8_t>& out);
+
+    private:
+        std::vector<uint8_t>    m_buffer;
+        std::size_t             m_begin{0};
+        std::size_t             m_end{0};
+        std::vector<uint64_t>   m_aligned;  // copies of payloads that were not aligned in the buffer
+    };
+
+    static_assert(sizeof(WinToastPipeServer::FrameHeader) == 16, "frame header is part of the protocol");
+}
+
+#endif // TOAST_PIPE_H
@@ -0,0 +1,503 @@
+#include "toast_pipe_transport.h"
+#include <algorithm>
+#ifndef _WIN32
+#include "toast_path.h"
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+using namespace WinToastLib;
+
+#ifdef _WIN32
+
+namespace {
+    const DWORD BufferSize = 64 * 1024;
+    const DWORD ConnectTimeoutMs = 2000;
+
+    HANDLE createPipe(_In_ const std::wstring& path, _In_ bool first) {
+        return CreateNamedPipeW(path.c_str(), PIPE_ACCESS_DUPLEX | FILE_FLAG_OVERLAPPED | (first ? FILE_FLAG_FIRST_PIPE_INSTANCE : 0),
+                                PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS,
+                                PIPE_UNLIMITED_INSTANCES, BufferSize, BufferSize, 0, nullptr);
+    }
+}
+
+WinToastPipeChannel::~WinToastPipeChannel() {
+    close();
+    if (m_wakeEvent != nullptr) {
+        CloseHandle(m_wakeEvent);
+    }
+    if (m_stopEvent != nullptr) {
+        CloseHandle(m_stopEvent);
+    }
+}
+
+bool WinToastPipeChannel::attach(_In_ HANDLE pipe) {
+    close();
+    m_pipe = pipe;
+    if (m_wakeEvent == nullptr) {
+        m_wakeEvent = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+    }
+    if (m_stopEvent == nullptr) {
+        m_stopEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    } else {
+        ResetEvent(m_stopEvent);
+    }
+    m_readEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    m_writeEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    if (m_wakeEvent == nullptr || m_stopEvent == nullptr || m_readEvent == nullptr || m_writeEvent == nullptr) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+bool WinToastPipeChannel::connect(_In_ const std::wstring& name) {
+    close();
+    const std::wstring path = L"\\\\.\\pipe\\" + name;
+    HANDLE pipe = CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, FILE_FLAG_OVERLAPPED, nullptr);
+    if (pipe == INVALID_HANDLE_VALUE && GetLastError() == ERROR_PIPE_BUSY && WaitNamedPipeW(path.c_str(), ConnectTimeoutMs)) {
+        // Every instance was taken, the listener has created the next one.
+        pipe = CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, FILE_FLAG_OVERLAPPED, nullptr);
+    }
+    return pipe != INVALID_HANDLE_VALUE && attach(pipe);
+}
+
+void WinToastPipeChannel::close() {
+    if (m_pipe != INVALID_HANDLE_VALUE) {
+        // Not disconnected, the client still reads the replies written before.
+        CloseHandle(m_pipe);
+        m_pipe = INVALID_HANDLE_VALUE;
+    }
+    if (m_readEvent != nullptr) {
+        CloseHandle(m_readEvent);
+        m_readEvent = nullptr;
+    }
+    if (m_writeEvent != nullptr) {
+        CloseHandle(m_writeEvent);
+        m_writeEvent = nullptr;
+    }
+}
+
+bool WinToastPipeChannel::isOpen() const {
+    return m_pipe != INVALID_HANDLE_VALUE;
+}
+
+std::size_t WinToastPipeChannel::read(_Out_writes_bytes_(size) void* data, _In_ std::size_t size,
+                                      _In_opt_ const std::function<void()>& woken) {
+    if (m_pipe == INVALID_HANDLE_VALUE || size == 0 || WaitForSingleObject(m_stopEvent, 0) == WAIT_OBJECT_0) {
+        return 0;
+    }
+
+    OVERLAPPED overlapped{};
+    overlapped.hEvent = m_readEvent;
+    DWORD transferred = 0;
+    if (!ReadFile(m_pipe, data, static_cast<DWORD>((std::min)(size, static_cast<std::size_t>(MAXDWORD))), nullptr, &overlapped)) {
+        if (GetLastError() != ERROR_IO_PENDING) {
+            return 0;
+        }
+        // The read stays pending while the reader is woken.
+        HANDLE handles[3] = {m_stopEvent, m_readEvent, m_wakeEvent};
+        DWORD wait = WAIT_OBJECT_0 + 2;
+        while (wait == WAIT_OBJECT_0 + 2) {
+            wait = WaitForMultipleObjects(3, handles, FALSE, INFINITE);
+            if (wait == WAIT_OBJECT_0 + 2 && woken) {
+                woken();
+            }
+        }
+        if (wait != WAIT_OBJECT_0 + 1) {
+            CancelIoEx(m_pipe, &overlapped);
+            GetOverlappedResult(m_pipe, &overlapped, &transferred, TRUE);
+            return 0;
+        }
+    }
+    if (!GetOverlappedResult(m_pipe, &overlapped, &transferred, FALSE)) {
+        return 0;
+    }
+    return transferred;
+}
+
+bool WinToastPipeChannel::write(_In_reads_bytes_(size) const void* data, _In_ std::size_t size, _In_ uint32_t timeoutMs) {
+    if (m_pipe == INVALID_HANDLE_VALUE || size > MAXDWORD) {
+        return false;
+    }
+
+    OVERLAPPED overlapped{};
+    overlapped.hEvent = m_writeEvent;
+    DWORD written = 0;
+    bool succeeded = WriteFile(m_pipe, data, static_cast<DWORD>(size), nullptr, &overlapped) != FALSE || GetLastError() == ERROR_IO_PENDING;
+    if (succeeded && WaitForSingleObject(m_writeEvent, timeoutMs) != WAIT_OBJECT_0) {
+        CancelIoEx(m_pipe, &overlapped);
+        GetOverlappedResult(m_pipe, &overlapped, &written, TRUE);
+        succeeded = false;
+    }
+    return succeeded && GetOverlappedResult(m_pipe, &overlapped, &written, FALSE) && written == size;
+}
+
+void WinToastPipeChannel::wake() {
+    if (m_wakeEvent != nullptr) {
+        SetEvent(m_wakeEvent);
+    }
+}
+
+void WinToastPipeChannel::shutdown() {
+    if (m_stopEvent != nullptr) {
+        SetEvent(m_stopEvent);
+    }
+}
+
+WinToastPipeListener::~WinToastPipeListener() {
+    close();
+}
+
+bool WinToastPipeListener::open(_In_ const std::wstring& name) {
+    close();
+    m_path = L"\\\\.\\pipe\\" + name;
+    // The first instance fails if another process already owns the name.
+    m_pipe = createPipe(m_path, true);
+    m_connectEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    m_stopEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    if (m_pipe == INVALID_HANDLE_VALUE || m_connectEvent == nullptr || m_stopEvent == nullptr) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void WinToastPipeListener::close() {
+    if (m_pipe != INVALID_HANDLE_VALUE) {
+        CloseHandle(m_pipe);
+        m_pipe = INVALID_HANDLE_VALUE;
+    }
+    if (m_connectEvent != nullptr) {
+        CloseHandle(m_connectEvent);
+        m_connectEvent = nullptr;
+    }
+    if (m_stopEvent != nullptr) {
+        CloseHandle(m_stopEvent);
+        m_stopEvent = nullptr;
+    }
+}
+
+bool WinToastPipeListener::accept(_Inout_ WinToastPipeChannel& channel) {
+    while (m_pipe != INVALID_HANDLE_VALUE) {
+        OVERLAPPED overlapped{};
+        overlapped.hEvent = m_connectEvent;
+        bool connected = ConnectNamedPipe(m_pipe, &overlapped) != FALSE;
+        const DWORD error = GetLastError();
+        if (!connected && error == ERROR_IO_PENDING) {
+            HANDLE handles[2] = {m_stopEvent, m_connectEvent};
+            DWORD transferred = 0;
+            if (WaitForMultipleObjects(2, handles, FALSE, INFINITE) == WAIT_OBJECT_0) {
+                CancelIoEx(m_pipe, &overlapped);
+                GetOverlappedResult(m_pipe, &overlapped, &transferred, TRUE);
+                return false;
+            }
+            connected = GetOverlappedResult(m_pipe, &overlapped, &transferred, FALSE) != FALSE;
+        } else if (!connected && error == ERROR_PIPE_CONNECTED) {
+            // The client connected between creating the instance and waiting for it.
+            connected = true;
+        }
+
+        HANDLE pipe = m_pipe;
+        m_pipe = WaitForSingleObject(m_stopEvent, 0) == WAIT_OBJECT_0 ? INVALID_HANDLE_VALUE : createPipe(m_path, false);
+        if (!connected) {
+            CloseHandle(pipe);
+        } else if (channel.attach(pipe)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void WinToastPipeListener::shutdown() {
+    if (m_stopEvent != nullptr) {
+        SetEvent(m_stopEvent);
+    }
+}
+
+#else
+
+#ifndef MSG_NOSIGNAL
+// Where it is missing, SO_NOSIGPIPE is set on the socket instead.
+#define MSG_NOSIGNAL 0
+#endif
+
+namespace {
+    // Sockets live in the temporary directory, named after the pipe.
+    std::string socketPath(_In_ const std::wstring& name) {
+        const char* directory = getenv("TMPDIR");
+        std::string path = directory != nullptr && directory[0] != '\0' ? directory : "/tmp";
+        if (path.back() != '/') {
+            path += '/';
+        }
+        std::string native = nativePath(name);
+        std::replace(native.begin(), native.end(), '/', '_');
+        return path + native;
+    }
+
+    bool socketAddress(_In_ const std::string& path, _Out_ sockaddr_un& address) {
+        memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(address.sun_path)) {
+            return false;
+        }
+        memcpy(address.sun_path, path.c_str(), path.size() + 1);
+        return true;
+    }
+
+    bool setFlags(_In_ int descriptor) {
+        const int flags = fcntl(descriptor, F_GETFL);
+        return flags >= 0 && fcntl(descriptor, F_SETFL, flags | O_NONBLOCK) == 0 && fcntl(descriptor, F_SETFD, FD_CLOEXEC) == 0;
+    }
+
+    bool openPipe(_Out_writes_(2) int descriptors[2]) {
+        if (pipe(descriptors) != 0) {
+            descriptors[0] = descriptors[1] = -1;
+            return false;
+        }
+        if (!setFlags(descriptors[0]) || !setFlags(descriptors[1])) {
+            ::close(descriptors[0]);
+            ::close(descriptors[1]);
+            descriptors[0] = descriptors[1] = -1;
+            return false;
+        }
+        return true;
+    }
+
+    void closePipe(_Inout_ int descriptors[2]) {
+        for (int i = 0; i < 2; i++) {
+            if (descriptors[i] >= 0) {
+                ::close(descriptors[i]);
+                descriptors[i] = -1;
+            }
+        }
+    }
+
+    void notify(_In_ int descriptor) {
+        // A full pipe is still readable, the reader wakes anyway.
+        const char byte = 0;
+        while (::write(descriptor, &byte, 1) < 0 && errno == EINTR) {
+        }
+    }
+
+    void drain(_In_ int descriptor) {
+        char bytes[64];
+        while (::read(descriptor, bytes, sizeof(bytes)) > 0) {
+        }
+    }
+
+    // The socket of a server that is gone refuses connections.
+    bool isStale(_In_ const sockaddr_un& address) {
+        const int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (probe < 0) {
+            return false;
+        }
+        const bool refused = connect(probe, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 && errno == ECONNREFUSED;
+        ::close(probe);
+        return refused;
+    }
+}
+
+WinToastPipeChannel::~WinToastPipeChannel() {
+    close();
+    closePipe(m_wake);
+}
+
+bool WinToastPipeChannel::attach(_In_ int socket) {
+    close();
+    m_socket = socket;
+    m_stopped.store(false);
+#ifdef SO_NOSIGPIPE
+    const int on = 1;
+    setsockopt(socket, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+    if (!setFlags(socket) || (m_wake[0] < 0 && !openPipe(m_wake))) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+bool WinToastPipeChannel::connect(_In_ const std::wstring& name) {
+    close();
+    sockaddr_un address;
+    if (!socketAddress(socketPath(name), address)) {
+        return false;
+    }
+    const int client = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (client < 0) {
+        return false;
+    }
+    if (::connect(client, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+        ::close(client);
+        return false;
+    }
+    return attach(client);
+}
+
+void WinToastPipeChannel::close() {
+    if (m_socket >= 0) {
+        ::close(m_socket);
+        m_socket = -1;
+    }
+}
+
+bool WinToastPipeChannel::isOpen() const {
+    return m_socket >= 0;
+}
+
+std::size_t WinToastPipeChannel::read(_Out_writes_bytes_(size) void* data, _In_ std::size_t size,
+                                      _In_opt_ const std::function<void()>& woken) {
+    while (m_socket >= 0 && size > 0 && !m_stopped.load()) {
+        pollfd descriptors[2] = {{m_socket, POLLIN, 0}, {m_wake[0], POLLIN, 0}};
+        if (poll(descriptors, 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return 0;
+        }
+        if (descriptors[1].revents != 0) {
+            drain(m_wake[0]);
+            if (m_stopped.load()) {
+                return 0;
+            }
+            if (woken) {
+                woken();
+            }
+        }
+        if (descriptors[0].revents != 0) {
+            const ssize_t received = recv(m_socket, data, size, 0);
+            if (received > 0) {
+                return static_cast<std::size_t>(received);
+            }
+            if (received == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+                return 0;
+            }
+        }
+    }
+    return 0;
+}
+
+bool WinToastPipeChannel::write(_In_reads_bytes_(size) const void* data, _In_ std::size_t size, _In_ uint32_t timeoutMs) {
+    const uint8_t* in = static_cast<const uint8_t*>(data);
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    while (size > 0) {
+        if (m_socket < 0) {
+            return false;
+        }
+        const ssize_t sent = send(m_socket, in, size, MSG_NOSIGNAL);
+        if (sent > 0) {
+            in += sent;
+            size -= static_cast<std::size_t>(sent);
+            continue;
+        }
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+            return false;
+        }
+
+        // The client is not reading, wait for room until the deadline.
+        const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+        pollfd descriptor{m_socket, POLLOUT, 0};
+        if (left <= 0 || poll(&descriptor, 1, static_cast<int>(std::min<long long>(left, INT_MAX))) == 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void WinToastPipeChannel::wake() {
+    if (m_wake[1] >= 0) {
+        notify(m_wake[1]);
+    }
+}
+
+void WinToastPipeChannel::shutdown() {
+    m_stopped.store(true);
+    wake();
+}
+
+WinToastPipeListener::~WinToastPipeListener() {
+    close();
+}
+
+bool WinToastPipeListener::open(_In_ const std::wstring& name) {
+    close();
+    const std::string path = socketPath(name);
+    sockaddr_un address;
+    if (!socketAddress(path, address) || !openPipe(m_stop)) {
+        close();
+        return false;
+    }
+
+    m_socket = socket(AF_UNIX, SOCK_STREAM, 0);
+    const sockaddr* bound = reinterpret_cast<const sockaddr*>(&address);
+    if (m_socket < 0 || !setFlags(m_socket)
+        || (bind(m_socket, bound, sizeof(address)) != 0
+            && !(errno == EADDRINUSE && isStale(address) && unlink(path.c_str()) == 0 && bind(m_socket, bound, sizeof(address)) == 0))
+        || listen(m_socket, SOMAXCONN) != 0) {
+        close();
+        return false;
+    }
+    // Only the server that bound the socket removes it.
+    m_path = path;
+    return true;
+}
+
+void WinToastPipeListener::close() {
+    if (m_socket >= 0) {
+        ::close(m_socket);
+        m_socket = -1;
+    }
+    if (!m_path.empty()) {
+        unlink(m_path.c_str());
+        m_path.clear();
+    }
+    closePipe(m_stop);
+}
+
+bool WinToastPipeListener::accept(_Inout_ WinToastPipeChannel& channel) {
+    while (m_socket >= 0) {
+        pollfd descriptors[2] = {{m_socket, POLLIN, 0}, {m_stop[0], POLLIN, 0}};
+        if (poll(descriptors, 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        if (descriptors[1].revents != 0) {
+            return false;
+        }
+        if (descriptors[0].revents == 0) {
+            continue;
+        }
+
+        const int client = ::accept(m_socket, nullptr, nullptr);
+        if (client >= 0) {
+            if (channel.attach(client)) {
+                return true;
+            }
+        } else if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR && errno != ECONNABORTED) {
+            return false;
+        }
+    }
+    return false;
+}
+
+void WinToastPipeListener::shutdown() {
+    if (m_stop[1] >= 0) {
+        notify(m_stop[1]);
+    }
+}
+
+#endif
@@ -0,0 +1,107 @@
+#ifndef TOAST_PIPE_TRANSPORT_H
+#define TOAST_PIPE_TRANSPORT_H
+
+#include <sal.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+
+namespace WinToastLib {
+
+    /**
+     * One connected stream of the pipe server, or of a client of it.
+     *
+     * The byte stream of a local named pipe on Windows and of a Unix domain
+     * socket on POSIX. This is the only part of the pipe server that differs
+     * between them, framing and dispatch build and are tested on any host.
+     * A channel is read and written by one thread; wake and shutdown may be
+     * called from any thread until it is destroyed, even after close.
+     */
+    class WinToastPipeChannel {
+    public:
+        WinToastPipeChannel() = default;
+        ~WinToastPipeChannel();
+        WinToastPipeChannel(const WinToastPipeChannel&) = delete;
+        WinToastPipeChannel& operator=(const WinToastPipeChannel&) = delete;
+
+        // Connects to the server listening on name, see WinToastPipeListener::open.
+        bool connect(_In_ const std::wstring& name);
+        // Closes the stream. The channel may still be woken until it is destroyed.
+        void close();
+        bool isOpen() const;
+
+        // Waits for data and reads what is there, at most size bytes. Calls woken on the reading thread for every
+        // wake while it waits. Returns 0 once the stream ended or the channel was shut down.
+        std::size_t read(_Out_writes_bytes_(size) void* data, _In_ std::size_t size, _In_opt_ const std::function<void()>& woken = nullptr);
+        // Writes all of size bytes, false if the stream ended or did not take them within timeoutMs.
+        bool write(_In_reads_bytes_(size) const void* data, _In_ std::size_t size, _In_ uint32_t timeoutMs);
+        // Makes a waiting read call its woken, or the next read if none is waiting.
+        void wake();
+        // Makes the waiting read and every later one return 0.
+        void shutdown();
+
+    private:
+        friend class WinToastPipeListener;
+
+#ifdef _WIN32
+        bool attach(_In_ HANDLE pipe);
+
+        HANDLE      m_pipe{INVALID_HANDLE_VALUE};
+        HANDLE      m_readEvent{nullptr};
+        HANDLE      m_writeEvent{nullptr};
+        // Closed with the channel, not the stream.
+        HANDLE      m_wakeEvent{nullptr};
+        HANDLE      m_stopEvent{nullptr};
+#else
+        bool attach(_In_ int socket);
+
+        int         m_socket{-1};
+        // A pipe, written to wake the reader. Closed with the channel, not the stream.
+        int         m_wake[2]{-1, -1};
+        std::atomic<bool> m_stopped{false};
+#endif
+    };
+
+    /**
+     * Accepts the connections of the pipe server.
+     *
+     * Listens on the named pipe \\.\pipe\<name> on Windows, which only
+     * accepts local clients, and on a Unix domain socket in the temporary
+     * directory on POSIX, replacing the socket of a server that is gone.
+     */
+    class WinToastPipeListener {
+    public:
+        WinToastPipeListener() = default;
+        ~WinToastPipeListener();
+        WinToastPipeListener(const WinToastPipeListener&) = delete;
+        WinToastPipeListener& operator=(const WinToastPipeListener&) = delete;
+
+        // Fails if another server listens on name.
+        bool open(_In_ const std::wstring& name);
+        void close();
+
+        // Waits for the next client and attaches the channel to it. Returns false once shut down or when listening failed.
+        bool accept(_Inout_ WinToastPipeChannel& channel);
+        // Makes the waiting accept and every later one return false. Any thread.
+        void shutdown();
+
+    private:
+#ifdef _WIN32
+        HANDLE          m_pipe{INVALID_HANDLE_VALUE};   // the instance the next client connects to
+        HANDLE          m_connectEvent{nullptr};
+        HANDLE          m_stopEvent{nullptr};
+        std::wstring    m_path;
+#else
+        int             m_socket{-1};
+        int             m_stop[2]{-1, -1};
+        std::string     m_path;
+#endif
+    };
+}
+
+#endif // TOAST_PIPE_TRANSPORT_H
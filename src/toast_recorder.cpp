@@ -0,0 +1,225 @@
+#include "toast_recorder.h"
+#include "toast_path.h"
+#include <chrono>
+#include <cwchar>
+
+using namespace WinToastLib;
+
+namespace {
+    const uint32_t Magic = 0x43524d50; // "PMRC"
+    const uint32_t Version = 2;
+
+#ifdef _WIN32
+    // wchar_t is a UTF-16 unit.
+    uint32_t units(_In_opt_ PCWSTR text) {
+        const std::size_t characters = text != nullptr ? wcslen(text) : 0;
+        return static_cast<uint32_t>(characters < WinToastRecorder::MaxStringLength ? characters : WinToastRecorder::MaxStringLength);
+    }
+
+    void writeText(_Inout_ std::ofstream& file, _In_ PCWSTR text, _In_ uint32_t units) {
+        file.write(reinterpret_cast<const char*>(text), units * sizeof(wchar_t));
+    }
+
+    bool readText(_Inout_ std::ifstream& file, _In_ uint32_t units, _Out_ std::wstring& text) {
+        text.resize(units);
+        return units == 0 || file.read(reinterpret_cast<char*>(&text[0]), units * sizeof(wchar_t));
+    }
+#else
+    // wchar_t holds code points, recordings hold UTF-16 like on Windows. A pair is never cut in half.
+    template <typename Sink>
+    uint32_t encode(_In_opt_ PCWSTR text, _In_ Sink&& sink) {
+        uint32_t count = 0;
+        for (; text != nullptr && *text != L'\0'; text++) {
+            const uint32_t code = static_cast<uint32_t>(*text);
+            const uint32_t needed = code >= 0x10000 ? 2 : 1;
+            if (count + needed > WinToastRecorder::MaxStringLength) {
+                break;
+            }
+            if (needed == 2) {
+                sink(static_cast<uint16_t>(0xD800 | ((code - 0x10000) >> 10)));
+                sink(static_cast<uint16_t>(0xDC00 | ((code - 0x10000) & 0x3FF)));
+            } else {
+                sink(static_cast<uint16_t>(code));
+            }
+            count += needed;
+        }
+        return count;
+    }
+
+    uint32_t units(_In_opt_ PCWSTR text) {
+        return encode(text, [](uint16_t) {});
+    }
+
+    void writeText(_Inout_ std::ofstream& file, _In_ PCWSTR text, _In_ uint32_t) {
+        encode(text, [&file](uint16_t unit) {
+            file.write(reinterpret_cast<const char*>(&unit), sizeof(unit));
+        });
+    }
+
+    bool readText(_Inout_ std::ifstream& file, _In_ uint32_t units, _Out_ std::wstring& text) {
+        std::vector<uint16_t> buffer(units);
+        text.clear();
+        if (units > 0 && !file.read(reinterpret_cast<char*>(buffer.data()), units * sizeof(uint16_t))) {
+            return false;
+        }
+        text.reserve(units);
+        for (uint32_t i = 0; i < units; i++) {
+            uint32_t code = buffer[i];
+            if (code >= 0xD800 && code < 0xDC00 && i + 1 < units && buffer[i + 1] >= 0xDC00 && buffer[i + 1] < 0xE000) {
+                code = 0x10000 + ((code - 0xD800) << 10) + (buffer[++i] - 0xDC00);
+            }
+            text += static_cast<wchar_t>(code);
+        }
+        return true;
+    }
+#endif
+}
+
+WinToastRecorder::~WinToastRecorder() {
+    stop();
+}
+
+bool WinToastRecorder::start(_In_ const std::wstring& path) {
+    std::lock_guard<std::mutex> lock(m_lock);
+    if (m_file.is_open()) {
+        return false;
+    }
+
+    m_file.open(nativePath(path).c_str(), std::ios::binary | std::ios::trunc);
+    const uint32_t header[4] = {Magic, Version, static_cast<uint32_t>(sizeof(Record)), 0};
+    m_file.write(reinterpret_cast<const char*>(header), sizeof(header));
+    if (!m_file.good()) {
+        m_file.close();
+        return false;
+    }
+
+    m_started = now();
+    m_nextObject = 0;
+    m_objects.clear();
+    m_recording.store(true, std::memory_order_relaxed);
+    return true;
+}
+
+void WinToastRecorder::stop() {
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_recording.store(false, std::memory_order_relaxed);
+    if (m_file.is_open()) {
+        m_file.close();
+    }
+    m_objects.clear();
+}
+
+uint64_t WinToastRecorder::now() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+void WinToastRecorder::record(_In_ Call call, _In_opt_ const void* object, _In_ int64_t value, _In_ int64_t value2,
+                              _In_opt_ PCWSTR first, _In_opt_ PCWSTR second) {
+    if (!isRecording()) {
+        return;
+    }
+
+    Record record{0, call, 0, value, value2, 0, {units(first), units(second)}};
+    append(record, object, first, second);
+}
+
+uint32_t WinToastRecorder::object(_In_opt_ const void* object, _In_ bool release) {
+    if (!isRecording() || object == nullptr) {
+        return 0;
+    }
+
+    std::lock_guard<std::mutex> lock(m_lock);
+    auto it = m_objects.find(object);
+    if (it == m_objects.end()) {
+        return 0;
+    }
+    const uint32_t number = it->second;
+    if (release) {
+        m_objects.erase(it);
+    }
+    return number;
+}
+
+void WinToastRecorder::recordShow(_In_ Call call, _In_ uint32_t object, _In_ int64_t id, _In_ int64_t value2, _In_ uint64_t duration,
+                                  _In_reads_bytes_opt_(bytes) const void* data, _In_ std::size_t bytes) {
+    if (!isRecording()) {
+        return;
+    }
+
+    // The payload is stored as whole UTF-16 units, an odd trailing byte is never recorded.
+    const std::size_t units = data != nullptr ? bytes / sizeof(uint16_t) : 0;
+    Record record{0, call, object, id, value2, duration, {static_cast<uint32_t>(units <= MaxStringLength ? units : 0), 0}};
+    append(record, nullptr, nullptr, nullptr, data);
+}
+
+void WinToastRecorder::append(_Inout_ Record& record, _In_opt_ const void* object, _In_opt_ PCWSTR first, _In_opt_ PCWSTR second,
+                              _In_reads_bytes_opt_(record.lengths[0] * 2) const void* payload) {
+    std::lock_guard<std::mutex> lock(m_lock);
+    if (!m_file.is_open()) {
+        return;
+    }
+
+    record.timestamp = now() - m_started;
+    if (object != nullptr) {
+        if (record.call == Create) {
+            record.object = m_objects[object] = ++m_nextObject;
+        } else {
+            auto it = m_objects.find(object);
+            if (it != m_objects.end()) {
+                record.object = it->second;
+                // The address may be reused by the next object once this one is gone.
+                if (record.call == Delete) {
+                    m_objects.erase(it);
+                }
+            }
+        }
+    }
+
+    m_file.write(reinterpret_cast<const char*>(&record), sizeof(record));
+    if (record.lengths[0] > 0) {
+        if (payload != nullptr) {
+            m_file.write(static_cast<const char*>(payload), record.lengths[0] * sizeof(uint16_t));
+        } else {
+            writeText(m_file, first, record.lengths[0]);
+        }
+    }
+    if (record.lengths[1] > 0) {
+        writeText(m_file, second, record.lengths[1]);
+    }
+}
+
+bool WinToastRecorder::load(_In_ const std::wstring& path, _Out_ std::vector<Entry>& entries) {
+    entries.clear();
+    std::ifstream file(nativePath(path).c_str(), std::ios::binary);
+    uint32_t header[4] = {};
+    file.read(reinterpret_cast<char*>(header), sizeof(header));
+    if (!file.good() || header[0] != Magic || header[1] != Version || header[2] != sizeof(Record)) {
+        return false;
+    }
+
+    Entry entry;
+    while (file.read(reinterpret_cast<char*>(&entry.record), sizeof(Record))) {
+        entry.payload.clear();
+        for (std::size_t i = 0; i < 2; i++) {
+            const uint32_t units = entry.record.lengths[i];
+            if (units > MaxStringLength) {
+                return false;
+            }
+            bool read;
+            if (i == 0 && entry.record.call == ShowDescriptor) {
+                entry.strings[i].clear();
+                entry.payload.resize(units * sizeof(uint16_t));
+                read = units == 0 || file.read(reinterpret_cast<char*>(entry.payload.data()), entry.payload.size());
+            } else {
+                read = readText(file, units, entry.strings[i]);
+            }
+            if (!read) {
+                return file.eof();
+            }
+        }
+        entries.push_back(entry);
+    }
+    // A record cut off by a crash ends the file.
+    return file.eof();
+}
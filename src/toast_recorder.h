@@ -0,0 +1,113 @@
+#ifndef TOAST_RECORDER_H
+#define TOAST_RECORDER_H
+
+#include <Windows.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace WinToastLib {
+
+    /**
+     * Records the calls made through the C API and the events delivered back.
+     *
+     * Every call is appended to a binary file as a fixed-size record followed
+     * by up to two UTF-16 strings, so a recorded workload can be replayed
+     * later with its original arguments and timing, on any host: the bench
+     * tree builds the recorder and replays recordings with toast_replay. Notification objects are
+     * recorded by a number assigned when they are created instead of their
+     * address. Recording costs one relaxed load per call while it is off.
+     */
+    class WinToastRecorder {
+    public:
+        enum Call : uint32_t {
+            Create = 1,             // strings: title, content
+            Delete,
+            AddButton,              // strings: label
+            SetImage,               // strings: path
+            SetImageFromExecutable, // strings: path
+            SetSound,               // value: option, value2: file
+            SetPriority,            // value: priority
+            SetActivationToken,     // strings: token
+            SetGroup,               // strings: group
+            SetKey,                 // strings: key
+            Show,                   // value: toast Id
+            ShowAndRelease,         // value: toast Id
+            ShowAsync,              // value: toast Id
+            TemplateArgument,       // strings: name, value; belongs to the next ShowTemplate
+            ShowTemplate,           // value: toast Id or -1, value2: template Id
+            Hide,                   // value: toast Id
+            HideGroup,              // strings: group
+            HideByKey,              // strings: key
+            Cancel,                 // value: toast Id
+            ShowDescriptor,         // value: toast Id, payload: the descriptor bytes
+
+            // Events, value: toast Id
+            Activated = 100,        // value2: action
+            Dismissed,              // value2: reason
+            Failed,
+            Completed               // value2: HRESULT
+        };
+
+        struct Record {
+            uint64_t timestamp;     // ns since the recording was started
+            uint32_t call;
+            uint32_t object;        // number of the notification object, 0 for none
+            int64_t value;
+            int64_t value2;
+            uint64_t duration;      // ns the call took, set for the show calls
+            uint32_t lengths[2];    // UTF-16 units of the strings following the record
+        };
+
+        struct Entry {
+            Record record;
+            std::wstring strings[2];
+            std::vector<uint8_t> payload;   // the binary payload of a ShowDescriptor, in place of its first string
+        };
+
+        static constexpr uint32_t MaxStringLength = 1 << 16;
+
+        ~WinToastRecorder();
+
+        bool start(_In_ const std::wstring& path);
+        void stop();
+        bool isRecording() const {
+            return m_recording.load(std::memory_order_relaxed);
+        }
+
+        // Steady clock in ns, for measuring the duration of recorded calls.
+        static uint64_t now();
+
+        void record(_In_ Call call, _In_opt_ const void* object, _In_ int64_t value = 0, _In_ int64_t value2 = 0,
+                    _In_opt_ PCWSTR first = nullptr, _In_opt_ PCWSTR second = nullptr);
+
+        // Number of a recorded notification object, 0 if it is unknown or nothing is recorded. A released
+        // object is forgotten right away, its address may be reused as soon as it is handed over.
+        uint32_t object(_In_opt_ const void* object, _In_ bool release = false);
+
+        // Records a show with the duration of the call. The object is a number returned by object(), the
+        // optional binary payload is recorded as the first string unless it is over MaxStringLength units.
+        void recordShow(_In_ Call call, _In_ uint32_t object, _In_ int64_t id, _In_ int64_t value2, _In_ uint64_t duration,
+                        _In_reads_bytes_opt_(bytes) const void* data = nullptr, _In_ std::size_t bytes = 0);
+
+        static bool load(_In_ const std::wstring& path, _Out_ std::vector<Entry>& entries);
+
+    private:
+        void append(_Inout_ Record& record, _In_opt_ const void* object, _In_opt_ PCWSTR first, _In_opt_ PCWSTR second,
+                    _In_reads_bytes_opt_(record.lengths[0] * 2) const void* payload = nullptr);
+
+        std::atomic<bool>                           m_recording{false};
+        std::mutex                                  m_lock;
+        std::ofstream                               m_file;
+        uint64_t                                    m_started{0};
+        uint32_t                                    m_nextObject{0};
+        std::unordered_map<const void*, uint32_t>   m_objects;
+    };
+}
+
+#endif // TOAST_RECORDER_H
@@ -0,0 +1,252 @@
+#include "toast_registry.h"
+
+using namespace WinToastLib;
+
+namespace {
+    // Node of an index set plus the string, an approximation of what the indexes hold per entry.
+    const std::size_t IndexEntryOverhead = sizeof(INT64) + 2 * sizeof(void*);
+
+    uint64_t now() {
+        FILETIME now;
+        GetSystemTimeAsFileTime(&now);
+        return (static_cast<uint64_t>(now.dwHighDateTime) << 32) | now.dwLowDateTime;
+    }
+}
+
+void WinToastRegistry::setCapacity(_In_ std::size_t maxCount, _In_ uint64_t maxBytes, _Out_ std::vector<Removed>& evicted) {
+    evicted.clear();
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_maxCount = maxCount;
+    m_maxBytes = maxBytes;
+    evict(-1, evicted);
+}
+
+void WinToastRegistry::insert(_In_ INT64 id, _In_ Entry entry, _Out_ std::vector<Removed>& evicted) {
+    evicted.clear();
+    if (entry.priority < 0 || entry.priority >= PriorityCount) {
+        entry.priority = 0;
+    }
+
+    std::lock_guard<std::mutex> lock(m_lock);
+    auto existing = m_entries.find(id);
+    if (existing != m_entries.end()) {
+        erase(existing);
+    }
+
+    RecencyList& lru = m_lru[entry.priority];
+    lru.push_front(id);
+    m_bytes += NodeOverhead + ownedBytes(entry) + entry.bytes;
+    index(m_groups, entry.group, id);
+    index(m_keys, entry.key, id);
+    m_entries.emplace(id, Node{std::move(entry), lru.begin()});
+    evict(id, evicted);
+}
+
+bool WinToastRegistry::find(_In_ INT64 id, _Out_ Entry& entry) const {
+    std::lock_guard<std::mutex> lock(m_lock);
+    auto it = m_entries.find(id);
+    if (it == m_entries.end()) {
+        return false;
+    }
+    entry = it->second.entry;
+    return true;
+}
+
+bool WinToastRegistry::remove(_In_ INT64 id, _Out_opt_ Entry* entry) {
+    std::lock_guard<std::mutex> lock(m_lock);
+    auto it = m_entries.find(id);
+    if (it == m_entries.end()) {
+        return false;
+    }
+    erase(it, entry);
+    return true;
+}
+
+void WinToastRegistry::removeAll(_Out_ std::vector<Removed>& removed) {
+    removed.clear();
+    std::lock_guard<std::mutex> lock(m_lock);
+    removed.reserve(m_entries.size());
+    for (auto& entry : m_entries) {
+        removed.push_back(Removed{entry.first, std::move(entry.second.entry.notification)});
+    }
+    m_entries.clear();
+    for (auto& lru : m_lru) {
+        lru.clear();
+    }
+    m_groups.clear();
+    m_keys.clear();
+    m_bytes = 0;
+}
+
+void WinToastRegistry::removeGroup(_In_ const std::wstring& group, _Out_ std::vector<Removed>& removed, _In_ int source) {
+    removed.clear();
+    std::lock_guard<std::mutex> lock(m_lock);
+    removeIndexed(m_groups, group, source, removed);
+}
+
+void WinToastRegistry::removeKey(_In_ const std::wstring& key, _Out_ std::vector<Removed>& removed, _In_ int source) {
+    removed.clear();
+    std::lock_guard<std::mutex> lock(m_lock);
+    removeIndexed(m_keys, key, source, removed);
+}
+
+std::size_t WinToastRegistry::count() const {
+    std::lock_guard<std::mutex> lock(m_lock);
+    return m_entries.size();
+}
+
+uint64_t WinToastRegistry::bytes() const {
+    std::lock_guard<std::mutex> lock(m_lock);
+    return m_bytes;
+}
+
+WinToastRegistry::DismissalReason WinToastRegistry::dismissed(_In_ INT64 id, _In_ DismissalReason reason, _In_ bool expired) {
+    if (reason != TimedOut || expired) {
+        remove(id);
+    }
+    if (reason == UserCanceled && expired) {
+        reason = TimedOut;
+    }
+    if (reason == ApplicationHidden) {
+        setState(id, Hidden);
+    } else if (expired) {
+        setState(id, Expired);
+    } else if (reason == UserCanceled) {
+        setState(id, Dismissed, reason);
+    }
+    return reason;
+}
+
+void WinToastRegistry::setState(_In_ INT64 id, _In_ State state, _In_ int32_t value) {
+    const uint64_t timestamp = now();
+    std::lock_guard<std::mutex> lock(m_lock);
+    Status& status = m_states[static_cast<uint64_t>(id) % StateSlots];
+    if (status.id != id) {
+        // Late events of an older toast must not wipe the state of the newer one holding the slot.
+        if (status.state != Unknown && sequence(id) <= sequence(status.id)) {
+            return;
+        }
+        status = Status{id, 0, 0, 0, Unknown, 0};
+    }
+    if (status.state >= Activated || state <= status.state) {
+        return;
+    }
+
+    status.state = state;
+    switch (state) {
+    case Queued:
+        status.queuedAt = timestamp;
+        break;
+    case Shown:
+        status.shownAt = timestamp;
+        break;
+    default:
+        status.endedAt = timestamp;
+        status.value = value;
+        break;
+    }
+}
+
+WinToastRegistry::State WinToastRegistry::state(_In_ INT64 id) const {
+    std::lock_guard<std::mutex> lock(m_lock);
+    const Status& status = m_states[static_cast<uint64_t>(id) % StateSlots];
+    return status.id == id ? static_cast<State>(status.state) : Unknown;
+}
+
+std::size_t WinToastRegistry::snapshot(_Out_writes_(capacity) Status* statuses, _In_ std::size_t capacity) const {
+    std::size_t copied = 0;
+    std::lock_guard<std::mutex> lock(m_lock);
+    for (std::size_t i = 0; i < StateSlots && copied < capacity; i++) {
+        if (m_states[i].state != Unknown) {
+            statuses[copied++] = m_states[i];
+        }
+    }
+    return copied;
+}
+
+std::size_t WinToastRegistry::ownedBytes(_In_ const Entry& entry) {
+    std::size_t bytes = 0;
+    if (!entry.group.empty()) {
+        bytes += entry.group.capacity() * sizeof(wchar_t) + IndexEntryOverhead;
+    }
+    if (!entry.key.empty()) {
+        bytes += entry.key.capacity() * sizeof(wchar_t) + IndexEntryOverhead;
+    }
+    return bytes;
+}
+
+void WinToastRegistry::index(_Inout_ Index& index, _In_ const std::wstring& value, _In_ INT64 id) {
+    if (!value.empty()) {
+        index[value].insert(id);
+    }
+}
+
+void WinToastRegistry::unindex(_Inout_ Index& index, _In_ const std::wstring& value, _In_ INT64 id) {
+    if (value.empty()) {
+        return;
+    }
+    auto it = index.find(value);
+    if (it != index.end()) {
+        it->second.erase(id);
+        if (it->second.empty()) {
+            index.erase(it);
+        }
+    }
+}
+
+void WinToastRegistry::removeIndexed(_In_ const Index& index, _In_ const std::wstring& value, _In_ int source,
+                                     _Out_ std::vector<Removed>& removed) {
+    auto ids = index.find(value);
+    if (value.empty() || ids == index.end()) {
+        return;
+    }
+
+    // erase() unindexes the entries, so work on a copy of the set.
+    const std::vector<INT64> matching(ids->second.begin(), ids->second.end());
+    removed.reserve(matching.size());
+    for (const INT64 id : matching) {
+        if (source != AnySource && static_cast<uint64_t>(id) >> SequenceBits != static_cast<uint64_t>(source)) {
+            continue;
+        }
+        auto it = m_entries.find(id);
+        if (it != m_entries.end()) {
+            removed.push_back(Removed{id, std::move(it->second.entry.notification)});
+            erase(it);
+        }
+    }
+}
+
+void WinToastRegistry::erase(_In_ Entries::iterator it, _Out_opt_ Entry* entry) {
+    m_bytes -= NodeOverhead + ownedBytes(it->second.entry) + it->second.entry.bytes;
+    unindex(m_groups, it->second.entry.group, it->first);
+    unindex(m_keys, it->second.entry.key, it->first);
+    m_lru[it->second.entry.priority].erase(it->second.lru);
+    // Only moved out once the accounting and the indexes no longer need the group and key.
+    if (entry != nullptr) {
+        *entry = std::move(it->second.entry);
+    }
+    m_entries.erase(it);
+}
+
+void WinToastRegistry::evict(_In_ INT64 keep, _Out_ std::vector<Removed>& evicted) {
+    while ((m_maxCount > 0 && m_entries.size() > m_maxCount) || (m_maxBytes > 0 && m_bytes > m_maxBytes)) {
+        // Oldest entry of the lowest priority, the entry that was just inserted is never a candidate.
+        auto candidate = m_entries.end();
+        for (auto& lru : m_lru) {
+            for (auto it = lru.rbegin(); it != lru.rend() && candidate == m_entries.end(); ++it) {
+                if (*it != keep) {
+                    candidate = m_entries.find(*it);
+                }
+            }
+            if (candidate != m_entries.end()) {
+                break;
+            }
+        }
+        if (candidate == m_entries.end()) {
+            return;
+        }
+
+        evicted.push_back(Removed{candidate->first, std::move(candidate->second.entry.notification)});
+        erase(candidate);
+    }
+}
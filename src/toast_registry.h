@@ -0,0 +1,161 @@
+#ifndef TOAST_REGISTRY_H
+#define TOAST_REGISTRY_H
+
+#include <Windows.h>
+#include <wrl/client.h>
+#include <windows.ui.notifications.h>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "toast_allocator.h"
+#include "toast_stats.h"
+
+namespace WinToastLib {
+
+    class IWinToastHandler;
+
+    /**
+     * Live notifications by Id, bounded by count and estimated memory.
+     *
+     * Entries are kept in one recency list per priority. When an insert
+     * exceeds the configured capacity, the least recently shown entries of
+     * the lowest priority are evicted first; the caller is expected to hide
+     * the evicted notifications. Byte accounting covers the registry's own
+     * nodes exactly plus the estimate the caller passes for everything the
+     * entry keeps alive outside of it (XML, COM objects, handler).
+     * Entries can carry a group and a caller key; both are indexed so all
+     * entries of a group or key are removed in one pass.
+     *
+     * The registry's nodes, recency lists and indexes are allocated from
+     * fixed-size pools on WinToastAllocator.
+     *
+     * Independent of the entries, the lifecycle state of the most recent
+     * StateSlots Ids is kept in a fixed table indexed by Id, so the state of
+     * a toast can be looked up in constant time also after it was removed.
+     * A slot belongs to the newest Id that was seen in it; events that
+     * arrive later for an older Id of the same slot are dropped.
+     */
+    class WinToastRegistry {
+    public:
+        static constexpr int PriorityCount = 3;
+        static constexpr std::size_t StateSlots = 1024;
+        // Ids count up in their low SequenceBits, the bits above tell apart the processes sharing a broker.
+        static constexpr unsigned SequenceBits = 58;
+        // The source of an Id is its bits above SequenceBits, 0 for the toasts of this process.
+        static constexpr int AnySource = -1;
+
+        // States only move forward, the terminal states (Activated and above) are final.
+        enum State {
+            Unknown = 0,
+            Queued,
+            Shown,
+            Activated,
+            Dismissed,
+            Expired,
+            Failed,
+            Hidden
+        };
+
+        // Mirrors ToastDismissalReason.
+        enum DismissalReason {
+            UserCanceled = 0,
+            ApplicationHidden,
+            TimedOut
+        };
+
+        struct Status {
+            INT64       id;
+            uint64_t    queuedAt;   // FILETIME, UTC, zero if the state was skipped
+            uint64_t    shownAt;
+            uint64_t    endedAt;    // set with the terminal state
+            int32_t     state;
+            int32_t     value;      // action for Activated, dismissal reason for Dismissed, HRESULT for Failed
+        };
+
+        struct Entry {
+            Microsoft::WRL::ComPtr<ABI::Windows::UI::Notifications::IToastNotification> notification;
+            std::shared_ptr<IWinToastHandler>   handler;
+            WinToastStats::TimePoint            shownAt;
+            uint64_t                            contentHash;
+            int                                 priority;
+            std::size_t                         bytes;      // estimate of the memory held outside the registry
+            std::wstring                        group;
+            std::wstring                        key;
+        };
+
+        struct Removed {
+            INT64 id;
+            Microsoft::WRL::ComPtr<ABI::Windows::UI::Notifications::IToastNotification> notification;
+        };
+
+        // Zero disables the respective limit. Entries above the new limits are evicted right away.
+        void setCapacity(_In_ std::size_t maxCount, _In_ uint64_t maxBytes, _Out_ std::vector<Removed>& evicted);
+
+        // Adds or replaces the entry for id and evicts other entries until the limits are met again.
+        void insert(_In_ INT64 id, _In_ Entry entry, _Out_ std::vector<Removed>& evicted);
+        bool find(_In_ INT64 id, _Out_ Entry& entry) const;
+        bool remove(_In_ INT64 id, _Out_opt_ Entry* entry = nullptr);
+        void removeAll(_Out_ std::vector<Removed>& removed);
+        // Only toasts whose Ids are of source are removed, unless it is AnySource.
+        void removeGroup(_In_ const std::wstring& group, _Out_ std::vector<Removed>& removed, _In_ int source = AnySource);
+        void removeKey(_In_ const std::wstring& key, _Out_ std::vector<Removed>& removed, _In_ int source = AnySource);
+
+        std::size_t count() const;
+        uint64_t bytes() const;
+
+        // Applies a Dismissed event of id: the toast is removed and ended unless it only timed out into the
+        // Action Center and has not expired. Returns the reason to report, UserCanceled after expiry is TimedOut.
+        DismissalReason dismissed(_In_ INT64 id, _In_ DismissalReason reason, _In_ bool expired);
+
+        void setState(_In_ INT64 id, _In_ State state, _In_ int32_t value = 0);
+        State state(_In_ INT64 id) const;
+        // Copies the tracked states of up to capacity toasts in one critical section. Returns the number copied.
+        std::size_t snapshot(_Out_writes_(capacity) Status* statuses, _In_ std::size_t capacity) const;
+
+    private:
+        typedef std::list<INT64, WinToastPoolAllocator<INT64>> RecencyList;
+
+        struct Node {
+            Entry                   entry;
+            RecencyList::iterator   lru;
+        };
+
+        typedef std::unordered_map<INT64, Node, std::hash<INT64>, std::equal_to<INT64>,
+                                   WinToastPoolAllocator<std::pair<const INT64, Node>>> Entries;
+        typedef std::unordered_set<INT64, std::hash<INT64>, std::equal_to<INT64>, WinToastPoolAllocator<INT64>> IdSet;
+
+        // Map node, list node and the entry itself. Allocator headers are not included.
+        static constexpr std::size_t NodeOverhead = sizeof(std::pair<const INT64, Node>) + 2 * sizeof(void*)
+                                                  + sizeof(INT64) + 2 * sizeof(void*);
+
+        typedef std::unordered_map<std::wstring, IdSet, std::hash<std::wstring>, std::equal_to<std::wstring>,
+                                   WinToastPoolAllocator<std::pair<const std::wstring, IdSet>>> Index;
+
+        static std::size_t ownedBytes(_In_ const Entry& entry);
+        static uint64_t sequence(_In_ INT64 id) {
+            return static_cast<uint64_t>(id) & ((uint64_t(1) << SequenceBits) - 1);
+        }
+        static void index(_Inout_ Index& index, _In_ const std::wstring& value, _In_ INT64 id);
+        static void unindex(_Inout_ Index& index, _In_ const std::wstring& value, _In_ INT64 id);
+
+        void erase(_In_ Entries::iterator it, _Out_opt_ Entry* entry = nullptr);
+        void removeIndexed(_In_ const Index& index, _In_ const std::wstring& value, _In_ int source, _Out_ std::vector<Removed>& removed);
+        void evict(_In_ INT64 keep, _Out_ std::vector<Removed>& evicted);
+
+        mutable std::mutex                  m_lock;
+        Entries                             m_entries;
+        RecencyList                         m_lru[PriorityCount];  // front is the most recently shown
+        Index                               m_groups;
+        Index                               m_keys;
+        std::size_t                         m_maxCount{0};
+        uint64_t                            m_maxBytes{0};
+        uint64_t                            m_bytes{0};
+        Status                              m_states[StateSlots]{};
+    };
+}
+
+#endif // TOAST_REGISTRY_H
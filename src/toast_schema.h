@@ -0,0 +1,156 @@
+#ifndef TOAST_SCHEMA_H
+#define TOAST_SCHEMA_H
+
+#include "toast_template.h"
+
+namespace WinToastLib {
+
+    /**
+     * Compile-time description of the toast schema.
+     *
+     * Everything the template and the XML builder need to know about template
+     * types, system sounds, scenarios and durations lives in constant tables
+     * indexed by the enum value, so lookups neither hash nor allocate and can
+     * be evaluated by the compiler.
+     */
+    namespace ToastSchema {
+
+        constexpr std::size_t TemplateTypeCount = 8;
+        constexpr std::size_t AudioSystemFileCount = WinToastTemplate::Call10 + 1;
+        constexpr std::size_t MaxTextFields = 3;
+        // Characters of a line of toast text, generous so that Windows still clips before we shorten.
+        constexpr std::size_t CharactersPerLine = 64;
+
+        namespace Detail {
+            constexpr std::size_t TextFieldsCount[TemplateTypeCount] = { 1, 2, 2, 3, 1, 2, 2, 3 };
+
+            // Lines each text field wraps to, as documented for the legacy templates.
+            constexpr std::size_t TextFieldLines[TemplateTypeCount][MaxTextFields] = {
+                { 3, 0, 0 }, { 1, 2, 0 }, { 2, 1, 0 }, { 1, 1, 1 },
+                { 3, 0, 0 }, { 1, 2, 0 }, { 2, 1, 0 }, { 1, 1, 1 },
+            };
+
+            constexpr const wchar_t* TemplateNames[TemplateTypeCount] = {
+                L"ToastImageAndText01", L"ToastImageAndText02", L"ToastImageAndText03", L"ToastImageAndText04",
+                L"ToastText01", L"ToastText02", L"ToastText03", L"ToastText04",
+            };
+
+            constexpr const wchar_t* AudioFiles[AudioSystemFileCount] = {
+                L"ms-winsoundevent:Notification.Default",
+                L"ms-winsoundevent:Notification.IM",
+                L"ms-winsoundevent:Notification.Mail",
+                L"ms-winsoundevent:Notification.Reminder",
+                L"ms-winsoundevent:Notification.SMS",
+                L"ms-winsoundevent:Notification.Looping.Alarm",
+                L"ms-winsoundevent:Notification.Looping.Alarm2",
+                L"ms-winsoundevent:Notification.Looping.Alarm3",
+                L"ms-winsoundevent:Notification.Looping.Alarm4",
+                L"ms-winsoundevent:Notification.Looping.Alarm5",
+                L"ms-winsoundevent:Notification.Looping.Alarm6",
+                L"ms-winsoundevent:Notification.Looping.Alarm7",
+                L"ms-winsoundevent:Notification.Looping.Alarm8",
+                L"ms-winsoundevent:Notification.Looping.Alarm9",
+                L"ms-winsoundevent:Notification.Looping.Alarm10",
+                L"ms-winsoundevent:Notification.Looping.Call",
+                L"ms-winsoundevent:Notification.Looping.Call1",
+                L"ms-winsoundevent:Notification.Looping.Call2",
+                L"ms-winsoundevent:Notification.Looping.Call3",
+                L"ms-winsoundevent:Notification.Looping.Call4",
+                L"ms-winsoundevent:Notification.Looping.Call5",
+                L"ms-winsoundevent:Notification.Looping.Call6",
+                L"ms-winsoundevent:Notification.Looping.Call7",
+                L"ms-winsoundevent:Notification.Looping.Call8",
+                L"ms-winsoundevent:Notification.Looping.Call9",
+                L"ms-winsoundevent:Notification.Looping.Call10",
+            };
+
+            constexpr const wchar_t* Scenarios[] = { L"Default", L"Alarm", L"IncomingCall", L"Reminder" };
+            constexpr const wchar_t* Durations[] = { nullptr, L"short", L"long" };
+        }
+
+        constexpr bool isValid(_In_ WinToastTemplate::WinToastTemplateType type) {
+            return static_cast<std::size_t>(type) < TemplateTypeCount;
+        }
+
+        constexpr std::size_t textFieldsCount(_In_ WinToastTemplate::WinToastTemplateType type) {
+            return isValid(type) ? Detail::TextFieldsCount[type] : 0;
+        }
+
+        // Characters of the field Windows can show, 0 if the template type has no such field.
+        constexpr std::size_t textBudget(_In_ WinToastTemplate::WinToastTemplateType type, _In_ WinToastTemplate::TextField field) {
+            return isValid(type) && static_cast<std::size_t>(field) < MaxTextFields
+                ? Detail::TextFieldLines[type][field] * CharactersPerLine : 0;
+        }
+
+        // Name of the legacy template in the binding element.
+        constexpr const wchar_t* templateName(_In_ WinToastTemplate::WinToastTemplateType type) {
+            return isValid(type) ? Detail::TemplateNames[type] : nullptr;
+        }
+
+        constexpr bool hasImage(_In_ WinToastTemplate::WinToastTemplateType type) {
+            return type < WinToastTemplate::Text01;
+        }
+
+        constexpr const wchar_t* audioFile(_In_ WinToastTemplate::AudioSystemFile file) {
+            return static_cast<std::size_t>(file) < AudioSystemFileCount ? Detail::AudioFiles[file] : nullptr;
+        }
+
+        constexpr const wchar_t* scenarioName(_In_ WinToastTemplate::Scenario scenario) {
+            return Detail::Scenarios[static_cast<std::size_t>(scenario)];
+        }
+
+        // Returns nullptr for Duration::System, which leaves the attribute unset.
+        constexpr const wchar_t* durationName(_In_ WinToastTemplate::Duration duration) {
+            return Detail::Durations[duration];
+        }
+
+        static_assert(textFieldsCount(WinToastTemplate::ImageAndText04) == 3, "text field table out of sync");
+        static_assert(textFieldsCount(WinToastTemplate::Text01) == 1, "text field table out of sync");
+        static_assert(textBudget(WinToastTemplate::Text04, WinToastTemplate::ThirdLine) != 0
+                      && textBudget(WinToastTemplate::ImageAndText03, WinToastTemplate::ThirdLine) == 0, "text budget table out of sync");
+        static_assert(!hasImage(WinToastTemplate::Text04) && hasImage(WinToastTemplate::ImageAndText04), "image templates out of sync");
+        static_assert(sizeof(Detail::Scenarios) / sizeof(Detail::Scenarios[0]) == static_cast<std::size_t>(WinToastTemplate::Scenario::Reminder) + 1,
+                      "scenario table out of sync");
+        static_assert(sizeof(Detail::Durations) / sizeof(Detail::Durations[0]) == WinToastTemplate::Long + 1, "duration table out of sync");
+    }
+
+    /**
+     * Template whose type is fixed at compile time.
+     *
+     * Text fields and the image can only be set where the template type has
+     * them; other positions fail to compile instead of asserting at runtime.
+     * It converts to WinToastTemplate and can be shown like any other template.
+     */
+    template <WinToastTemplate::WinToastTemplateType Type>
+    class WinToastTypedTemplate : public WinToastTemplate {
+        static_assert(ToastSchema::isValid(Type), "unknown template type");
+
+    public:
+        WinToastTypedTemplate() : WinToastTemplate(Type) {}
+
+        template <WinToastTemplate::TextField Position>
+        void setTextField(_In_ const std::wstring& text) {
+            static_assert(static_cast<std::size_t>(Position) < ToastSchema::textFieldsCount(Type), "template type has no text field at this position");
+            WinToastTemplate::setTextField(text, Position);
+        }
+
+        void setFirstLine(_In_ const std::wstring& text) {
+            setTextField<WinToastTemplate::FirstLine>(text);
+        }
+
+        void setSecondLine(_In_ const std::wstring& text) {
+            setTextField<WinToastTemplate::SecondLine>(text);
+        }
+
+        void setThirdLine(_In_ const std::wstring& text) {
+            setTextField<WinToastTemplate::ThirdLine>(text);
+        }
+
+        void setImagePath(_In_ const std::wstring& imgPath) {
+            static_assert(ToastSchema::hasImage(Type), "template type has no image");
+            WinToastTemplate::setImagePath(imgPath);
+        }
+    };
+}
+
+#endif // TOAST_SCHEMA_H
@@ -0,0 +1,160 @@
+#include "toast_stats.h"
+
+using namespace WinToastLib;
+
+namespace {
+    unsigned highestBit(uint64_t value) {
+        unsigned bit = 0;
+        for (unsigned shift = 32; shift > 0; shift >>= 1) {
+            if (value >> shift) {
+                value >>= shift;
+                bit += shift;
+            }
+        }
+        return bit;
+    }
+
+    void storeMax(std::atomic<uint64_t>& target, uint64_t value) {
+        uint64_t current = target.load(std::memory_order_relaxed);
+        while (current < value && !target.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+        }
+    }
+}
+
+unsigned WinToastStats::bucketIndex(uint64_t ns) {
+    if (ns < (1u << SubBucketBits)) {
+        return static_cast<unsigned>(ns);
+    }
+    const unsigned msb = highestBit(ns);
+    if (msb > MaxExponent) {
+        return BucketCount - 1;
+    }
+    const unsigned sub = static_cast<unsigned>(ns >> (msb - SubBucketBits)) & ((1u << SubBucketBits) - 1);
+    return ((msb - SubBucketBits + 1) << SubBucketBits) + sub;
+}
+
+uint64_t WinToastStats::bucketUpperBound(unsigned index) {
+    if (index < (1u << SubBucketBits)) {
+        return index;
+    }
+    const unsigned msb = (index >> SubBucketBits) + SubBucketBits - 1;
+    const uint64_t sub = index & ((1u << SubBucketBits) - 1);
+    const uint64_t width = uint64_t(1) << (msb - SubBucketBits);
+    return (uint64_t(1) << msb) + (sub + 1) * width - 1;
+}
+
+WinToastStats::Shard& WinToastStats::localShard() {
+    static std::atomic<unsigned> nextShard{0};
+    thread_local const unsigned shard = nextShard.fetch_add(1, std::memory_order_relaxed) % ShardCount;
+    return m_shards[shard];
+}
+
+WinToastStats::TimePoint WinToastStats::lap(Stage stage, TimePoint begin) {
+    const TimePoint end = now();
+    record(stage, begin, end);
+    return end;
+}
+
+void WinToastStats::record(Stage stage, TimePoint begin, TimePoint end) {
+    const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count();
+    recordNs(stage, elapsed > 0 ? static_cast<uint64_t>(elapsed) : 0);
+}
+
+void WinToastStats::recordNs(Stage stage, uint64_t ns) {
+    Shard& shard = localShard();
+    shard.buckets[stage][bucketIndex(ns)].fetch_add(1, std::memory_order_relaxed);
+    shard.sumNs[stage].fetch_add(ns, std::memory_order_relaxed);
+    storeMax(shard.maxNs[stage], ns);
+}
+
+void WinToastStats::increment(Counter counter) {
+    localShard().counters[counter].fetch_add(1, std::memory_order_relaxed);
+}
+
+void WinToastStats::recordFailure(int32_t hr) {
+    for (auto& slot : m_failures) {
+        int32_t current = slot.hr.load(std::memory_order_acquire);
+        if (current == 0 && slot.hr.compare_exchange_strong(current, hr, std::memory_order_acq_rel)) {
+            current = hr;
+        }
+        if (current == hr) {
+            slot.count.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+    }
+    // Table is full, account the failure under the last slot's code.
+    m_failures[MaxFailureCodes - 1].count.fetch_add(1, std::memory_order_relaxed);
+}
+
+void WinToastStats::snapshot(Snapshot& out) const {
+    out = Snapshot{};
+
+    for (unsigned stage = 0; stage < StageCount; stage++) {
+        uint64_t buckets[BucketCount] = {};
+        Latency& latency = out.stages[stage];
+        for (const auto& shard : m_shards) {
+            for (unsigned i = 0; i < BucketCount; i++) {
+                const uint64_t count = shard.buckets[stage][i].load(std::memory_order_relaxed);
+                buckets[i] += count;
+                latency.count += count;
+            }
+            latency.sumNs += shard.sumNs[stage].load(std::memory_order_relaxed);
+            const uint64_t max = shard.maxNs[stage].load(std::memory_order_relaxed);
+            if (max > latency.maxNs) {
+                latency.maxNs = max;
+            }
+        }
+
+        const uint64_t p50Rank = (latency.count + 1) / 2;
+        const uint64_t p99Rank = latency.count - latency.count / 100;
+        uint64_t seen = 0;
+        for (unsigned i = 0; i < BucketCount && seen < p99Rank; i++) {
+            seen += buckets[i];
+            if (latency.p50Ns == 0 && seen >= p50Rank) {
+                latency.p50Ns = bucketUpperBound(i);
+            }
+            if (seen >= p99Rank) {
+                latency.p99Ns = bucketUpperBound(i);
+            }
+        }
+        if (latency.p50Ns > latency.maxNs) latency.p50Ns = latency.maxNs;
+        if (latency.p99Ns > latency.maxNs) latency.p99Ns = latency.maxNs;
+    }
+
+    for (unsigned counter = 0; counter < CounterCount; counter++) {
+        for (const auto& shard : m_shards) {
+            out.counters[counter] += shard.counters[counter].load(std::memory_order_relaxed);
+        }
+    }
+
+    for (const auto& slot : m_failures) {
+        const int32_t hr = slot.hr.load(std::memory_order_acquire);
+        if (hr == 0) {
+            break;
+        }
+        out.failures[out.failureCount].hr = hr;
+        out.failures[out.failureCount].count = slot.count.load(std::memory_order_relaxed);
+        out.failureCount++;
+    }
+}
+
+void WinToastStats::reset() {
+    for (auto& shard : m_shards) {
+        for (auto& stage : shard.buckets) {
+            for (auto& bucket : stage) {
+                bucket.store(0, std::memory_order_relaxed);
+            }
+        }
+        for (unsigned stage = 0; stage < StageCount; stage++) {
+            shard.sumNs[stage].store(0, std::memory_order_relaxed);
+            shard.maxNs[stage].store(0, std::memory_order_relaxed);
+        }
+        for (auto& counter : shard.counters) {
+            counter.store(0, std::memory_order_relaxed);
+        }
+    }
+    for (auto& slot : m_failures) {
+        slot.count.store(0, std::memory_order_relaxed);
+        slot.hr.store(0, std::memory_order_release);
+    }
+}
@@ -0,0 +1,106 @@
+#ifndef TOAST_STATS_H
+#define TOAST_STATS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace WinToastLib {
+
+    /**
+     * Latency histograms and counters for the show path.
+     *
+     * Samples are recorded into a small set of cache-line aligned shards picked
+     * per thread, so concurrent callers don't contend on the same counters.
+     * Every histogram is log-linear: each power of two of nanoseconds is split
+     * into four linear sub-buckets, which bounds the quantile error to 25%.
+     */
+    class WinToastStats {
+    public:
+        enum Stage {
+            FactoryLookup = 0,
+            XmlBuild,
+            CreateNotification,
+            RegisterHandlers,
+            Show,
+            ShowTotal,
+            ShowToActivation,
+            ShowToDismissal,
+            StageCount
+        };
+
+        enum Counter {
+            Shown = 0,
+            Failed,
+            Activated,
+            Dismissed,
+            CounterCount
+        };
+
+        struct Latency {
+            uint64_t count;
+            uint64_t sumNs;
+            uint64_t p50Ns;
+            uint64_t p99Ns;
+            uint64_t maxNs;
+        };
+
+        struct Failure {
+            int32_t hr;
+            uint64_t count;
+        };
+
+        static constexpr std::size_t MaxFailureCodes = 16;
+
+        struct Snapshot {
+            uint64_t counters[CounterCount];
+            Latency stages[StageCount];
+            Failure failures[MaxFailureCodes];
+            std::size_t failureCount;
+        };
+
+        typedef std::chrono::steady_clock::time_point TimePoint;
+
+        static TimePoint now() {
+            return std::chrono::steady_clock::now();
+        }
+
+        // Records the time elapsed since begin and returns the current time,
+        // so consecutive stages can be chained.
+        TimePoint lap(Stage stage, TimePoint begin);
+        void record(Stage stage, TimePoint begin, TimePoint end);
+        void recordNs(Stage stage, uint64_t ns);
+        void increment(Counter counter);
+        void recordFailure(int32_t hr);
+        void snapshot(Snapshot& out) const;
+        void reset();
+
+    private:
+        static constexpr unsigned SubBucketBits = 2;
+        static constexpr unsigned MaxExponent = 40;
+        static constexpr unsigned BucketCount = (MaxExponent + 1) << SubBucketBits;
+        static constexpr std::size_t ShardCount = 8;
+
+        struct alignas(64) Shard {
+            std::atomic<uint64_t> buckets[StageCount][BucketCount];
+            std::atomic<uint64_t> sumNs[StageCount];
+            std::atomic<uint64_t> maxNs[StageCount];
+            std::atomic<uint64_t> counters[CounterCount];
+        };
+
+        struct FailureSlot {
+            std::atomic<int32_t> hr;
+            std::atomic<uint64_t> count;
+        };
+
+        static unsigned bucketIndex(uint64_t ns);
+        static uint64_t bucketUpperBound(unsigned index);
+        Shard& localShard();
+
+        Shard m_shards[ShardCount]{};
+        FailureSlot m_failures[MaxFailureCodes]{};
+    };
+}
+
+#endif // TOAST_STATS_H
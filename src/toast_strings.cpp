@@ -0,0 +1,140 @@
+#include "toast_strings.h"
+#include <atomic>
+#include <cassert>
+#include <mutex>
+#include <unordered_map>
+
+using namespace WinToastLib;
+
+namespace {
+    struct Slot {
+        std::wstring            value;
+        std::atomic<uint32_t>   refs{0};
+        uint32_t                nextFree{0};
+    };
+
+    struct ValueHash {
+        std::size_t operator()(const std::wstring* value) const { return std::hash<std::wstring>()(*value); }
+    };
+
+    struct ValueEqual {
+        bool operator()(const std::wstring* a, const std::wstring* b) const { return *a == *b; }
+    };
+
+    // Handles are slot index + 1. The map keys point at the slot's own string.
+    struct Pool {
+        std::mutex                                                                  lock;
+        std::atomic<Slot*>                                                          chunks[WinToastStringPool::MaxChunks]{};
+        std::unordered_map<const std::wstring*, WinToastStringPool::Handle, ValueHash, ValueEqual> handles;
+        std::size_t                                                                 chunkCount{0};
+        uint32_t                                                                    freeList{0};
+        std::size_t                                                                 characterBytes{0};
+
+        Slot& slot(WinToastStringPool::Handle handle) const {
+            const std::size_t index = handle - 1;
+            return chunks[index / WinToastStringPool::ChunkSize].load(std::memory_order_acquire)[index % WinToastStringPool::ChunkSize];
+        }
+
+        WinToastStringPool::Handle allocate() {
+            if (freeList == 0) {
+                if (chunkCount == WinToastStringPool::MaxChunks) {
+                    return 0;
+                }
+                Slot* chunk = new Slot[WinToastStringPool::ChunkSize];
+                chunks[chunkCount].store(chunk, std::memory_order_release);
+                const auto first = static_cast<WinToastStringPool::Handle>(chunkCount * WinToastStringPool::ChunkSize + 1);
+                chunkCount++;
+                for (std::size_t i = WinToastStringPool::ChunkSize; i-- > 0;) {
+                    chunk[i].nextFree = freeList;
+                    freeList = first + static_cast<uint32_t>(i);
+                }
+            }
+            const WinToastStringPool::Handle handle = freeList;
+            freeList = slot(handle).nextFree;
+            return handle;
+        }
+    };
+
+    // Never destroyed, templates held by other statics may still release their strings at exit.
+    Pool& pool() {
+        static Pool* instance = new Pool();
+        return *instance;
+    }
+
+    const std::wstring EmptyString;
+}
+
+WinToastStringPool::Handle WinToastStringPool::intern(_In_ const std::wstring& value) {
+    if (value.empty()) {
+        return 0;
+    }
+
+    Pool& p = pool();
+    std::lock_guard<std::mutex> lock(p.lock);
+    auto existing = p.handles.find(&value);
+    if (existing != p.handles.end()) {
+        p.slot(existing->second).refs.fetch_add(1, std::memory_order_relaxed);
+        return existing->second;
+    }
+
+    const Handle handle = p.allocate();
+    assert(handle != 0);
+    if (handle == 0) {
+        return 0;
+    }
+    Slot& slot = p.slot(handle);
+    slot.value = value;
+    slot.refs.store(1, std::memory_order_relaxed);
+    p.handles.emplace(&slot.value, handle);
+    p.characterBytes += slot.value.capacity() * sizeof(wchar_t);
+    return handle;
+}
+
+void WinToastStringPool::addRef(_In_ Handle handle) {
+    if (handle != 0) {
+        pool().slot(handle).refs.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void WinToastStringPool::release(_In_ Handle handle) {
+    if (handle == 0) {
+        return;
+    }
+
+    // Only the last reference is dropped under the lock, so intern can never revive a string that is being freed.
+    Pool& p = pool();
+    Slot& slot = p.slot(handle);
+    uint32_t refs = slot.refs.load(std::memory_order_relaxed);
+    while (refs > 1) {
+        if (slot.refs.compare_exchange_weak(refs, refs - 1, std::memory_order_release, std::memory_order_relaxed)) {
+            return;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(p.lock);
+    if (slot.refs.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+        return;
+    }
+    p.handles.erase(&slot.value);
+    p.characterBytes -= slot.value.capacity() * sizeof(wchar_t);
+    std::wstring().swap(slot.value);
+    slot.nextFree = p.freeList;
+    p.freeList = handle;
+}
+
+const std::wstring& WinToastStringPool::get(_In_ Handle handle) {
+    return handle != 0 ? pool().slot(handle).value : EmptyString;
+}
+
+std::size_t WinToastStringPool::count() {
+    Pool& p = pool();
+    std::lock_guard<std::mutex> lock(p.lock);
+    return p.handles.size();
+}
+
+std::size_t WinToastStringPool::memoryUsage() {
+    Pool& p = pool();
+    std::lock_guard<std::mutex> lock(p.lock);
+    return p.chunkCount * ChunkSize * sizeof(Slot) + p.characterBytes
+         + p.handles.size() * (sizeof(std::pair<const std::wstring*, Handle>) + 2 * sizeof(void*));
+}
@@ -0,0 +1,74 @@
+#ifndef TOAST_STRINGS_H
+#define TOAST_STRINGS_H
+
+#include <sal.h>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+
+namespace WinToastLib {
+
+    /**
+     * Process-wide pool of immutable, reference counted strings.
+     *
+     * Equal strings are stored once and referred to by a 32-bit handle, so
+     * button labels, image paths and audio URIs that recur across thousands
+     * of toasts cost one copy each. Strings live in fixed-size chunks that
+     * never move, so reading the string of a handle takes no lock; interning
+     * and releasing the last reference take the pool lock. A string is freed
+     * when its last reference is released and its slot is reused.
+     */
+    class WinToastStringPool {
+    public:
+        typedef uint32_t Handle;    // 0 is the empty string
+
+        static constexpr std::size_t ChunkSize = 1024;
+        static constexpr std::size_t MaxChunks = 4096;
+
+        // Returns a handle holding one reference.
+        static Handle intern(_In_ const std::wstring& value);
+        static void addRef(_In_ Handle handle);
+        static void release(_In_ Handle handle);
+        static const std::wstring& get(_In_ Handle handle);
+
+        static std::size_t count();
+        // Slot chunks plus the character buffers of the pooled strings.
+        static std::size_t memoryUsage();
+    };
+
+    // Owning reference to a pooled string. Equal strings have equal handles.
+    class WinToastString {
+    public:
+        WinToastString() = default;
+        explicit WinToastString(_In_ const std::wstring& value) : m_handle(WinToastStringPool::intern(value)) {}
+        WinToastString(_In_ const WinToastString& other) : m_handle(other.m_handle) {
+            WinToastStringPool::addRef(m_handle);
+        }
+        WinToastString(_In_ WinToastString&& other) noexcept : m_handle(other.m_handle) {
+            other.m_handle = 0;
+        }
+        ~WinToastString() {
+            WinToastStringPool::release(m_handle);
+        }
+
+        WinToastString& operator=(_In_ WinToastString other) {
+            std::swap(m_handle, other.m_handle);
+            return *this;
+        }
+
+        bool operator==(_In_ const WinToastString& other) const { return m_handle == other.m_handle; }
+        bool operator!=(_In_ const WinToastString& other) const { return m_handle != other.m_handle; }
+
+        const std::wstring& str() const { return WinToastStringPool::get(m_handle); }
+        bool empty() const { return m_handle == 0; }
+        WinToastStringPool::Handle handle() const { return m_handle; }
+
+    private:
+        WinToastStringPool::Handle m_handle{0};
+    };
+
+    static_assert(sizeof(WinToastString) == sizeof(uint32_t), "pooled strings are held by handle");
+}
+
+#endif // TOAST_STRINGS_H
@@ -0,0 +1,185 @@
+/* * Copyright (C) 2016-2019 Mohammed Boujemaoui <mohabouje@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "toast_template.h"
+#include "toast_arguments.h"
+#include "toast_schema.h"
+#include <cassert>
+
+using namespace WinToastLib;
+
+WinToastTemplate::WinToastTemplate(_In_ WinToastTemplateType type) : m_type(type) {
+	assert(ToastSchema::isValid(type));
+	m_textFields = std::vector<std::wstring>(ToastSchema::textFieldsCount(type), L"");
+}
+
+WinToastTemplate::~WinToastTemplate() {
+	m_textFields.clear();
+}
+
+void WinToastTemplate::setTextField(_In_ const std::wstring& txt, _In_ WinToastTemplate::TextField pos) {
+	const auto position = static_cast<std::size_t>(pos);
+	assert(position < m_textFields.size());
+	m_textFields[position] = txt;
+}
+
+void WinToastTemplate::setImagePath(_In_ const std::wstring& imgPath) {
+	m_imagePath = WinToastString(imgPath);
+}
+
+void WinToastTemplate::setAudioPath(_In_ const std::wstring& audioPath) {
+	m_audioPath = WinToastString(audioPath);
+}
+
+void WinToastTemplate::setAudioPath(_In_ AudioSystemFile file) {
+	const wchar_t* path = ToastSchema::audioFile(file);
+	assert(path != nullptr);
+	if (path != nullptr) {
+		m_audioPath = WinToastString(path);
+	}
+}
+
+void WinToastTemplate::setAudioOption(_In_ WinToastTemplate::AudioOption audioOption) {
+	m_audioOption = audioOption;
+}
+
+void WinToastTemplate::setFirstLine(_In_ const std::wstring &text) {
+	setTextField(text, WinToastTemplate::FirstLine);
+}
+
+void WinToastTemplate::setSecondLine(_In_ const std::wstring &text) {
+	setTextField(text, WinToastTemplate::SecondLine);
+}
+
+void WinToastTemplate::setThirdLine(_In_ const std::wstring &text) {
+	setTextField(text, WinToastTemplate::ThirdLine);
+}
+
+void WinToastTemplate::setDuration(_In_ Duration duration) {
+	m_duration = duration;
+}
+
+void WinToastTemplate::setExpiration(_In_ int64_t millisecondsFromNow) {
+	m_expiration = millisecondsFromNow;
+}
+
+void WinToastLib::WinToastTemplate::setScenario(Scenario scenario) {
+	m_scenario = scenario;
+}
+
+void WinToastTemplate::setAttributionText(_In_ const std::wstring& attributionText) {
+	m_attributionText = attributionText;
+}
+
+void WinToastTemplate::setPriority(_In_ Priority priority) {
+	m_priority = priority;
+}
+
+void WinToastTemplate::setGroup(_In_ const std::wstring& group) {
+	m_group = group;
+}
+
+void WinToastTemplate::setKey(_In_ const std::wstring& key) {
+	m_key = key;
+}
+
+void WinToastTemplate::setActivationToken(_In_ const std::wstring& token) {
+	assert(token.size() <= WinToastArguments::MaxTokenLength);
+	m_activationToken = token.substr(0, WinToastArguments::MaxTokenLength);
+}
+
+void WinToastTemplate::addAction(_In_ const std::wstring & label) {
+	m_actions.emplace_back(label);
+}
+
+std::size_t WinToastTemplate::textFieldsCount() const {
+	return m_textFields.size();
+}
+
+std::size_t WinToastTemplate::actionsCount() const {
+	return m_actions.size();
+}
+
+bool WinToastTemplate::hasImage() const {
+	return ToastSchema::hasImage(m_type);
+}
+
+const std::vector<std::wstring>& WinToastTemplate::textFields() const {
+	return m_textFields;
+}
+
+const std::wstring& WinToastTemplate::textField(_In_ TextField pos) const {
+	const auto position = static_cast<std::size_t>(pos);
+	assert(position < m_textFields.size());
+	return m_textFields[position];
+}
+
+const std::wstring& WinToastTemplate::actionLabel(_In_ std::size_t position) const {
+	assert(position < m_actions.size());
+	return m_actions[position].str();
+}
+
+const std::wstring& WinToastTemplate::imagePath() const {
+	return m_imagePath.str();
+}
+
+const std::wstring& WinToastTemplate::audioPath() const {
+	return m_audioPath.str();
+}
+
+const std::wstring& WinToastTemplate::attributionText() const {
+	return m_attributionText;
+}
+
+const std::wstring& WinToastTemplate::activationToken() const {
+	return m_activationToken;
+}
+
+WinToastTemplate::Priority WinToastTemplate::priority() const {
+	return m_priority;
+}
+
+const std::wstring& WinToastTemplate::group() const {
+	return m_group;
+}
+
+const std::wstring& WinToastTemplate::key() const {
+	return m_key;
+}
+
+WinToastTemplate::Scenario WinToastTemplate::scenario() const {
+	return m_scenario;
+}
+
+int64_t WinToastTemplate::expiration() const {
+	return m_expiration;
+}
+
+WinToastTemplate::WinToastTemplateType WinToastTemplate::type() const {
+	return m_type;
+}
+
+WinToastTemplate::AudioOption WinToastTemplate::audioOption() const {
+	return m_audioOption;
+}
+
+WinToastTemplate::Duration WinToastTemplate::duration() const {
+	return m_duration;
+}
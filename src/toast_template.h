@@ -0,0 +1,148 @@
+/* * Copyright (C) 2016-2019 Mohammed Boujemaoui <mohabouje@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef TOAST_TEMPLATE_H
+#define TOAST_TEMPLATE_H
+
+#include <sal.h>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "toast_strings.h"
+
+namespace WinToastLib {
+
+    class WinToast;
+
+    class WinToastTemplate {
+    public:
+        enum class Scenario { Default, Alarm, IncomingCall, Reminder };
+        enum Duration { System, Short, Long };
+        enum AudioOption { Default = 0, Silent, Loop };
+        enum Priority { Low = 0, Normal, High };
+        enum TextField { FirstLine = 0, SecondLine, ThirdLine };
+        enum WinToastTemplateType {
+            ImageAndText01 = 0, // Number of fields 1
+            ImageAndText02 = 1, // Number of fields 2
+            ImageAndText03 = 2, // Number of fields 2
+            ImageAndText04 = 3, // Number of fields 3
+            Text01 = 4, // Number of fields 1
+            Text02 = 5, // Number of fields 2
+            Text03 = 6, // Number of fields 2
+            Text04 = 7, // Number of fields 3
+        };
+
+        enum AudioSystemFile {
+            DefaultSound,
+            IM,
+            Mail,
+            Reminder,
+            SMS,
+            Alarm,
+            Alarm2,
+            Alarm3,
+            Alarm4,
+            Alarm5,
+            Alarm6,
+            Alarm7,
+            Alarm8,
+            Alarm9,
+            Alarm10,
+            Call,
+            Call1,
+            Call2,
+            Call3,
+            Call4,
+            Call5,
+            Call6,
+            Call7,
+            Call8,
+            Call9,
+            Call10,
+        };
+
+
+        WinToastTemplate(_In_ WinToastTemplateType type = WinToastTemplateType::ImageAndText02);
+        WinToastTemplate(_In_ const WinToastTemplate& other) = default;
+        WinToastTemplate(_In_ WinToastTemplate&& other) = default;
+        ~WinToastTemplate();
+        WinToastTemplate& operator=(_In_ const WinToastTemplate& other) = default;
+        WinToastTemplate& operator=(_In_ WinToastTemplate&& other) = default;
+
+        void setFirstLine(_In_ const std::wstring& text);
+        void setSecondLine(_In_ const std::wstring& text);
+        void setThirdLine(_In_ const std::wstring& text);
+        void setTextField(_In_ const std::wstring& txt, _In_ TextField pos);
+        void setAttributionText(_In_ const std::wstring& attributionText);
+        void setImagePath(_In_ const std::wstring& imgPath);
+        void setAudioPath(_In_ WinToastTemplate::AudioSystemFile audio);
+        void setAudioPath(_In_ const std::wstring& audioPath);
+        void setAudioOption(_In_ WinToastTemplate::AudioOption audioOption);
+        void setDuration(_In_ Duration duration);
+        void setExpiration(_In_ int64_t millisecondsFromNow);
+        void setScenario(_In_ Scenario scenario);
+        void setActivationToken(_In_ const std::wstring& token);
+        void setPriority(_In_ Priority priority);
+        // Caller defined group and correlation key, see WinToast::hideGroup and WinToast::hideByKey.
+        void setGroup(_In_ const std::wstring& group);
+        void setKey(_In_ const std::wstring& key);
+        void addAction(_In_ const std::wstring& label);
+
+        std::size_t textFieldsCount() const;
+        std::size_t actionsCount() const;
+        bool hasImage() const;
+        const std::vector<std::wstring>& textFields() const;
+        const std::wstring& textField(_In_ TextField pos) const;
+        const std::wstring& actionLabel(_In_ std::size_t pos) const;
+        const std::wstring& imagePath() const;
+        const std::wstring& audioPath() const;
+        const std::wstring& attributionText() const;
+        const std::wstring& activationToken() const;
+        Priority priority() const;
+        const std::wstring& group() const;
+        const std::wstring& key() const;
+        Scenario scenario() const;
+        int64_t expiration() const;
+        WinToastTemplateType type() const;
+        WinToastTemplate::AudioOption audioOption() const;
+        Duration duration() const;
+    private:
+        friend class WinToast;  // takes over the strings of consumed templates
+
+        std::vector<std::wstring>           m_textFields{};
+        // Labels, image and audio recur across toasts and are pooled, see WinToastStringPool.
+        std::vector<WinToastString>         m_actions{};
+        WinToastString                      m_imagePath{};
+        WinToastString                      m_audioPath{};
+        std::wstring                        m_attributionText{};
+        std::wstring                        m_activationToken{};
+        std::wstring                        m_group{};
+        std::wstring                        m_key{};
+        Scenario                            m_scenario{Scenario::Default};
+        int64_t                             m_expiration{0};
+        AudioOption                         m_audioOption{WinToastTemplate::AudioOption::Default};
+        WinToastTemplateType                m_type{WinToastTemplateType::Text01};
+        Duration                            m_duration{Duration::System};
+        Priority                            m_priority{Priority::Normal};
+    };
+}
+
+#endif // TOAST_TEMPLATE_H
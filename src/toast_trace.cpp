@@ -0,0 +1,269 @@
+#include "toast_trace.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace WinToastLib;
+
+namespace {
+    const uint32_t FlightRecorderMagic = 0x52544d50; // "PMTR"
+    const uint32_t FlightRecorderVersion = 1;
+
+    // A record is stored as four words guarded by a sequence number, odd while
+    // the owning thread is writing it, so readers can detect torn copies.
+    struct Slot {
+        std::atomic<uint64_t> sequence;
+        std::atomic<uint64_t> words[4];
+    };
+
+    struct Ring {
+        std::atomic<bool> owned{false};
+        std::atomic<uint64_t> head{0};
+        Slot slots[WinToastTrace::RecordsPerThread]{};
+    };
+
+    struct RingHolder {
+        Ring* ring{nullptr};
+        uint8_t index{0};
+
+        ~RingHolder() {
+            if (ring) {
+                ring->owned.store(false, std::memory_order_release);
+            }
+        }
+    };
+
+    std::atomic<Ring*> rings[WinToastTrace::MaxThreads]{};
+    std::atomic<int> currentLevel{WinToastTrace::Info};
+    std::atomic<bool> flightRecorderEnabled{false};
+    std::atomic<bool> flightRecorderPending{false};
+    std::mutex flightRecorderLock;
+    std::wstring flightRecorderPath;
+
+    // Writes the flight recorder on its own thread, so tracing an error never waits for the file.
+    class FlightRecorderWriter {
+    public:
+        ~FlightRecorderWriter() {
+            stop();
+        }
+
+        void start() {
+            std::lock_guard<std::mutex> lock(m_startLock);
+            if (m_thread.joinable()) {
+                return;
+            }
+            m_stop = false;
+            m_thread = std::thread(&FlightRecorderWriter::run, this);
+        }
+
+        void stop() {
+            std::lock_guard<std::mutex> lock(m_startLock);
+            if (!m_thread.joinable()) {
+                return;
+            }
+            {
+                std::lock_guard<std::mutex> wakeLock(m_lock);
+                m_stop = true;
+            }
+            m_wake.notify_one();
+            m_thread.join();
+        }
+
+        // Only the first error after a write takes the lock, the others find the request pending.
+        void request() {
+            if (!flightRecorderPending.exchange(true)) {
+                std::lock_guard<std::mutex> lock(m_lock);
+                m_wake.notify_one();
+            }
+        }
+
+    private:
+        void run() {
+            for (;;) {
+                {
+                    std::unique_lock<std::mutex> lock(m_lock);
+                    m_wake.wait(lock, [this] { return m_stop || flightRecorderPending.load(); });
+                    if (m_stop) {
+                        return;
+                    }
+                }
+                // Cleared before the rings are collected, so an error traced during the write is
+                // either in this dump or requests the next one.
+                flightRecorderPending.store(false);
+                WinToastTrace::writeFlightRecorder();
+            }
+        }
+
+        std::mutex              m_startLock;
+        std::mutex              m_lock;
+        std::condition_variable m_wake;
+        std::thread             m_thread;
+        bool                    m_stop{false};
+    };
+
+    FlightRecorderWriter flightRecorderWriter;
+
+    uint64_t timestamp() {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    bool claimRing(RingHolder& holder) {
+        for (std::size_t i = 0; i < WinToastTrace::MaxThreads; i++) {
+            Ring* ring = rings[i].load(std::memory_order_acquire);
+            if (ring == nullptr) {
+                Ring* created = new Ring();
+                created->owned.store(true, std::memory_order_relaxed);
+                if (rings[i].compare_exchange_strong(ring, created, std::memory_order_acq_rel)) {
+                    holder.ring = created;
+                    holder.index = static_cast<uint8_t>(i);
+                    return true;
+                }
+                delete created;
+            }
+            bool owned = false;
+            if (ring->owned.compare_exchange_strong(owned, true, std::memory_order_acq_rel)) {
+                holder.ring = ring;
+                holder.index = static_cast<uint8_t>(i);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void collect(std::vector<WinToastTrace::Record>& records) {
+        for (const auto& entry : rings) {
+            const Ring* ring = entry.load(std::memory_order_acquire);
+            if (ring == nullptr) {
+                continue;
+            }
+            const uint64_t head = ring->head.load(std::memory_order_acquire);
+            const uint64_t first = head > WinToastTrace::RecordsPerThread ? head - WinToastTrace::RecordsPerThread : 0;
+            for (uint64_t n = first; n < head; n++) {
+                const Slot& slot = ring->slots[n % WinToastTrace::RecordsPerThread];
+                const uint64_t before = slot.sequence.load(std::memory_order_acquire);
+                if (before != 2 * n + 2) {
+                    continue;
+                }
+                uint64_t words[4];
+                for (int i = 0; i < 4; i++) {
+                    words[i] = slot.words[i].load(std::memory_order_relaxed);
+                }
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (slot.sequence.load(std::memory_order_relaxed) != before) {
+                    continue;
+                }
+
+                WinToastTrace::Record record;
+                record.timestamp = words[0];
+                record.toastId = static_cast<int64_t>(words[1]);
+                record.hr = static_cast<int32_t>(words[2] >> 32);
+                record.event = static_cast<uint16_t>(words[2] >> 16);
+                record.level = static_cast<uint8_t>(words[2] >> 8);
+                record.thread = static_cast<uint8_t>(words[2]);
+                record.payload = words[3];
+                records.push_back(record);
+            }
+        }
+        std::sort(records.begin(), records.end(), [](const WinToastTrace::Record& a, const WinToastTrace::Record& b) {
+            return a.timestamp < b.timestamp;
+        });
+    }
+}
+
+std::size_t WinToastTrace::memoryUsage() {
+    std::size_t bytes = 0;
+    for (const auto& entry : rings) {
+        if (entry.load(std::memory_order_acquire) != nullptr) {
+            bytes += sizeof(Ring);
+        }
+    }
+    return bytes;
+}
+
+void WinToastTrace::setLevel(Level level) {
+    currentLevel.store(level, std::memory_order_relaxed);
+}
+
+WinToastTrace::Level WinToastTrace::level() {
+    return static_cast<Level>(currentLevel.load(std::memory_order_relaxed));
+}
+
+bool WinToastTrace::enabled(Level level) {
+    return level <= currentLevel.load(std::memory_order_relaxed);
+}
+
+void WinToastTrace::write(Level level, Event event, int64_t toastId, int32_t hr, uint64_t payload) {
+    thread_local RingHolder holder;
+    if (holder.ring == nullptr && !claimRing(holder)) {
+        return;
+    }
+
+    Ring& ring = *holder.ring;
+    const uint64_t n = ring.head.load(std::memory_order_relaxed);
+    Slot& slot = ring.slots[n % RecordsPerThread];
+    slot.sequence.store(2 * n + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.words[0].store(timestamp(), std::memory_order_relaxed);
+    slot.words[1].store(static_cast<uint64_t>(toastId), std::memory_order_relaxed);
+    slot.words[2].store((uint64_t(static_cast<uint32_t>(hr)) << 32) | (uint64_t(event & 0xffff) << 16)
+                        | (uint64_t(level & 0xff) << 8) | holder.index, std::memory_order_relaxed);
+    slot.words[3].store(payload, std::memory_order_relaxed);
+    slot.sequence.store(2 * n + 2, std::memory_order_release);
+    ring.head.store(n + 1, std::memory_order_release);
+
+    if (level == Error && flightRecorderEnabled.load(std::memory_order_relaxed)) {
+        flightRecorderWriter.request();
+    }
+}
+
+std::size_t WinToastTrace::dump(Record* records, std::size_t capacity) {
+    if (records == nullptr || capacity == 0) {
+        return 0;
+    }
+
+    std::vector<Record> collected;
+    collect(collected);
+    const std::size_t count = std::min(capacity, collected.size());
+    std::copy(collected.end() - count, collected.end(), records);
+    return count;
+}
+
+void WinToastTrace::setFlightRecorderPath(const std::wstring& path) {
+    {
+        std::lock_guard<std::mutex> lock(flightRecorderLock);
+        flightRecorderPath = path;
+        flightRecorderEnabled.store(!path.empty(), std::memory_order_relaxed);
+    }
+    // The writer takes flightRecorderLock itself, so it is started and stopped outside of it.
+    if (path.empty()) {
+        flightRecorderWriter.stop();
+        flightRecorderPending.store(false);
+    } else {
+        flightRecorderWriter.start();
+    }
+}
+
+bool WinToastTrace::writeFlightRecorder() {
+    // Writers are serialized, the file always holds one complete dump.
+    std::lock_guard<std::mutex> lock(flightRecorderLock);
+    if (flightRecorderPath.empty()) {
+        return false;
+    }
+
+    std::vector<Record> collected;
+    collect(collected);
+    std::ofstream file(flightRecorderPath.c_str(), std::ios::binary | std::ios::trunc);
+    const uint32_t header[4] = {FlightRecorderMagic, FlightRecorderVersion, static_cast<uint32_t>(sizeof(Record)),
+                                static_cast<uint32_t>(collected.size())};
+    file.write(reinterpret_cast<const char*>(header), sizeof(header));
+    if (!collected.empty()) {
+        file.write(reinterpret_cast<const char*>(collected.data()), collected.size() * sizeof(Record));
+    }
+    return file.good();
+}
@@ -0,0 +1,80 @@
+#ifndef TOAST_TRACE_H
+#define TOAST_TRACE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace WinToastLib {
+
+    /**
+     * Always-on binary trace of the notification path.
+     *
+     * Every thread writes fixed-size records into its own ring, so tracing
+     * takes no locks and never allocates after the first record of a thread.
+     * Rings are claimed on first use and handed back when the thread exits.
+     * When a flight recorder path is set, all rings are written to that file
+     * whenever an error level record is traced. The file is written by a
+     * background thread, the thread tracing the error only wakes it.
+     */
+    class WinToastTrace {
+    public:
+        enum Level {
+            Error = 0,
+            Warning,
+            Info,
+            Debug
+        };
+
+        enum Event {
+            Initialize = 1,
+            ShowBegin,
+            ShowEnd,
+            ShowFailed,
+            Hide,
+            Clear,
+            Activated,
+            Dismissed,
+            Failed,
+            WorkerStalled,
+            Evicted
+        };
+
+        struct Record {
+            uint64_t timestamp; // steady clock, nanoseconds
+            int64_t toastId;
+            int32_t hr;
+            uint16_t event;
+            uint8_t level;
+            uint8_t thread;
+            uint64_t payload;
+        };
+
+        static constexpr std::size_t RecordsPerThread = 256;
+        static constexpr std::size_t MaxThreads = 64;
+
+        static void setLevel(Level level);
+        static Level level();
+        static bool enabled(Level level);
+
+        static void write(Level level, Event event, int64_t toastId, int32_t hr = 0, uint64_t payload = 0);
+
+        // Copies up to capacity records of all threads, oldest first. Returns the number of records copied.
+        static std::size_t dump(Record* records, std::size_t capacity);
+
+        // Bytes allocated for the per-thread rings.
+        static std::size_t memoryUsage();
+
+        static void setFlightRecorderPath(const std::wstring& path);
+        // Writes the flight recorder right away on the calling thread.
+        static bool writeFlightRecorder();
+    };
+}
+
+#define WINTOAST_TRACE(level, ...) \
+    do { \
+        if (WinToastLib::WinToastTrace::enabled(WinToastLib::WinToastTrace::level)) \
+            WinToastLib::WinToastTrace::write(WinToastLib::WinToastTrace::level, __VA_ARGS__); \
+    } while (false)
+
+#endif // TOAST_TRACE_H
@@ -0,0 +1,358 @@
+#include "toast_worker.h"
+#include "toast_trace.h"
+
+using namespace WinToastLib;
+
+WinToastWorker::WinToastWorker(_In_ WinToast* toast) : m_toast(toast) {}
+
+WinToastWorker::~WinToastWorker() {
+    stop();
+}
+
+bool WinToastWorker::start(_In_ DWORD watchdogTimeoutMs, _In_ CompletionHandler completion, _In_ std::size_t renderThreads) {
+    std::lock_guard<std::mutex> lock(m_startLock);
+    if (m_running.load() || m_thread.joinable()) {
+        return false;
+    }
+
+    m_wakeEvent = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+    m_stopEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    if (m_wakeEvent == nullptr || m_stopEvent == nullptr) {
+        if (m_wakeEvent) CloseHandle(m_wakeEvent);
+        if (m_stopEvent) CloseHandle(m_stopEvent);
+        m_wakeEvent = m_stopEvent = nullptr;
+        return false;
+    }
+
+    m_watchdogTimeoutMs = watchdogTimeoutMs;
+    m_completion = std::move(completion);
+    m_running.store(true);
+    m_renderStop = false;
+    for (std::size_t i = 0; i < renderThreads && i < MaxRenderThreads; i++) {
+        m_renderers.emplace_back(&WinToastWorker::render, this);
+    }
+    m_thread = std::thread(&WinToastWorker::run, this);
+    if (m_watchdogTimeoutMs > 0) {
+        m_watchdog = std::thread(&WinToastWorker::watch, this);
+    }
+    return true;
+}
+
+void WinToastWorker::stop() {
+    std::lock_guard<std::mutex> lock(m_startLock);
+    if (!m_running.exchange(false)) {
+        return;
+    }
+
+    // Commands queued before the stop are still executed. Callers that saw the worker running
+    // push before the Stop command, later ones are turned away by enter().
+    while (m_users.load() != 0) {
+        std::this_thread::yield();
+    }
+    Command command;
+    command.kind = Command::Stop;
+    push(std::move(command));
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+
+    {
+        std::lock_guard<std::mutex> renderLock(m_renderLock);
+        m_renderStop = true;
+    }
+    m_renderReady.notify_all();
+    for (auto& renderer : m_renderers) {
+        renderer.join();
+    }
+    m_renderers.clear();
+
+    SetEvent(m_stopEvent);
+    if (m_watchdog.joinable()) {
+        m_watchdog.join();
+    }
+
+    CloseHandle(m_wakeEvent);
+    CloseHandle(m_stopEvent);
+    m_wakeEvent = m_stopEvent = nullptr;
+}
+
+bool WinToastWorker::isRunning() const {
+    return m_running.load();
+}
+
+bool WinToastWorker::show(_In_ INT64 id, _In_ const WinToastTemplate& toast, _In_ std::shared_ptr<IWinToastHandler> handler) {
+    if (!isRunning()) {
+        return false;
+    }
+    std::unique_ptr<WinToastTemplate> copy(new WinToastTemplate(toast));
+    return show(id, std::move(copy), std::move(handler));
+}
+
+bool WinToastWorker::show(_In_ INT64 id, _In_ std::unique_ptr<WinToastTemplate>&& toast, _In_ std::shared_ptr<IWinToastHandler> handler) {
+    if (!enter()) {
+        return false;
+    }
+
+    Command command;
+    command.kind = Command::Show;
+    command.id = id;
+    command.toast = std::move(toast);
+    command.handler = std::move(handler);
+    {
+        std::lock_guard<std::mutex> lock(m_pendingLock);
+        m_pending[id] = false;
+    }
+    m_toast->registry().setState(id, WinToastRegistry::Queued);
+    push(std::move(command));
+    leave();
+    return true;
+}
+
+bool WinToastWorker::cancel(_In_ INT64 id) {
+    std::lock_guard<std::mutex> lock(m_pendingLock);
+    auto it = m_pending.find(id);
+    if (it == m_pending.end() || it->second) {
+        return false;
+    }
+    it->second = true;
+    return true;
+}
+
+bool WinToastWorker::takePending(_In_ INT64 id) {
+    std::lock_guard<std::mutex> lock(m_pendingLock);
+    auto it = m_pending.find(id);
+    const bool cancelled = it != m_pending.end() && it->second;
+    if (it != m_pending.end()) {
+        m_pending.erase(it);
+    }
+    return !cancelled;
+}
+
+bool WinToastWorker::hide(_In_ INT64 id) {
+    Command command;
+    command.kind = Command::Hide;
+    command.id = id;
+    return enqueue(std::move(command));
+}
+
+bool WinToastWorker::hideGroup(_In_ const std::wstring& group, _In_ int source) {
+    Command command;
+    command.kind = Command::HideGroup;
+    command.match = group;
+    command.source = source;
+    return enqueue(std::move(command));
+}
+
+bool WinToastWorker::hideByKey(_In_ const std::wstring& key, _In_ int source) {
+    Command command;
+    command.kind = Command::HideKey;
+    command.match = key;
+    command.source = source;
+    return enqueue(std::move(command));
+}
+
+bool WinToastWorker::clear() {
+    Command command;
+    command.kind = Command::Clear;
+    return enqueue(std::move(command));
+}
+
+std::size_t WinToastWorker::stalls() const {
+    return m_stalls.load();
+}
+
+bool WinToastWorker::enter() {
+    m_users.fetch_add(1);
+    if (m_running.load()) {
+        return true;
+    }
+    m_users.fetch_sub(1);
+    return false;
+}
+
+void WinToastWorker::leave() {
+    m_users.fetch_sub(1);
+}
+
+bool WinToastWorker::enqueue(_In_ Command command) {
+    if (!enter()) {
+        return false;
+    }
+    push(std::move(command));
+    leave();
+    return true;
+}
+
+void WinToastWorker::push(_In_ Command command) {
+    m_queue.push(std::move(command));
+    if (m_sleeping.exchange(false)) {
+        SetEvent(m_wakeEvent);
+    }
+}
+
+void WinToastWorker::run() {
+    const HRESULT initHr = CoInitializeEx(nullptr, COINIT::COINIT_MULTITHREADED);
+
+    Command command;
+    bool stopping = false;
+    for (;;) {
+        submitRendered();
+        if (stopping && m_inFlight.empty()) {
+            break;
+        }
+        if (stopping || !m_queue.pop(command)) {
+            m_sleeping.store(true);
+            if ((stopping || m_queue.empty()) && !isFrontRendered()) {
+                WaitForSingleObject(m_wakeEvent, INFINITE);
+            }
+            m_sleeping.store(false);
+            continue;
+        }
+
+        if (command.kind == Command::Stop) {
+            // Renders still in flight are submitted before the worker exits.
+            stopping = true;
+        } else if (!m_renderers.empty() && (command.kind == Command::Show || !m_inFlight.empty())) {
+            enqueueRender(command);
+        } else {
+            execute(command);
+        }
+        command = Command();
+    }
+
+    if (SUCCEEDED(initHr)) {
+        CoUninitialize();
+    }
+}
+
+void WinToastWorker::render() {
+    const HRESULT initHr = CoInitializeEx(nullptr, COINIT::COINIT_MULTITHREADED);
+
+    for (;;) {
+        Render* job = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(m_renderLock);
+            m_renderReady.wait(lock, [this] { return m_renderStop || !m_renderQueue.empty(); });
+            if (m_renderQueue.empty()) {
+                break;
+            }
+            job = m_renderQueue.front();
+            m_renderQueue.pop_front();
+        }
+
+        m_toast->prepareToast(job->command.id, std::move(*job->command.toast), std::move(job->command.handler), job->prepared);
+        // The worker thread may free the job as soon as it is marked done.
+        job->done.store(true);
+        if (m_sleeping.exchange(false)) {
+            SetEvent(m_wakeEvent);
+        }
+    }
+
+    if (SUCCEEDED(initHr)) {
+        CoUninitialize();
+    }
+}
+
+// Commands queued behind a show that is still rendering wait for it, so the order is kept.
+void WinToastWorker::enqueueRender(_In_ Command& command) {
+    std::unique_ptr<Render> job(new Render());
+    job->command = std::move(command);
+    if (job->command.kind == Command::Show) {
+        {
+            std::lock_guard<std::mutex> lock(m_renderLock);
+            m_renderQueue.push_back(job.get());
+        }
+        m_renderReady.notify_one();
+    } else {
+        job->done.store(true);
+    }
+    m_inFlight.push_back(std::move(job));
+}
+
+void WinToastWorker::submitRendered() {
+    while (isFrontRendered()) {
+        std::unique_ptr<Render> job = std::move(m_inFlight.front());
+        m_inFlight.pop_front();
+        execute(job->command, job->command.kind == Command::Show ? &job->prepared : nullptr);
+    }
+}
+
+bool WinToastWorker::isFrontRendered() const {
+    return !m_inFlight.empty() && m_inFlight.front()->done.load();
+}
+
+void WinToastWorker::execute(_In_ Command& command, _In_opt_ WinToast::PreparedToast* prepared) {
+    if (command.kind == Command::Show && !takePending(command.id)) {
+        m_toast->registry().setState(command.id, WinToastRegistry::Failed, E_ABORT);
+        complete(command.id, WinToast::NotDisplayed, E_ABORT);
+        return;
+    }
+
+    const uint64_t token = ++m_generation;
+    m_commandId.store(command.id, std::memory_order_relaxed);
+    m_commandKind.store(command.kind, std::memory_order_relaxed);
+    m_commandStarted.store(GetTickCount64(), std::memory_order_relaxed);
+    m_commandToken.store(token, std::memory_order_release);
+
+    WinToast::WinToastError error = WinToast::NoError;
+    HRESULT hr = S_OK;
+    switch (command.kind) {
+    case Command::Show:
+        if (prepared != nullptr) {
+            m_toast->submitToast(*prepared, &error, &hr);
+        } else {
+            m_toast->showToastWithId(command.id, std::move(*command.toast), command.handler, &error, &hr);
+        }
+        break;
+    case Command::Hide:
+        m_toast->hideToast(command.id);
+        break;
+    case Command::HideGroup:
+        m_toast->hideGroup(command.match, command.source);
+        break;
+    case Command::HideKey:
+        m_toast->hideByKey(command.match, command.source);
+        break;
+    case Command::Clear:
+        m_toast->clear();
+        break;
+    default:
+        break;
+    }
+
+    uint64_t expected = token;
+    if (m_commandToken.compare_exchange_strong(expected, 0) && command.kind == Command::Show) {
+        complete(command.id, error, hr);
+    }
+}
+
+void WinToastWorker::watch() {
+    const DWORD interval = m_watchdogTimeoutMs / 4 > 10 ? m_watchdogTimeoutMs / 4 : 10;
+    while (WaitForSingleObject(m_stopEvent, interval) == WAIT_TIMEOUT) {
+        uint64_t token = m_commandToken.load(std::memory_order_acquire);
+        if (token == 0) {
+            continue;
+        }
+
+        const ULONGLONG started = m_commandStarted.load(std::memory_order_relaxed);
+        if (GetTickCount64() - started < m_watchdogTimeoutMs) {
+            continue;
+        }
+
+        const INT64 id = m_commandId.load(std::memory_order_relaxed);
+        const int kind = m_commandKind.load(std::memory_order_relaxed);
+        if (m_commandToken.compare_exchange_strong(token, 0)) {
+            m_stalls++;
+            WINTOAST_TRACE(Error, WinToastTrace::WorkerStalled, id, HRESULT_FROM_WIN32(ERROR_TIMEOUT), static_cast<uint64_t>(kind));
+            if (kind == Command::Show) {
+                complete(id, WinToast::NotDisplayed, HRESULT_FROM_WIN32(ERROR_TIMEOUT));
+            }
+        }
+    }
+}
+
+void WinToastWorker::complete(_In_ INT64 id, _In_ WinToast::WinToastError error, _In_ HRESULT hr) {
+    if (m_completion) {
+        m_completion(id, error, hr);
+    }
+}
@@ -0,0 +1,126 @@
+#ifndef TOAST_WORKER_H
+#define TOAST_WORKER_H
+
+#include "wintoastlib.h"
+#include "mpsc_queue.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace WinToastLib {
+
+    /**
+     * Runs all WinRT notification calls of a WinToast instance on one thread.
+     *
+     * The worker thread owns its own multithreaded apartment, the cached
+     * factories and the notification buffer. Callers only enqueue commands and
+     * return immediately; show results are reported through the completion
+     * handler from the worker thread. A watchdog reports a command as failed
+     * with HRESULT_FROM_WIN32(ERROR_TIMEOUT) if a COM call hangs for longer
+     * than the configured timeout. Shows that have not been executed yet can
+     * be cancelled and are then completed with E_ABORT.
+     *
+     * Optionally the XML and notification objects of shows are built on a
+     * pool of render threads. The worker thread still hands them to the
+     * notifier, and executes all other commands, in the order they were
+     * queued. The watchdog covers only that last step.
+     */
+    class WinToastWorker {
+    public:
+        typedef std::function<void(INT64 id, WinToast::WinToastError error, HRESULT hr)> CompletionHandler;
+
+        static constexpr std::size_t MaxRenderThreads = 16;
+
+        explicit WinToastWorker(_In_ WinToast* toast);
+        ~WinToastWorker();
+
+        bool start(_In_ DWORD watchdogTimeoutMs, _In_ CompletionHandler completion, _In_ std::size_t renderThreads = 0);
+        void stop();
+        bool isRunning() const;
+
+        // Commands are only accepted while the worker is running, all of them return false otherwise.
+        // A command that was accepted is executed, also if stop() is called right after.
+        bool show(_In_ INT64 id, _In_ const WinToastTemplate& toast, _In_ std::shared_ptr<IWinToastHandler> handler);
+        // Takes ownership of the template, it is consumed by the show and freed on the worker thread.
+        // The template is left untouched if the show is not accepted.
+        bool show(_In_ INT64 id, _In_ std::unique_ptr<WinToastTemplate>&& toast, _In_ std::shared_ptr<IWinToastHandler> handler);
+        bool cancel(_In_ INT64 id);
+        bool hide(_In_ INT64 id);
+        bool hideGroup(_In_ const std::wstring& group, _In_ int source = WinToastRegistry::AnySource);
+        bool hideByKey(_In_ const std::wstring& key, _In_ int source = WinToastRegistry::AnySource);
+        bool clear();
+
+        std::size_t stalls() const;
+
+    private:
+        struct Command {
+            enum Kind { Show, Hide, HideGroup, HideKey, Clear, Stop };
+
+            Kind kind{Stop};
+            INT64 id{-1};
+            std::unique_ptr<WinToastTemplate> toast;
+            std::shared_ptr<IWinToastHandler> handler;
+            std::wstring match;     // group or key of HideGroup and HideKey
+            int source{WinToastRegistry::AnySource};   // of the Ids HideGroup and HideKey are limited to
+        };
+
+        // A show being rendered, or a command queued behind one. Owned by the worker thread.
+        struct Render {
+            Command                     command;
+            WinToast::PreparedToast     prepared;
+            std::atomic<bool>           done{false};
+        };
+
+        bool enter();
+        void leave();
+        bool enqueue(_In_ Command command);
+        void push(_In_ Command command);
+        void run();
+        void watch();
+        void render();
+        void enqueueRender(_In_ Command& command);
+        void submitRendered();
+        bool isFrontRendered() const;
+        void execute(_In_ Command& command, _In_opt_ WinToast::PreparedToast* prepared = nullptr);
+        void complete(_In_ INT64 id, _In_ WinToast::WinToastError error, _In_ HRESULT hr);
+        bool takePending(_In_ INT64 id);
+
+        WinToast*                   m_toast;
+        MpscQueue<Command>          m_queue;
+        CompletionHandler           m_completion;
+        DWORD                       m_watchdogTimeoutMs{0};
+        HANDLE                      m_wakeEvent{nullptr};
+        HANDLE                      m_stopEvent{nullptr};
+        std::mutex                  m_startLock;
+        std::thread                 m_thread;
+        std::thread                 m_watchdog;
+        std::atomic<bool>           m_running{false};
+        std::atomic<int>            m_users{0};     // callers between the running check and their push
+        std::atomic<bool>           m_sleeping{false};
+        // The command in flight is identified by a non-zero token. Whoever
+        // swaps the token back to zero, the worker or the watchdog, reports it.
+        uint64_t                    m_generation{0};
+        std::atomic<uint64_t>       m_commandToken{0};
+        std::atomic<ULONGLONG>      m_commandStarted{0};
+        std::atomic<INT64>          m_commandId{-1};
+        std::atomic<int>            m_commandKind{Command::Stop};
+        std::atomic<std::size_t>    m_stalls{0};
+        std::mutex                  m_pendingLock;
+        std::unordered_map<INT64, bool> m_pending;
+        std::vector<std::thread>    m_renderers;
+        std::mutex                  m_renderLock;
+        std::condition_variable     m_renderReady;
+        std::deque<Render*>         m_renderQueue;
+        bool                        m_renderStop{false};
+        std::deque<std::unique_ptr<Render>> m_inFlight;   // in queue order
+    };
+}
+
+#endif // TOAST_WORKER_H
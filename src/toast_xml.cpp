@@ -0,0 +1,203 @@
+#include "toast_xml.h"
+#include "toast_schema.h"
+#include <cwchar>
+
+using namespace WinToastLib;
+
+namespace {
+    struct Fragment {
+        const wchar_t*  data;
+        std::size_t     length;
+    };
+
+    template <std::size_t N>
+    constexpr Fragment fragment(_In_ const wchar_t (&text)[N]) {
+        return Fragment{text, N - 1};
+    }
+
+    constexpr Fragment ToastOpen = fragment(L"<toast launch=\"");
+    constexpr Fragment GenericTemplate = fragment(L"\" template=\"ToastGeneric");
+    constexpr Fragment DurationAttribute = fragment(L"\" duration=\"");
+    constexpr Fragment ScenarioAttribute = fragment(L"\" scenario=\"");
+    constexpr Fragment BindingOpen = fragment(L"\"><visual><binding template=\"");
+    constexpr Fragment ImageOpen = fragment(L"\"><image id=\"1\" src=\"");
+    constexpr Fragment ImageScheme = fragment(L"file:///");
+    constexpr Fragment ImageClose = fragment(L"\"/>");
+    constexpr Fragment BindingClose = fragment(L"\">");
+    constexpr Fragment TextOpen[] = { fragment(L"<text id=\"1\">"), fragment(L"<text id=\"2\">"), fragment(L"<text id=\"3\">") };
+    constexpr Fragment AttributionOpen = fragment(L"<text placement=\"attribution\">");
+    constexpr Fragment TextClose = fragment(L"</text>");
+    constexpr Fragment VisualClose = fragment(L"</binding></visual>");
+    constexpr Fragment ActionsOpen = fragment(L"<actions>");
+    constexpr Fragment ActionOpen = fragment(L"<action content=\"");
+    constexpr Fragment ActionArguments = fragment(L"\" arguments=\"");
+    constexpr Fragment ActionClose = fragment(L"\"/>");
+    constexpr Fragment ActionsClose = fragment(L"</actions>");
+    constexpr Fragment AudioOpen = fragment(L"<audio");
+    constexpr Fragment AudioSource = fragment(L" src=\"");
+    constexpr Fragment AudioSourceClose = fragment(L"\"");
+    constexpr Fragment AudioLoop = fragment(L" loop=\"true\"");
+    constexpr Fragment AudioSilent = fragment(L" silent=\"true\"");
+    constexpr Fragment AudioClose = fragment(L"/>");
+    constexpr Fragment ToastClose = fragment(L"</toast>");
+
+    static_assert(sizeof(TextOpen) / sizeof(TextOpen[0]) == 3, "one text element per text field");
+
+    // Replacement of a character in text and attribute values, nullptr if it is copied as is.
+    inline const wchar_t* entity(_In_ wchar_t c, _Out_ std::size_t& length) {
+        switch (c) {
+        case L'&':  length = 5; return L"&amp;";
+        case L'<':  length = 4; return L"&lt;";
+        case L'>':  length = 4; return L"&gt;";
+        case L'"':  length = 6; return L"&quot;";
+        case L'\'': length = 6; return L"&apos;";
+        case L'\t': case L'\n': case L'\r':
+            length = 1;
+            return nullptr;
+        default:
+            // Other control characters are not allowed in XML 1.0.
+            if (c < 0x20) {
+                length = 0;
+                return L"";
+            }
+            length = 1;
+            return nullptr;
+        }
+    }
+}
+
+WinToastXml::WinToastXml(_In_ const WinToastTemplate& toast, _In_ const std::wstring& launchArguments,
+                         _In_ const std::vector<std::wstring>& actionArguments, _In_ bool modernFeatures,
+                         _In_opt_ WinToastArena* arena)
+    : m_spans(WinToastStlAllocator<Span>(arena)) {
+    const std::size_t actions = modernFeatures ? toast.actionsCount() : 0;
+    m_spans.reserve(24 + 4 * toast.textFieldsCount() + 4 * actions);
+
+    markup(ToastOpen.data, ToastOpen.length);
+    text(launchArguments);
+    if (modernFeatures) {
+        const wchar_t* duration = ToastSchema::durationName(toast.duration());
+        if (actions > 0) {
+            markup(GenericTemplate.data, GenericTemplate.length);
+            if (duration == nullptr) {
+                duration = ToastSchema::durationName(WinToastTemplate::Long);
+            }
+        }
+        if (duration != nullptr) {
+            markup(DurationAttribute.data, DurationAttribute.length);
+            markup(duration, wcslen(duration));
+        }
+        const wchar_t* scenario = ToastSchema::scenarioName(toast.scenario());
+        markup(ScenarioAttribute.data, ScenarioAttribute.length);
+        markup(scenario, wcslen(scenario));
+    }
+
+    const wchar_t* templateName = ToastSchema::templateName(toast.type());
+    markup(BindingOpen.data, BindingOpen.length);
+    markup(templateName, wcslen(templateName));
+    if (ToastSchema::hasImage(toast.type())) {
+        markup(ImageOpen.data, ImageOpen.length);
+        if (toast.hasImage()) {
+            markup(ImageScheme.data, ImageScheme.length);
+            text(toast.imagePath());
+        }
+        markup(ImageClose.data, ImageClose.length);
+    } else {
+        markup(BindingClose.data, BindingClose.length);
+    }
+
+    for (std::size_t i = 0, count = toast.textFieldsCount(); i < count; i++) {
+        markup(TextOpen[i].data, TextOpen[i].length);
+        text(toast.textField(static_cast<WinToastTemplate::TextField>(i)));
+        markup(TextClose.data, TextClose.length);
+    }
+    if (modernFeatures && !toast.attributionText().empty()) {
+        markup(AttributionOpen.data, AttributionOpen.length);
+        text(toast.attributionText());
+        markup(TextClose.data, TextClose.length);
+    }
+    markup(VisualClose.data, VisualClose.length);
+
+    if (actions > 0) {
+        markup(ActionsOpen.data, ActionsOpen.length);
+        for (std::size_t i = 0; i < actions; i++) {
+            markup(ActionOpen.data, ActionOpen.length);
+            text(toast.actionLabel(i));
+            markup(ActionArguments.data, ActionArguments.length);
+            text(actionArguments[i]);
+            markup(ActionClose.data, ActionClose.length);
+        }
+        markup(ActionsClose.data, ActionsClose.length);
+    }
+
+    if (modernFeatures && (!toast.audioPath().empty() || toast.audioOption() != WinToastTemplate::AudioOption::Default)) {
+        markup(AudioOpen.data, AudioOpen.length);
+        if (!toast.audioPath().empty()) {
+            markup(AudioSource.data, AudioSource.length);
+            text(toast.audioPath());
+            markup(AudioSourceClose.data, AudioSourceClose.length);
+        }
+        if (toast.audioOption() == WinToastTemplate::AudioOption::Loop) {
+            markup(AudioLoop.data, AudioLoop.length);
+        } else if (toast.audioOption() == WinToastTemplate::AudioOption::Silent) {
+            markup(AudioSilent.data, AudioSilent.length);
+        }
+        markup(AudioClose.data, AudioClose.length);
+    }
+    markup(ToastClose.data, ToastClose.length);
+}
+
+void WinToastXml::flatten(_Out_ std::wstring& xml) const {
+    xml.resize(m_length);
+    if (m_length > 0) {
+        write(&xml[0], m_length);
+    }
+}
+
+std::size_t WinToastXml::write(_Out_writes_(capacity) wchar_t* buffer, _In_ std::size_t capacity) const {
+    if (capacity < m_length) {
+        return 0;
+    }
+
+    wchar_t* out = buffer;
+    for (const Span& span : m_spans) {
+        if (!span.escape) {
+            wmemcpy(out, span.data, span.length);
+            out += span.length;
+            continue;
+        }
+        for (std::size_t i = 0; i < span.length; i++) {
+            std::size_t length;
+            const wchar_t* replacement = entity(span.data[i], length);
+            if (replacement == nullptr) {
+                *out++ = span.data[i];
+            } else {
+                wmemcpy(out, replacement, length);
+                out += length;
+            }
+        }
+    }
+    return static_cast<std::size_t>(out - buffer);
+}
+
+std::size_t WinToastXml::escapedLength(_In_reads_(length) const wchar_t* text, _In_ std::size_t length) {
+    std::size_t escaped = 0;
+    for (std::size_t i = 0; i < length; i++) {
+        std::size_t characters;
+        entity(text[i], characters);
+        escaped += characters;
+    }
+    return escaped;
+}
+
+void WinToastXml::markup(_In_reads_(length) const wchar_t* text, _In_ std::size_t length) {
+    m_spans.push_back(Span{text, length, false});
+    m_length += length;
+}
+
+void WinToastXml::text(_In_ const std::wstring& value) {
+    if (!value.empty()) {
+        m_spans.push_back(Span{value.data(), value.size(), true});
+        m_length += escapedLength(value.data(), value.size());
+    }
+}
@@ -0,0 +1,61 @@
+#ifndef TOAST_XML_H
+#define TOAST_XML_H
+
+#include "toast_template.h"
+#include "toast_allocator.h"
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace WinToastLib {
+
+    /**
+     * Toast XML composed from constant fragments and the toast's own text.
+     *
+     * The markup every toast shares is kept as constants whose length is
+     * known at compile time. A toast is described as a list of spans over
+     * those constants and over the strings of its template, so the length
+     * of the document is known before a single character is copied. The
+     * document is then flattened once into a buffer of exactly that size,
+     * or handed span by span to a consumer. Dynamic text is escaped while
+     * it is copied; characters XML cannot carry are dropped.
+     */
+    class WinToastXml {
+    public:
+        struct Span {
+            const wchar_t*  data;
+            std::size_t     length;     // characters before escaping
+            bool            escape;     // dynamic text, constant markup is copied as is
+        };
+
+        typedef std::vector<Span, WinToastStlAllocator<Span>> Spans;
+
+        // The template and the arguments are referenced, not copied, and must outlive the composer.
+        // Spans are taken from the arena when one is given, which then must outlive the composer as well.
+        WinToastXml(_In_ const WinToastTemplate& toast, _In_ const std::wstring& launchArguments,
+                    _In_ const std::vector<std::wstring>& actionArguments, _In_ bool modernFeatures,
+                    _In_opt_ WinToastArena* arena = nullptr);
+        WinToastXml(_In_ const WinToastTemplate& toast, _In_ std::wstring&& launchArguments,
+                    _In_ const std::vector<std::wstring>& actionArguments, _In_ bool modernFeatures,
+                    _In_opt_ WinToastArena* arena = nullptr) = delete;
+
+        const Spans& spans() const { return m_spans; }
+        // Characters of the flattened document.
+        std::size_t length() const { return m_length; }
+
+        void flatten(_Out_ std::wstring& xml) const;
+        // Returns the number of characters written, 0 if the buffer is smaller than length().
+        std::size_t write(_Out_writes_(capacity) wchar_t* buffer, _In_ std::size_t capacity) const;
+
+        static std::size_t escapedLength(_In_reads_(length) const wchar_t* text, _In_ std::size_t length);
+
+    private:
+        void markup(_In_reads_(length) const wchar_t* text, _In_ std::size_t length);
+        void text(_In_ const std::wstring& value);
+
+        Spans               m_spans;
+        std::size_t         m_length{0};
+    };
+}
+
+#endif // TOAST_XML_H
@@ -20,9 +20,12 @@
 
 #include <wrl\wrappers\corewrappers.h>
 #include "wintoastlib.h"
+#include "toast_arguments.h"
+#include "toast_budget.h"
+#include "toast_schema.h"
+#include "toast_trace.h"
+#include "toast_xml.h"
 #include <assert.h>
-#include <unordered_map>
-#include <array>
 
 #pragma comment(lib,"shlwapi")
 #pragma comment(lib,"user32")
@@ -233,69 +236,93 @@ namespace Util {
 		return hr;
 	}
 
-
-    inline PCWSTR AsString(ComPtr<IXmlDocument> &xmlDocument) {
-		HSTRING xml;
-		ComPtr<IXmlNodeSerializer> ser;
-		HRESULT hr = xmlDocument.As<IXmlNodeSerializer>(&ser);
-		hr = ser->GetXml(&xml);
-		if (SUCCEEDED(hr))
-			return DllImporter::WindowsGetStringRawBuffer(xml, nullptr);
-		return nullptr;
-	}
-
-	inline PCWSTR AsString(HSTRING hstring) {
-		return DllImporter::WindowsGetStringRawBuffer(hstring, nullptr);
+	inline void hashString(_Inout_ uint64_t& hash, _In_ const std::wstring& text) {
+		for (const wchar_t c : text) {
+			hash ^= static_cast<uint16_t>(c);
+			hash *= 1099511628211ull;
+		}
+		// Separator, so moving text between fields changes the hash.
+		hash *= 1099511628211ull;
+	}
+
+	// Copies the template with the text fields over budget shortened. Returns false if all of them fit.
+	inline bool shortenText(_In_ const WinToastTemplate& toast, _Out_ WinToastTemplate& shortened) {
+		const std::vector<std::wstring>& fields = toast.textFields();
+		bool copied = false;
+		std::wstring text;
+		for (std::size_t i = 0; i < fields.size(); i++) {
+			const auto field = static_cast<WinToastTemplate::TextField>(i);
+			const std::size_t budget = ToastSchema::textBudget(toast.type(), field);
+			if (budget == 0 || fields[i].size() <= budget) {
+				continue;
+			}
+			if (!copied) {
+				shortened = toast;
+				copied = true;
+			}
+			WinToastTextBudget::shorten(fields[i].data(), fields[i].size(), budget, WinToastTextBudget::Auto, text);
+			shortened.setTextField(text, field);
+		}
+		return copied;
 	}
 
-    inline HRESULT setNodeStringValue(const std::wstring& string, IXmlNode *node, IXmlDocument *xml) {
-		ComPtr<IXmlText> textNode;
-        HRESULT hr = xml->CreateTextNode( WinToastStringWrapper(string).Get(), &textNode);
-		if (SUCCEEDED(hr)) {
-			ComPtr<IXmlNode> stringNode;
-			hr = textNode.As(&stringNode);
-			if (SUCCEEDED(hr)) {
-				ComPtr<IXmlNode> appendedChild;
-				hr = node->AppendChild(stringNode.Get(), &appendedChild);
-			}
+	// FNV-1a over everything the user can see in the toast.
+	inline uint64_t contentHash(_In_ const WinToastTemplate& toast) {
+		uint64_t hash = 14695981039346656037ull ^ static_cast<uint64_t>(toast.type());
+		for (const auto& text : toast.textFields()) {
+			hashString(hash, text);
 		}
-		return hr;
+		hashString(hash, toast.attributionText());
+		hashString(hash, toast.imagePath());
+		for (std::size_t i = 0, count = toast.actionsCount(); i < count; i++) {
+			hashString(hash, toast.actionLabel(i));
+		}
+		return hash;
+	}
+
+	// Rough size of what a live toast keeps alive besides its registry entry: the XML DOM and
+	// notification object held by the platform, and the handler.
+	inline std::size_t estimateBytes(_In_ const WinToastTemplate& toast) {
+		const std::size_t NotificationObjectBytes = 1024;
+		const std::size_t XmlNodeBytes = 128;
+		const std::size_t HandlerBytes = 64;
+
+		// toast, visual, binding and image or audio elements plus one per text and action
+		std::size_t nodes = 4 + toast.textFieldsCount() + toast.actionsCount();
+		std::size_t characters = toast.imagePath().size() + toast.audioPath().size() + toast.attributionText().size()
+		                       + toast.activationToken().size();
+		for (const auto& text : toast.textFields()) {
+			characters += text.size();
+		}
+		for (std::size_t i = 0, count = toast.actionsCount(); i < count; i++) {
+			characters += toast.actionLabel(i).size();
+		}
+		return NotificationObjectBytes + HandlerBytes + nodes * XmlNodeBytes + characters * sizeof(wchar_t);
 	}
 
-	inline HRESULT setEventHandlers(_In_ IToastNotification* notification, _In_ std::shared_ptr<IWinToastHandler> eventHandler, _In_ INT64 expirationTime) {
+	inline HRESULT setEventHandlers(_In_ IToastNotification* notification, _In_ std::shared_ptr<IWinToastHandler> eventHandler, _In_ INT64 expirationTime,
+	                                _In_ INT64 id, _In_ WinToastStats* stats, _In_ WinToastStats::TimePoint shownAt,
+	                                _In_ WinToastHistory* history, _In_ uint64_t contentHash,
+	                                _In_ ITypedEventHandler<ToastNotification*, IInspectable*>* activatedHandler, _In_ WinToastRegistry* registry) {
 		EventRegistrationToken activatedToken, dismissedToken, failedToken;
-		HRESULT hr = notification->add_Activated(
-			Callback < Implements < RuntimeClassFlags<ClassicCom>,
-			ITypedEventHandler<ToastNotification*, IInspectable* >> >(
-				[eventHandler](IToastNotification*, IInspectable* inspectable)
-				{
-                    IToastActivatedEventArgs *activatedEventArgs;
-					HRESULT hr = inspectable->QueryInterface(&activatedEventArgs);
-					if (SUCCEEDED(hr)) {
-						HSTRING argumentsHandle;
-						hr = activatedEventArgs->get_Arguments(&argumentsHandle);
-						if (SUCCEEDED(hr)) {
-							PCWSTR arguments = Util::AsString(argumentsHandle);
-							if (arguments && *arguments) {
-								eventHandler->toastActivated(static_cast<int>(wcstol(arguments, nullptr, 10)));
-								return S_OK;
-							}
-						}
-					}
-					eventHandler->toastActivated();
-					return S_OK;
-				}).Get(), &activatedToken);
+		// Activations route themselves through their arguments, so all toasts share one handler.
+		HRESULT hr = notification->add_Activated(activatedHandler, &activatedToken);
 
 		if (SUCCEEDED(hr)) {
 			hr = notification->add_Dismissed(Callback < Implements < RuntimeClassFlags<ClassicCom>,
 				ITypedEventHandler<ToastNotification*, ToastDismissedEventArgs* >> >(
-					[eventHandler, expirationTime](IToastNotification*, IToastDismissedEventArgs* e)
+					[eventHandler, expirationTime, id, stats, shownAt, history, contentHash, registry](IToastNotification*, IToastDismissedEventArgs* e)
 					{
+						stats->increment(WinToastStats::Dismissed);
+						stats->record(WinToastStats::ShowToDismissal, shownAt, WinToastStats::now());
 						ToastDismissalReason reason;
 						if (SUCCEEDED(e->get_Reason(&reason)))
 						{
-							if (reason == ToastDismissalReason_UserCanceled && expirationTime && InternalDateTime::Now() >= expirationTime)
-								reason = ToastDismissalReason_TimedOut;
+							// A timed out toast moves to the Action Center and can still be activated from there.
+							const bool expired = expirationTime && InternalDateTime::Now() >= expirationTime;
+							reason = static_cast<ToastDismissalReason>(registry->dismissed(id, static_cast<WinToastRegistry::DismissalReason>(reason), expired));
+							WINTOAST_TRACE(Info, WinToastTrace::Dismissed, id, S_OK, static_cast<uint64_t>(reason));
+							history->write(WinToastHistory::Dismissed, id, contentHash, static_cast<int32_t>(reason));
 							eventHandler->toastDismissed(static_cast<IWinToastHandler::WinToastDismissalReason>(reason));
 						}
 						return S_OK;
@@ -303,8 +330,17 @@ namespace Util {
 			if (SUCCEEDED(hr)) {
 				hr = notification->add_Failed(Callback < Implements < RuntimeClassFlags<ClassicCom>,
 					ITypedEventHandler<ToastNotification*, ToastFailedEventArgs* >> >(
-						[eventHandler](IToastNotification*, IToastFailedEventArgs*)
+						[eventHandler, id, stats, history, contentHash, registry](IToastNotification*, IToastFailedEventArgs* e)
 						{
+							HRESULT errorCode = E_FAIL;
+							registry->remove(id);
+							stats->increment(WinToastStats::Failed);
+							if (SUCCEEDED(e->get_ErrorCode(&errorCode))) {
+								stats->recordFailure(errorCode);
+							}
+							registry->setState(id, WinToastRegistry::Failed, errorCode);
+							WINTOAST_TRACE(Error, WinToastTrace::Failed, id, errorCode);
+							history->write(WinToastHistory::Failed, id, contentHash, errorCode);
 							eventHandler->toastFailed();
 							return S_OK;
 						}).Get(), &failedToken);
@@ -312,51 +348,6 @@ namespace Util {
 		}
 		return hr;
 	}
-
-    inline HRESULT addAttribute(_In_ IXmlDocument *xml, const std::wstring &name, IXmlNamedNodeMap *attributeMap) {
-		ComPtr<ABI::Windows::Data::Xml::Dom::IXmlAttribute> srcAttribute;
-		HRESULT hr = xml->CreateAttribute(WinToastStringWrapper(name).Get(), &srcAttribute);
-		if (SUCCEEDED(hr)) {
-			ComPtr<IXmlNode> node;
-			hr = srcAttribute.As(&node);
-			if (SUCCEEDED(hr)) {
-				ComPtr<IXmlNode> pNode;
-				hr = attributeMap->SetNamedItem(node.Get(), &pNode);
-			}
-		}
-		return hr;
-	}
-
-    inline HRESULT createElement(_In_ IXmlDocument *xml, _In_ const std::wstring& root_node, _In_ const std::wstring& element_name, _In_ const std::vector<std::wstring>& attribute_names) {
-		ComPtr<IXmlNodeList> rootList;
-		HRESULT hr = xml->GetElementsByTagName(WinToastStringWrapper(root_node).Get(), &rootList);
-		if (SUCCEEDED(hr)) {
-			ComPtr<IXmlNode> root;
-			hr = rootList->Item(0, &root);
-			if (SUCCEEDED(hr)) {
-				ComPtr<ABI::Windows::Data::Xml::Dom::IXmlElement> audioElement;
-				hr = xml->CreateElement(WinToastStringWrapper(element_name).Get(), &audioElement);
-				if (SUCCEEDED(hr)) {
-					ComPtr<IXmlNode> audioNodeTmp;
-					hr = audioElement.As(&audioNodeTmp);
-					if (SUCCEEDED(hr)) {
-						ComPtr<IXmlNode> audioNode;
-						hr = root->AppendChild(audioNodeTmp.Get(), &audioNode);
-						if (SUCCEEDED(hr)) {
-							ComPtr<IXmlNamedNodeMap> attributes;
-							hr = audioNode->get_Attributes(&attributes);
-							if (SUCCEEDED(hr)) {
-								for (const auto& it : attribute_names) {
-									hr = addAttribute(xml, it, attributes.Get());
-								}
-							}
-						}
-					}
-				}
-			}
-		}
-		return hr;
-	}
 }
 
 WinToast* WinToast::instance() {
@@ -366,14 +357,20 @@ WinToast* WinToast::instance() {
 
 WinToast::WinToast() :
 	m_isInitialized(false),
-	m_hasCoInitialized(false)
+	m_hasCoInitialized(false),
+	m_nextId(InternalDateTime::Now())
 {
 	if (!isCompatible()) {
 		DEBUG_MSG(L"Warning: Your system is not compatible with this library ");
 	}
+	m_activatedHandler = Callback<Implements<RuntimeClassFlags<ClassicCom>, ITypedEventHandler<ToastNotification*, IInspectable*>>>(
+		[this](IToastNotification*, IInspectable* inspectable) {
+			return activated(inspectable);
+		});
 }
 
 WinToast::~WinToast() {
+	releaseFactories();
 	if (m_hasCoInitialized) {
 		CoUninitialize();
 	}
@@ -385,6 +382,7 @@ void WinToast::setAppName(_In_ const std::wstring& appName) {
 
 void WinToast::setAppUserModelId(_In_ const std::wstring& aumi) {
 	m_aumi = aumi;
+	releaseFactories();
 	DEBUG_MSG(L"Default App User Model Id: " << m_aumi.c_str());
 }
 
@@ -426,20 +424,22 @@ std::wstring WinToast::configureAUMI(_In_ const std::wstring &companyName,
 }
 
 const std::wstring& WinToast::strerror(WinToastError error) {
-	static const std::unordered_map<WinToastError, std::wstring> Labels = {
-		{WinToastError::NoError, L"No error. The process was executed correctly"},
-		{WinToastError::NotInitialized, L"The library has not been initialized"},
-		{WinToastError::SystemNotSupported, L"The OS does not support WinToast"},
-		{WinToastError::ShellLinkNotCreated, L"The library was not able to create a Shell Link for the app"},
-		{WinToastError::InvalidAppUserModelID, L"The AUMI is not a valid one"},
-		{WinToastError::InvalidParameters, L"The parameters used to configure the library are not valid normally because an invalid AUMI or App Name"},
-		{WinToastError::NotDisplayed, L"The toast was created correctly but WinToast was not able to display the toast"},
-		{WinToastError::UnknownError, L"Unknown error"}
+	static const std::wstring Labels[] = {
+		L"No error. The process was executed correctly",
+		L"The library has not been initialized",
+		L"The OS does not support WinToast",
+		L"The library was not able to create a Shell Link for the app",
+		L"The AUMI is not a valid one",
+		L"The parameters used to configure the library are not valid normally because an invalid AUMI or App Name",
+		L"The handler used to show the toast is not valid",
+		L"The toast was created correctly but WinToast was not able to display the toast",
+		L"Unknown error"
 	};
+	static_assert(sizeof(Labels) / sizeof(Labels[0]) == WinToastError::UnknownError + 1, "error label table out of sync");
 
-	const auto iter = Labels.find(error);
-	assert(iter != Labels.end());
-	return iter->second;
+	const auto index = static_cast<std::size_t>(error);
+	assert(index <= WinToastError::UnknownError);
+	return Labels[index <= WinToastError::UnknownError ? index : WinToastError::UnknownError];
 }
 
 enum WinToast::ShortcutResult WinToast::createShortcut() {
@@ -463,6 +463,7 @@ bool WinToast::initialize(_Out_opt_ WinToastError* error) {
 
 	if (!isCompatible()) {
 		setError(error, WinToastError::SystemNotSupported);
+		WINTOAST_TRACE(Error, WinToastTrace::Initialize, -1, E_FAIL, WinToastError::SystemNotSupported);
 		DEBUG_MSG(L"Error: system not supported.");
 		return false;
 	}
@@ -470,6 +471,7 @@ bool WinToast::initialize(_Out_opt_ WinToastError* error) {
 
 	if (m_aumi.empty() || m_appName.empty()) {
 		setError(error, WinToastError::InvalidParameters);
+		WINTOAST_TRACE(Error, WinToastTrace::Initialize, -1, E_FAIL, WinToastError::InvalidParameters);
 		DEBUG_MSG(L"Error while initializing, did you set up a valid AUMI and App name?");
 		return false;
 	}
@@ -483,6 +485,7 @@ bool WinToast::initialize(_Out_opt_ WinToastError* error) {
 		HRESULT initHr = CoInitializeEx(nullptr, COINIT::COINIT_MULTITHREADED);
 		if (initHr != RPC_E_CHANGED_MODE) {
 			if (FAILED(initHr) && initHr != S_FALSE) {
+				WINTOAST_TRACE(Error, WinToastTrace::Initialize, -1, initHr);
 				DEBUG_MSG(L"Error on COM library initialization!");
 				return false;
 			}
@@ -495,6 +498,7 @@ bool WinToast::initialize(_Out_opt_ WinToastError* error) {
 	if (m_shortcutPolicy != SHORTCUT_POLICY_IGNORE) {
 		if (createShortcut() < 0) {
 			setError(error, WinToastError::ShellLinkNotCreated);
+			WINTOAST_TRACE(Error, WinToastTrace::Initialize, -1, E_FAIL, WinToastError::ShellLinkNotCreated);
 			DEBUG_MSG(L"Error while attaching the AUMI to the current proccess");
 			return false;
 		}
@@ -502,11 +506,13 @@ bool WinToast::initialize(_Out_opt_ WinToastError* error) {
 
 	if (FAILED(DllImporter::SetCurrentProcessExplicitAppUserModelID(m_aumi.c_str()))) {
 		setError(error, WinToastError::InvalidAppUserModelID);
+		WINTOAST_TRACE(Error, WinToastTrace::Initialize, -1, E_FAIL, WinToastError::InvalidAppUserModelID);
 		DEBUG_MSG(L"Error while attaching the AUMI to the current proccess");
 		return false;
 	}
 
 	m_isInitialized = true;
+	WINTOAST_TRACE(Info, WinToastTrace::Initialize, -1);
 	return m_isInitialized;
 }
 
@@ -720,551 +726,411 @@ HRESULT	WinToast::createShellLinkHelper() {
 	return hr;
 }
 
+INT64 WinToast::reserveId() {
+	return m_nextId.fetch_add(1, std::memory_order_relaxed);
+}
+
 INT64 WinToast::showToast(_In_ const WinToastTemplate& toast, _In_ std::shared_ptr<IWinToastHandler> handler, _Out_ WinToastError* error) {
-	setError(error, WinToastError::NoError);
-	INT64 id = -1;
+	return showToastWithId(reserveId(), toast, handler, error);
+}
+
+INT64 WinToast::showToastWithId(_In_ INT64 id, _In_ const WinToastTemplate& toast, _In_ std::shared_ptr<IWinToastHandler> handler, _Out_opt_ WinToastError* error, _Out_opt_ HRESULT* result) {
+	return show(id, toast, toast.group(), toast.key(), std::move(handler), error, result);
+}
+
+INT64 WinToast::showToast(_In_ WinToastTemplate&& toast, _In_ std::shared_ptr<IWinToastHandler> handler, _Out_opt_ WinToastError* error) {
+	return showToastWithId(reserveId(), std::move(toast), std::move(handler), error);
+}
+
+INT64 WinToast::showToastWithId(_In_ INT64 id, _In_ WinToastTemplate&& toast, _In_ std::shared_ptr<IWinToastHandler> handler, _Out_opt_ WinToastError* error, _Out_opt_ HRESULT* result) {
+	return show(id, toast, std::move(toast.m_group), std::move(toast.m_key), std::move(handler), error, result);
+}
+
+INT64 WinToast::show(_In_ INT64 id, _In_ const WinToastTemplate& toast, _In_ std::wstring group, _In_ std::wstring key,
+                     _In_ std::shared_ptr<IWinToastHandler> handler, _Out_opt_ WinToastError* error, _Out_opt_ HRESULT* result) {
+	PreparedToast prepared;
+	prepare(id, toast, std::move(group), std::move(key), std::move(handler), prepared);
+	return submitToast(prepared, error, result);
+}
+
+void WinToast::prepareToast(_In_ INT64 id, _In_ WinToastTemplate&& toast, _In_ std::shared_ptr<IWinToastHandler> handler, _Out_ PreparedToast& prepared) {
+	prepare(id, toast, std::move(toast.m_group), std::move(toast.m_key), std::move(handler), prepared);
+}
+
+void WinToast::prepare(_In_ INT64 id, _In_ const WinToastTemplate& toast, _In_ std::wstring group, _In_ std::wstring key,
+                       _In_ std::shared_ptr<IWinToastHandler> handler, _Out_ PreparedToast& prepared) {
+	prepared = PreparedToast();
+	prepared.id = id;
 	if (!isInitialized()) {
-		setError(error, WinToastError::NotInitialized);
+		prepared.error = WinToastError::NotInitialized;
+		prepared.hr = E_ILLEGAL_METHOD_CALL;
+		WINTOAST_TRACE(Error, WinToastTrace::ShowFailed, id, E_ILLEGAL_METHOD_CALL, WinToastError::NotInitialized);
 		DEBUG_MSG("Error when launching the toast. WinToast is not initialized.");
-		return id;
+		return;
 	}
 	if (!handler) {
-		setError(error, WinToastError::InvalidHandler);
+		prepared.error = WinToastError::InvalidHandler;
+		prepared.hr = E_INVALIDARG;
+		WINTOAST_TRACE(Error, WinToastTrace::ShowFailed, id, E_INVALIDARG, WinToastError::InvalidHandler);
 		DEBUG_MSG("Error when launching the toast. Handler cannot be nullptr.");
-		return id;
+		return;
 	}
 
+	prepared.accepted = true;
+	m_registry.setState(id, WinToastRegistry::Queued);
+	prepared.started = WinToastStats::now();
+	auto stageBegin = prepared.started;
 	ComPtr<IToastNotificationManagerStatics> notificationManager;
-	HRESULT hr = DllImporter::Wrap_GetActivationFactory(WinToastStringWrapper(RuntimeClass_Windows_UI_Notifications_ToastNotificationManager).Get(), &notificationManager);
+	ComPtr<IToastNotifier> notifier;
+	ComPtr<IToastNotificationFactory> notificationFactory;
+	HRESULT hr = factories(notificationManager, notifier, notificationFactory);
 	if (SUCCEEDED(hr)) {
-		ComPtr<IToastNotifier> notifier;
-		hr = notificationManager->CreateToastNotifierWithId(WinToastStringWrapper(m_aumi).Get(), &notifier);
-		if (SUCCEEDED(hr)) {
-			ComPtr<IToastNotificationFactory> notificationFactory;
-			hr = DllImporter::Wrap_GetActivationFactory(WinToastStringWrapper(RuntimeClass_Windows_UI_Notifications_ToastNotification).Get(), &notificationFactory);
-			if (SUCCEEDED(hr)) {
-				ComPtr<IXmlDocument> xmlDocument;
-				HRESULT hr = notificationManager->GetTemplateContent(ToastTemplateType(toast.type()), &xmlDocument);
-				if (SUCCEEDED(hr)) {
-					for (UINT32 i = 0, fieldsCount = static_cast<UINT32>(toast.textFieldsCount()); i < fieldsCount && SUCCEEDED(hr); i++) {
-						hr = setTextFieldHelper(xmlDocument.Get(), toast.textField(WinToastTemplate::TextField(i)), i);
-					}
-
-					// Modern feature are supported Windows > Windows 10
-					if (SUCCEEDED(hr) && isSupportingModernFeatures()) {
-
-						// Note that we do this *after* using toast.textFieldsCount() to
-						// iterate/fill the template's text fields, since we're adding yet another text field.
-						if (SUCCEEDED(hr)
-							&& !toast.attributionText().empty()) {
-							hr = setAttributionTextFieldHelper(xmlDocument.Get(), toast.attributionText());
-						}
-
-						std::array<WCHAR, 12> buf;
-						for (std::size_t i = 0, actionsCount = toast.actionsCount(); i < actionsCount && SUCCEEDED(hr); i++) {
-							_snwprintf_s(buf.data(), buf.size(), _TRUNCATE, L"%zd", i);
-							hr = addActionHelper(xmlDocument.Get(), toast.actionLabel(i), buf.data());
-						}
+		stageBegin = m_stats.lap(WinToastStats::FactoryLookup, stageBegin);
+		// Modern feature are supported Windows > Windows 10
+		const bool modernFeatures = isSupportingModernFeatures();
+		if (!modernFeatures) {
+			DEBUG_MSG("Modern features (Actions/Sounds/Attributes) not supported in this os version");
+		}
 
-						if (SUCCEEDED(hr)) {
-							hr = (toast.audioPath().empty() && toast.audioOption() == WinToastTemplate::AudioOption::Default)
-								? hr : setAudioFieldHelper(xmlDocument.Get(), toast.audioPath(), toast.audioOption());
-						}
+		// Text over budget is shortened on a copy, templates that fit are composed as they are.
+		WinToastTemplate shortened;
+		const WinToastTemplate& composed = m_textBudget.load(std::memory_order_relaxed) && Util::shortenText(toast, shortened) ? shortened : toast;
 
-						if (SUCCEEDED(hr) && toast.duration() != WinToastTemplate::Duration::System) {
-							hr = addDurationHelper(xmlDocument.Get(),
-								(toast.duration() == WinToastTemplate::Duration::Short) ? L"short" : L"long");
-						}
+		const std::wstring launchArguments = WinToastArguments::encode(id, WinToastArguments::BodyAction, toast.activationToken());
+		std::vector<std::wstring> actionArguments;
+		if (modernFeatures) {
+			actionArguments.reserve(toast.actionsCount());
+			for (std::size_t i = 0, actionsCount = toast.actionsCount(); i < actionsCount; i++) {
+				actionArguments.push_back(WinToastArguments::encode(id, static_cast<int>(i), toast.activationToken()));
+			}
+		}
 
-						if (SUCCEEDED(hr)) {
-							hr = addScenarioHelper(xmlDocument.Get(), toast.scenario());
-						}
+		// The spans and the flattened XML only live until the document is parsed, so both come from one arena per show.
+		WinToastArena arena;
+		const WinToastXml composer(composed, launchArguments, actionArguments, modernFeatures, &arena);
+		const std::size_t length = composer.length();
+		wchar_t* xml = static_cast<wchar_t*>(arena.allocate((length + 1) * sizeof(wchar_t), alignof(wchar_t)));
+		xml[composer.write(xml, length)] = L'\0';
+		ComPtr<IXmlDocument> xmlDocument;
+		hr = loadXml(xml, static_cast<UINT32>(length), xmlDocument);
+		if (SUCCEEDED(hr)) {
+			stageBegin = m_stats.lap(WinToastStats::XmlBuild, stageBegin);
+			ComPtr<IToastNotification> notification;
+			hr = notificationFactory->CreateToastNotification(xmlDocument.Get(), &notification);
+			if (SUCCEEDED(hr)) {
+				stageBegin = m_stats.lap(WinToastStats::CreateNotification, stageBegin);
+				const uint64_t hash = m_history.isOpen() ? Util::contentHash(toast) : 0;
+				INT64 expiration = 0, relativeExpiration = toast.expiration();
+				if (relativeExpiration > 0) {
+					InternalDateTime expirationDateTime(relativeExpiration);
+					expiration = expirationDateTime;
+					hr = notification->put_ExpirationTime(&expirationDateTime);
+				}
 
-                    } else {
-						DEBUG_MSG("Modern features (Actions/Sounds/Attributes) not supported in this os version");
+				if (SUCCEEDED(hr)) {
+					WINTOAST_TRACE(Debug, WinToastTrace::ShowBegin, id, S_OK, static_cast<uint64_t>(toast.type()));
+					hr = Util::setEventHandlers(notification.Get(), handler, expiration, id, &m_stats, stageBegin, &m_history, hash,
+					                            m_activatedHandler.Get(), &m_registry);
+					if (FAILED(hr)) {
+						prepared.error = WinToastError::InvalidHandler;
 					}
+				}
 
-					if (SUCCEEDED(hr)) {
-						hr = toast.hasImage() ? setImageFieldHelper(xmlDocument.Get(), toast.imagePath()) : hr;
-						if (SUCCEEDED(hr)) {
-							ComPtr<IToastNotification> notification;
-							hr = notificationFactory->CreateToastNotification(xmlDocument.Get(), &notification);
-							if (SUCCEEDED(hr)) {
-								INT64 expiration = 0, relativeExpiration = toast.expiration();
-								if (relativeExpiration > 0) {
-									InternalDateTime expirationDateTime(relativeExpiration);
-									expiration = expirationDateTime;
-									hr = notification->put_ExpirationTime(&expirationDateTime);
-								}
-
-								if (SUCCEEDED(hr)) {
-									hr = Util::setEventHandlers(notification.Get(), handler, expiration);
-									if (FAILED(hr)) {
-										setError(error, WinToastError::InvalidHandler);
-									}
-								}
-
-								if (SUCCEEDED(hr)) {
-									GUID guid;
-									hr = CoCreateGuid(&guid);
-									if (SUCCEEDED(hr)) {
-										id = guid.Data1;
-										m_buffer[id] = notification;
-										DEBUG_MSG("xml: " << Util::AsString(xmlDocument));
-										hr = notifier->Show(notification.Get());
-										if (FAILED(hr)) {
-											setError(error, WinToastError::NotDisplayed);
-										}
-									}
-								}
-							}
-						}
-					}
+				if (SUCCEEDED(hr)) {
+					prepared.stageBegin = m_stats.lap(WinToastStats::RegisterHandlers, stageBegin);
+					prepared.notification = std::move(notification);
+					prepared.handler = std::move(handler);
+					prepared.group = std::move(group);
+					prepared.key = std::move(key);
+					prepared.contentHash = hash;
+					prepared.priority = toast.priority();
+					prepared.bytes = Util::estimateBytes(toast);
 				}
 			}
 		}
 	}
-	return FAILED(hr) ? -1 : id;
+	prepared.hr = hr;
 }
 
-ComPtr<IToastNotifier> WinToast::notifier(_In_ bool* succeded) const {
-	ComPtr<IToastNotificationManagerStatics> notificationManager;
-	ComPtr<IToastNotifier> notifier;
-	HRESULT hr = DllImporter::Wrap_GetActivationFactory(WinToastStringWrapper(RuntimeClass_Windows_UI_Notifications_ToastNotificationManager).Get(), &notificationManager);
-	if (SUCCEEDED(hr)) {
-		hr = notificationManager->CreateToastNotifierWithId(WinToastStringWrapper(m_aumi).Get(), &notifier);
+INT64 WinToast::submitToast(_Inout_ PreparedToast& prepared, _Out_opt_ WinToastError* error, _Out_opt_ HRESULT* result) {
+	const INT64 id = prepared.id;
+	setError(error, prepared.error);
+	if (result) {
+		*result = prepared.hr;
 	}
-	*succeded = SUCCEEDED(hr);
-	return notifier;
-}
-
-bool WinToast::hideToast(_In_ INT64 id) {
-	if (!isInitialized()) {
-		DEBUG_MSG("Error when hiding the toast. WinToast is not initialized.");
-		return false;
+	if (!prepared.accepted) {
+		return -1;
 	}
 
-	if (m_buffer.find(id) != m_buffer.end()) {
+	HRESULT hr = prepared.hr;
+	if (SUCCEEDED(hr)) {
 		auto succeded = false;
 		auto notify = notifier(&succeded);
-		if (succeded) {
-			auto result = notify->Hide(m_buffer[id].Get());
-			m_buffer.erase(id);
-			return SUCCEEDED(result);
+		if (!succeded) {
+			hr = E_FAIL;
+		} else {
+			std::vector<WinToastRegistry::Removed> evicted;
+			m_registry.insert(id, WinToastRegistry::Entry{prepared.notification, prepared.handler, prepared.stageBegin, prepared.contentHash,
+			                                              prepared.priority, prepared.bytes, std::move(prepared.group), std::move(prepared.key)}, evicted);
+			hr = notify->Show(prepared.notification.Get());
+			m_stats.lap(WinToastStats::Show, prepared.stageBegin);
+			if (FAILED(hr)) {
+				m_registry.remove(id);
+				setError(error, WinToastError::NotDisplayed);
+			} else {
+				m_registry.setState(id, WinToastRegistry::Shown);
+				m_history.write(WinToastHistory::Shown, id, prepared.contentHash);
+			}
+			hideEvicted(notify.Get(), evicted);
 		}
 	}
-	return false;
-}
 
-void WinToast::clear() {
-	auto succeded = false;
-	auto notify = notifier(&succeded);
-	if (succeded) {
-		auto end = m_buffer.end();
-		for (auto it = m_buffer.begin(); it != end; ++it) {
-			notify->Hide(it->second.Get());
+	if (FAILED(hr)) {
+		m_registry.setState(id, WinToastRegistry::Failed, hr);
+		m_stats.increment(WinToastStats::Failed);
+		m_stats.recordFailure(hr);
+		WINTOAST_TRACE(Error, WinToastTrace::ShowFailed, id, hr);
+		if (result) {
+			*result = hr;
 		}
-		m_buffer.clear();
+		return -1;
 	}
+	WINTOAST_TRACE(Info, WinToastTrace::ShowEnd, id);
+	m_stats.increment(WinToastStats::Shown);
+	m_stats.record(WinToastStats::ShowTotal, prepared.started, WinToastStats::now());
+	return id;
 }
 
-//
-// Available as of Windows 10 Anniversary Update
-// Ref: https://docs.microsoft.com/en-us/windows/uwp/design/shell/tiles-and-notifications/adaptive-interactive-toasts
-//
-// NOTE: This will add a new text field, so be aware when iterating over
-//       the toast's text fields or getting a count of them.
-//
-HRESULT WinToast::setAttributionTextFieldHelper(_In_ IXmlDocument *xml, _In_ const std::wstring& text) {
-	Util::createElement(xml, L"binding", L"text", { L"placement" });
-	ComPtr<IXmlNodeList> nodeList;
-	HRESULT hr = xml->GetElementsByTagName(WinToastStringWrapper(L"text").Get(), &nodeList);
-	if (SUCCEEDED(hr)) {
-		UINT32 nodeListLength;
-		hr = nodeList->get_Length(&nodeListLength);
-		if (SUCCEEDED(hr)) {
-			for (UINT32 i = 0; i < nodeListLength; i++) {
-				ComPtr<IXmlNode> textNode;
-				hr = nodeList->Item(i, &textNode);
-				if (SUCCEEDED(hr)) {
-					ComPtr<IXmlNamedNodeMap> attributes;
-					hr = textNode->get_Attributes(&attributes);
-					if (SUCCEEDED(hr)) {
-						ComPtr<IXmlNode> editedNode;
-						if (SUCCEEDED(hr)) {
-							hr = attributes->GetNamedItem(WinToastStringWrapper(L"placement").Get(), &editedNode);
-							if (FAILED(hr) || !editedNode) {
-								continue;
-							}
-							hr = Util::setNodeStringValue(L"attribution", editedNode.Get(), xml);
-							if (SUCCEEDED(hr)) {
-								return setTextFieldHelper(xml, text, i);
-							}
-						}
-					}
-				}
-			}
-		}
-	}
-	return hr;
+WinToastStats& WinToast::stats() {
+	return m_stats;
 }
 
-HRESULT WinToast::addDurationHelper(_In_ IXmlDocument *xml, _In_ const std::wstring& duration) {
-	ComPtr<IXmlNodeList> nodeList;
-	HRESULT hr = xml->GetElementsByTagName(WinToastStringWrapper(L"toast").Get(), &nodeList);
-	if (SUCCEEDED(hr)) {
-		UINT32 length;
-		hr = nodeList->get_Length(&length);
-		if (SUCCEEDED(hr)) {
-			ComPtr<IXmlNode> toastNode;
-			hr = nodeList->Item(0, &toastNode);
-			if (SUCCEEDED(hr)) {
-				ComPtr<IXmlElement> toastElement;
-				hr = toastNode.As(&toastElement);
-				if (SUCCEEDED(hr)) {
-					hr = toastElement->SetAttribute(WinToastStringWrapper(L"duration").Get(),
-						WinToastStringWrapper(duration).Get());
-				}
-			}
-		}
-	}
-	return hr;
+WinToastHistory& WinToast::history() {
+	return m_history;
 }
 
-HRESULT WinToast::addScenarioHelper(_In_ IXmlDocument* xml, _In_ const std::wstring& scenario) {
-	ComPtr<IXmlNodeList> nodeList;
-	HRESULT hr = xml->GetElementsByTagName(WinToastStringWrapper(L"toast").Get(), &nodeList);
+HRESULT WinToast::activated(_In_ IInspectable* inspectable) {
+	ComPtr<IToastActivatedEventArgs> activatedEventArgs;
+	HRESULT hr = inspectable->QueryInterface(IID_PPV_ARGS(&activatedEventArgs));
+	HSTRING argumentsHandle = nullptr;
 	if (SUCCEEDED(hr)) {
-		UINT32 length;
-		hr = nodeList->get_Length(&length);
-		if (SUCCEEDED(hr)) {
-			ComPtr<IXmlNode> toastNode;
-			hr = nodeList->Item(0, &toastNode);
-			if (SUCCEEDED(hr)) {
-				ComPtr<IXmlElement> toastElement;
-				hr = toastNode.As(&toastElement);
-				if (SUCCEEDED(hr)) {
-					hr = toastElement->SetAttribute(WinToastStringWrapper(L"scenario").Get(),
-						WinToastStringWrapper(scenario).Get());
-				}
-			}
-		}
+		hr = activatedEventArgs->get_Arguments(&argumentsHandle);
 	}
-	return hr;
-}
 
-HRESULT WinToast::setTextFieldHelper(_In_ IXmlDocument *xml, _In_ const std::wstring& text, _In_ UINT32 pos) {
-	ComPtr<IXmlNodeList> nodeList;
-	HRESULT hr = xml->GetElementsByTagName(WinToastStringWrapper(L"text").Get(), &nodeList);
+	WinToastArguments::Decoded arguments{};
+	bool routed = false;
 	if (SUCCEEDED(hr)) {
-		ComPtr<IXmlNode> node;
-		hr = nodeList->Item(pos, &node);
-		if (SUCCEEDED(hr)) {
-			hr = Util::setNodeStringValue(text, node.Get(), xml);
-		}
+		UINT32 length = 0;
+		PCWSTR raw = DllImporter::WindowsGetStringRawBuffer(argumentsHandle, &length);
+		routed = WinToastArguments::decode(raw, length, arguments);
+		DllImporter::WindowsDeleteString(argumentsHandle);
+	}
+	if (!routed) {
+		WINTOAST_TRACE(Warning, WinToastTrace::Activated, -1, FAILED(hr) ? hr : E_INVALIDARG);
+		return S_OK;
 	}
-	return hr;
-}
 
-HRESULT WinToast::setImageFieldHelper(_In_ IXmlDocument *xml, _In_ const std::wstring& path) {
-	assert(path.size() < MAX_PATH);
+	WinToastRegistry::Entry entry;
+	if (!m_registry.find(arguments.id, entry)) {
+		WINTOAST_TRACE(Warning, WinToastTrace::Activated, arguments.id, E_NOT_SET, static_cast<uint64_t>(arguments.action));
+		return S_OK;
+	}
 
-	wchar_t imagePath[MAX_PATH] = L"file:///";
-	HRESULT hr = StringCchCatW(imagePath, MAX_PATH, path.c_str());
-	if (SUCCEEDED(hr)) {
-		ComPtr<IXmlNodeList> nodeList;
-		HRESULT hr = xml->GetElementsByTagName(WinToastStringWrapper(L"image").Get(), &nodeList);
-		if (SUCCEEDED(hr)) {
-			ComPtr<IXmlNode> node;
-			hr = nodeList->Item(0, &node);
-            if (SUCCEEDED(hr))  {
-				ComPtr<IXmlNamedNodeMap> attributes;
-				hr = node->get_Attributes(&attributes);
-				if (SUCCEEDED(hr)) {
-					ComPtr<IXmlNode> editedNode;
-					hr = attributes->GetNamedItem(WinToastStringWrapper(L"src").Get(), &editedNode);
-					if (SUCCEEDED(hr)) {
-						Util::setNodeStringValue(imagePath, editedNode.Get(), xml);
-					}
-				}
-			}
-		}
+	m_registry.setState(arguments.id, WinToastRegistry::Activated, arguments.action);
+	m_stats.increment(WinToastStats::Activated);
+	m_stats.record(WinToastStats::ShowToActivation, entry.shownAt, WinToastStats::now());
+	WINTOAST_TRACE(Info, WinToastTrace::Activated, arguments.id, S_OK, static_cast<uint64_t>(arguments.action));
+	m_history.write(WinToastHistory::Activated, arguments.id, entry.contentHash, arguments.action);
+	if (arguments.action == WinToastArguments::BodyAction) {
+		entry.handler->toastActivated();
+	} else {
+		entry.handler->toastActivated(arguments.action);
 	}
-	return hr;
+	return S_OK;
 }
 
-HRESULT WinToast::setAudioFieldHelper(_In_ IXmlDocument *xml, _In_ const std::wstring& path, _In_opt_ WinToastTemplate::AudioOption option) {
-	std::vector<std::wstring> attrs;
-	if (!path.empty()) attrs.push_back(L"src");
-	if (option == WinToastTemplate::AudioOption::Loop) attrs.push_back(L"loop");
-	if (option == WinToastTemplate::AudioOption::Silent) attrs.push_back(L"silent");
-	Util::createElement(xml, L"toast", L"audio", attrs);
-
-	ComPtr<IXmlNodeList> nodeList;
-	HRESULT hr = xml->GetElementsByTagName(WinToastStringWrapper(L"audio").Get(), &nodeList);
-	if (SUCCEEDED(hr)) {
-		ComPtr<IXmlNode> node;
-		hr = nodeList->Item(0, &node);
-		if (SUCCEEDED(hr)) {
-			ComPtr<IXmlNamedNodeMap> attributes;
-			hr = node->get_Attributes(&attributes);
-			if (SUCCEEDED(hr)) {
-				ComPtr<IXmlNode> editedNode;
-				if (!path.empty()) {
-					if (SUCCEEDED(hr)) {
-						hr = attributes->GetNamedItem(WinToastStringWrapper(L"src").Get(), &editedNode);
-						if (SUCCEEDED(hr)) {
-							hr = Util::setNodeStringValue(path, editedNode.Get(), xml);
-						}
-					}
-				}
-
-				if (SUCCEEDED(hr)) {
-					switch (option) {
-					case WinToastTemplate::AudioOption::Loop:
-						hr = attributes->GetNamedItem(WinToastStringWrapper(L"loop").Get(), &editedNode);
-						if (SUCCEEDED(hr)) {
-							hr = Util::setNodeStringValue(L"true", editedNode.Get(), xml);
-						}
-						break;
-					case WinToastTemplate::AudioOption::Silent:
-						hr = attributes->GetNamedItem(WinToastStringWrapper(L"silent").Get(), &editedNode);
-						if (SUCCEEDED(hr)) {
-							hr = Util::setNodeStringValue(L"true", editedNode.Get(), xml);
-						}
-					default:
-						break;
-					}
-				}
-			}
+// Parses the composed XML into a new document, instead of editing the template the notification manager hands out.
+HRESULT WinToast::loadXml(_In_reads_(length) PCWSTR xml, _In_ UINT32 length, _Out_ ComPtr<IXmlDocument>& document) const {
+	ComPtr<IActivationFactory> factory;
+	HRESULT hr = S_OK;
+	{
+		std::lock_guard<std::mutex> lock(m_factoriesLock);
+		if (!m_xmlDocumentFactory) {
+			hr = DllImporter::Wrap_GetActivationFactory(WinToastStringWrapper(RuntimeClass_Windows_Data_Xml_Dom_XmlDocument).Get(), &m_xmlDocumentFactory);
 		}
+		factory = m_xmlDocumentFactory;
 	}
-	return hr;
-}
 
-HRESULT WinToast::addActionHelper(_In_ IXmlDocument *xml, _In_ const std::wstring& content, _In_ const std::wstring& arguments) {
-	ComPtr<IXmlNodeList> nodeList;
-	HRESULT hr = xml->GetElementsByTagName(WinToastStringWrapper(L"actions").Get(), &nodeList);
+	ComPtr<IInspectable> inspectable;
 	if (SUCCEEDED(hr)) {
-		UINT32 length;
-		hr = nodeList->get_Length(&length);
-		if (SUCCEEDED(hr)) {
-			ComPtr<IXmlNode> actionsNode;
-			if (length > 0) {
-				hr = nodeList->Item(0, &actionsNode);
-            } else {
-				hr = xml->GetElementsByTagName(WinToastStringWrapper(L"toast").Get(), &nodeList);
-				if (SUCCEEDED(hr)) {
-					hr = nodeList->get_Length(&length);
-					if (SUCCEEDED(hr)) {
-						ComPtr<IXmlNode> toastNode;
-						hr = nodeList->Item(0, &toastNode);
-						if (SUCCEEDED(hr)) {
-							ComPtr<IXmlElement> toastElement;
-							hr = toastNode.As(&toastElement);
-							if (SUCCEEDED(hr))
-								hr = toastElement->SetAttribute(WinToastStringWrapper(L"template").Get(), WinToastStringWrapper(L"ToastGeneric").Get());
-							if (SUCCEEDED(hr))
-								hr = toastElement->SetAttribute(WinToastStringWrapper(L"duration").Get(), WinToastStringWrapper(L"long").Get());
-							if (SUCCEEDED(hr)) {
-								ComPtr<IXmlElement> actionsElement;
-								hr = xml->CreateElement(WinToastStringWrapper(L"actions").Get(), &actionsElement);
-								if (SUCCEEDED(hr)) {
-									hr = actionsElement.As(&actionsNode);
-									if (SUCCEEDED(hr)) {
-										ComPtr<IXmlNode> appendedChild;
-										hr = toastNode->AppendChild(actionsNode.Get(), &appendedChild);
-									}
-								}
-							}
-						}
-					}
-				}
-			}
-			if (SUCCEEDED(hr)) {
-				ComPtr<IXmlElement> actionElement;
-				hr = xml->CreateElement(WinToastStringWrapper(L"action").Get(), &actionElement);
-				if (SUCCEEDED(hr))
-					hr = actionElement->SetAttribute(WinToastStringWrapper(L"content").Get(), WinToastStringWrapper(content).Get());
-				if (SUCCEEDED(hr))
-					hr = actionElement->SetAttribute(WinToastStringWrapper(L"arguments").Get(), WinToastStringWrapper(arguments).Get());
-				if (SUCCEEDED(hr)) {
-					ComPtr<IXmlNode> actionNode;
-					hr = actionElement.As(&actionNode);
-					if (SUCCEEDED(hr)) {
-						ComPtr<IXmlNode> appendedChild;
-						hr = actionsNode->AppendChild(actionNode.Get(), &appendedChild);
-					}
-				}
-			}
-		}
+		hr = factory->ActivateInstance(&inspectable);
+	}
+	if (SUCCEEDED(hr)) {
+		hr = inspectable.As(&document);
+	}
+	ComPtr<IXmlDocumentIO> documentIO;
+	if (SUCCEEDED(hr)) {
+		hr = document.As(&documentIO);
+	}
+	if (SUCCEEDED(hr)) {
+		hr = documentIO->LoadXml(WinToastStringWrapper(xml, length).Get());
 	}
 	return hr;
 }
 
-void WinToast::setError(_Out_opt_ WinToastError* error, _In_ WinToastError value) {
-	if (error) {
-		*error = value;
+HRESULT WinToast::factories(_Out_ ComPtr<IToastNotificationManagerStatics>& notificationManager, _Out_ ComPtr<IToastNotifier>& notifier,
+                            _Out_ ComPtr<IToastNotificationFactory>& notificationFactory) const {
+	std::lock_guard<std::mutex> lock(m_factoriesLock);
+	HRESULT hr = S_OK;
+	if (!m_notificationManager) {
+		hr = DllImporter::Wrap_GetActivationFactory(WinToastStringWrapper(RuntimeClass_Windows_UI_Notifications_ToastNotificationManager).Get(), &m_notificationManager);
 	}
-}
-
-void WinToast::setShellLinkToCopy(_In_ const std::wstring& path) {
-	this->m_originalShellLinkPath = path;
-}
-
-WinToastTemplate::WinToastTemplate(_In_ WinToastTemplateType type) : m_type(type) {
-    static constexpr std::size_t TextFieldsCount[] = { 1, 2, 2, 3, 1, 2, 2, 3};
-	m_textFields = std::vector<std::wstring>(TextFieldsCount[type], L"");
-}
-
-WinToastTemplate::~WinToastTemplate() {
-	m_textFields.clear();
-}
-
-void WinToastTemplate::setTextField(_In_ const std::wstring& txt, _In_ WinToastTemplate::TextField pos) {
-	const auto position = static_cast<std::size_t>(pos);
-	assert(position < m_textFields.size());
-	m_textFields[position] = txt;
-}
-
-void WinToastTemplate::setImagePath(_In_ const std::wstring& imgPath) {
-	m_imagePath = imgPath;
-}
-
-void WinToastTemplate::setAudioPath(_In_ const std::wstring& audioPath) {
-	m_audioPath = audioPath;
-}
-
-void WinToastTemplate::setAudioPath(_In_ AudioSystemFile file) {
-	static const std::unordered_map<AudioSystemFile, std::wstring> Files = {
-		{AudioSystemFile::DefaultSound, L"ms-winsoundevent:Notification.Default"},
-		{AudioSystemFile::IM, L"ms-winsoundevent:Notification.IM"},
-		{AudioSystemFile::Mail, L"ms-winsoundevent:Notification.Mail"},
-		{AudioSystemFile::Reminder, L"ms-winsoundevent:Notification.Reminder"},
-		{AudioSystemFile::SMS, L"ms-winsoundevent:Notification.SMS"},
-		{AudioSystemFile::Alarm, L"ms-winsoundevent:Notification.Looping.Alarm"},
-		{AudioSystemFile::Alarm2, L"ms-winsoundevent:Notification.Looping.Alarm2"},
-		{AudioSystemFile::Alarm3, L"ms-winsoundevent:Notification.Looping.Alarm3"},
-		{AudioSystemFile::Alarm4, L"ms-winsoundevent:Notification.Looping.Alarm4"},
-		{AudioSystemFile::Alarm5, L"ms-winsoundevent:Notification.Looping.Alarm5"},
-		{AudioSystemFile::Alarm6, L"ms-winsoundevent:Notification.Looping.Alarm6"},
-		{AudioSystemFile::Alarm7, L"ms-winsoundevent:Notification.Looping.Alarm7"},
-		{AudioSystemFile::Alarm8, L"ms-winsoundevent:Notification.Looping.Alarm8"},
-		{AudioSystemFile::Alarm9, L"ms-winsoundevent:Notification.Looping.Alarm9"},
-		{AudioSystemFile::Alarm10, L"ms-winsoundevent:Notification.Looping.Alarm10"},
-		{AudioSystemFile::Call, L"ms-winsoundevent:Notification.Looping.Call"},
-		{AudioSystemFile::Call1, L"ms-winsoundevent:Notification.Looping.Call1"},
-		{AudioSystemFile::Call2, L"ms-winsoundevent:Notification.Looping.Call2"},
-		{AudioSystemFile::Call3, L"ms-winsoundevent:Notification.Looping.Call3"},
-		{AudioSystemFile::Call4, L"ms-winsoundevent:Notification.Looping.Call4"},
-		{AudioSystemFile::Call5, L"ms-winsoundevent:Notification.Looping.Call5"},
-		{AudioSystemFile::Call6, L"ms-winsoundevent:Notification.Looping.Call6"},
-		{AudioSystemFile::Call7, L"ms-winsoundevent:Notification.Looping.Call7"},
-		{AudioSystemFile::Call8, L"ms-winsoundevent:Notification.Looping.Call8"},
-		{AudioSystemFile::Call9, L"ms-winsoundevent:Notification.Looping.Call9"},
-		{AudioSystemFile::Call10, L"ms-winsoundevent:Notification.Looping.Call10"},
-	};
-	const auto iter = Files.find(file);
-	assert(iter != Files.end());
-	m_audioPath = iter->second;
-}
-
-void WinToastTemplate::setAudioOption(_In_ WinToastTemplate::AudioOption audioOption) {
-	m_audioOption = audioOption;
-}
-
-void WinToastTemplate::setFirstLine(_In_ const std::wstring &text) {
-	setTextField(text, WinToastTemplate::FirstLine);
-}
-
-void WinToastTemplate::setSecondLine(_In_ const std::wstring &text) {
-	setTextField(text, WinToastTemplate::SecondLine);
-}
-
-void WinToastTemplate::setThirdLine(_In_ const std::wstring &text) {
-	setTextField(text, WinToastTemplate::ThirdLine);
-}
-
-void WinToastTemplate::setDuration(_In_ Duration duration) {
-	m_duration = duration;
-}
-
-void WinToastTemplate::setExpiration(_In_ INT64 millisecondsFromNow) {
-	m_expiration = millisecondsFromNow;
-}
-
-void WinToastLib::WinToastTemplate::setScenario(Scenario scenario) {
-	switch (scenario) {
-	case Scenario::Default: m_scenario = L"Default"; break;
-	case Scenario::Alarm: m_scenario = L"Alarm"; break;
-	case Scenario::IncomingCall: m_scenario = L"IncomingCall"; break;
-	case Scenario::Reminder: m_scenario = L"Reminder"; break;
+	if (SUCCEEDED(hr) && !m_notifier) {
+		hr = m_notificationManager->CreateToastNotifierWithId(WinToastStringWrapper(m_aumi).Get(), &m_notifier);
+	}
+	if (SUCCEEDED(hr) && !m_notificationFactory) {
+		hr = DllImporter::Wrap_GetActivationFactory(WinToastStringWrapper(RuntimeClass_Windows_UI_Notifications_ToastNotification).Get(), &m_notificationFactory);
 	}
+	if (SUCCEEDED(hr)) {
+		notificationManager = m_notificationManager;
+		notifier = m_notifier;
+		notificationFactory = m_notificationFactory;
+	}
+	return hr;
 }
 
-void WinToastTemplate::setAttributionText(_In_ const std::wstring& attributionText) {
-	m_attributionText = attributionText;
+void WinToast::releaseFactories() {
+	std::lock_guard<std::mutex> lock(m_factoriesLock);
+	m_notificationFactory.Reset();
+	m_notifier.Reset();
+	m_notificationManager.Reset();
+	m_xmlDocumentFactory.Reset();
 }
 
-void WinToastTemplate::addAction(_In_ const std::wstring & label) {
-	m_actions.push_back(label);
+ComPtr<IToastNotifier> WinToast::notifier(_In_ bool* succeded) const {
+	ComPtr<IToastNotificationManagerStatics> notificationManager;
+	ComPtr<IToastNotifier> notifier;
+	ComPtr<IToastNotificationFactory> notificationFactory;
+	HRESULT hr = factories(notificationManager, notifier, notificationFactory);
+	*succeded = SUCCEEDED(hr);
+	return notifier;
 }
 
-std::size_t WinToastTemplate::textFieldsCount() const {
-	return m_textFields.size();
-}
+bool WinToast::hideToast(_In_ INT64 id) {
+	if (!isInitialized()) {
+		WINTOAST_TRACE(Warning, WinToastTrace::Hide, id, E_ILLEGAL_METHOD_CALL);
+		DEBUG_MSG("Error when hiding the toast. WinToast is not initialized.");
+		return false;
+	}
 
-std::size_t WinToastTemplate::actionsCount() const {
-	return m_actions.size();
+	auto succeded = false;
+	auto notify = notifier(&succeded);
+	WinToastRegistry::Entry entry;
+	if (succeded && m_registry.remove(id, &entry)) {
+		m_registry.setState(id, WinToastRegistry::Hidden);
+		auto result = notify->Hide(entry.notification.Get());
+		WINTOAST_TRACE(Info, WinToastTrace::Hide, id, result);
+		return SUCCEEDED(result);
+	}
+	WINTOAST_TRACE(Warning, WinToastTrace::Hide, id, E_INVALIDARG);
+	return false;
 }
 
-bool WinToastTemplate::hasImage() const {
-    return m_type <  WinToastTemplateType::Text01;
+std::size_t WinToast::hideGroup(_In_ const std::wstring& group, _In_ int source) {
+	std::vector<WinToastRegistry::Removed> removed;
+	if (isInitialized()) {
+		m_registry.removeGroup(group, removed, source);
+	}
+	return hideRemoved(removed);
 }
 
-const std::vector<std::wstring>& WinToastTemplate::textFields() const {
-	return m_textFields;
+std::size_t WinToast::hideByKey(_In_ const std::wstring& key, _In_ int source) {
+	std::vector<WinToastRegistry::Removed> removed;
+	if (isInitialized()) {
+		m_registry.removeKey(key, removed, source);
+	}
+	return hideRemoved(removed);
 }
 
-const std::wstring& WinToastTemplate::textField(_In_ TextField pos) const {
-	const auto position = static_cast<std::size_t>(pos);
-	assert(position < m_textFields.size());
-	return m_textFields[position];
+void WinToast::clear() {
+	auto succeded = false;
+	auto notify = notifier(&succeded);
+	if (succeded) {
+		std::vector<WinToastRegistry::Removed> removed;
+		m_registry.removeAll(removed);
+		for (const auto& entry : removed) {
+			m_registry.setState(entry.id, WinToastRegistry::Hidden);
+			notify->Hide(entry.notification.Get());
+		}
+		WINTOAST_TRACE(Info, WinToastTrace::Clear, -1, S_OK, removed.size());
+	}
 }
 
-const std::wstring& WinToastTemplate::actionLabel(_In_ std::size_t position) const {
-	assert(position < m_actions.size());
-	return m_actions[position];
+void WinToast::setCapacity(_In_ std::size_t maxCount, _In_ uint64_t maxBytes) {
+	std::vector<WinToastRegistry::Removed> evicted;
+	m_registry.setCapacity(maxCount, maxBytes, evicted);
+	if (!evicted.empty()) {
+		auto succeded = false;
+		auto notify = notifier(&succeded);
+		if (succeded) {
+			hideEvicted(notify.Get(), evicted);
+		}
+	}
 }
 
-const std::wstring& WinToastTemplate::imagePath() const {
-	return m_imagePath;
+void WinToast::setTextBudget(_In_ bool enabled) {
+	m_textBudget.store(enabled, std::memory_order_relaxed);
 }
 
-const std::wstring& WinToastTemplate::audioPath() const {
-	return m_audioPath;
+WinToastRegistry& WinToast::registry() {
+	return m_registry;
 }
 
-const std::wstring& WinToastTemplate::attributionText() const {
-	return m_attributionText;
+void WinToast::hideEvicted(_In_ IToastNotifier* notifier, _In_ const std::vector<WinToastRegistry::Removed>& evicted) {
+	for (const auto& entry : evicted) {
+		m_registry.setState(entry.id, WinToastRegistry::Hidden);
+		const HRESULT hr = notifier->Hide(entry.notification.Get());
+		WINTOAST_TRACE(Info, WinToastTrace::Evicted, entry.id, hr);
+	}
 }
 
-const std::wstring& WinToastLib::WinToastTemplate::scenario() const {
-	return m_scenario;
-}
+// Hides toasts that were already taken out of the registry, one notifier for all of them.
+std::size_t WinToast::hideRemoved(_In_ const std::vector<WinToastRegistry::Removed>& removed) {
+	if (removed.empty()) {
+		return 0;
+	}
 
-INT64 WinToastTemplate::expiration() const {
-	return m_expiration;
-}
+	auto succeded = false;
+	auto notify = notifier(&succeded);
+	if (!succeded) {
+		return 0;
+	}
 
-WinToastTemplate::WinToastTemplateType WinToastTemplate::type() const {
-	return m_type;
+	std::size_t hidden = 0;
+	for (const auto& entry : removed) {
+		m_registry.setState(entry.id, WinToastRegistry::Hidden);
+		const HRESULT hr = notify->Hide(entry.notification.Get());
+		WINTOAST_TRACE(Info, WinToastTrace::Hide, entry.id, hr);
+		if (SUCCEEDED(hr)) {
+			hidden++;
+		}
+	}
+	return hidden;
 }
 
-WinToastTemplate::AudioOption WinToastTemplate::audioOption() const {
-	return m_audioOption;
+//
+// Available as of Windows 10 Anniversary Update
+// Ref: https://docs.microsoft.com/en-us/windows/uwp/design/shell/tiles-and-notifications/adaptive-interactive-toasts
+//
+// NOTE: This will add a new text field, so be aware when iterating over
+//       the toast's text fields or getting a count of them.
+//
+void WinToast::setError(_Out_opt_ WinToastError* error, _In_ WinToastError value) {
+	if (error) {
+		*error = value;
+	}
 }
 
-WinToastTemplate::Duration WinToastTemplate::duration() const {
-	return m_duration;
+void WinToast::setShellLinkToCopy(_In_ const std::wstring& path) {
+	this->m_originalShellLinkPath = path;
 }
@@ -40,6 +40,14 @@
 #include <string.h>
 #include <vector>
 #include <map>
+#include <mutex>
+#include <atomic>
+#include "toast_stats.h"
+#include "toast_history.h"
+#include "toast_registry.h"
+#include "toast_handler.h"
+#include "toast_strings.h"
+#include "toast_template.h"
 using namespace Microsoft::WRL;
 using namespace ABI::Windows::Data::Xml::Dom;
 using namespace ABI::Windows::Foundation;
@@ -48,110 +56,13 @@ using namespace Windows::Foundation;
 
 namespace WinToastLib {
 
-    class IWinToastHandler {
-    public:
-        enum WinToastDismissalReason {
-            UserCanceled = ToastDismissalReason::ToastDismissalReason_UserCanceled,
-            ApplicationHidden = ToastDismissalReason::ToastDismissalReason_ApplicationHidden,
-            TimedOut = ToastDismissalReason::ToastDismissalReason_TimedOut
-        };
-        virtual ~IWinToastHandler() = default;
-        virtual void toastActivated() const = 0;
-        virtual void toastActivated(int actionIndex) const = 0;
-        virtual void toastDismissed(WinToastDismissalReason state) const = 0;
-        virtual void toastFailed() const = 0;
-    };
-
-    class WinToastTemplate {
-    public:
-        enum class Scenario { Default, Alarm, IncomingCall, Reminder };
-        enum Duration { System, Short, Long };
-        enum AudioOption { Default = 0, Silent, Loop };
-        enum TextField { FirstLine = 0, SecondLine, ThirdLine };
-        enum WinToastTemplateType {
-            ImageAndText01 = ToastTemplateType::ToastTemplateType_ToastImageAndText01, // Number of fields 1
-            ImageAndText02 = ToastTemplateType::ToastTemplateType_ToastImageAndText02, // Number of fields 2
-            ImageAndText03 = ToastTemplateType::ToastTemplateType_ToastImageAndText03, // Number of fields 2
-            ImageAndText04 = ToastTemplateType::ToastTemplateType_ToastImageAndText04, // Number of fields 3
-            Text01 = ToastTemplateType::ToastTemplateType_ToastText01, // Number of fields 1
-            Text02 = ToastTemplateType::ToastTemplateType_ToastText02, // Number of fields 2
-            Text03 = ToastTemplateType::ToastTemplateType_ToastText03, // Number of fields 2
-            Text04 = ToastTemplateType::ToastTemplateType_ToastText04, // Number of fields 3
-        };
-
-        enum AudioSystemFile {
-            DefaultSound,
-            IM,
-            Mail,
-            Reminder,
-            SMS,
-            Alarm,
-            Alarm2,
-            Alarm3,
-            Alarm4,
-            Alarm5,
-            Alarm6,
-            Alarm7,
-            Alarm8,
-            Alarm9,
-            Alarm10,
-            Call,
-            Call1,
-            Call2,
-            Call3,
-            Call4,
-            Call5,
-            Call6,
-            Call7,
-            Call8,
-            Call9,
-            Call10,
-        };
-
-
-        WinToastTemplate(_In_ WinToastTemplateType type = WinToastTemplateType::ImageAndText02);
-        ~WinToastTemplate();
-
-        void setFirstLine(_In_ const std::wstring& text);
-        void setSecondLine(_In_ const std::wstring& text);
-        void setThirdLine(_In_ const std::wstring& text);
-        void setTextField(_In_ const std::wstring& txt, _In_ TextField pos);
-        void setAttributionText(_In_ const std::wstring& attributionText);
-        void setImagePath(_In_ const std::wstring& imgPath);
-        void setAudioPath(_In_ WinToastTemplate::AudioSystemFile audio);
-        void setAudioPath(_In_ const std::wstring& audioPath);
-        void setAudioOption(_In_ WinToastTemplate::AudioOption audioOption);
-        void setDuration(_In_ Duration duration);
-        void setExpiration(_In_ INT64 millisecondsFromNow);
-        void setScenario(_In_ Scenario scenario);
-        void addAction(_In_ const std::wstring& label);
-
-        std::size_t textFieldsCount() const;
-        std::size_t actionsCount() const;
-        bool hasImage() const;
-        const std::vector<std::wstring>& textFields() const;
-        const std::wstring& textField(_In_ TextField pos) const;
-        const std::wstring& actionLabel(_In_ std::size_t pos) const;
-        const std::wstring& imagePath() const;
-        const std::wstring& audioPath() const;
-        const std::wstring& attributionText() const;
-        const std::wstring& scenario() const;
-        INT64 expiration() const;
-        WinToastTemplateType type() const;
-        WinToastTemplate::AudioOption audioOption() const;
-        Duration duration() const;
-    private:
-        std::vector<std::wstring>           m_textFields{};
-        std::vector<std::wstring>           m_actions{};
-        std::wstring                        m_imagePath{};
-        std::wstring                        m_audioPath{};
-        std::wstring                        m_attributionText{};
-        std::wstring                        m_scenario{L"Default"};
-        INT64                               m_expiration{0};
-        AudioOption                         m_audioOption{WinToastTemplate::AudioOption::Default};
-        WinToastTemplateType                m_type{WinToastTemplateType::Text01};
-        Duration                            m_duration{Duration::System};
-    };
+    static_assert(WinToastTemplate::ImageAndText01 == ToastTemplateType::ToastTemplateType_ToastImageAndText01
+                  && WinToastTemplate::Text01 == ToastTemplateType::ToastTemplateType_ToastText01
+                  && WinToastTemplate::Text04 == ToastTemplateType::ToastTemplateType_ToastText04, "template types mirror ToastTemplateType");
+    static_assert(WinToastTemplate::High + 1 == WinToastRegistry::PriorityCount, "priority count mismatch");
+    static_assert(WinToastRegistry::UserCanceled == ToastDismissalReason::ToastDismissalReason_UserCanceled
+                  && WinToastRegistry::ApplicationHidden == ToastDismissalReason::ToastDismissalReason_ApplicationHidden
+                  && WinToastRegistry::TimedOut == ToastDismissalReason::ToastDismissalReason_TimedOut, "dismissal reasons mirror ToastDismissalReason");
 
     class WinToast {
     public:
@@ -188,6 +99,23 @@ namespace WinToastLib {
             SHORTCUT_POLICY_REQUIRE_CREATE = 2,
         };
 
+        // A toast whose notification object is built but not yet handed to the notifier.
+        struct PreparedToast {
+            INT64                               id{-1};
+            bool                                accepted{false};    // passed the initialization and handler checks
+            WinToastError                       error{NoError};
+            HRESULT                             hr{S_OK};
+            ComPtr<IToastNotification>          notification;
+            std::shared_ptr<IWinToastHandler>   handler;
+            std::wstring                        group;
+            std::wstring                        key;
+            uint64_t                            contentHash{0};
+            WinToastTemplate::Priority          priority{WinToastTemplate::Priority::Normal};
+            std::size_t                         bytes{0};
+            WinToastStats::TimePoint            started{};
+            WinToastStats::TimePoint            stageBegin{};
+        };
+
         WinToast(void);
         virtual ~WinToast();
         static WinToast* instance();
@@ -201,9 +129,31 @@ namespace WinToastLib {
         virtual bool initialize(_Out_opt_ WinToastError* error = nullptr);
         virtual bool isInitialized() const;
         virtual bool hideToast(_In_ INT64 id);
+        // Hide all live toasts shown with the given group or key, only those with Ids of source unless it is
+        // WinToastRegistry::AnySource. Return the number of toasts hidden.
+        virtual std::size_t hideGroup(_In_ const std::wstring& group, _In_ int source = WinToastRegistry::AnySource);
+        virtual std::size_t hideByKey(_In_ const std::wstring& key, _In_ int source = WinToastRegistry::AnySource);
         virtual INT64 showToast(_In_ const WinToastTemplate &toast, _In_ std::shared_ptr<IWinToastHandler> handler, _Out_opt_ WinToastError *error = nullptr);
+        virtual INT64 showToastWithId(_In_ INT64 id, _In_ const WinToastTemplate &toast, _In_ std::shared_ptr<IWinToastHandler> handler,
+                                      _Out_opt_ WinToastError *error = nullptr, _Out_opt_ HRESULT *result = nullptr);
+        // Consuming overloads, strings the live toast keeps are moved out of the template instead of copied.
+        virtual INT64 showToast(_In_ WinToastTemplate &&toast, _In_ std::shared_ptr<IWinToastHandler> handler, _Out_opt_ WinToastError *error = nullptr);
+        virtual INT64 showToastWithId(_In_ INT64 id, _In_ WinToastTemplate &&toast, _In_ std::shared_ptr<IWinToastHandler> handler,
+                                      _Out_opt_ WinToastError *error = nullptr, _Out_opt_ HRESULT *result = nullptr);
+        // Showing in two steps: building the XML and notification object may run on several threads
+        // at once, submitting hands it to the notifier and reports failures of both steps.
+        void prepareToast(_In_ INT64 id, _In_ WinToastTemplate&& toast, _In_ std::shared_ptr<IWinToastHandler> handler, _Out_ PreparedToast& prepared);
+        INT64 submitToast(_Inout_ PreparedToast& prepared, _Out_opt_ WinToastError* error = nullptr, _Out_opt_ HRESULT* result = nullptr);
+        INT64 reserveId();
         virtual void clear();
         virtual enum ShortcutResult createShortcut();
+        WinToastStats& stats();
+        WinToastHistory& history();
+        WinToastRegistry& registry();
+        // Limits the number and estimated memory of live toasts, zero disables a limit. See WinToastRegistry.
+        void setCapacity(_In_ std::size_t maxCount, _In_ uint64_t maxBytes);
+        // Shortens text fields over their visible budget when toasts are prepared. See WinToastTextBudget.
+        void setTextBudget(_In_ bool enabled);
 
         const std::wstring& appName() const;
         const std::wstring& appUserModelId() const;
@@ -219,18 +169,33 @@ namespace WinToastLib {
         ShortcutPolicy                                  m_shortcutPolicy{SHORTCUT_POLICY_REQUIRE_CREATE};
         std::wstring                                    m_appName{};
         std::wstring                                    m_aumi{};
-        std::map<INT64, ComPtr<IToastNotification>>     m_buffer{};
+        WinToastRegistry                                m_registry;
+        ComPtr<ITypedEventHandler<ToastNotification*, IInspectable*>> m_activatedHandler;
         std::wstring                                    m_originalShellLinkPath;
+        WinToastStats                                   m_stats{};
+        WinToastHistory                                 m_history;
+        std::atomic<INT64>                              m_nextId{0};
+        std::atomic<bool>                               m_textBudget{false};
+        mutable std::mutex                              m_factoriesLock;
+        mutable ComPtr<IToastNotificationManagerStatics> m_notificationManager;
+        mutable ComPtr<IToastNotifier>                  m_notifier;
+        mutable ComPtr<IToastNotificationFactory>       m_notificationFactory;
+        mutable ComPtr<IActivationFactory>              m_xmlDocumentFactory;
 
         HRESULT createShellLinkHelper();
-        HRESULT setImageFieldHelper(_In_ IXmlDocument *xml, _In_ const std::wstring& path);
-        HRESULT setAudioFieldHelper(_In_ IXmlDocument *xml, _In_ const std::wstring& path, _In_opt_ WinToastTemplate::AudioOption option = WinToastTemplate::AudioOption::Default);
-        HRESULT setTextFieldHelper(_In_ IXmlDocument *xml, _In_ const std::wstring& text, _In_ UINT32 pos);
-        HRESULT setAttributionTextFieldHelper(_In_ IXmlDocument *xml, _In_ const std::wstring& text);
-        HRESULT addActionHelper(_In_ IXmlDocument *xml, _In_ const std::wstring& action, _In_ const std::wstring& arguments);
-        HRESULT addDurationHelper(_In_ IXmlDocument *xml, _In_ const std::wstring& duration);
-        HRESULT addScenarioHelper(_In_ IXmlDocument *xml, _In_ const std::wstring& scenario);
+        HRESULT activated(_In_ IInspectable* inspectable);
+        INT64 show(_In_ INT64 id, _In_ const WinToastTemplate& toast, _In_ std::wstring group, _In_ std::wstring key,
+                   _In_ std::shared_ptr<IWinToastHandler> handler, _Out_opt_ WinToastError* error, _Out_opt_ HRESULT* result);
+        void prepare(_In_ INT64 id, _In_ const WinToastTemplate& toast, _In_ std::wstring group, _In_ std::wstring key,
+                     _In_ std::shared_ptr<IWinToastHandler> handler, _Out_ PreparedToast& prepared);
+        void hideEvicted(_In_ IToastNotifier* notifier, _In_ const std::vector<WinToastRegistry::Removed>& evicted);
+        std::size_t hideRemoved(_In_ const std::vector<WinToastRegistry::Removed>& removed);
         ComPtr<IToastNotifier> notifier(_In_ bool *succeeded) const;
+        // xml must be zero-terminated after length characters.
+        HRESULT loadXml(_In_reads_(length) PCWSTR xml, _In_ UINT32 length, _Out_ ComPtr<IXmlDocument>& document) const;
+        HRESULT factories(_Out_ ComPtr<IToastNotificationManagerStatics>& notificationManager, _Out_ ComPtr<IToastNotifier>& notifier,
+                          _Out_ ComPtr<IToastNotificationFactory>& notificationFactory) const;
+        void releaseFactories();
         void setError(_Out_opt_ WinToastError *error, _In_ WinToastError value);
     };
 }